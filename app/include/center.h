@@ -0,0 +1,198 @@
+#ifndef H_CENTER
+#define H_CENTER
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "sl651/sl651.h"
+#include "vec/vec.h"
+#include "reactor.h"
+#include "metrics.h"
+#include "session_table.h"
+#include "dedup_filter.h"
+
+#define CENTER_FRAME_MAX_LEN (PACKAGE_HEAD_STX_LEN + PACKAGE_HEAD_STX_BODY_LEN_MASK + PACKAGE_TAIL_LEN)
+#define CENTER_CONN_OUT_MAX (64 * 1024) // 对端不读时，超过后断开
+#define CENTER_HANDLER_TABLE_SIZE 256   // 按功能码直接索引
+#define CENTER_LISTEN_BACKLOG 1024
+#define CENTER_IDLE_TIMEOUT 300 // s, 没有任何报文后断开
+#define CENTER_DEDUP_WINDOW 600 // s, 遥测站重发及主备信道重复上报的去重窗口
+#define CENTER_DEDUP_CAPACITY (1024 * 1024)
+
+    struct Center;
+    struct CenterConn;
+
+    /**
+     * 一个遥测站，按 RemoteStationAddr 索引，断线重连后沿用，直到 Center 析构
+     */
+    typedef struct CenterSession
+    {
+        RemoteStationAddr addr;
+        struct Center *center;
+        /**
+         * NULL: 离线
+         * 关闭的 conn 经 session 表的 Rcu 延迟释放: loop 线程直接读取，其他线程在
+         * Rcu_ReadLock(&center->sessions.rcu) 中读取，读临界区内 conn 有效，但只能在 conn 的 loop 线程中收发
+         */
+        struct CenterConn *conn;
+        int64_t lastSeen;        // s
+        MetricCounter framesIn;
+        void *data; // 由 handler 使用
+    } CenterSession;
+    typedef vec_t(CenterSession *) CenterSessionPtrVector;
+
+    /**
+     * 在连接所在的 loop 线程中调用，conn->session 已绑定
+     * @return false: 自动应答为 NAK
+     */
+    typedef bool (*CenterHandleFunc)(struct CenterConn *const conn, Package *const request);
+
+    // 上行报文的自动应答
+    typedef enum
+    {
+        CENTER_REPLY_NONE = 0,
+        CENTER_REPLY_CONFIRM = 1, // ETB: ACK, ETX: EOT 或 ESC
+    } CenterReplyMode;
+
+    typedef struct CenterConn
+    {
+        int fd;
+        struct Center *center;
+        ReactorShard *shard;
+        ReactorTask startTask; // 在 shard 中启动 watcher
+        ev_tstamp acceptedAt;  // acceptor 所在 loop 被唤醒的时间
+        ev_io watcher;
+        ev_timer idleWatcher;
+        CenterSession *session; // 当前报文的遥测站，收到第一个报文后绑定
+        // 一个连接上可能有多个遥测站，关闭时逐个解绑(已被其他连接接管的除外)
+        CenterSessionPtrVector sessions;
+        bool closing;           // 在处理完当前数据后关闭
+        // 未组成完整报文的数据
+        uint8_t in[CENTER_FRAME_MAX_LEN];
+        size_t inLen;
+        // 未写出的应答
+        uint8_t *out;
+        size_t outLen;
+        size_t outSize;
+        struct CenterConn *prev;
+        struct CenterConn *next;
+    } CenterConn;
+
+    /**
+     * 监听 socket，SO_REUSEPORT 时每个 loop 一个，由内核分配连接
+     */
+    typedef struct CenterAcceptor
+    {
+        int fd;
+        struct Center *center;
+        ReactorShard *shard; // 所在 loop
+        ev_io watcher;
+        ReactorTask startTask; // 在 shard 中启动 watcher
+    } CenterAcceptor;
+
+    // 每个 loop 的 accept 统计，按 shard id 索引
+    typedef struct
+    {
+        MetricCounter accepts;
+        MetricHistogram acceptLatency; // us, 从 loop 被唤醒到连接在所在 loop 中注册
+    } CenterLoopMetrics;
+
+    // loop 线程作为 session 表的 QSBR reader，阻塞前 offline
+    typedef struct
+    {
+        Rcu *rcu;
+        RcuReader *reader; // NULL: reader 已满，查找时加读锁
+    } CenterLoopReader;
+
+    /**
+     * 中心站: 连接分配到 N 个 loop，每个连接只在一个 loop 中处理
+     * reusePort: 每个 loop 一个 acceptor，连接留在 accept 它的 loop
+     * 否则: 一个 acceptor，连接按负载转交
+     */
+    typedef struct Center
+    {
+        ReactorPool pool;
+        uint16_t port;
+        CenterAcceptor *acceptors;
+        uint16_t acceptorCount;
+        bool reusePort;  // Listen 之前设置，默认在支持时开启，实际是否生效见 acceptorCount
+        bool steer;      // Listen 之前设置，按源端口 % loop 数分配连接，attach 失败时 Listen 后为 false
+        bool keepOnline; // 最后一包应答 ESC 而不是 EOT
+        CenterHandleFunc handlers[CENTER_HANDLER_TABLE_SIZE];
+        uint8_t replies[CENTER_HANDLER_TABLE_SIZE]; // CenterReplyMode
+        bool dedups[CENTER_HANDLER_TABLE_SIZE];     // 按功能码去重，dedup 为 NULL 时不生效
+        DedupFilter *dedup;
+        MetricCounter duplicates;
+        SessionTable sessions;
+        CenterLoopReader *loopReaders; // 按 shard id 索引
+        pthread_mutex_t mutex;         // conns
+        CenterConn *conns;
+        ChannelMetrics metrics;
+        CenterLoopMetrics *loopMetrics;
+    } Center;
+
+    /**
+     * @param loops 0 时为 1
+     */
+    void Center_ctor(Center *const me, uint16_t loops, bool pin);
+    void Center_dtor(Center *const me);
+    // Start 之前调用
+    CenterHandleFunc Center_SetHandler(Center *const me, FunctionCode code, CenterHandleFunc cb);
+    void Center_SetReply(Center *const me, FunctionCode code, CenterReplyMode mode);
+    /**
+     * 开启上报去重: 同一遥测站、功能码、内容(含观测时间)的报文在窗口内只分发一次
+     * 重复的报文不解码要素，照常确认；handler 返回 false 时允许重发的报文再次分发
+     * 默认对 TEST..PICTURE 去重，见 Center_SetDedup
+     */
+    bool Center_EnableDedup(Center *const me, uint32_t windowS, size_t capacity);
+    void Center_SetDedup(Center *const me, FunctionCode code, bool dedup);
+    /**
+     * @param host NULL: 所有地址
+     * @param port 0: 由系统分配，见 Center.port
+     */
+    bool Center_Listen(Center *const me, char const *const host, uint16_t port);
+    bool Center_Start(Center *const me);
+    void Center_Stop(Center *const me);
+    // MetricsRender, 用于 MetricsServer_Open
+    void Center_RenderMetrics(void *data, MetricsText *const text);
+    // for any thread
+    size_t Center_SessionCount(Center *const me);
+    CenterSession *Center_FindSession(Center *const me, RemoteStationAddr const *const addr);
+    // 预先加入遥测站名单，已存在时返回已有的 session
+    CenterSession *Center_AddSession(Center *const me, RemoteStationAddr const *const addr);
+    /**
+     * 名单固定后把 session 表重建为最小完美哈希，之后出现新的遥测站时自动退回开放寻址
+     */
+    bool Center_FreezeSessions(Center *const me);
+    /**
+     * 在 conn 所在的 loop 线程中调用，例如在 handler 中回复下行报文
+     * 不能立即写出的部分缓存，等待可写
+     */
+    bool CenterConn_Send(CenterConn *const me, uint8_t const *data, size_t len);
+    /**
+     * 从 buff 开头查找一个完整的报文
+     * @return >0: 报文长度，0: 数据不足，<0: 开头不是报文，丢弃 -n 字节后重试
+     */
+    int32_t Center_FrameLength(uint8_t const *buff, size_t len);
+    /**
+     * 编码上行报文的应答: 同中心站地址、功能码、流水号，多包时带包序号
+     * @return 读模式，NULL 为失败
+     */
+    ByteBuffer *Center_EncodeReply(Package const *const request, uint8_t etx);
+    /**
+     * 上行报文的去重指纹: 遥测站地址、功能码、包序号和正文
+     * 不含中心站地址、密码、流水号和发报时间，重发或经不同信道到达时相同
+     * @param frame 一个完整的报文，见 Center_FrameLength
+     */
+    uint64_t Center_ReportFingerprint(uint8_t const *frame, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,60 @@
+#ifndef H_CHECKPOINT
+#define H_CHECKPOINT
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+    /**
+     * 文件传输断点，记录已被中心站确认的最后一包
+     * 文件哈希/大小/修改时间/分包大小都一致时才能续传
+     */
+    typedef struct
+    {
+        uint64_t fileHash; // SentIndex_Hash(path)
+        uint64_t fileSize;
+        int64_t mtime;
+        uint32_t chunkSize;
+        uint16_t pkgCount;
+        uint16_t acked; // 1..acked 已确认
+        uint16_t seq;   // 第一包的流水号，续传时保持一致
+        uint32_t stamp; // 越大越新，满时替换最旧的
+    } TransferCheckpoint;
+
+#define CHECKPOINT_SLOTS 8
+#define CHECKPOINT_RECORD_LEN 48
+#define CHECKPOINT_MAGIC 0x4B43 // "CK"
+
+    /**
+     * 每个 channel 一个断点文件，固定 CHECKPOINT_SLOTS 个定长记录
+     * 更新时只覆盖对应的记录(pwrite)，不追加、不 fsync
+     */
+    typedef struct
+    {
+        TransferCheckpoint slots[CHECKPOINT_SLOTS];
+        uint32_t stamp;
+        char *file;
+        int fd;
+    } CheckpointStore;
+
+    void CheckpointStore_ctor(CheckpointStore *const me);
+    void CheckpointStore_dtor(CheckpointStore *const me);
+    // 加载断点文件，不存在时创建，损坏的记录被忽略
+    bool CheckpointStore_Open(CheckpointStore *const me, char const *const file);
+    /**
+     * 查找可以续传的断点
+     * @return NULL 没有或者文件已变化
+     */
+    TransferCheckpoint const *CheckpointStore_Find(CheckpointStore *const me, uint64_t fileHash,
+                                                   uint64_t fileSize, int64_t mtime, uint32_t chunkSize);
+    bool CheckpointStore_Save(CheckpointStore *const me, TransferCheckpoint const *const cp);
+    bool CheckpointStore_Remove(CheckpointStore *const me, uint64_t fileHash);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,62 @@
+#ifndef H_CONFIG_CACHE
+#define H_CONFIG_CACHE
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bytebuffer/bytebuffer.h"
+
+#define CONFIG_CACHE_MAGIC 0x43433136 // "61CC"
+// 编码格式变化时 +1，旧的缓存自动失效
+#define CONFIG_CACHE_FORMAT 1
+#define CONFIG_CACHE_HEADER_LEN 40
+#define CONFIG_CACHE_NULL_STRING 0xFFFF
+
+    // 生成缓存的源文件(config.json)
+    typedef struct
+    {
+        int64_t mtime;
+        uint64_t size;
+        uint64_t hash; // FNV-1a of content
+    } ConfigCacheSource;
+
+    /**
+     * 解析后的配置的二进制快照，启动时 mmap 读取，源文件 mtime / size / hash 都一致时才有效
+     * magic(4) format(4) mtime(8) size(8) hash(8) payloadLen(4) payloadHash(4), little endian
+     * payload 中的整数为小端，字符串为 len(2) + bytes + '\0'，可以直接引用映射的内存
+     */
+    typedef struct
+    {
+        void *map;
+        size_t mapLen;
+        uint8_t const *payload;
+        uint32_t len;
+        uint32_t pos;
+        bool error; // 越界或者格式错误
+    } ConfigCache;
+
+    uint64_t ConfigCache_Hash(uint8_t const *data, size_t len);
+    bool ConfigCacheSource_Stat(ConfigCacheSource *const me, char const *const file);
+    // @return false 不存在、已过期或者损坏
+    bool ConfigCache_Open(ConfigCache *const me, char const *const file, ConfigCacheSource const *const source);
+    void ConfigCache_dtor(ConfigCache *const me);
+    uint64_t ConfigCache_GetUInt(ConfigCache *const me, uint8_t size);
+    // 指向映射的内存，Close 之后失效; NULL: 写入时为 NULL 或者出错
+    char const *ConfigCache_GetString(ConfigCache *const me);
+    // 所有内容都被读取，且没有出错
+#define ConfigCache_IsComplete(ptr_) (!(ptr_)->error && (ptr_)->pos == (ptr_)->len)
+
+    void ConfigCache_PutUInt(ByteBuffer *const payload, uint64_t val, uint8_t size);
+    void ConfigCache_PutString(ByteBuffer *const payload, char const *const str);
+    // 先写临时文件再改名，payload 为 [0, position)
+    bool ConfigCache_Save(char const *const file, ConfigCacheSource const *const source, ByteBuffer *const payload);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,70 @@
+#ifndef H_DEDUP_FILTER
+#define H_DEDUP_FILTER
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define DEDUP_FILTER_STRIPES 16    // 按指纹高位分段加锁
+#define DEDUP_FILTER_GENERATIONS 4 // 环上的时间桶数，最老的一代被清空复用
+#define DEDUP_FILTER_MIN_SLOTS 64
+#define DEDUP_FILTER_COMMITTED (1ULL << 63) // 槽位中的标记位，指纹只使用低 63 位
+
+    typedef enum
+    {
+        DEDUP_NEW,       // 第一次出现，已记录为处理中
+        DEDUP_PENDING,   // 第一份还在处理中(例如在其他 loop 上)
+        DEDUP_DUPLICATE, // 第一份已处理完成
+    } DedupResult;
+
+    // 一个时间桶: 开放寻址的指纹集合，只在换代时整体清空
+    typedef struct
+    {
+        uint64_t *slots;
+        size_t count; // 含删除标记
+        int64_t start; // s
+    } DedupGeneration;
+
+    typedef struct
+    {
+        pthread_mutex_t mutex;
+        DedupGeneration generations[DEDUP_FILTER_GENERATIONS];
+        uint8_t current;
+    } DedupStripe;
+
+    /**
+     * 按时间分桶的指纹环，内存固定: STRIPES * GENERATIONS * slotCount * 8 字节
+     * 指纹至少保留 window 秒；写满时提前换代，窗口随之缩短
+     */
+    typedef struct
+    {
+        DedupStripe stripes[DEDUP_FILTER_STRIPES];
+        size_t slotCount; // 2^n
+        size_t maxCount;  // 负载因子 < 1/2
+        uint32_t span;    // s, 每一代的时长
+    } DedupFilter;
+
+    /**
+     * @param windowS 去重窗口
+     * @param capacity 窗口内需要记住的指纹数
+     */
+    void DedupFilter_ctor(DedupFilter *const me, uint32_t windowS, size_t capacity);
+    void DedupFilter_dtor(DedupFilter *const me);
+    /**
+     * 第一次出现时记录为处理中，处理完成后调用 DedupFilter_Commit，失败时调用 DedupFilter_Remove
+     */
+    DedupResult DedupFilter_Add(DedupFilter *const me, uint64_t fingerprint, int64_t now);
+    // 报文处理完成，之后的重复报文可以直接确认
+    void DedupFilter_Commit(DedupFilter *const me, uint64_t fingerprint);
+    // 报文处理失败，允许重发的报文再次通过
+    void DedupFilter_Remove(DedupFilter *const me, uint64_t fingerprint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
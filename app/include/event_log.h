@@ -0,0 +1,144 @@
+#ifndef H_EVENT_LOG
+#define H_EVENT_LOG
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+
+    typedef enum
+    {
+        EVENT_LEVEL_DEBUG,
+        EVENT_LEVEL_INFO,
+        EVENT_LEVEL_WARN,
+        EVENT_LEVEL_ERROR,
+        EVENT_LEVEL_OFF
+    } EventLevel;
+
+    typedef enum
+    {
+        EVENT_DATA_NONE,
+        EVENT_DATA_STR, // data 作为 fmt 的第一个参数(%s)
+        EVENT_DATA_HEX  // data 转为 hex 后作为 fmt 的第一个参数(%s)
+    } EventDataType;
+
+    /**
+     * 事件定义，格式化在 drainer 线程中进行
+     * args 都以 unsigned long long 传给 fmt，使用 %llu / %llX
+     */
+    typedef struct
+    {
+        uint8_t level;
+        uint8_t data; // EventDataType
+        char const *fmt;
+    } EventDef;
+
+#define EVENT_MAX_ARGS 5
+#define EVENT_DATA_LEN 40
+#define EVENT_NO_CHANNEL 0xFF
+
+    /**
+     * 定长二进制记录，二进制日志直接按此布局写出(host byte order)
+     */
+    typedef struct
+    {
+        uint64_t stamp; // ns, CLOCK_REALTIME
+        uint16_t event;
+        uint8_t level;
+        uint8_t channel;
+        uint8_t argc;
+        uint8_t dataLen;
+        uint8_t reserved[2];
+        uint64_t args[EVENT_MAX_ARGS];
+        uint8_t data[EVENT_DATA_LEN]; // 超长时截断
+    } EventRecord;
+
+#define EVENT_RING_SIZE 1024 // 2 的幂
+#define EVENT_LOG_DEFAULT_RATE 100
+#define EVENT_LOG_DRAIN_INTERVAL 10 // ms
+
+    typedef struct
+    {
+        uint32_t second;
+        uint32_t count;
+    } EventRate;
+
+    /**
+     * 每个线程一个，单生产者(所属线程) / 单消费者(drainer)
+     */
+    typedef struct EventRing
+    {
+        EventRecord records[EVENT_RING_SIZE];
+        size_t head; // producer
+        uint8_t pad[64];
+        size_t tail; // consumer
+        uint64_t dropped;    // ring 满
+        uint64_t suppressed; // 超过 rate
+        EventRate *rates;    // 按 event，只有所属线程访问
+        pthread_t owner;     // 所属线程
+        struct EventRing *next;
+    } EventRing;
+
+    /**
+     * 热路径只做 级别判断 + 限速 + 写入本线程的 ring，由后台线程格式化输出
+     * 没有 Start 时同步格式化输出(例如测试或启动前)
+     */
+    typedef struct
+    {
+        uint64_t id; // 区分线程缓存的 ring 属于哪个 EventLog
+        EventDef const *defs;
+        uint16_t count;
+        uint8_t level;
+        uint32_t rate; // 每个线程每个事件每秒最多记录的条数，0 不限制
+        EventRing *rings;
+        pthread_mutex_t outMutex; // 同步输出时使用
+        FILE *out;
+        int binaryFd; // >= 0 时写二进制记录
+        pthread_t *drainer;
+        bool stopping;
+        uint64_t reportedLost;
+    } EventLog;
+
+    void EventLog_ctor(EventLog *const me, EventDef const *defs, uint16_t count);
+    void EventLog_dtor(EventLog *const me);
+    /**
+     * 启动 drainer 线程
+     * @param binaryFile 非 NULL 时追加二进制记录到该文件，否则格式化输出到 out
+     */
+    bool EventLog_Start(EventLog *const me, FILE *out, char const *binaryFile);
+    // for any thread
+    void EventLog_Write(EventLog *const me, uint16_t event, uint8_t channel,
+                        uint64_t const *args, uint8_t argc, void const *data, size_t len);
+    // ring 满或限速丢弃的总数
+    uint64_t EventLog_Lost(EventLog *const me);
+#define EventLog_IsEnabled(ptr_, event_) ((ptr_)->defs[(event_)].level >= (ptr_)->level)
+#define EventLog_Emit(ptr_, event_, channel_, ...)                                                 \
+    do                                                                                             \
+    {                                                                                              \
+        if (EventLog_IsEnabled((ptr_), (event_)))                                                  \
+        {                                                                                          \
+            uint64_t const args_[] = {__VA_ARGS__};                                                \
+            EventLog_Write((ptr_), (event_), (channel_), args_, sizeof(args_) / sizeof(args_[0]), NULL, 0); \
+        }                                                                                          \
+    } while (0)
+#define EventLog_EmitData(ptr_, event_, channel_, data_, len_, ...)                                 \
+    do                                                                                              \
+    {                                                                                               \
+        if (EventLog_IsEnabled((ptr_), (event_)))                                                   \
+        {                                                                                           \
+            uint64_t const args_[] = {__VA_ARGS__};                                                 \
+            EventLog_Write((ptr_), (event_), (channel_), args_, sizeof(args_) / sizeof(args_[0]), (data_), (len_)); \
+        }                                                                                           \
+    } while (0)
+    // "debug" / "info" / "warn" / "error" / "off"
+    EventLevel EventLevel_FromString(char const *level, EventLevel defaultLevel);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
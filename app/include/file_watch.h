@@ -0,0 +1,40 @@
+#ifndef H_FILE_WATCH
+#define H_FILE_WATCH
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+    typedef void (*FileWatchNotify)(void *data);
+
+#define FILE_WATCH_POLL_INTERVAL 1000 // ms, 不支持 inotify 时比较 mtime / size
+
+    /**
+     * 监视单个文件，写完(close/rename 覆盖)后在 watcher 线程中回调
+     * 监视所在目录，编辑器先写临时文件再改名也能收到
+     */
+    typedef struct
+    {
+        char *dir;
+        char *name;
+        int inotifyFd;
+        int64_t mtime;
+        int64_t size;
+        pthread_t *thread;
+        bool stopping;
+        FileWatchNotify notify;
+        void *data;
+    } FileWatch;
+
+    bool FileWatch_Open(FileWatch *const me, char const *const file, FileWatchNotify notify, void *data);
+    void FileWatch_dtor(FileWatch *const me);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
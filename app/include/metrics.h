@@ -0,0 +1,108 @@
+#ifndef H_METRICS
+#define H_METRICS
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+    /**
+     * 计数器只做原子加，不加锁，任意线程更新，抓取时读取近似值
+     */
+    typedef uint64_t MetricCounter;
+#define Metric_Inc(ptr_) __atomic_fetch_add((ptr_), 1, __ATOMIC_RELAXED)
+#define Metric_Add(ptr_, n_) __atomic_fetch_add((ptr_), (n_), __ATOMIC_RELAXED)
+#define Metric_Get(ptr_) __atomic_load_n((ptr_), __ATOMIC_RELAXED)
+
+#define METRIC_HISTOGRAM_BUCKETS 10 // 最后一个为 +Inf
+    extern uint64_t const METRIC_HISTOGRAM_BOUNDS[METRIC_HISTOGRAM_BUCKETS - 1]; // us
+
+    // 固定分桶的耗时直方图，单位 us，buckets 不累加，输出时再累加
+    typedef struct
+    {
+        MetricCounter buckets[METRIC_HISTOGRAM_BUCKETS];
+        MetricCounter count;
+        MetricCounter sum;
+    } MetricHistogram;
+    void MetricHistogram_Observe(MetricHistogram *const me, uint64_t us);
+
+#define METRIC_MAX_ERROR_CODES 32 // 超出的错误码计入最后一个
+
+    typedef struct
+    {
+        MetricCounter framesIn;
+        MetricCounter bytesIn;
+        MetricCounter framesOut;
+        MetricCounter bytesOut;
+        MetricCounter decodeErrors[METRIC_MAX_ERROR_CODES];
+        MetricCounter sendBlocked; // 发送缓冲区满，等待可写
+        MetricCounter retransmits; // 文件包重发
+        MetricCounter connects;
+        MetricCounter disconnects;
+        MetricCounter fileBytes;
+        MetricCounter filesSent;
+        MetricCounter filesFailed;
+    } ChannelMetrics;
+#define ChannelMetrics_DecodeError(ptr_, code_) \
+    Metric_Inc(&(ptr_)->decodeErrors[(code_) < METRIC_MAX_ERROR_CODES ? (code_) : METRIC_MAX_ERROR_CODES - 1])
+
+#define METRIC_MAX_FUNC_CODES 256
+
+    typedef struct
+    {
+        // 按 FunctionCode 统计 handler 耗时，第一次使用时分配
+        MetricHistogram *handlerLatency[METRIC_MAX_FUNC_CODES];
+    } StationMetrics;
+    void StationMetrics_ctor(StationMetrics *const me);
+    void StationMetrics_dtor(StationMetrics *const me);
+    // for any thread
+    MetricHistogram *StationMetrics_Handler(StationMetrics *const me, uint8_t funcCode);
+
+    /**
+     * Prometheus text format(0.0.4) 输出
+     */
+    typedef struct
+    {
+        char *buff;
+        size_t len;
+        size_t size;
+    } MetricsText;
+    void MetricsText_ctor(MetricsText *const me);
+    void MetricsText_dtor(MetricsText *const me);
+    bool MetricsText_Printf(MetricsText *const me, char const *fmt, ...) __attribute__((format(printf, 2, 3)));
+    // # HELP / # TYPE，同名的 sample 需紧跟其后
+    void MetricsText_Family(MetricsText *const me, char const *name, char const *type, char const *help);
+    // @param labels 例如 channel="4"，可为 NULL
+    void MetricsText_Sample(MetricsText *const me, char const *name, char const *labels, uint64_t value);
+    void MetricsText_Histogram(MetricsText *const me, char const *name, char const *labels, MetricHistogram *const h);
+
+    typedef void (*MetricsRender)(void *data, MetricsText *const text);
+
+    /**
+     * 本地抓取端口，Unix socket 或 127.0.0.1:port，独立线程逐个应答
+     * HTTP GET 返回带头的响应，其他请求(例如 nc -U)直接返回文本
+     */
+    typedef struct
+    {
+        int fd;
+        char *socketPath; // 关闭时删除
+        pthread_t *thread;
+        bool stopping;
+        MetricsRender render;
+        void *data;
+    } MetricsServer;
+    /**
+     * @param socketPath 非 NULL 时监听 Unix socket，否则监听 127.0.0.1:port，Windows 上只支持 port
+     */
+    bool MetricsServer_Open(MetricsServer *const me, char const *socketPath, uint16_t port,
+                            MetricsRender render, void *data);
+    void MetricsServer_dtor(MetricsServer *const me);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,80 @@
+#ifndef H_OUTBOX
+#define H_OUTBOX
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "vec/vec.h"
+
+    /**
+     * 待发送文件目录(filesDir)，所有 channel 共享
+     * 启动时扫描一次，之后由 inotify 增量维护按文件名排序的队列
+     * 不支持 inotify 的平台由调用方定时 Outbox_Scan
+     */
+    typedef struct
+    {
+        char *name; // 指向 path 中的文件名
+        char path[];
+    } OutboxFile;
+    typedef vec_t(OutboxFile *) OutboxFilePtrVector;
+
+    typedef void (*OutboxNotify)(void *data);
+
+    typedef struct
+    {
+        char *dir;
+        OutboxFilePtrVector files; // sorted by name
+        // 加入过的最大文件名，新文件不大于它时 epoch + 1，所有 cursor 从头开始
+        char *last;
+        uint64_t epoch;
+        pthread_mutex_t mutex;
+        int inotifyFd;
+        pthread_t *watcher;
+        bool stopping;
+        // 有新文件时在 watcher 线程中回调
+        OutboxNotify notify;
+        void *notifyData;
+    } Outbox;
+
+    // 返回 true 时跳过该文件(例如 channel 已发送过)
+    typedef bool (*OutboxSkip)(void *ctx, char const *path);
+
+    /**
+     * 每个 channel 一个，记录已被 skip 的前缀，避免每次 Outbox_Next 都从头检查
+     * 要求 skip 过的文件在队列中一直被 skip(已发送的文件只在移出队列后才清除记录)
+     */
+    typedef struct
+    {
+        uint64_t epoch;
+        char *name; // 不大于 name 的文件都已被 skip，NULL 表示从头开始
+    } OutboxCursor;
+
+    void OutboxCursor_ctor(OutboxCursor *const me);
+    void OutboxCursor_dtor(OutboxCursor *const me);
+
+    bool Outbox_Open(Outbox *const me, char const *const dir, OutboxNotify notify, void *notifyData);
+    void Outbox_dtor(Outbox *const me);
+    // 重新扫描整个目录，替换队列
+    bool Outbox_Scan(Outbox *const me);
+    /**
+     * 取第一个未被 skip 的文件
+     * @param cursor 从 cursor 之后开始检查并前移，NULL 时从头开始
+     * @param path 复制出完整路径，队列中的文件随时可能被移除
+     */
+    bool Outbox_Next(Outbox *const me, OutboxCursor *const cursor, OutboxSkip skip, void *ctx,
+                     char *path, size_t size);
+    void Outbox_Add(Outbox *const me, char const *const name);
+    void Outbox_Remove(Outbox *const me, char const *const name);
+    size_t Outbox_Size(Outbox *const me);
+#define Outbox_IsWatching(ptr_) ((ptr_)->watcher != NULL)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,57 @@
+#ifndef H_PACKAGE_READER
+#define H_PACKAGE_READER
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "packet_creator.h"
+
+#define PACKAGE_READER_BUFF_SIZE 4096
+#define PACKAGE_READER_TOKEN_SIZE 64 // 字符串/数字的最大长度，超出的部分丢弃
+
+    typedef enum
+    {
+        PACKAGE_READER_OK = 0,
+        PACKAGE_READER_END = 1,
+        PACKAGE_READER_SYNTAX_ERROR = 2,
+    } PackageReaderStatus;
+
+    /**
+     * 流式读取 createPackage 的 JSON schema，不构造 cJSON
+     * 输入为单个对象、对象数组或连续的多个对象，每次 Next 返回一个
+     * 内存占用与文件大小无关: 读缓冲 + 一个 element 的值 + 当前报文的 element
+     */
+    typedef struct
+    {
+        FILE *file;
+        uint8_t const *window; // buff 或内存输入
+        uint8_t buff[PACKAGE_READER_BUFF_SIZE];
+        size_t len;
+        size_t pos;
+        bool inArray;
+        bool first; // 数组中的第一个元素
+        PackageReaderStatus status;
+        uint64_t offset; // window 在输入中的位置，出错时 offset + pos 定位
+        double values[ELEMENT_MAX_VALUES];
+        ElementPtrVector elements;
+    } PackageReader;
+
+    void PackageReader_ctor(PackageReader *const me, FILE *file);
+    void PackageReader_ctor_memory(PackageReader *const me, char const *data, size_t len);
+    void PackageReader_dtor(PackageReader *const me);
+    /**
+     * @param pkg 无效的 schema 为 NULL，与 createPackage 一致，可继续读取下一个
+     * @return false: 结束或语法错误，见 status
+     */
+    bool PackageReader_Next(PackageReader *const me, Package **pkg);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -11,6 +11,16 @@ extern "C"
 #include "tinydir/tinydir.h"
 #include "sl651/sl651.h"
 
+    // 不依赖 cJSON 的 Element 创建，参数无效时返回 NULL
+#define ELEMENT_MAX_VALUES 255 // NumberListElement 下标为 u8
+    Element *createNumberElement(uint8_t id, uint8_t vt, bool sign, double value);
+    Element *createTimeStepCodeElement(char const *step, uint8_t id, uint8_t vt, bool sign, double const *values, size_t count);
+    Element *createObserveTimeElement(char const *observetime);
+    Element *createDRP5MINElement(double const *values, size_t count);
+    Element *createRelativeWaterLevelElement(uint8_t id, double const *values, size_t count);
+    // 只创建报文头，observetime 为 10 位 hex，NULL 为当前时间
+    Package *createPackageHead(Direction direction, char const *observetime);
+
     // Element Creator，对应一个Element
     typedef struct
     {
@@ -59,6 +69,82 @@ extern "C"
 
     Package *createPackage(cJSON *const data);
 
+    // ReportTemplate
+    typedef enum
+    {
+        REPORT_SLOT_BCD = 0,       // number / time_step_code, v * 10^precision
+        REPORT_SLOT_DRP5MIN = 1,   // u8, v * 10, NaN 为 0xFF
+        REPORT_SLOT_WATER5MIN = 2, // BE u16, v * 100, NaN 为 0xFFFF
+    } ReportSlotKind;
+
+    // 一个值在报文中的位置
+    typedef struct
+    {
+        uint16_t offset;
+        uint8_t size;
+        uint8_t kind;
+        double scale;
+    } ReportSlot;
+
+    /**
+     * 编译后的上行报文模板，schema 只解析一次
+     * 按 schema 编码一次得到报文原型，记录每个值在报文中的位置，之后只改写这些字节
+     * 值的顺序与 schema elements 一致，数组类(time_step_code/rain_hour_5min/water_hour_5min)逐个展开，observetime 不占位
+     * 中心站地址/流水号/发报时间由 channel 发送前修改
+     */
+    typedef struct
+    {
+        ByteBuffer frame;
+        ReportSlot *slots;
+        uint16_t slotCount;
+        uint16_t observeTimeAt;        // 0: 使用 schema 中固定的观测时间
+        uint16_t stationAddrElementAt; // 0: 报文头不含遥测站地址
+        uint16_t categoryAt;           // 0: 报文头不含遥测站分类码
+    } ReportTemplate;
+
+    // 仅支持 STX 上行报文
+    bool ReportTemplate_Compile(ReportTemplate *const me, cJSON *const schema);
+    void ReportTemplate_dtor(ReportTemplate *const me);
+    void ReportTemplate_SetStation(ReportTemplate *const me, RemoteStationAddr const *const stationAddr, uint16_t password, uint8_t category);
+    /**
+     * 不分配内存，直接改写 frame 并更新 CRC
+     * @param values 个数为 ReportTemplate_ValueCount
+     * @return false: 有负值(模板不预留符号字节)，frame 不变
+     */
+    bool ReportTemplate_Fill(ReportTemplate *const me, double const *values);
+#define ReportTemplate_ValueCount(me_) ((me_)->slotCount)
+    // ReportTemplate END
+
+    // ReportSpec
+    // 一个数值要素，dataDef 高 5 位为字节数，低 3 位为小数位数
+    typedef struct
+    {
+        uint8_t id;
+        uint8_t dataDef;
+        double value;
+        bool supportSignedFlag; // 负值在 BCD 前加一个 0xFF 符号字节，false 时负值编码失败
+    } ReportField;
+
+    /**
+     * 上行数值要素报文，不经过 cJSON
+     * fields 由调用方持有，编码后即可复用
+     */
+    typedef struct
+    {
+        uint8_t funcCode;
+        ObserveTime const *observeTime; // NULL: 当前时间
+        ReportField const *fields;
+        uint16_t fieldCount;
+    } ReportSpec;
+
+    /**
+     * 直接编码为报文，只分配返回的 ByteBuffer，已 flip
+     * 中心站地址/流水号/发报时间为 0，由 channel 发送前修改
+     * @return NULL: dataDef 无效、报文过长或不支持符号位的要素为负值
+     */
+    ByteBuffer *ReportSpec_Encode(ReportSpec const *const me, RemoteStationAddr const *const stationAddr, uint16_t password, uint8_t category);
+    // ReportSpec END
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,81 @@
+#ifndef H_RCU
+#define H_RCU
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define RCU_MAX_READERS 64
+#define RCU_CACHE_LINE_SIZE 64
+
+    // 0: offline，不持有任何引用
+    typedef struct
+    {
+        uint64_t epoch;
+        uint8_t pad[RCU_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    } RcuReader;
+
+    typedef void (*RcuFree)(void *ptr);
+
+    typedef struct RcuRetired
+    {
+        void *ptr;
+        RcuFree free;
+        uint64_t epoch; // 被替换时的 epoch，所有 reader 都越过之后才能释放
+        struct RcuRetired *next;
+    } RcuRetired;
+
+    /**
+     * QSBR(quiescent-state-based reclamation)
+     * 读: 已注册的线程(event loop)直接 Rcu_Dereference，不加锁、不计数
+     *     loop 每次阻塞前 Rcu_Offline，唤醒后 Rcu_Online，此时不持有旧的指针
+     *     未注册的线程使用 Rcu_ReadLock / Rcu_ReadUnlock
+     * 写: Rcu_Publish 原子替换，旧对象在所有 reader 经过静止状态后释放
+     */
+    typedef struct
+    {
+        void *current;
+        uint64_t epoch; // 每次发布 +1
+        RcuReader readers[RCU_MAX_READERS];
+        bool used[RCU_MAX_READERS];
+        uint32_t inside; // 未注册线程的读临界区
+        RcuRetired *retired;
+        RcuFree free;
+        pthread_mutex_t mutex; // writers / register
+    } Rcu;
+
+    void Rcu_ctor(Rcu *const me, void *initial, RcuFree free);
+    // 释放当前及所有待回收的对象，调用时不能再有 reader
+    void Rcu_dtor(Rcu *const me);
+#define Rcu_Dereference(ptr_) __atomic_load_n(&(ptr_)->current, __ATOMIC_ACQUIRE)
+    /**
+     * 替换当前对象，旧对象延迟释放
+     * 并发的读-改-写由调用方串行化
+     */
+    void Rcu_Publish(Rcu *const me, void *next);
+    /**
+     * 延迟释放一个已不可达的对象(例如从当前对象中摘除的元素)
+     * 与 Rcu_Publish 的旧对象一样，所有 reader 经过静止状态后调用 free
+     */
+    void Rcu_Retire(Rcu *const me, void *ptr, RcuFree free);
+    // @return 还未释放的数量
+    size_t Rcu_Reclaim(Rcu *const me);
+    // 注册后处于 online 状态，NULL 表示已满
+    RcuReader *Rcu_Register(Rcu *const me);
+    void Rcu_Unregister(Rcu *const me, RcuReader *const reader);
+    void Rcu_Online(Rcu *const me, RcuReader *const reader);
+#define Rcu_Offline(reader_) __atomic_store_n(&(reader_)->epoch, 0, __ATOMIC_SEQ_CST)
+    // 已不再持有之前读到的指针
+#define Rcu_Quiescent(me_, reader_) Rcu_Online((me_), (reader_))
+#define Rcu_ReadLock(ptr_) __atomic_fetch_add(&(ptr_)->inside, 1, __ATOMIC_SEQ_CST)
+#define Rcu_ReadUnlock(ptr_) __atomic_fetch_sub(&(ptr_)->inside, 1, __ATOMIC_SEQ_CST)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
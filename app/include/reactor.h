@@ -0,0 +1,68 @@
+#ifndef H_REACTOR
+#define H_REACTOR
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "libev/ev.h"
+
+    typedef struct ev_loop Reactor;
+
+    /**
+     * 投递到 ReactorShard 的任务，由 loop 所在线程执行
+     * 同一个任务在执行前只会入队一次，重复投递会被合并
+     */
+    typedef struct ReactorTask
+    {
+        struct ReactorTask *next;
+        void (*run)(struct ReactorTask *const me);
+        void *data;
+        uint8_t queued;
+    } ReactorTask;
+    void ReactorTask_ctor(ReactorTask *const me, void (*run)(ReactorTask *const me), void *data);
+
+    /**
+     * 一个 ev_loop + 一个线程，多个 Channel 共享
+     * tasks 是无锁的 MPSC 栈，任意线程投递，loop 线程一次取走
+     */
+    typedef struct
+    {
+        uint16_t id;
+        int16_t cpu; // -1 不绑定
+        Reactor *loop;
+        pthread_t *thread;
+        ev_async wakeup;
+        ReactorTask *tasks;
+        uint8_t stopping;
+        size_t load; // 分配到这个 loop 上的 channel 数量
+    } ReactorShard;
+    void ReactorShard_ctor(ReactorShard *const me, uint16_t id, int16_t cpu);
+    void ReactorShard_dtor(ReactorShard *const me);
+    // for other thread to call this function
+    bool ReactorShard_Post(ReactorShard *const me, ReactorTask *const task);
+    void ReactorShard_Stop(ReactorShard *const me);
+
+    typedef struct
+    {
+        ReactorShard *shards;
+        uint16_t count;
+    } ReactorPool;
+    void ReactorPool_ctor(ReactorPool *const me, uint16_t count, bool pin);
+    void ReactorPool_dtor(ReactorPool *const me);
+    bool ReactorPool_Start(ReactorPool *const me);
+    void ReactorPool_Join(ReactorPool *const me);
+    void ReactorPool_Stop(ReactorPool *const me);
+    ReactorShard *ReactorPool_LeastLoaded(ReactorPool *const me);
+#define ReactorPool_IsEnabled(ptr_) ((ptr_)->count > 0)
+#define REACTOR_MAX_SHARDS 64
+#define REACTOR_THREAD_STACK_SIZE (1024 * 64)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,78 @@
+#ifndef H_RESOLVER
+#define H_RESOLVER
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#define RESOLVER_MAX_ADDRS 8
+#define RESOLVER_DEFAULT_TTL 300  // s, getaddrinfo 不返回 TTL，使用固定值
+#define RESOLVER_RETRY_INTERVAL 5 // s, 失败后重试，保留之前的地址
+
+    typedef struct
+    {
+        struct in_addr addrs[RESOLVER_MAX_ADDRS];
+        uint8_t count;
+    } ResolverAddrs;
+
+    /**
+     * 在 resolver 线程中调用，测试时可以替换
+     * @param ttl 默认为 Resolver.ttl，可修改
+     * @return 地址个数，0 为失败
+     */
+    typedef uint8_t (*ResolverLookup)(void *data, char const *host, struct in_addr *addrs, uint8_t max, uint32_t *ttl);
+
+    typedef struct ResolverEntry
+    {
+        char *host;
+        ResolverAddrs addrs;
+        int64_t expireAt; // ms, monotonic
+        bool pending;
+        uint32_t version; // 地址变化时 +1
+        struct ResolverEntry *next;
+    } ResolverEntry;
+
+    /**
+     * 域名在后台线程中解析，event loop 只读取缓存的结果
+     * 过期后后台刷新，刷新完成前继续使用旧的地址
+     */
+    typedef struct
+    {
+        ResolverEntry *entries;
+        pthread_t *thread; // 第一次 Add 时启动
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        bool stopping;
+        char *hostsFile; // 先查找，格式同 /etc/hosts
+        ResolverLookup lookup; // NULL: hostsFile + getaddrinfo
+        void *data;
+        uint32_t ttl;
+    } Resolver;
+
+    void Resolver_ctor(Resolver *const me);
+    void Resolver_dtor(Resolver *const me);
+    // 在第一次 Add 之前调用
+    void Resolver_SetHostsFile(Resolver *const me, char const *const path);
+    // 同一个 host 返回同一个 entry，生命周期与 resolver 相同
+    ResolverEntry *Resolver_Add(Resolver *const me, char const *const host);
+    /**
+     * 不阻塞，过期时触发后台刷新
+     * @return 地址个数，0 表示解析中或失败
+     */
+    uint8_t Resolver_Get(Resolver *const me, ResolverEntry *const entry, ResolverAddrs *const out);
+    uint8_t Resolver_LookupHostsFile(char const *const path, char const *const host, struct in_addr *addrs, uint8_t max);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
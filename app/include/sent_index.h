@@ -0,0 +1,54 @@
+#ifndef H_SENT_INDEX
+#define H_SENT_INDEX
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+    /**
+     * 已发送文件索引，按路径的 64 位哈希记录
+     * 内存中为开放寻址的哈希集合，文件为追加写的日志: op(1) + hash(8)
+     * 日志中的无效记录过多时整体重写(压缩)
+     */
+    typedef struct
+    {
+        uint64_t *slots;
+        size_t capacity; // 2^n
+        size_t count;
+        size_t tombstones;
+        char *file;
+        int fd;
+        size_t logRecords;
+    } SentIndex;
+
+#define SENT_INDEX_OP_ADD 'A'
+#define SENT_INDEX_OP_DEL 'D'
+#define SENT_INDEX_RECORD_LEN 9
+#define SENT_INDEX_INIT_CAPACITY 64
+#define SENT_INDEX_COMPACT_THRESHOLD 1024 // 无效记录数
+
+    void SentIndex_ctor(SentIndex *const me);
+    void SentIndex_dtor(SentIndex *const me);
+    /**
+     * 加载日志，不存在时创建
+     */
+    bool SentIndex_Open(SentIndex *const me, char const *const file);
+    /**
+     * 导入旧版本的 records.json: {"records": {"path": {}, ...}}
+     */
+    bool SentIndex_ImportJSON(SentIndex *const me, char const *const jsonFile);
+    bool SentIndex_Contains(SentIndex const *const me, char const *const path);
+    bool SentIndex_Add(SentIndex *const me, char const *const path);
+    bool SentIndex_Remove(SentIndex *const me, char const *const path);
+    bool SentIndex_Compact(SentIndex *const me);
+    uint64_t SentIndex_Hash(char const *const path);
+#define SentIndex_Count(ptr_) (ptr_)->count
+
+#ifdef __cplusplus
+}
+#endif
+#endif
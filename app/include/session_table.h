@@ -0,0 +1,85 @@
+#ifndef H_SESSION_TABLE
+#define H_SESSION_TABLE
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "sl651/sl651.h"
+#include "rcu.h"
+
+#define SESSION_TABLE_BUCKET_SLOTS 8 // 8 个 key 正好一个 cache line
+#define SESSION_TABLE_INIT_CAPACITY 64
+#define SESSION_TABLE_KEY_EMPTY 0
+#define SESSION_TABLE_KEY_TAG (1ULL << 40) // 地址只占低 40 位，置位后不会为 0
+
+    // 开放寻址的一个桶: 一次比较 8 个 key，命中后再读 value
+    typedef struct
+    {
+        uint64_t keys[SESSION_TABLE_BUCKET_SLOTS];
+        void *values[SESSION_TABLE_BUCKET_SLOTS];
+    } __attribute__((aligned(RCU_CACHE_LINE_SIZE))) SessionBucket;
+
+    /**
+     * 一个版本的表，两种布局之一:
+     * buckets != NULL: 开放寻址，按桶线性探测，可以原地插入
+     * buckets == NULL: 最小完美哈希(hash and displace)，只读，插入新 key 时重建为开放寻址
+     */
+    typedef struct
+    {
+        SessionBucket *buckets;
+        size_t mask; // 桶数 - 1
+        // 最小完美哈希
+        uint64_t *keys;
+        void **values;
+        uint32_t *disps;
+        uint32_t dispCount;
+        uint32_t slotCount;
+        uint64_t seed;
+    } SessionTableData;
+
+    /**
+     * 遥测站地址 -> session，key 为 A5-A1 组成的 uint64
+     * 读: 不加锁。loop 线程作为 QSBR reader 直接 SessionTable_Find，其他线程在 Rcu_ReadLock 中调用
+     * 写: 持有 mutex，新 key 原地写入(先 value 后 key)，扩容或重建时整体发布，旧版本延迟释放
+     * 不支持删除，遥测站断线后 session 保留
+     */
+    typedef struct
+    {
+        Rcu rcu; // SessionTableData
+        pthread_mutex_t mutex;
+        size_t count;
+    } SessionTable;
+
+    typedef void (*SessionTableVisit)(uint64_t key, void *value, void *data);
+
+    void SessionTable_ctor(SessionTable *const me, size_t capacity);
+    // 调用时不能再有 reader，value 由调用方先用 SessionTable_ForEach 释放
+    void SessionTable_dtor(SessionTable *const me);
+    uint64_t SessionTable_Key(RemoteStationAddr const *const addr);
+    // 需在 RCU 读临界区中调用，返回的 value 在表中一直有效
+    void *SessionTable_Find(SessionTable *const me, uint64_t key);
+    /**
+     * 已存在时返回已有的 value，不替换
+     * @return NULL: 内存不足
+     */
+    void *SessionTable_Insert(SessionTable *const me, uint64_t key, void *value);
+    /**
+     * 遥测站名单固定后重建为最小完美哈希，每次查找只访问一个槽
+     * @return false: 没有找到可用的位移，保持开放寻址
+     */
+    bool SessionTable_Freeze(SessionTable *const me);
+    bool SessionTable_IsFrozen(SessionTable *const me);
+    // 持有写锁遍历
+    void SessionTable_ForEach(SessionTable *const me, SessionTableVisit visit, void *data);
+#define SessionTable_Count(ptr_) __atomic_load_n(&(ptr_)->count, __ATOMIC_RELAXED)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -9,8 +9,14 @@ extern "C"
 
 #ifdef _WIN32
 #include <winsock2.h>
+    struct iovec
+    {
+        void *iov_base;
+        size_t iov_len;
+    };
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #endif
@@ -18,17 +24,49 @@ extern "C"
 #include "libev/ev.h"
 #include "cJSON/cJSON.h"
 #include "vec/vec.h"
+#include "ring/ring.h"
 #include "common/error.h"
 #include "sl651/sl651.h"
 #include "tinydir/tinydir.h"
 
 #include "packet_creator.h"
+#include "reactor.h"
+#include "wal.h"
+#include "sent_index.h"
+#include "checkpoint.h"
+#include "outbox.h"
+#include "token_bucket.h"
+#include "metrics.h"
+#include "event_log.h"
+#include "rcu.h"
+#include "file_watch.h"
+#include "config_cache.h"
+#include "resolver.h"
 
     typedef enum
     {
         SL651_APP_ERROR_SUCCESS = ERROR_ENUM_BEGIN_RANGE(0),
     } SL651AppError;
 
+    // 运行日志事件，定义见 station.c STATION_EVENTS
+    typedef enum
+    {
+        STATION_EVENT_FRAME_HANDLED,
+        STATION_EVENT_FRAME_DROPPED,
+        STATION_EVENT_FRAME_INVALID,
+        STATION_EVENT_CONNECTING,
+        STATION_EVENT_BREAKING,
+        STATION_EVENT_SEND_ERROR,
+        STATION_EVENT_FILE_PICKED,
+        STATION_EVENT_FILE_PKG_SENDING,
+        STATION_EVENT_FILE_RESUMED,
+        STATION_EVENT_SEND_RING_FULL,
+        STATION_EVENT_WAL_FULL,
+        STATION_EVENT_CONNECT_FAILED,
+        STATION_EVENT_RECONNECT,
+        STATION_EVENT_COUNT
+    } StationEvent;
+
     typedef enum
     {
         CONFIG_CENTER_ADDRS = 1,
@@ -82,15 +120,16 @@ extern "C"
 
     typedef struct
     {
-        Ipv4 ipv4;
+        Ipv4 ipv4; // 当前(最近一次连接成功)的地址，下次连接优先
         char *domainStr;
+        ResolverEntry *resolved;
     } Domain;
 
-    typedef struct ev_loop Reactor;
     typedef ev_timer ChannelConnectWatcher;
     typedef ev_io ChannelDataWatcher;
     typedef ev_timer ChannelFilesWatcher;
     typedef ev_async ChannelAsyncWatcher;
+    typedef ev_timer ChannelPaceWatcher;
 
     typedef enum
     {
@@ -111,21 +150,50 @@ extern "C"
     struct ChannelVtbl;
     struct Channel;
 
+    typedef bool (*ChannelHandleFunc)(struct Channel *const ch, Package *const request);
+
     typedef struct
     {
         FunctionCode code;
-        bool (*cb)(struct Channel *const ch, Package *const request);
+        ChannelHandleFunc cb;
     } ChannelHandler;
 
-    typedef vec_t(ChannelHandler *) ChannelHandlerPtrVector;
-#define CHANNEL_RESERVED_HANDLER_SIZE 10
+    struct ChannelMiddleware;
+    /**
+     * 一次分发的调用链: middlewares[index..count) -> handler
+     */
+    typedef struct
+    {
+        struct ChannelMiddleware const *const *middlewares;
+        uint8_t count;
+        uint8_t index;
+        ChannelHandleFunc handler;
+    } ChannelDispatch;
+    // 调用链上的下一个，最后是 handler; @return false 没有 handler 或者处理失败
+    bool ChannelDispatch_Next(ChannelDispatch *const me, struct Channel *const ch, Package *const request);
+
+    /**
+     * 对所有功能码生效(包括没有 handler 的)，用于统计/审计
+     * 调用 ChannelDispatch_Next 继续，不调用则拦截
+     */
+    typedef struct ChannelMiddleware
+    {
+        bool (*cb)(struct ChannelMiddleware const *const me, ChannelDispatch *const next,
+                   struct Channel *const ch, Package *const request);
+        void *data;
+    } ChannelMiddleware;
+#define CHANNEL_HANDLER_TABLE_SIZE 256 // 按功能码直接索引
+#define STATION_MAX_MIDDLEWARES 8
+#define CHANNEL_FILE_HEAD_MAX_LEN 64 // 文件第一包的报文头模板
 #define CHANNLE_DEFAULT_KEEPALIVE_INTERVAL 40
 
     typedef enum
     {
         FILE_SEND_SUCCESS = 0,
         FILE_SEND_FAIL,
-        FILE_SEND_WAIT_ACK
+        FILE_SEND_WAIT_ACK,
+        FILE_SEND_PENDING, // 已开始发送，完成后由 channel 标记结果
+        FILE_SEND_BUSY     // channel 正在发送其他文件，稍后重试
     } FilePkgSendStatus;
 
     typedef struct
@@ -144,8 +212,40 @@ extern "C"
         CHANNEL_STATUS_STOP,
         CHANNEL_STATUS_RUNNING,
         CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK,
-        CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK
+        CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK,
+        CHANNEL_STATUS_SENDING_FILE
     } ChannelStatus;
+
+    /**
+     * 正在发送的文件，发送调度器每取到一个令牌发送一包
+     * 报文头编码一次作为模板，数据直接取自 mmap 的文件
+     * window > 0 时为滑动窗口模式: 最多 window 包未确认，中心站逐包 ACK/NAK，只重发缺失的包
+     */
+    typedef struct
+    {
+        int fd;
+        uint8_t const *mapped; // NULL 时每包读入 channel 的 buff
+        size_t size;
+        uint16_t pkgNo; // 下一个新包
+        uint16_t pkgCount;
+        // 滑动窗口
+        uint16_t window;
+        uint16_t base;    // 最小的未确认包
+        uint8_t retries;  // 超时重发次数，收到确认后清零
+        uint8_t *acked;   // bitmap, 第 pkgNo - 1 位
+        uint8_t *resend;  // bitmap, 等待重发
+        // 续传
+        uint64_t fileHash;
+        int64_t mtime;
+        uint16_t seq;   // 第一包的流水号
+        uint16_t saved; // 已保存的断点
+        uint32_t firstHeadLen;
+        uint8_t head[CHANNEL_FILE_HEAD_MAX_LEN];
+        // 完成后的处理，二选一
+        tinydir_file *file; // 扫描式
+        FilePkg *filePkg;   // 触发式
+    } FileTransfer;
+    typedef vec_t(ByteBuffer *) ByteBufferPtrVector;
     typedef struct Channel
     {
         struct ChannelVtbl const *vptr;
@@ -158,15 +258,37 @@ extern "C"
         uint16_t seq;
         uint8_t keepaliveTimer;
         uint8_t centerAddr;
-        ChannelHandlerPtrVector handlers; // 静态引用，不需要释放
+        ChannelHandleFunc *handlers; // 覆盖 station 的处理，设置时才分配，NULL 项使用 station 的
         pthread_t *thread;
         ChannelStatus status;
         tinydir_file *currentFile;
         FilePkg *currentFilePkg;
-        // recordsFile
-        char *recordsFile;
-        cJSON *recordsFileInJSON;
+        // 已发送的文件
+        SentIndex sentIndex;
+        // 共享 outbox 中本 channel 已发送的前缀，只在 channel 所在线程访问
+        OutboxCursor outboxCursor;
+        // 窗口模式下的续传断点
+        CheckpointStore checkpoints;
         pthread_mutex_t cleanUpMutex;
+        // 共享 reactor 模式下分配的 loop，NULL 表示独立线程 + 独立 loop
+        ReactorShard *shard;
+        // 待发送的 Packet，Station_AsyncSend 投递，channel 所在线程消费
+        Ring sendRing;
+        // 发送调度，按 msgSendInterval 限速，不阻塞 loop
+        TokenBucket pacer;
+        ByteBufferPtrVector outFrames; // 优先于文件发送
+        FileTransfer *transfer;
+        // 已经过限速、等待写出的报文，队首的 position 为已写出的部分
+        ByteBufferPtrVector writeQueue;
+        size_t outBytes; // outFrames + writeQueue
+        // 超过高水位后暂停消费 sendRing / wal，低于低水位后恢复
+        bool outBlocked;
+        ChannelMetrics metrics;
+        uint64_t configVersion; // 缓存的 centerAddr 对应的配置版本
+        // 预编码的心跳 / 测试报，配置变化时重新编码，每次只改写流水号、时间和 CRC
+        ByteBuffer *keepaliveFrame;
+        ByteBuffer *testFrame;
+        uint64_t framesVersion;
         // reference
         Station *station;
     } Channel;
@@ -179,7 +301,13 @@ extern "C"
         void (*close)(Channel *const me);
         void (*keepalive)(Channel *const me);
         ByteBuffer *(*onRead)(Channel *const me);
+        // 进入发送队列，由发送调度器限速发出
         bool (*send)(Channel *const me, ByteBuffer *const buff);
+        /**
+         * 不阻塞写出多段数据(gather write)
+         * @return 写出的字节数，发送缓冲区已满时可能小于总长度或为 0；-1 表示连接已关闭
+         */
+        ssize_t (*sendv)(Channel *const me, struct iovec *const iov, int iovcnt);
         bool (*expandEncode)(Channel *const me, ByteBuffer *const buff);
         void (*onFilesQuery)(Channel *const me);
         bool (*notifyData)(Channel *const me);
@@ -198,8 +326,21 @@ extern "C"
         ChannelFilesWatcher *filesWatcher;
         ChannelDataWatcher *dataWatcher;
         ChannelAsyncWatcher *asyncWatcher;
+        ChannelPaceWatcher *paceWatcher;
+        bool waitWritable;
+        // shared reactor
+        ReactorTask notifyTask;
+        // 连接中，connectWatcher 为连接超时
+        bool connecting;
+        uint8_t connectFailures; // 连续失败次数，决定重连的退避时间
+        uint32_t backoffSeed;
     } IOChannel;
 
+#define CHANNEL_CONNECT_TIMEOUT 10 // s, 包括所有地址的尝试
+#define CHANNEL_BACKOFF_MIN 1      // s
+#define CHANNEL_BACKOFF_BASE 5     // s, 第 n 次失败后在 [MIN, BASE * 2^n] 中随机，避免所有遥测站同时重连
+#define CHANNEL_BACKOFF_MAX 300    // s
+
     typedef struct IOChannelVtbl
     {
         struct ChannelVtbl super;
@@ -209,16 +350,33 @@ extern "C"
         void (*onAsyncEvent)(Reactor *reactor, ev_async *w, int revents);
     } IOChannelVtbl;
 
+#define SOCKET_CHANNEL_MAX_ATTEMPTS RESOLVER_MAX_ADDRS
+#define SOCKET_CHANNEL_ATTEMPT_DELAY 0.25 // s, happy eyeballs: 上一个地址未完成时开始连接下一个
+
+    // 一个地址的非阻塞连接
+    typedef struct
+    {
+        ev_io watcher; // EV_WRITE
+        int fd;        // -1: 未开始或已结束
+        struct sockaddr_in addr;
+    } ConnectAttempt;
+
     typedef struct SocketChannel
     {
         IOChannel supper;
         char *deviceStr;
+        ConnectAttempt attempts[SOCKET_CHANNEL_MAX_ATTEMPTS];
+        uint8_t attemptCount; // 已开始的
+        uint8_t addrCount;
+        ev_timer attemptWatcher;
     } SocketChannel;
 
     typedef struct SocketChannelVtbl
     {
         struct IOChannelVtbl super;
         Ipv4 *(*ip)(SocketChannel *me);
+        // 按优先级返回要连接的地址
+        uint8_t (*addrs)(SocketChannel *me, struct sockaddr_in *addrs, uint8_t max);
     } SocketChannelVtbl;
 
     typedef struct Ipv4Channel
@@ -237,18 +395,38 @@ extern "C"
     typedef vec_t(Channel *) ChannelPtrVector;
 
     /**
+     * 运行中可修改的参数，发布后只读，修改时整体替换
      * 都使用指针方式，解码编码都是可选项
      */
     typedef struct
     {
+        uint64_t version;
         CenterAddrs *centerAddrs;
         RemoteStationAddr *stationAddr;
         uint16_t *password;
-        ChannelPtrVector channels;
         uint8_t *workMode;
         StationCategory stationCategory;
+        cJSON *configInJSON; // 对应的完整配置，从缓存启动时为 NULL
+    } ConfigSnapshot;
+    // 解析成功时接管 json
+    ConfigSnapshot *ConfigSnapshot_FromJSON(cJSON *const json, uint64_t version);
+    void ConfigSnapshot_Free(void *ptr);
+
+    /**
+     * channel / 线程等启动参数只在启动时读取，运行参数在 snapshots 中
+     */
+    typedef struct
+    {
+        ChannelPtrVector channels;
+        /**
+         * 当前的 ConfigSnapshot
+         * loop 线程注册为 reader 后直接读取(Config_Current)，其他线程需要 Rcu_ReadLock
+         */
+        Rcu snapshots;
+        pthread_mutex_t updateMutex; // 读-改-写 串行化
+        // config.json 被修改后重新加载运行参数
+        FileWatch *watch;
         // extend config
-        cJSON *configInJSON;
         char *configFile;
         char *workDir;
         char *filesDir;
@@ -259,10 +437,38 @@ extern "C"
         bool waitFileSendAck;
         bool fastFailed;
         bool scanFiles;
+        // 文件滑动窗口大小，0: 不逐包确认
+        uint16_t fileWindow;
         uint8_t sendRetryCounts;
+        // 0: 每个 channel 一个线程 + loop; N: 所有 channel 分布到 N 个共享 loop
+        uint16_t reactors;
+        bool pinReactors;
+        // 报文持久化: "wal": true 或 {"segmentSize", "maxSegments", "syncInterval"}
+        bool walEnabled;
+        size_t walSegmentSize;
+        uint32_t walMaxSegments;
+        uint32_t walSyncInterval;
+        // 指标抓取: "metrics": true(workDir/metrics.sock) 或 {"socket": path} / {"port": N}(127.0.0.1)
+        bool metricsEnabled;
+        char *metricsSocket;
+        uint16_t metricsPort;
+        // 运行日志: "log": {"level": "info", "rate": 100, "binary": path}
+        uint8_t logLevel;
+        uint32_t logRate;
+        char *logBinary;
         // reference
         Station *station;
     } Config;
+#define Config_Current(ptr_) ((ConfigSnapshot const *)Rcu_Dereference(&(ptr_)->snapshots))
+    // 对当前配置打补丁，保存到 configFile 并发布新的版本
+    bool Config_Update(Config *const me, cJSON *const patches);
+    // 重新读取 configFile，发布新的版本; 内容与当前版本相同时不发布
+    bool Config_Reload(Config *const me);
+    // loop 阻塞时 offline，唤醒后 online，回调中读取配置不需要加锁
+    void Config_AttachLoop(Config *const me, Reactor *const loop);
+    void Config_DetachLoop(Config *const me, Reactor *const loop);
+    // configFile 被修改后自动 Config_Reload
+    void Config_Watch(Config *const me);
     Channel *Config_FindChannel(Config *const me, uint8_t chId);
     int32_t Config_IndexOfChannel(Config *const me, uint8_t chid);
     bool Config_IsChannelEnable(Config *const me, Channel *const ch);
@@ -279,26 +485,76 @@ extern "C"
 #define CHANNEL_MAX_MSG_SEND_RETRY_COUNT 10
 #define CHANNEL_DEFAULT_MSG_SEND_RETRY_COUNT 2 // @Todo 默认修改为0，不重试
 
+#define CHANNEL_SEND_RING_SIZE 256
+#define CHANNEL_MAX_IOV 8
+#define CHANNEL_PACE_BURST 1 // 与原来每个报文后等待 msgSendInterval 一致
+#define CHANNEL_MAX_FILE_WINDOW 64
+#define CHANNEL_FILE_ACK_TIMEOUT 2. // s
+#define CHANNEL_CHECKPOINT_INTERVAL 8 // 每确认多少包保存一次断点
+#define CHANNEL_OUT_HIGH_WATERMARK (32 * 1024)
+#define CHANNEL_OUT_LOW_WATERMARK (8 * 1024)
+#define Channel_IsOutputBlocked(ptr_) __atomic_load_n(&(ptr_)->outBlocked, __ATOMIC_ACQUIRE)
+    /**
+     * 只对这个 channel 生效，cb 为 NULL 时恢复使用 station 的处理
+     * 在 channel 启动前或者所在的 loop 中调用
+     * @return 之前生效的处理
+     */
+    ChannelHandleFunc Channel_SetHandler(Channel *const me, FunctionCode code, ChannelHandleFunc cb);
+    ChannelHandleFunc Channel_FindHandler(Channel *const me, uint8_t code);
+    /**
+     * 收到的报文经过 station 的 middleware 交给处理表中的 handler，记录处理耗时和事件
+     * @return false 没有 handler、被 middleware 拦截或者处理失败
+     */
+    bool Channel_Dispatch(Channel *const me, Package *const request);
+
+#define CHANNEL_FILES_NEXT_DELAY 0.01  // s, 连续发送文件的间隔
+#define CHANNEL_FILES_IDLE_INTERVAL 10. // s, 没有文件时的检查间隔
+
+    /**
+     * 投递后只读，frame 为编码好的报文(中心站地址/流水号/发报时间由各 channel 发送前修改)
+     * channelSentMask 为原子操作，最后一个完成的 channel 负责释放
+     */
     typedef struct
     {
-        Package *pkg;
-        // 发送时根据当前的channel设置mask位，当全零时，表示可以清除
+        ByteBuffer *frame;
+        bool uplink; // 上行报文由 channel 分配流水号
+        uint16_t seq;
+        // 投递时根据目标 channel 设置mask位，当全零时，表示可以清除
         uint16_t channelSentMask;
         bool result;
     } Packet;
-    typedef vec_t(Packet *) PacketPtrVector;
     void Packet_dtor(Packet *const me);
-#define Packet_IsSent(ptr_) (ptr_)->channelSentMask == 0
+    // channel 处理完成后调用，最后一个 channel 释放 Packet
+    void Packet_Release(Packet *const me, uint8_t chId);
+#define Packet_IsSent(ptr_) (__atomic_load_n(&(ptr_)->channelSentMask, __ATOMIC_ACQUIRE) == 0)
 
     struct _station
     {
         // Reactor *reactor;
         Config config;
-        PacketPtrVector packets;
         FilePkgPtrVector files;
         pthread_mutex_t cleanUpMutex;
-        pthread_mutex_t sendMutex;
+        pthread_mutex_t sendMutex; // files only, packets 走 channel 的 sendRing
+        ReactorPool reactors;
+        // 启用时 packets 写入 wal，各 channel 按自己的 cursor 读取发送，不再使用 sendRing
+        Wal *wal;
+        // filesDir 中待发送的文件
+        Outbox *outbox;
+        StationMetrics metrics;
+        MetricsServer *metricsServer;
+        EventLog log;
+        Resolver resolver; // DomainChannel
+        ChannelHandleFunc handlers[CHANNEL_HANDLER_TABLE_SIZE];
+        ChannelMiddleware const *middlewares[STATION_MAX_MIDDLEWARES];
+        uint8_t middlewareCount;
     };
+    /**
+     * 注册功能码的处理，所有 channel 共享，在 Station_Start 之前调用
+     * @return 之前的处理，新的处理可以调用它(链式)
+     */
+    ChannelHandleFunc Station_SetHandler(Station *const me, FunctionCode code, ChannelHandleFunc cb);
+    // 按注册的顺序调用，在 Station_Start 之前调用
+    bool Station_Use(Station *const me, ChannelMiddleware const *const middleware);
     void Station_ctor(Station *const me);
     bool Station_Start(Station *const me);
     bool Station_Stop(Station *const me);
@@ -306,7 +562,14 @@ extern "C"
     void Station_dtor(Station *const me);
     bool Station_IsFileSentByAllChannel(Station *const me, tinydir_file *const file, Channel *const currentCh);
     // for other thread to call this function
+    // 返回 false 时所有目标 channel 的 sendRing 都已满(积压)，调用方应稍后重试
     bool Station_AsyncSend(Station *const me, cJSON *const data);
+    // 如 PackageReader 读出的报文，不接管 pkg
+    bool Station_AsyncSendPackage(Station *const me, Package *const pkg);
+    // 发送 ReportTemplate_Fill 后的报文，遥测站地址/密码/分类码取当前配置
+    bool Station_AsyncSendReport(Station *const me, ReportTemplate *const tpl);
+    // 数值要素直接编码投递，不构造 cJSON
+    bool Station_AsyncSendSpec(Station *const me, ReportSpec const *const spec);
     void Station_SendPacketsToChannel(Station *const me, Channel *const ch);
     // file
     bool Station_AsyncSendFilePkg(Station *const me, const char *file);
@@ -314,6 +577,8 @@ extern "C"
     void Station_MarkFilePkgSent(Station *const me, Channel *const ch, FilePkg *const filePkg, bool result);
 #define SL651_DEFAULT_WORKDIR "/sl651"
 #define SL651_DEFAULT_CONFIG_FILE_NAME_LEN 11
+#define SL651_CONFIG_CACHE_FILE "config.cache"
+#define SL651_HOSTS_FILE "hosts" // 工作目录中存在时先于 DNS 查找
     // #define SL651_DEFAULT_CONFIGFILE "/sl651/config.json"
 
 #define Station_config(_ptr) &(_ptr->config)
@@ -0,0 +1,31 @@
+#ifndef H_TOKEN_BUCKET
+#define H_TOKEN_BUCKET
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdbool.h>
+
+    /**
+     * 令牌桶，控制 channel 发送报文的速率
+     * 时间单位为秒(ev_now)，rate <= 0 时不限速
+     */
+    typedef struct
+    {
+        double rate;  // 每秒令牌数
+        double burst; // 桶容量
+        double tokens;
+        double last;
+    } TokenBucket;
+
+    void TokenBucket_ctor(TokenBucket *const me, double rate, double burst);
+    // 取一个令牌
+    bool TokenBucket_Take(TokenBucket *const me, double now);
+    // 距离下一个令牌可用的时间，0 表示可用
+    double TokenBucket_Delay(TokenBucket *const me, double now);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
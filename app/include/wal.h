@@ -0,0 +1,111 @@
+#ifndef H_WAL
+#define H_WAL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "vec/vec.h"
+
+    /**
+     * 追加写日志，保存编码好的报文，重启后继续发送
+     * 日志按 segment 切分，每个 segment 一个文件，mmap 读写
+     * LSN 为全局字节偏移，segment 文件名为其起始 LSN(16位HEX)
+     * 记录格式: WalRecordHead + data
+     */
+    typedef struct
+    {
+        uint32_t len;
+        uint16_t crc;
+        uint16_t magic;
+    } WalRecordHead;
+#define WAL_RECORD_MAGIC 0x651A
+#define WAL_RECORD_HEAD_LEN sizeof(WalRecordHead)
+
+    typedef struct
+    {
+        uint64_t base;
+        uint8_t *addr;
+        size_t size;
+        int fd;
+    } WalSegment;
+    typedef vec_t(WalSegment *) WalSegmentPtrVector;
+
+    /**
+     * 读取位置，每个 channel 一个，只由所属 channel 的线程读写
+     * 缓存当前 segment，跨 segment 时才需要加锁查找
+     */
+    typedef struct
+    {
+        uint64_t lsn;
+        uint32_t peekLen;
+        bool tracked; // 参与 segment 回收
+        // cached segment
+        uint64_t segBase;
+        size_t segSize;
+        uint8_t *segAddr;
+    } WalCursor;
+#define WAL_MAX_CURSORS 17 // index by channel id, 1 ~ 16
+
+    typedef struct
+    {
+        char *dir;
+        size_t segmentSize;
+        uint32_t maxSegments;
+        uint32_t syncInterval; // ms, group commit
+        WalSegmentPtrVector segments;
+        WalSegmentPtrVector retired; // 写满时丢弃的 segment，文件已删除，仍被 cursor 缓存时保留映射
+        uint64_t firstLsn;
+        uint64_t writeLsn;
+        uint64_t syncedLsn;
+        WalCursor cursors[WAL_MAX_CURSORS];
+        uint32_t persistedMask; // cursors loaded from file
+        uint64_t savedCursors[WAL_MAX_CURSORS];
+        int cursorsFd;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t *flusher;
+        uint32_t syncing; // 释放锁落盘中，期间丢弃的 segment 只删除文件，保留映射
+        bool stopping;
+    } Wal;
+
+#define WAL_DEFAULT_SEGMENT_SIZE (1024 * 1024 * 4)
+#define WAL_MIN_SEGMENT_SIZE (1024 * 64)
+#define WAL_MAX_SEGMENT_SIZE (1024 * 1024 * 256)
+#define WAL_DEFAULT_MAX_SEGMENTS 16
+#define WAL_DEFAULT_SYNC_INTERVAL 20
+
+    /**
+     * 打开(或创建)目录下的日志，恢复写位置和各 cursor
+     * @return false 时不可用(不支持 mmap 的平台也返回 false)
+     */
+    bool Wal_Open(Wal *const me, char const *const dir, size_t segmentSize, uint32_t maxSegments, uint32_t syncInterval);
+    void Wal_dtor(Wal *const me);
+    /**
+     * for any thread
+     * 达到 maxSegments 时丢弃最老的 segment，落后的 cursor(例如一直未连接的 channel)跳过这部分记录
+     * @return false: 记录过大或者创建 segment 失败
+     */
+    bool Wal_Append(Wal *const me, uint8_t const *const data, uint32_t len);
+    // 从未保存过的 cursor 从最早的记录开始
+    void Wal_Track(Wal *const me, uint8_t id);
+    /**
+     * 读取 cursor 处的记录，不移动 cursor
+     * @return 记录长度，0 表示没有新记录; data 指向 mmap 内存，Wal_Advance 前有效
+     */
+    uint32_t Wal_Peek(Wal *const me, uint8_t id, uint8_t const **data);
+    // 跳过 Wal_Peek 读到的记录
+    void Wal_Advance(Wal *const me, uint8_t id);
+    // 立即落盘，阻塞
+    void Wal_Sync(Wal *const me);
+#define Wal_Pending(ptr_, id_) (__atomic_load_n(&(ptr_)->writeLsn, __ATOMIC_ACQUIRE) - (ptr_)->cursors[(id_)].lsn)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
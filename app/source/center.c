@@ -0,0 +1,1062 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define MSG_NOSIGNAL 0
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
+#include "common/class.h"
+#include "common/error.h"
+#include "center.h"
+
+#define CENTER_SESSIONS_INIT_SIZE 64
+#define CENTER_ACCEPT_BATCH 64 // 每次可读事件最多 accept 的连接数，避免饿死其他 watcher
+#define CENTER_FUNC_CODE_INDEX 10
+
+static int64_t Center_NowS()
+{
+#ifdef _WIN32
+    return (int64_t)(GetTickCount64() / 1000);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+#endif
+}
+
+static bool Center_SetNonBlocking(int fd)
+{
+#ifdef _WIN32
+    unsigned long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static void Center_CloseSocket(int fd)
+{
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+// 没有数据可读或者发送缓冲区满
+static bool Center_WouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static bool Center_Interrupted()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+// Framer
+int32_t Center_FrameLength(uint8_t const *buff, size_t len)
+{
+    assert(buff || len == 0);
+    if (len < 2)
+    {
+        return len == 1 && buff[0] != (SOH_BINARY >> 8) ? -1 : 0;
+    }
+    if (((buff[0] << 8) | buff[1]) != SOH_BINARY)
+    {
+        // 跳到下一个可能的 SOH
+        size_t skip = 1;
+        while (skip < len && buff[skip] != (SOH_BINARY >> 8))
+        {
+            skip++;
+        }
+        return -(int32_t)skip;
+    }
+    if (len < PACKAGE_HEAD_STX_LEN)
+    {
+        return 0;
+    }
+    uint8_t stxFlag = buff[PACKAGE_HEAD_STX_LEN - 1];
+    if (stxFlag != STX && stxFlag != SYN)
+    {
+        return -1;
+    }
+    uint16_t bodyLen = ((buff[PACKAGE_HEAD_STX_DIRECTION_INDEX] & 0x0F) << 8) | buff[PACKAGE_HEAD_STX_DIRECTION_INDEX + 1];
+    int32_t frameLen = PACKAGE_WRAPPER_LEN + bodyLen;
+    if (len < (size_t)frameLen)
+    {
+        return 0;
+    }
+    switch (buff[frameLen - PACKAGE_TAIL_LEN])
+    {
+    case ETX:
+    case ETB:
+    case ENQ:
+    case EOT:
+    case ACK:
+    case NAK:
+    case ESC:
+        break;
+    default:
+        return -1; // 长度不对，从下一个字节重新同步
+    }
+    return frameLen;
+}
+// Framer END
+
+ByteBuffer *Center_EncodeReply(Package const *const request, uint8_t etx)
+{
+    assert(request);
+    Package reply;
+    memset(&reply, 0, sizeof(Package));
+    reply.head = request->head;
+    reply.head.direction = Down;
+    // 多包时，第二包开始没有报文头
+    bool hasMsgHead = request->head.stxFlag == STX || request->head.sequence.seq <= 1;
+    reply.head.len = (request->head.stxFlag == SYN ? PACKAGE_HEAD_SEQUENCE_LEN : 0) +
+                     (hasMsgHead ? 2 + DATETIME_LEN : 0);
+    reply.tail.etxFlag = etx;
+    ByteBuffer *byteBuff = NewInstance(ByteBuffer);
+    BB_ctor(byteBuff, PACKAGE_WRAPPER_LEN + reply.head.len);
+    bool res = Package_EncodeHead(&reply, byteBuff);
+    if (res && hasMsgHead)
+    {
+        DateTime now;
+        DateTime_now(&now);
+        res = BB_BE_PutUInt16(byteBuff, ((UplinkMessage const *)request)->messageHead.seq) == 2 &&
+              BB_BCDPutUInt8(byteBuff, now.year) &&
+              BB_BCDPutUInt8(byteBuff, now.month) &&
+              BB_BCDPutUInt8(byteBuff, now.day) &&
+              BB_BCDPutUInt8(byteBuff, now.hour) &&
+              BB_BCDPutUInt8(byteBuff, now.minute) &&
+              BB_BCDPutUInt8(byteBuff, now.second);
+    }
+    if (!(res && Package_EncodeTail(&reply, byteBuff)))
+    {
+        BB_dtor(byteBuff);
+        DelInstance(byteBuff);
+        return NULL;
+    }
+    BB_Flip(byteBuff);
+    return byteBuff;
+}
+
+// FNV-1a
+static uint64_t Center_Fnv(uint64_t hash, uint8_t const *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t Center_ReportFingerprint(uint8_t const *frame, size_t len)
+{
+    assert(frame);
+    assert(len >= PACKAGE_WRAPPER_LEN);
+    bool syn = frame[PACKAGE_HEAD_STX_LEN - 1] == SYN;
+    size_t headLen = syn ? PACKAGE_HEAD_SYN_LEN : PACKAGE_HEAD_STX_LEN;
+    size_t end = len - PACKAGE_TAIL_LEN;
+    if (headLen > end)
+    {
+        headLen = end;
+    }
+    // 多包时只有第一包有报文头
+    uint16_t seq = syn ? ((frame[PACKAGE_HEAD_STX_LEN + 1] & 0x0F) << 8) | frame[PACKAGE_HEAD_STX_LEN + 2] : 0;
+    size_t bodyStart = headLen + (!syn || seq <= 1 ? 2 + DATETIME_LEN : 0); // 跳过流水号和发报时间
+    if (bodyStart > end)
+    {
+        bodyStart = end;
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = Center_Fnv(hash, frame + 3, REMOTE_STATION_ADDR_LEN);
+    hash = Center_Fnv(hash, frame + CENTER_FUNC_CODE_INDEX, 1);
+    hash = Center_Fnv(hash, frame + PACKAGE_HEAD_STX_LEN, headLen - PACKAGE_HEAD_STX_LEN);
+    return Center_Fnv(hash, frame + bodyStart, end - bodyStart);
+}
+
+// Session
+static void Center_OnLoopRelease(Reactor *loop) EV_THROW
+{
+    CenterLoopReader *r = (CenterLoopReader *)ev_userdata(loop);
+    Rcu_Offline(r->reader); // 阻塞期间不持有 session 表
+}
+
+static void Center_OnLoopAcquire(Reactor *loop) EV_THROW
+{
+    CenterLoopReader *r = (CenterLoopReader *)ev_userdata(loop);
+    Rcu_Online(r->rcu, r->reader);
+}
+
+// loop 启动之前调用
+static void Center_AttachLoops(Center *const me)
+{
+    for (uint16_t i = 0; i < me->pool.count; i++)
+    {
+        CenterLoopReader *r = &me->loopReaders[i];
+        if (r->reader != NULL)
+        {
+            continue;
+        }
+        r->rcu = &me->sessions.rcu;
+        r->reader = Rcu_Register(&me->sessions.rcu);
+        if (r->reader != NULL)
+        {
+            ev_set_userdata(me->pool.shards[i].loop, r);
+            ev_set_loop_release_cb(me->pool.shards[i].loop, &Center_OnLoopRelease, &Center_OnLoopAcquire);
+        }
+    }
+}
+
+// loop 停止之后调用
+static void Center_DetachLoops(Center *const me)
+{
+    for (uint16_t i = 0; i < me->pool.count; i++)
+    {
+        CenterLoopReader *r = &me->loopReaders[i];
+        if (r->reader != NULL)
+        {
+            ev_set_loop_release_cb(me->pool.shards[i].loop, NULL, NULL);
+            ev_set_userdata(me->pool.shards[i].loop, NULL);
+            Rcu_Unregister(&me->sessions.rcu, r->reader);
+            r->reader = NULL;
+        }
+    }
+}
+
+static void Center_FreeSession(uint64_t key, void *value, void *data)
+{
+    CenterSession *session = (CenterSession *)value;
+    DelInstance(session);
+}
+
+CenterSession *Center_FindSession(Center *const me, RemoteStationAddr const *const addr)
+{
+    assert(me);
+    assert(addr);
+    Rcu_ReadLock(&me->sessions.rcu); // 调用方不一定是 loop 线程
+    CenterSession *session = (CenterSession *)SessionTable_Find(&me->sessions, SessionTable_Key(addr));
+    Rcu_ReadUnlock(&me->sessions.rcu);
+    return session;
+}
+
+size_t Center_SessionCount(Center *const me)
+{
+    assert(me);
+    return SessionTable_Count(&me->sessions);
+}
+
+CenterSession *Center_AddSession(Center *const me, RemoteStationAddr const *const addr)
+{
+    assert(me);
+    assert(addr);
+    CenterSession *session = Center_FindSession(me, addr);
+    if (session != NULL)
+    {
+        return session;
+    }
+    session = NewInstance(CenterSession);
+    if (session == NULL)
+    {
+        return NULL;
+    }
+    session->addr = *addr;
+    session->center = me;
+    CenterSession *existing = (CenterSession *)SessionTable_Insert(&me->sessions, SessionTable_Key(addr), session);
+    if (existing != session)
+    {
+        DelInstance(session); // 并发加入或内存不足
+    }
+    return existing;
+}
+
+bool Center_FreezeSessions(Center *const me)
+{
+    assert(me);
+    return SessionTable_Freeze(&me->sessions);
+}
+
+/**
+ * loop 线程中调用，已知的遥测站不加锁、不写共享变量即可找到
+ * 同一个遥测站的新连接接管 session，旧连接继续收发，关闭时不再解绑
+ */
+static CenterSession *Center_BindSession(Center *const me, CenterConn *const conn, RemoteStationAddr const *const addr)
+{
+    CenterSession *session = NULL;
+    if (me->loopReaders[conn->shard->id].reader != NULL)
+    {
+        session = (CenterSession *)SessionTable_Find(&me->sessions, SessionTable_Key(addr));
+    }
+    if (session == NULL)
+    {
+        session = Center_AddSession(me, addr);
+    }
+    if (session != NULL)
+    {
+        __atomic_store_n(&session->conn, conn, __ATOMIC_RELEASE);
+    }
+    return session;
+}
+// Session END
+
+// CenterConn
+static void CenterConn_Release(void *ptr)
+{
+    CenterConn *me = (CenterConn *)ptr;
+    if (me->out != NULL)
+    {
+        DelInstance(me->out);
+    }
+    vec_deinit(&me->sessions);
+    DelInstance(me);
+}
+
+static void CenterConn_Free(CenterConn *me)
+{
+    Center *center = me->center;
+    CenterSession *session = NULL;
+    int i;
+    vec_foreach(&me->sessions, session, i)
+    {
+        // 已被新连接接管时不解绑
+        CenterConn *expected = me;
+        __atomic_compare_exchange_n(&session->conn, &expected, (CenterConn *)NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&center->mutex);
+    if (me->prev != NULL)
+    {
+        me->prev->next = me->next;
+    }
+    else
+    {
+        center->conns = me->next;
+    }
+    if (me->next != NULL)
+    {
+        me->next->prev = me->prev;
+    }
+    pthread_mutex_unlock(&center->mutex);
+    if (me->fd >= 0)
+    {
+        Center_CloseSocket(me->fd);
+        me->fd = -1;
+    }
+    if (me->sessions.length > 0)
+    {
+        // 其他线程可能刚从 session->conn 读到它
+        Rcu_Retire(&center->sessions.rcu, me, &CenterConn_Release);
+        return;
+    }
+    CenterConn_Release(me);
+}
+
+// loop 线程中调用
+static void CenterConn_Close(CenterConn *me)
+{
+    Reactor *loop = me->shard->loop;
+    ev_io_stop(loop, &me->watcher);
+    ev_timer_stop(loop, &me->idleWatcher);
+    __atomic_sub_fetch(&me->shard->load, 1, __ATOMIC_RELAXED);
+    Metric_Inc(&me->center->metrics.disconnects);
+    CenterConn_Free(me);
+}
+
+static void CenterConn_WatchWritable(CenterConn *const me, bool writable)
+{
+    Reactor *loop = me->shard->loop;
+    int events = EV_READ | (writable ? EV_WRITE : 0);
+    if (me->watcher.events == events)
+    {
+        return;
+    }
+    ev_io_stop(loop, &me->watcher);
+    ev_io_set(&me->watcher, me->fd, events);
+    ev_io_start(loop, &me->watcher);
+}
+
+static bool CenterConn_Flush(CenterConn *const me)
+{
+    size_t sent = 0;
+    while (sent < me->outLen)
+    {
+        ssize_t n = send(me->fd, (char const *)me->out + sent, me->outLen - sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (Center_WouldBlock())
+            {
+                break;
+            }
+            if (Center_Interrupted())
+            {
+                continue;
+            }
+            return false;
+        }
+        sent += n;
+    }
+    Metric_Add(&me->center->metrics.bytesOut, sent);
+    memmove(me->out, me->out + sent, me->outLen - sent);
+    me->outLen -= sent;
+    CenterConn_WatchWritable(me, me->outLen > 0);
+    return true;
+}
+
+bool CenterConn_Send(CenterConn *const me, uint8_t const *data, size_t len)
+{
+    assert(me);
+    assert(data);
+    if (me->closing)
+    {
+        return false;
+    }
+    if (me->outLen + len > CENTER_CONN_OUT_MAX)
+    {
+        me->closing = true; // 对端不读
+        return false;
+    }
+    if (me->outLen + len > me->outSize)
+    {
+        size_t size = me->outSize == 0 ? CENTER_FRAME_MAX_LEN : me->outSize;
+        while (size < me->outLen + len)
+        {
+            size *= 2;
+        }
+        uint8_t *out = (uint8_t *)realloc(me->out, size);
+        if (out == NULL)
+        {
+            me->closing = true;
+            return false;
+        }
+        me->out = out;
+        me->outSize = size;
+    }
+    memcpy(me->out + me->outLen, data, len);
+    me->outLen += len;
+    Metric_Inc(&me->center->metrics.framesOut);
+    if (me->outLen == len && !CenterConn_Flush(me)) // 之前有未写出的数据时等待可写
+    {
+        me->closing = true;
+        return false;
+    }
+    return true;
+}
+
+// 切换到报文中的遥测站，同一个连接上可能有多个遥测站
+static CenterSession *CenterConn_Bind(CenterConn *const me, RemoteStationAddr const *const addr)
+{
+    if (me->session == NULL || memcmp(&me->session->addr, addr, REMOTE_STATION_ADDR_LEN) != 0)
+    {
+        me->session = Center_BindSession(me->center, me, addr);
+        int i = 0;
+        if (me->session != NULL)
+        {
+            vec_find(&me->sessions, me->session, i);
+        }
+        if (i < 0)
+        {
+            int length = me->sessions.length;
+            vec_push(&me->sessions, me->session);
+            if (me->sessions.length == length) // 记不下时立即解绑，不能让 session 指向关闭后的连接
+            {
+                CenterConn *expected = me;
+                __atomic_compare_exchange_n(&me->session->conn, &expected, (CenterConn *)NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    if (me->session != NULL)
+    {
+        me->session->lastSeen = Center_NowS();
+    }
+    return me->session;
+}
+
+// 自动应答
+static void CenterConn_Confirm(CenterConn *const me, Package const *const pkg, bool handled)
+{
+    Center *center = me->center;
+    if (center->replies[pkg->head.funcCode] != CENTER_REPLY_CONFIRM)
+    {
+        return;
+    }
+    uint8_t etx = center->keepOnline ? ESC : EOT;
+    if (!handled)
+    {
+        etx = NAK; // 要求重发
+    }
+    else if (pkg->tail.etxFlag == ETB)
+    {
+        etx = ACK; // 多包，继续发送
+    }
+    ByteBuffer *reply = Center_EncodeReply(pkg, etx);
+    if (reply != NULL)
+    {
+        CenterConn_Send(me, reply->buff, BB_Limit(reply));
+        BB_dtor(reply);
+        DelInstance(reply);
+    }
+}
+
+/**
+ * 窗口内重复的上报: 只解码报文头(含 CRC 校验)，不解码要素，丢弃
+ * 第一份已处理完成时照常确认；第一份还在其他 loop 上处理时回 NAK，由遥测站稍后重发，
+ * 避免第一份处理失败后报告丢失
+ * @param fingerprint 不是重复的报文时为已记录(处理中)的指纹，0 为未记录
+ */
+static bool CenterConn_DropDuplicate(CenterConn *const me, uint8_t *frame, size_t len, uint64_t *fingerprint)
+{
+    Center *center = me->center;
+    *fingerprint = 0;
+    if ((frame[PACKAGE_HEAD_STX_DIRECTION_INDEX] >> PACKAGE_HEAD_STX_DIRECTION_INDEX_MASK_BIT) != Up ||
+        !center->dedups[frame[CENTER_FUNC_CODE_INDEX]])
+    {
+        return false;
+    }
+    UplinkMessage msg;
+    memset(&msg, 0, sizeof(UplinkMessage));
+    Package *pkg = (Package *)&msg;
+    ByteBuffer buff;
+    BB_ctor_wrapped(&buff, frame, len);
+    BB_Flip(&buff);
+    if (!Package_DecodeHead(pkg, &buff))
+    {
+        return false; // 由完整的解码记录错误
+    }
+    uint64_t hash = Center_ReportFingerprint(frame, len);
+    DedupResult res = DedupFilter_Add(center->dedup, hash, Center_NowS());
+    if (res == DEDUP_NEW)
+    {
+        *fingerprint = hash;
+        return false;
+    }
+    if (res == DEDUP_DUPLICATE)
+    {
+        Metric_Inc(&center->duplicates);
+    }
+    size_t headLen = Package_HeadSize(pkg);
+    if ((pkg->head.stxFlag == STX || pkg->head.sequence.seq <= 1) && headLen + 2 <= len - PACKAGE_TAIL_LEN)
+    {
+        msg.messageHead.seq = (frame[headLen] << 8) | frame[headLen + 1];
+    }
+    pkg->tail.etxFlag = frame[len - PACKAGE_TAIL_LEN];
+    if (CenterConn_Bind(me, &pkg->head.stationAddr) != NULL)
+    {
+        CenterConn_Confirm(me, pkg, res == DEDUP_DUPLICATE);
+    }
+    return true;
+}
+
+/**
+ * 一个完整的报文: 去重，绑定 session，分发，自动应答
+ */
+static void CenterConn_OnFrame(CenterConn *const me, uint8_t *frame, size_t len)
+{
+    Center *center = me->center;
+    uint64_t fingerprint = 0;
+    if (center->dedup != NULL && CenterConn_DropDuplicate(me, frame, len, &fingerprint))
+    {
+        return;
+    }
+    ByteBuffer buff;
+    BB_ctor_wrapped(&buff, frame, len);
+    BB_Flip(&buff); // 转为读模式
+    Package *pkg = decodePackage(&buff);
+    if (pkg == NULL)
+    {
+        ChannelMetrics_DecodeError(&center->metrics, last_error());
+        if (fingerprint != 0)
+        {
+            DedupFilter_Remove(center->dedup, fingerprint);
+        }
+        return;
+    }
+    Metric_Inc(&center->metrics.framesIn);
+    bool bound = pkg->head.direction == Up && CenterConn_Bind(me, &pkg->head.stationAddr) != NULL;
+    bool handled = false;
+    if (bound)
+    {
+        Metric_Inc(&me->session->framesIn);
+        CenterHandleFunc handler = center->handlers[pkg->head.funcCode];
+        handled = handler == NULL || handler(me, pkg);
+    }
+    // 先更新指纹再应答，遥测站收到确认后在其他信道上的重发不会再被当作处理中
+    if (fingerprint != 0)
+    {
+        if (handled)
+        {
+            DedupFilter_Commit(center->dedup, fingerprint);
+        }
+        else
+        {
+            DedupFilter_Remove(center->dedup, fingerprint); // 重发的报文需要再次处理
+        }
+    }
+    if (bound)
+    {
+        CenterConn_Confirm(me, pkg, handled);
+    }
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+}
+
+static void CenterConn_OnRead(CenterConn *const me)
+{
+    ssize_t n = recv(me->fd, (char *)me->in + me->inLen, sizeof(me->in) - me->inLen, 0);
+    if (n == 0 || (n < 0 && !Center_WouldBlock() && !Center_Interrupted()))
+    {
+        me->closing = true;
+        return;
+    }
+    if (n < 0)
+    {
+        return;
+    }
+    Metric_Add(&me->center->metrics.bytesIn, n);
+    me->inLen += n;
+    size_t pos = 0;
+    while (pos < me->inLen && !me->closing)
+    {
+        int32_t frameLen = Center_FrameLength(me->in + pos, me->inLen - pos);
+        if (frameLen == 0)
+        {
+            break;
+        }
+        if (frameLen < 0)
+        {
+            pos += -frameLen;
+            continue;
+        }
+        CenterConn_OnFrame(me, me->in + pos, frameLen);
+        pos += frameLen;
+        ev_timer_again(me->shard->loop, &me->idleWatcher);
+    }
+    // in 可以容纳最大的报文，剩余的部分一定是不完整的报文
+    memmove(me->in, me->in + pos, me->inLen - pos);
+    me->inLen -= pos;
+}
+
+static void CenterConn_OnEvent(Reactor *reactor, ev_io *w, int revents)
+{
+    CenterConn *me = (CenterConn *)w->data;
+    if ((revents & EV_WRITE) && !CenterConn_Flush(me))
+    {
+        me->closing = true;
+    }
+    if ((revents & EV_READ) && !me->closing)
+    {
+        CenterConn_OnRead(me);
+    }
+    if (me->closing)
+    {
+        CenterConn_Close(me);
+    }
+}
+
+static void CenterConn_OnIdle(Reactor *reactor, ev_timer *w, int revents)
+{
+    CenterConn_Close((CenterConn *)w->data);
+}
+
+static void CenterConn_OnStart(ReactorTask *const task)
+{
+    CenterConn *me = (CenterConn *)task->data;
+    Reactor *loop = me->shard->loop;
+    ev_tstamp latency = ev_time() - me->acceptedAt;
+    CenterLoopMetrics *metrics = &me->center->loopMetrics[me->shard->id];
+    Metric_Inc(&metrics->accepts);
+    MetricHistogram_Observe(&metrics->acceptLatency, latency > 0 ? (uint64_t)(latency * 1000000) : 0);
+    ev_io_init(&me->watcher, &CenterConn_OnEvent, me->fd, EV_READ);
+    me->watcher.data = me;
+    ev_io_start(loop, &me->watcher);
+    ev_init(&me->idleWatcher, &CenterConn_OnIdle);
+    me->idleWatcher.repeat = CENTER_IDLE_TIMEOUT;
+    me->idleWatcher.data = me;
+    ev_timer_again(loop, &me->idleWatcher);
+}
+// CenterConn END
+
+// Center
+static void Center_OnAccept(Reactor *reactor, ev_io *w, int revents)
+{
+    CenterAcceptor *acceptor = (CenterAcceptor *)w->data;
+    Center *me = acceptor->center;
+    ev_tstamp ready = ev_now(reactor);
+    for (int i = 0; i < CENTER_ACCEPT_BATCH; i++)
+    {
+        int fd = accept(acceptor->fd, NULL, NULL);
+        if (fd < 0)
+        {
+            break; // EAGAIN 或者 fd 用尽，下一次可读时重试
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char const *)&on, sizeof(on));
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (char const *)&on, sizeof(on));
+        if (!Center_SetNonBlocking(fd))
+        {
+            Center_CloseSocket(fd);
+            continue;
+        }
+        CenterConn *conn = NewInstance(CenterConn);
+        if (conn == NULL)
+        {
+            Center_CloseSocket(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->center = me;
+        conn->acceptedAt = ready;
+        // 每个 loop 一个 acceptor 时内核已经分配好，不再转交
+        conn->shard = me->acceptorCount > 1 ? acceptor->shard : ReactorPool_LeastLoaded(&me->pool);
+        __atomic_add_fetch(&conn->shard->load, 1, __ATOMIC_RELAXED);
+        ReactorTask_ctor(&conn->startTask, &CenterConn_OnStart, conn);
+        pthread_mutex_lock(&me->mutex);
+        conn->next = me->conns;
+        if (me->conns != NULL)
+        {
+            me->conns->prev = conn;
+        }
+        me->conns = conn;
+        pthread_mutex_unlock(&me->mutex);
+        Metric_Inc(&me->metrics.connects);
+        if (conn->shard == acceptor->shard)
+        {
+            CenterConn_OnStart(&conn->startTask);
+        }
+        else
+        {
+            ReactorShard_Post(conn->shard, &conn->startTask);
+        }
+    }
+}
+
+static void Center_OnStartAccept(ReactorTask *const task)
+{
+    CenterAcceptor *acceptor = (CenterAcceptor *)task->data;
+    ev_io_start(acceptor->shard->loop, &acceptor->watcher);
+}
+
+void Center_ctor(Center *const me, uint16_t loops, bool pin)
+{
+    assert(me);
+    memset(me, 0, sizeof(Center));
+    ReactorPool_ctor(&me->pool, loops == 0 ? 1 : loops, pin);
+    me->loopMetrics = (CenterLoopMetrics *)calloc(me->pool.count, sizeof(CenterLoopMetrics));
+    me->loopReaders = (CenterLoopReader *)calloc(me->pool.count, sizeof(CenterLoopReader));
+    SessionTable_ctor(&me->sessions, CENTER_SESSIONS_INIT_SIZE);
+#ifdef SO_REUSEPORT
+    me->reusePort = true;
+#endif
+    me->steer = false;
+    me->keepOnline = false;
+    pthread_mutex_init(&me->mutex, NULL);
+    // 遥测站主动上报的报文需要确认
+    for (uint8_t code = TEST; code <= PICTURE; code++)
+    {
+        me->replies[code] = CENTER_REPLY_CONFIRM;
+        me->dedups[code] = true;
+    }
+    me->dedup = NULL;
+}
+
+void Center_dtor(Center *const me)
+{
+    assert(me);
+    Center_Stop(me);
+    ReactorPool_dtor(&me->pool);
+    SessionTable_ForEach(&me->sessions, &Center_FreeSession, NULL);
+    SessionTable_dtor(&me->sessions);
+    if (me->loopMetrics != NULL)
+    {
+        DelInstance(me->loopMetrics);
+    }
+    if (me->loopReaders != NULL)
+    {
+        DelInstance(me->loopReaders);
+    }
+    if (me->dedup != NULL)
+    {
+        DedupFilter_dtor(me->dedup);
+        DelInstance(me->dedup);
+    }
+    pthread_mutex_destroy(&me->mutex);
+}
+
+CenterHandleFunc Center_SetHandler(Center *const me, FunctionCode code, CenterHandleFunc cb)
+{
+    assert(me);
+    CenterHandleFunc prev = me->handlers[(uint8_t)code];
+    me->handlers[(uint8_t)code] = cb;
+    return prev;
+}
+
+void Center_SetReply(Center *const me, FunctionCode code, CenterReplyMode mode)
+{
+    assert(me);
+    me->replies[(uint8_t)code] = mode;
+}
+
+bool Center_EnableDedup(Center *const me, uint32_t windowS, size_t capacity)
+{
+    assert(me);
+    if (me->dedup != NULL)
+    {
+        return false;
+    }
+    DedupFilter *dedup = NewInstance(DedupFilter);
+    if (dedup == NULL)
+    {
+        return false;
+    }
+    DedupFilter_ctor(dedup, windowS, capacity);
+    me->dedup = dedup;
+    return true;
+}
+
+void Center_SetDedup(Center *const me, FunctionCode code, bool dedup)
+{
+    assert(me);
+    me->dedups[(uint8_t)code] = dedup;
+}
+
+/**
+ * @param addr 端口为 0 时回写系统分配的端口，后续的 socket 绑定到同一个端口
+ */
+static int Center_OpenListener(struct sockaddr_in *const addr, bool reusePort)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char const *)&on, sizeof(on));
+    socklen_t len = sizeof(*addr);
+    if (
+#ifdef SO_REUSEPORT
+        (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char const *)&on, sizeof(on)) != 0) ||
+#endif
+        !Center_SetNonBlocking(fd) ||
+        bind(fd, (struct sockaddr *)addr, sizeof(*addr)) != 0 ||
+        listen(fd, CENTER_LISTEN_BACKLOG) != 0 ||
+        getsockname(fd, (struct sockaddr *)addr, &len) != 0)
+    {
+        Center_CloseSocket(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * SYN 到达时按 TCP 源端口 % count 选择 reuseport 组中的 socket，序号即 listen 的顺序
+ * 此时 skb 已经跳过 TCP 头，用 SKF_NET_OFF 从 IP 头开始定位
+ */
+static bool Center_AttachSteering(int fd, uint16_t count)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_NET_OFF)
+    struct sock_filter code[] = {
+        {BPF_LDX | BPF_B | BPF_MSH, 0, 0, (uint32_t)SKF_NET_OFF}, // X = IP 头长度
+        {BPF_LD | BPF_H | BPF_IND, 0, 0, (uint32_t)SKF_NET_OFF},  // A = 源端口
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, count},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, (void *)&prog, sizeof(prog)) == 0;
+#else
+    return false;
+#endif
+}
+
+// loop 已停止或未启动时调用
+static void Center_CloseAcceptors(Center *const me)
+{
+    for (uint16_t i = 0; i < me->acceptorCount; i++)
+    {
+        CenterAcceptor *acceptor = &me->acceptors[i];
+        if (acceptor->shard->loop != NULL)
+        {
+            ev_io_stop(acceptor->shard->loop, &acceptor->watcher);
+        }
+        Center_CloseSocket(acceptor->fd);
+    }
+    if (me->acceptors != NULL)
+    {
+        DelInstance(me->acceptors);
+    }
+    me->acceptorCount = 0;
+}
+
+static bool Center_OpenAcceptors(Center *const me, struct sockaddr_in addr, uint16_t count)
+{
+    me->acceptors = (CenterAcceptor *)calloc(count, sizeof(CenterAcceptor));
+    if (me->acceptors == NULL)
+    {
+        return false;
+    }
+    for (uint16_t i = 0; i < count; i++)
+    {
+        int fd = Center_OpenListener(&addr, count > 1);
+        if (fd < 0)
+        {
+            Center_CloseAcceptors(me);
+            return false;
+        }
+        CenterAcceptor *acceptor = &me->acceptors[i];
+        acceptor->fd = fd;
+        acceptor->center = me;
+        acceptor->shard = &me->pool.shards[i];
+        ev_io_init(&acceptor->watcher, &Center_OnAccept, fd, EV_READ);
+        acceptor->watcher.data = acceptor;
+        ReactorTask_ctor(&acceptor->startTask, &Center_OnStartAccept, acceptor);
+        me->acceptorCount++;
+    }
+    me->port = ntohs(addr.sin_port);
+    return true;
+}
+
+bool Center_Listen(Center *const me, char const *const host, uint16_t port)
+{
+    assert(me);
+    if (me->acceptorCount > 0)
+    {
+        return false;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (host != NULL && inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        return false;
+    }
+    // 不支持 SO_REUSEPORT 或者端口被其他进程占用时，退回一个 acceptor
+    if (!(me->reusePort && me->pool.count > 1 && Center_OpenAcceptors(me, addr, me->pool.count)) &&
+        !Center_OpenAcceptors(me, addr, 1))
+    {
+        return false;
+    }
+    if (me->steer && (me->acceptorCount == 1 || !Center_AttachSteering(me->acceptors[0].fd, me->acceptorCount)))
+    {
+        me->steer = false; // 内核按四元组哈希分配
+    }
+    return true;
+}
+
+bool Center_Start(Center *const me)
+{
+    assert(me);
+    if (me->acceptorCount == 0)
+    {
+        return false;
+    }
+    Center_AttachLoops(me);
+    if (!ReactorPool_Start(&me->pool))
+    {
+        return false;
+    }
+    for (uint16_t i = 0; i < me->acceptorCount; i++)
+    {
+        if (!ReactorShard_Post(me->acceptors[i].shard, &me->acceptors[i].startTask))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Center_Stop(Center *const me)
+{
+    assert(me);
+    ReactorPool_Stop(&me->pool);
+    ReactorPool_Join(&me->pool);
+    Center_DetachLoops(me);
+    // loop 已经停止，直接释放
+    while (me->conns != NULL)
+    {
+        CenterConn *conn = me->conns;
+        ev_io_stop(conn->shard->loop, &conn->watcher);
+        ev_timer_stop(conn->shard->loop, &conn->idleWatcher);
+        CenterConn_Free(conn);
+    }
+    Center_CloseAcceptors(me);
+}
+// Center END
+
+// Metrics
+typedef struct
+{
+    char const *name;
+    char const *help;
+    size_t offset;
+} CenterCounter;
+
+static CenterCounter const CENTER_COUNTERS[] = {
+    {"sl651_center_frames_in_total", "Frames decoded from stations.", offsetof(ChannelMetrics, framesIn)},
+    {"sl651_center_bytes_in_total", "Bytes read from stations.", offsetof(ChannelMetrics, bytesIn)},
+    {"sl651_center_frames_out_total", "Frames queued to stations.", offsetof(ChannelMetrics, framesOut)},
+    {"sl651_center_bytes_out_total", "Bytes written to stations.", offsetof(ChannelMetrics, bytesOut)},
+    {"sl651_center_connects_total", "Connections accepted.", offsetof(ChannelMetrics, connects)},
+    {"sl651_center_disconnects_total", "Connections closed.", offsetof(ChannelMetrics, disconnects)},
+};
+
+void Center_RenderMetrics(void *data, MetricsText *const text)
+{
+    Center *me = (Center *)data;
+    char labels[32];
+    for (size_t c = 0; c < sizeof(CENTER_COUNTERS) / sizeof(CENTER_COUNTERS[0]); c++)
+    {
+        MetricsText_Family(text, CENTER_COUNTERS[c].name, "counter", CENTER_COUNTERS[c].help);
+        MetricsText_Sample(text, CENTER_COUNTERS[c].name, NULL,
+                           Metric_Get((MetricCounter *)((uint8_t *)&me->metrics + CENTER_COUNTERS[c].offset)));
+    }
+    MetricsText_Family(text, "sl651_center_duplicates_total", "counter", "Retransmitted or redundant reports dropped before decoding.");
+    MetricsText_Sample(text, "sl651_center_duplicates_total", NULL, Metric_Get(&me->duplicates));
+    MetricsText_Family(text, "sl651_center_sessions", "gauge", "Stations seen since start.");
+    MetricsText_Sample(text, "sl651_center_sessions", NULL, Center_SessionCount(me));
+    MetricsText_Family(text, "sl651_center_connections", "gauge", "Open connections by event loop.");
+    for (uint16_t i = 0; i < me->pool.count; i++)
+    {
+        snprintf(labels, sizeof(labels), "loop=\"%d\"", i);
+        MetricsText_Sample(text, "sl651_center_connections", labels, __atomic_load_n(&me->pool.shards[i].load, __ATOMIC_RELAXED));
+    }
+    MetricsText_Family(text, "sl651_center_accepts_total", "counter", "Connections started by event loop.");
+    for (uint16_t i = 0; i < me->pool.count; i++)
+    {
+        snprintf(labels, sizeof(labels), "loop=\"%d\"", i);
+        MetricsText_Sample(text, "sl651_center_accepts_total", labels, Metric_Get(&me->loopMetrics[i].accepts));
+    }
+    MetricsText_Family(text, "sl651_center_accept_latency_seconds", "histogram", "Time from the acceptor waking up to the connection being watched.");
+    for (uint16_t i = 0; i < me->pool.count; i++)
+    {
+        snprintf(labels, sizeof(labels), "loop=\"%d\"", i);
+        MetricsText_Histogram(text, "sl651_center_accept_latency_seconds", labels, &me->loopMetrics[i].acceptLatency);
+    }
+}
+// Metrics END
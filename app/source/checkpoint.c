@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "bytebuffer/bytebuffer.h"
+#include "common/class.h"
+#include "checkpoint.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Record
+static void Checkpoint_PutLE(uint8_t *p, uint64_t v, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        p[i] = (v >> (i * 8)) & 0xFF;
+    }
+}
+
+static uint64_t Checkpoint_GetLE(uint8_t const *p, int size)
+{
+    uint64_t v = 0;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * magic(2) pkgCount(2) acked(2) seq(2) chunkSize(4) stamp(4)
+ * fileHash(8) fileSize(8) mtime(8) reserved(6) crc16(2), little endian
+ */
+static void Checkpoint_Encode(TransferCheckpoint const *const cp, uint8_t *record)
+{
+    memset(record, 0, CHECKPOINT_RECORD_LEN);
+    if (cp == NULL) // 空记录
+    {
+        return;
+    }
+    Checkpoint_PutLE(record, CHECKPOINT_MAGIC, 2);
+    Checkpoint_PutLE(record + 2, cp->pkgCount, 2);
+    Checkpoint_PutLE(record + 4, cp->acked, 2);
+    Checkpoint_PutLE(record + 6, cp->seq, 2);
+    Checkpoint_PutLE(record + 8, cp->chunkSize, 4);
+    Checkpoint_PutLE(record + 12, cp->stamp, 4);
+    Checkpoint_PutLE(record + 16, cp->fileHash, 8);
+    Checkpoint_PutLE(record + 24, cp->fileSize, 8);
+    Checkpoint_PutLE(record + 32, (uint64_t)cp->mtime, 8);
+    uint16_t crc = CRC16_Update(CRC16_INIT_VALUE, record, CHECKPOINT_RECORD_LEN - 2);
+    Checkpoint_PutLE(record + CHECKPOINT_RECORD_LEN - 2, crc, 2);
+}
+
+static bool Checkpoint_Decode(TransferCheckpoint *const cp, uint8_t const *record)
+{
+    if (Checkpoint_GetLE(record, 2) != CHECKPOINT_MAGIC ||
+        Checkpoint_GetLE(record + CHECKPOINT_RECORD_LEN - 2, 2) != CRC16_Update(CRC16_INIT_VALUE, record, CHECKPOINT_RECORD_LEN - 2))
+    {
+        return false;
+    }
+    cp->pkgCount = Checkpoint_GetLE(record + 2, 2);
+    cp->acked = Checkpoint_GetLE(record + 4, 2);
+    cp->seq = Checkpoint_GetLE(record + 6, 2);
+    cp->chunkSize = Checkpoint_GetLE(record + 8, 4);
+    cp->stamp = Checkpoint_GetLE(record + 12, 4);
+    cp->fileHash = Checkpoint_GetLE(record + 16, 8);
+    cp->fileSize = Checkpoint_GetLE(record + 24, 8);
+    cp->mtime = (int64_t)Checkpoint_GetLE(record + 32, 8);
+    return cp->fileHash != 0;
+}
+
+static bool CheckpointStore_Write(CheckpointStore *const me, int slot)
+{
+    if (me->fd < 0)
+    {
+        return true; // memory only
+    }
+    uint8_t record[CHECKPOINT_RECORD_LEN];
+    Checkpoint_Encode(me->slots[slot].fileHash != 0 ? &me->slots[slot] : NULL, record);
+    return pwrite(me->fd, record, CHECKPOINT_RECORD_LEN, (off_t)slot * CHECKPOINT_RECORD_LEN) == CHECKPOINT_RECORD_LEN;
+}
+// Record END
+
+void CheckpointStore_ctor(CheckpointStore *const me)
+{
+    assert(me);
+    memset(me->slots, 0, sizeof(me->slots));
+    me->stamp = 0;
+    me->file = NULL;
+    me->fd = -1;
+}
+
+void CheckpointStore_dtor(CheckpointStore *const me)
+{
+    assert(me);
+    if (me->fd >= 0)
+    {
+        close(me->fd);
+        me->fd = -1;
+    }
+    if (me->file != NULL)
+    {
+        DelInstance(me->file);
+    }
+}
+
+bool CheckpointStore_Open(CheckpointStore *const me, char const *const file)
+{
+    assert(me);
+    assert(file);
+    if (me->file != NULL)
+    {
+        return me->fd >= 0; // 已经打开
+    }
+    me->file = strdup(file);
+    me->fd = open(file, O_RDWR | O_CREAT | O_BINARY, 0644);
+    if (me->fd < 0)
+    {
+        return false;
+    }
+    uint8_t buff[CHECKPOINT_SLOTS * CHECKPOINT_RECORD_LEN];
+    ssize_t len = pread(me->fd, buff, sizeof(buff), 0);
+    for (int i = 0; i < CHECKPOINT_SLOTS && (i + 1) * CHECKPOINT_RECORD_LEN <= len; i++)
+    {
+        if (!Checkpoint_Decode(&me->slots[i], buff + i * CHECKPOINT_RECORD_LEN))
+        {
+            memset(&me->slots[i], 0, sizeof(TransferCheckpoint));
+        }
+        else if (me->slots[i].stamp > me->stamp)
+        {
+            me->stamp = me->slots[i].stamp;
+        }
+    }
+    return true;
+}
+
+static int CheckpointStore_IndexOf(CheckpointStore const *const me, uint64_t fileHash)
+{
+    for (int i = 0; i < CHECKPOINT_SLOTS; i++)
+    {
+        if (me->slots[i].fileHash == fileHash)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TransferCheckpoint const *CheckpointStore_Find(CheckpointStore *const me, uint64_t fileHash,
+                                               uint64_t fileSize, int64_t mtime, uint32_t chunkSize)
+{
+    assert(me);
+    int i = CheckpointStore_IndexOf(me, fileHash);
+    if (i < 0)
+    {
+        return NULL;
+    }
+    TransferCheckpoint const *cp = &me->slots[i];
+    if (cp->fileSize != fileSize || cp->mtime != mtime || cp->chunkSize != chunkSize)
+    {
+        CheckpointStore_Remove(me, fileHash); // 文件已变化
+        return NULL;
+    }
+    return cp;
+}
+
+bool CheckpointStore_Save(CheckpointStore *const me, TransferCheckpoint const *const cp)
+{
+    assert(me);
+    assert(cp);
+    assert(cp->fileHash != 0);
+    int i = CheckpointStore_IndexOf(me, cp->fileHash);
+    if (i < 0)
+    {
+        i = CheckpointStore_IndexOf(me, 0); // 空位
+    }
+    if (i < 0) // 替换最旧的
+    {
+        i = 0;
+        for (int j = 1; j < CHECKPOINT_SLOTS; j++)
+        {
+            if (me->slots[j].stamp < me->slots[i].stamp)
+            {
+                i = j;
+            }
+        }
+    }
+    me->slots[i] = *cp;
+    me->slots[i].stamp = ++me->stamp;
+    return CheckpointStore_Write(me, i);
+}
+
+bool CheckpointStore_Remove(CheckpointStore *const me, uint64_t fileHash)
+{
+    assert(me);
+    int i = CheckpointStore_IndexOf(me, fileHash);
+    if (i < 0 || fileHash == 0)
+    {
+        return true;
+    }
+    memset(&me->slots[i], 0, sizeof(TransferCheckpoint));
+    return CheckpointStore_Write(me, i);
+}
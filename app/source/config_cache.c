@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "common/class.h"
+#include "config_cache.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// FNV-1a
+uint64_t ConfigCache_Hash(uint8_t const *data, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void ConfigCache_EncodeLE(uint8_t *p, uint64_t v, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        p[i] = (v >> (i * 8)) & 0xFF;
+    }
+}
+
+static uint64_t ConfigCache_DecodeLE(uint8_t const *p, int size)
+{
+    uint64_t v = 0;
+    for (int i = size - 1; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+bool ConfigCacheSource_Stat(ConfigCacheSource *const me, char const *const file)
+{
+    assert(me);
+    assert(file);
+    int fd = open(file, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    uint8_t *buff = (uint8_t *)malloc(st.st_size);
+    bool res = read(fd, buff, st.st_size) == (ssize_t)st.st_size;
+    close(fd);
+    if (res)
+    {
+        me->mtime = st.st_mtime;
+        me->size = st.st_size;
+        me->hash = ConfigCache_Hash(buff, st.st_size);
+    }
+    DelInstance(buff);
+    return res;
+}
+
+static bool ConfigCache_Validate(ConfigCache *const me, ConfigCacheSource const *const source)
+{
+    uint8_t const *h = (uint8_t const *)me->map;
+    if (me->mapLen < CONFIG_CACHE_HEADER_LEN ||
+        ConfigCache_DecodeLE(h, 4) != CONFIG_CACHE_MAGIC ||
+        ConfigCache_DecodeLE(h + 4, 4) != CONFIG_CACHE_FORMAT ||
+        (int64_t)ConfigCache_DecodeLE(h + 8, 8) != source->mtime ||
+        ConfigCache_DecodeLE(h + 16, 8) != source->size ||
+        ConfigCache_DecodeLE(h + 24, 8) != source->hash)
+    {
+        return false;
+    }
+    uint32_t len = ConfigCache_DecodeLE(h + 32, 4);
+    if (len != me->mapLen - CONFIG_CACHE_HEADER_LEN)
+    {
+        return false; // 写入时被中断
+    }
+    me->payload = h + CONFIG_CACHE_HEADER_LEN;
+    me->len = len;
+    // 只校验低 32 位，源文件的 hash 已经一致
+    return ConfigCache_DecodeLE(h + 36, 4) == (ConfigCache_Hash(me->payload, len) & 0xFFFFFFFF);
+}
+
+bool ConfigCache_Open(ConfigCache *const me, char const *const file, ConfigCacheSource const *const source)
+{
+    assert(me);
+    assert(file);
+    assert(source);
+    memset(me, 0, sizeof(ConfigCache));
+    int fd = open(file, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < CONFIG_CACHE_HEADER_LEN)
+    {
+        close(fd);
+        return false;
+    }
+    me->mapLen = st.st_size;
+#ifndef _WIN32
+    void *map = mmap(NULL, me->mapLen, PROT_READ, MAP_PRIVATE, fd, 0);
+    me->map = map == MAP_FAILED ? NULL : map;
+#else
+    me->map = malloc(me->mapLen);
+    if (read(fd, me->map, me->mapLen) != (ssize_t)me->mapLen)
+    {
+        DelInstance(me->map);
+    }
+#endif
+    close(fd);
+    if (me->map == NULL)
+    {
+        return false;
+    }
+    if (!ConfigCache_Validate(me, source))
+    {
+        ConfigCache_dtor(me);
+        return false;
+    }
+    return true;
+}
+
+void ConfigCache_dtor(ConfigCache *const me)
+{
+    assert(me);
+    if (me->map != NULL)
+    {
+#ifndef _WIN32
+        munmap(me->map, me->mapLen);
+        me->map = NULL;
+#else
+        DelInstance(me->map);
+#endif
+    }
+    me->payload = NULL;
+    me->len = 0;
+    me->pos = 0;
+}
+
+uint64_t ConfigCache_GetUInt(ConfigCache *const me, uint8_t size)
+{
+    assert(me);
+    assert(size <= 8);
+    if (me->error || me->pos + size > me->len)
+    {
+        me->error = true;
+        return 0;
+    }
+    uint64_t v = ConfigCache_DecodeLE(me->payload + me->pos, size);
+    me->pos += size;
+    return v;
+}
+
+char const *ConfigCache_GetString(ConfigCache *const me)
+{
+    assert(me);
+    uint16_t len = ConfigCache_GetUInt(me, 2);
+    if (me->error || len == CONFIG_CACHE_NULL_STRING)
+    {
+        return NULL;
+    }
+    if (me->pos + len + 1 > me->len || me->payload[me->pos + len] != '\0')
+    {
+        me->error = true;
+        return NULL;
+    }
+    char const *str = (char const *)me->payload + me->pos;
+    me->pos += len + 1;
+    return str;
+}
+
+void ConfigCache_PutUInt(ByteBuffer *const payload, uint64_t val, uint8_t size)
+{
+    assert(payload);
+    assert(size <= 8);
+    BB_Expand(payload, size);
+    ConfigCache_EncodeLE(payload->buff + payload->position, val, size);
+    payload->position += size;
+}
+
+void ConfigCache_PutString(ByteBuffer *const payload, char const *const str)
+{
+    assert(payload);
+    size_t len = str == NULL ? 0 : strlen(str);
+    if (str == NULL || len >= CONFIG_CACHE_NULL_STRING)
+    {
+        ConfigCache_PutUInt(payload, CONFIG_CACHE_NULL_STRING, 2);
+        return;
+    }
+    ConfigCache_PutUInt(payload, len, 2);
+    BB_Expand(payload, len + 1);
+    memcpy(payload->buff + payload->position, str, len + 1);
+    payload->position += len + 1;
+}
+
+bool ConfigCache_Save(char const *const file, ConfigCacheSource const *const source, ByteBuffer *const payload)
+{
+    assert(file);
+    assert(source);
+    assert(payload);
+    uint32_t len = BB_Position(payload);
+    uint8_t header[CONFIG_CACHE_HEADER_LEN];
+    ConfigCache_EncodeLE(header, CONFIG_CACHE_MAGIC, 4);
+    ConfigCache_EncodeLE(header + 4, CONFIG_CACHE_FORMAT, 4);
+    ConfigCache_EncodeLE(header + 8, (uint64_t)source->mtime, 8);
+    ConfigCache_EncodeLE(header + 16, source->size, 8);
+    ConfigCache_EncodeLE(header + 24, source->hash, 8);
+    ConfigCache_EncodeLE(header + 32, len, 4);
+    ConfigCache_EncodeLE(header + 36, ConfigCache_Hash(payload->buff, len) & 0xFFFFFFFF, 4);
+    size_t nameLen = strlen(file) + 5;
+    char *tmp = (char *)malloc(nameLen);
+    snprintf(tmp, nameLen, "%s.tmp", file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0)
+    {
+        DelInstance(tmp);
+        return false;
+    }
+    bool res = write(fd, header, sizeof(header)) == (ssize_t)sizeof(header) &&
+               (len == 0 || write(fd, payload->buff, len) == (ssize_t)len);
+#ifndef _WIN32
+    res = res && fsync(fd) == 0;
+#endif
+    close(fd);
+    res = res && rename(tmp, file) == 0;
+    if (!res)
+    {
+        unlink(tmp);
+    }
+    DelInstance(tmp);
+    return res;
+}
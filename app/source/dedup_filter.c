@@ -0,0 +1,189 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/class.h"
+#include "dedup_filter.h"
+
+#define SLOT_EMPTY 0
+#define SLOT_DELETED 1
+
+// 保留 0 / 1 和标记位
+static inline uint64_t DedupFilter_Normalize(uint64_t fingerprint)
+{
+    fingerprint &= ~DEDUP_FILTER_COMMITTED;
+    return fingerprint <= SLOT_DELETED ? fingerprint + 2 : fingerprint;
+}
+
+// 高位选段，低位选槽位
+static inline DedupStripe *DedupFilter_Stripe(DedupFilter *const me, uint64_t fingerprint)
+{
+    return &me->stripes[(fingerprint >> 32) % DEDUP_FILTER_STRIPES];
+}
+
+void DedupFilter_ctor(DedupFilter *const me, uint32_t windowS, size_t capacity)
+{
+    assert(me);
+    // 当前这一代之外的 GENERATIONS - 1 代覆盖整个窗口
+    size_t perGeneration = capacity / (DEDUP_FILTER_STRIPES * (DEDUP_FILTER_GENERATIONS - 1)) + 1;
+    me->slotCount = DEDUP_FILTER_MIN_SLOTS;
+    while (me->slotCount < perGeneration * 2)
+    {
+        me->slotCount *= 2;
+    }
+    me->maxCount = me->slotCount / 2;
+    me->span = (windowS + DEDUP_FILTER_GENERATIONS - 2) / (DEDUP_FILTER_GENERATIONS - 1);
+    if (me->span == 0)
+    {
+        me->span = 1;
+    }
+    for (int s = 0; s < DEDUP_FILTER_STRIPES; s++)
+    {
+        DedupStripe *stripe = &me->stripes[s];
+        pthread_mutex_init(&stripe->mutex, NULL);
+        stripe->current = 0;
+        for (int g = 0; g < DEDUP_FILTER_GENERATIONS; g++)
+        {
+            stripe->generations[g].slots = (uint64_t *)calloc(me->slotCount, sizeof(uint64_t));
+            stripe->generations[g].count = 0;
+            stripe->generations[g].start = INT64_MIN / 2; // 已过期
+        }
+    }
+}
+
+void DedupFilter_dtor(DedupFilter *const me)
+{
+    assert(me);
+    for (int s = 0; s < DEDUP_FILTER_STRIPES; s++)
+    {
+        DedupStripe *stripe = &me->stripes[s];
+        for (int g = 0; g < DEDUP_FILTER_GENERATIONS; g++)
+        {
+            if (stripe->generations[g].slots != NULL)
+            {
+                DelInstance(stripe->generations[g].slots);
+            }
+        }
+        pthread_mutex_destroy(&stripe->mutex);
+    }
+}
+
+// 返回 fingerprint 所在的槽位，不存在时返回 slotCount
+static size_t DedupGeneration_Find(DedupGeneration const *const me, size_t slotCount, uint64_t fingerprint)
+{
+    size_t mask = slotCount - 1;
+    size_t i = fingerprint & mask;
+    for (size_t probes = 0; probes < slotCount; probes++)
+    {
+        uint64_t slot = me->slots[i];
+        if ((slot & ~DEDUP_FILTER_COMMITTED) == fingerprint)
+        {
+            return i;
+        }
+        if (slot == SLOT_EMPTY)
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return slotCount;
+}
+
+// 调用前已确认不存在，且 count < slotCount
+static void DedupGeneration_Insert(DedupGeneration *const me, size_t slotCount, uint64_t fingerprint)
+{
+    size_t mask = slotCount - 1;
+    size_t i = fingerprint & mask;
+    while (me->slots[i] > SLOT_DELETED)
+    {
+        i = (i + 1) & mask;
+    }
+    if (me->slots[i] == SLOT_EMPTY)
+    {
+        me->count++; // 复用删除标记时不增加
+    }
+    me->slots[i] = fingerprint;
+}
+
+// 需持有段锁，当前这一代到期或写满时清空最老的一代
+static DedupGeneration *DedupStripe_Current(DedupStripe *const me, DedupFilter const *const filter, int64_t now)
+{
+    DedupGeneration *current = &me->generations[me->current];
+    if (now - current->start < filter->span && current->count < filter->maxCount)
+    {
+        return current;
+    }
+    me->current = (me->current + 1) % DEDUP_FILTER_GENERATIONS;
+    current = &me->generations[me->current];
+    memset(current->slots, 0, sizeof(uint64_t) * filter->slotCount);
+    current->count = 0;
+    current->start = now;
+    return current;
+}
+
+DedupResult DedupFilter_Add(DedupFilter *const me, uint64_t fingerprint, int64_t now)
+{
+    assert(me);
+    fingerprint = DedupFilter_Normalize(fingerprint);
+    DedupStripe *stripe = DedupFilter_Stripe(me, fingerprint);
+    pthread_mutex_lock(&stripe->mutex);
+    DedupGeneration *current = DedupStripe_Current(stripe, me, now);
+    DedupResult res = DEDUP_NEW;
+    // 长时间没有写入时，老的几代可能已经过期
+    int64_t expire = (int64_t)me->span * DEDUP_FILTER_GENERATIONS;
+    for (int g = 0; g < DEDUP_FILTER_GENERATIONS && res == DEDUP_NEW; g++)
+    {
+        DedupGeneration *generation = &stripe->generations[g];
+        if (now - generation->start >= expire)
+        {
+            continue;
+        }
+        size_t i = DedupGeneration_Find(generation, me->slotCount, fingerprint);
+        if (i != me->slotCount)
+        {
+            res = (generation->slots[i] & DEDUP_FILTER_COMMITTED) ? DEDUP_DUPLICATE : DEDUP_PENDING;
+        }
+    }
+    if (res == DEDUP_NEW)
+    {
+        DedupGeneration_Insert(current, me->slotCount, fingerprint);
+    }
+    pthread_mutex_unlock(&stripe->mutex);
+    return res;
+}
+
+void DedupFilter_Commit(DedupFilter *const me, uint64_t fingerprint)
+{
+    assert(me);
+    fingerprint = DedupFilter_Normalize(fingerprint);
+    DedupStripe *stripe = DedupFilter_Stripe(me, fingerprint);
+    pthread_mutex_lock(&stripe->mutex);
+    for (int g = 0; g < DEDUP_FILTER_GENERATIONS; g++)
+    {
+        DedupGeneration *generation = &stripe->generations[g];
+        size_t i = DedupGeneration_Find(generation, me->slotCount, fingerprint);
+        if (i != me->slotCount)
+        {
+            generation->slots[i] |= DEDUP_FILTER_COMMITTED;
+        }
+    }
+    pthread_mutex_unlock(&stripe->mutex);
+}
+
+void DedupFilter_Remove(DedupFilter *const me, uint64_t fingerprint)
+{
+    assert(me);
+    fingerprint = DedupFilter_Normalize(fingerprint);
+    DedupStripe *stripe = DedupFilter_Stripe(me, fingerprint);
+    pthread_mutex_lock(&stripe->mutex);
+    for (int g = 0; g < DEDUP_FILTER_GENERATIONS; g++)
+    {
+        DedupGeneration *generation = &stripe->generations[g];
+        size_t i = DedupGeneration_Find(generation, me->slotCount, fingerprint);
+        if (i != me->slotCount)
+        {
+            generation->slots[i] = SLOT_DELETED;
+        }
+    }
+    pthread_mutex_unlock(&stripe->mutex);
+}
@@ -0,0 +1,350 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "common/class.h"
+#include "event_log.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+static char const *const EVENT_LEVEL_NAMES[] = {"debug", "info", "warn", "error", "off"};
+static char const EVENT_LEVEL_TAGS[] = {'D', 'I', 'W', 'E'};
+
+static uint64_t eventLogIds = 0;
+// 最近使用的 ring，属于 id 为 eventRingOwner 的 EventLog
+static __thread EventRing *eventRing = NULL;
+static __thread uint64_t eventRingOwner = 0;
+
+EventLevel EventLevel_FromString(char const *level, EventLevel defaultLevel)
+{
+    if (level == NULL)
+    {
+        return defaultLevel;
+    }
+    for (int i = EVENT_LEVEL_DEBUG; i <= EVENT_LEVEL_OFF; i++)
+    {
+        if (strcasecmp(level, EVENT_LEVEL_NAMES[i]) == 0)
+        {
+            return (EventLevel)i;
+        }
+    }
+    return defaultLevel;
+}
+
+static uint64_t EventLog_Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Format
+static void EventLog_Format(EventLog *const me, EventRecord const *const r, FILE *out)
+{
+    EventDef const *def = &me->defs[r->event];
+    time_t seconds = r->stamp / 1000000000;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    fprintf(out, "%04d-%02d-%02d %02d:%02d:%02d.%03d %c ",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            (int)(r->stamp / 1000000 % 1000), EVENT_LEVEL_TAGS[r->level]);
+    if (r->channel != EVENT_NO_CHANNEL)
+    {
+        fprintf(out, "ch[%2d] ", r->channel);
+    }
+    unsigned long long a[EVENT_MAX_ARGS] = {0};
+    for (int i = 0; i < r->argc; i++)
+    {
+        a[i] = r->args[i];
+    }
+    if (def->data == EVENT_DATA_NONE)
+    {
+        fprintf(out, def->fmt, a[0], a[1], a[2], a[3], a[4]);
+    }
+    else
+    {
+        char str[EVENT_DATA_LEN * 2 + 1];
+        if (def->data == EVENT_DATA_HEX)
+        {
+            for (int i = 0; i < r->dataLen; i++)
+            {
+                sprintf(str + i * 2, "%02X", r->data[i]);
+            }
+            str[r->dataLen * 2] = '\0';
+        }
+        else
+        {
+            memcpy(str, r->data, r->dataLen);
+            str[r->dataLen] = '\0';
+        }
+        fprintf(out, def->fmt, str, a[0], a[1], a[2], a[3], a[4]);
+    }
+    fputs("\r\n", out);
+}
+// Format END
+
+// Ring
+static EventRing *EventLog_NewRing(EventLog *const me)
+{
+    EventRing *ring = NewInstance(EventRing);
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->rates = (EventRate *)calloc(me->count, sizeof(EventRate));
+    if (ring->rates == NULL)
+    {
+        DelInstance(ring);
+        return NULL;
+    }
+    ring->owner = pthread_self();
+    // 只增不减，无锁头插
+    EventRing *head = __atomic_load_n(&me->rings, __ATOMIC_ACQUIRE);
+    do
+    {
+        ring->next = head;
+    } while (!__atomic_compare_exchange_n(&me->rings, &head, ring, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    return ring;
+}
+
+static EventRing *EventLog_ThreadRing(EventLog *const me)
+{
+    if (eventRingOwner == me->id)
+    {
+        return eventRing;
+    }
+    // 线程交替写多个 EventLog 时复用已有的 ring，不能每次切换都分配
+    EventRing *ring = __atomic_load_n(&me->rings, __ATOMIC_ACQUIRE);
+    while (ring != NULL && !pthread_equal(ring->owner, pthread_self()))
+    {
+        ring = ring->next;
+    }
+    if (ring == NULL)
+    {
+        ring = EventLog_NewRing(me);
+    }
+    eventRing = ring;
+    eventRingOwner = ring != NULL ? me->id : 0;
+    return ring;
+}
+
+/**
+ * 同一线程内每秒最多 rate 条
+ */
+static bool EventLog_Admit(EventLog *const me, EventRing *const ring, uint16_t event, uint64_t stamp)
+{
+    if (me->rate == 0)
+    {
+        return true;
+    }
+    EventRate *rate = &ring->rates[event];
+    uint32_t second = (uint32_t)(stamp / 1000000000);
+    if (rate->second != second)
+    {
+        rate->second = second;
+        rate->count = 0;
+    }
+    if (rate->count >= me->rate)
+    {
+        __atomic_fetch_add(&ring->suppressed, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    rate->count++;
+    return true;
+}
+
+/**
+ * 取出所有 ring 中的记录
+ * @return 记录数
+ */
+static size_t EventLog_Drain(EventLog *const me)
+{
+    size_t total = 0;
+    for (EventRing *ring = __atomic_load_n(&me->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t tail = ring->tail;
+        for (; tail != head; tail++)
+        {
+            EventRecord const *r = &ring->records[tail & (EVENT_RING_SIZE - 1)];
+            if (me->binaryFd >= 0)
+            {
+                if (write(me->binaryFd, r, sizeof(EventRecord)) != sizeof(EventRecord))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                EventLog_Format(me, r, me->out);
+            }
+            total++;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    uint64_t lost = EventLog_Lost(me);
+    if (lost != me->reportedLost)
+    {
+        if (me->out != NULL)
+        {
+            fprintf(me->out, "event log lost %llu records.\r\n", (unsigned long long)(lost - me->reportedLost));
+        }
+        me->reportedLost = lost;
+    }
+    if (me->out != NULL)
+    {
+        fflush(me->out);
+    }
+    return total;
+}
+
+static void *EventLog_Run(void *data)
+{
+    EventLog *me = (EventLog *)data;
+    while (!__atomic_load_n(&me->stopping, __ATOMIC_ACQUIRE))
+    {
+        if (EventLog_Drain(me) == 0)
+        {
+            usleep(EVENT_LOG_DRAIN_INTERVAL * 1000);
+        }
+    }
+    EventLog_Drain(me);
+    return NULL;
+}
+// Ring END
+
+void EventLog_ctor(EventLog *const me, EventDef const *defs, uint16_t count)
+{
+    assert(me);
+    assert(defs);
+    me->id = __atomic_add_fetch(&eventLogIds, 1, __ATOMIC_RELAXED);
+    me->defs = defs;
+    me->count = count;
+    me->level = EVENT_LEVEL_INFO;
+    me->rate = EVENT_LOG_DEFAULT_RATE;
+    me->rings = NULL;
+    pthread_mutex_init(&me->outMutex, NULL);
+    me->out = stdout;
+    me->binaryFd = -1;
+    me->drainer = NULL;
+    me->stopping = false;
+    me->reportedLost = 0;
+}
+
+void EventLog_dtor(EventLog *const me)
+{
+    assert(me);
+    __atomic_store_n(&me->stopping, true, __ATOMIC_RELEASE);
+    if (me->drainer != NULL)
+    {
+        pthread_join(*me->drainer, NULL);
+        DelInstance(me->drainer);
+    }
+    if (me->binaryFd >= 0)
+    {
+        close(me->binaryFd);
+        me->binaryFd = -1;
+    }
+    EventRing *ring = me->rings;
+    while (ring != NULL)
+    {
+        EventRing *next = ring->next;
+        free(ring->rates);
+        free(ring);
+        ring = next;
+    }
+    me->rings = NULL;
+    pthread_mutex_destroy(&me->outMutex);
+}
+
+bool EventLog_Start(EventLog *const me, FILE *out, char const *binaryFile)
+{
+    assert(me);
+    if (me->drainer != NULL)
+    {
+        return true;
+    }
+    me->out = out;
+    if (binaryFile != NULL)
+    {
+        me->binaryFd = open(binaryFile, O_WRONLY | O_CREAT | O_APPEND | O_BINARY, 0644);
+        if (me->binaryFd < 0)
+        {
+            return false;
+        }
+    }
+    pthread_t *thread = NewInstance(pthread_t);
+    if (pthread_create(thread, NULL, &EventLog_Run, me) != 0)
+    {
+        DelInstance(thread);
+        return false;
+    }
+    me->drainer = thread;
+    return true;
+}
+
+void EventLog_Write(EventLog *const me, uint16_t event, uint8_t channel,
+                    uint64_t const *args, uint8_t argc, void const *data, size_t len)
+{
+    assert(me);
+    assert(event < me->count);
+    uint64_t stamp = EventLog_Now();
+    EventRecord local;
+    EventRecord *r = &local;
+    EventRing *ring = NULL;
+    size_t head = 0;
+    if (me->drainer != NULL)
+    {
+        ring = EventLog_ThreadRing(me);
+        if (ring == NULL || !EventLog_Admit(me, ring, event, stamp))
+        {
+            return;
+        }
+        head = ring->head;
+        if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= EVENT_RING_SIZE)
+        {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        r = &ring->records[head & (EVENT_RING_SIZE - 1)];
+    }
+    r->stamp = stamp;
+    r->event = event;
+    r->level = me->defs[event].level;
+    r->channel = channel;
+    r->argc = argc < EVENT_MAX_ARGS ? argc : EVENT_MAX_ARGS;
+    memcpy(r->args, args, r->argc * sizeof(uint64_t));
+    r->dataLen = len < EVENT_DATA_LEN ? len : EVENT_DATA_LEN;
+    if (r->dataLen > 0)
+    {
+        memcpy(r->data, data, r->dataLen);
+    }
+    if (ring != NULL)
+    {
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        return;
+    }
+    // 没有 drainer，同步输出
+    pthread_mutex_lock(&me->outMutex);
+    EventLog_Format(me, r, me->out);
+    pthread_mutex_unlock(&me->outMutex);
+}
+
+uint64_t EventLog_Lost(EventLog *const me)
+{
+    assert(me);
+    uint64_t lost = 0;
+    for (EventRing *ring = __atomic_load_n(&me->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        lost += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED) + __atomic_load_n(&ring->suppressed, __ATOMIC_RELAXED);
+    }
+    return lost;
+}
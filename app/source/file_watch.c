@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "common/class.h"
+#include "file_watch.h"
+
+#define FILE_WATCH_EVENT_BUFF_SIZE 4096
+#define FILE_WATCH_STOP_CHECK 200 // ms
+
+/**
+ * mtime 或 size 变化
+ */
+static bool FileWatch_IsChanged(FileWatch *const me)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", me->dir, me->name);
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        return false; // 改名的过程中
+    }
+    bool changed = (int64_t)st.st_mtime != me->mtime || (int64_t)st.st_size != me->size;
+    me->mtime = st.st_mtime;
+    me->size = st.st_size;
+    return changed;
+}
+
+#ifdef __linux
+static bool FileWatch_ReadEvents(FileWatch *const me)
+{
+    char buff[FILE_WATCH_EVENT_BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(me->inotifyFd, buff, sizeof(buff));
+    bool changed = false;
+    for (char *p = buff; len > 0 && p < buff + len;)
+    {
+        struct inotify_event *ev = (struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + ev->len;
+        if ((ev->mask & IN_Q_OVERFLOW) ||
+            (ev->len > 0 && strcmp(ev->name, me->name) == 0))
+        {
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        FileWatch_IsChanged(me); // 同步 mtime，避免轮询时再通知一次
+    }
+    return changed;
+}
+#endif
+
+static void *FileWatch_Run(void *data)
+{
+    FileWatch *me = (FileWatch *)data;
+    int waited = 0;
+    while (!__atomic_load_n(&me->stopping, __ATOMIC_ACQUIRE))
+    {
+        bool changed = false;
+#ifdef __linux
+        if (me->inotifyFd >= 0)
+        {
+            struct pollfd pfd = {me->inotifyFd, POLLIN, 0};
+            changed = poll(&pfd, 1, FILE_WATCH_STOP_CHECK) > 0 && FileWatch_ReadEvents(me);
+        }
+        else
+#endif
+        {
+            usleep(FILE_WATCH_STOP_CHECK * 1000);
+            waited += FILE_WATCH_STOP_CHECK;
+            if (waited >= FILE_WATCH_POLL_INTERVAL)
+            {
+                waited = 0;
+                changed = FileWatch_IsChanged(me);
+            }
+        }
+        if (changed)
+        {
+            me->notify(me->data);
+        }
+    }
+    return NULL;
+}
+
+bool FileWatch_Open(FileWatch *const me, char const *const file, FileWatchNotify notify, void *data)
+{
+    assert(me);
+    assert(file);
+    assert(notify);
+    char const *slash = strrchr(file, '/');
+    if (slash != NULL)
+    {
+        size_t len = slash == file ? 1 : slash - file;
+        me->dir = (char *)malloc(len + 1); // mingw 没有 strndup
+        memcpy(me->dir, file, len);
+        me->dir[len] = '\0';
+        me->name = strdup(slash + 1);
+    }
+    else
+    {
+        me->dir = strdup(".");
+        me->name = strdup(file);
+    }
+    me->inotifyFd = -1;
+    me->mtime = 0;
+    me->size = 0;
+    me->thread = NULL;
+    me->stopping = false;
+    me->notify = notify;
+    me->data = data;
+    FileWatch_IsChanged(me);
+#ifdef __linux
+    me->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (me->inotifyFd >= 0 &&
+        inotify_add_watch(me->inotifyFd, me->dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(me->inotifyFd);
+        me->inotifyFd = -1; // 退回轮询
+    }
+#endif
+    pthread_t *thread = NewInstance(pthread_t);
+    if (pthread_create(thread, NULL, &FileWatch_Run, me) != 0)
+    {
+        DelInstance(thread);
+        FileWatch_dtor(me);
+        return false;
+    }
+    me->thread = thread;
+    return true;
+}
+
+void FileWatch_dtor(FileWatch *const me)
+{
+    assert(me);
+    __atomic_store_n(&me->stopping, true, __ATOMIC_RELEASE);
+    if (me->thread != NULL)
+    {
+        pthread_join(*me->thread, NULL);
+        DelInstance(me->thread);
+    }
+    if (me->inotifyFd >= 0)
+    {
+        close(me->inotifyFd);
+        me->inotifyFd = -1;
+    }
+    if (me->dir != NULL)
+    {
+        DelInstance(me->dir);
+    }
+    if (me->name != NULL)
+    {
+        DelInstance(me->name);
+    }
+}
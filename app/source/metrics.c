@@ -0,0 +1,378 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define MSG_NOSIGNAL 0
+#define SOCK_CLOEXEC 0
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "common/class.h"
+#include "metrics.h"
+
+#define METRICS_POLL_TIMEOUT 200   // ms, 检查 stopping
+#define METRICS_REQUEST_TIMEOUT 100 // ms
+#define METRICS_REQUEST_BUFF_SIZE 512
+
+uint64_t const METRIC_HISTOGRAM_BOUNDS[METRIC_HISTOGRAM_BUCKETS - 1] = {
+    10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000};
+
+// MetricHistogram
+void MetricHistogram_Observe(MetricHistogram *const me, uint64_t us)
+{
+    assert(me);
+    int i = 0;
+    while (i < METRIC_HISTOGRAM_BUCKETS - 1 && us > METRIC_HISTOGRAM_BOUNDS[i])
+    {
+        i++;
+    }
+    Metric_Inc(&me->buckets[i]);
+    Metric_Add(&me->sum, us);
+    Metric_Inc(&me->count);
+}
+// MetricHistogram END
+
+// StationMetrics
+void StationMetrics_ctor(StationMetrics *const me)
+{
+    assert(me);
+    memset(me->handlerLatency, 0, sizeof(me->handlerLatency));
+}
+
+void StationMetrics_dtor(StationMetrics *const me)
+{
+    assert(me);
+    for (int i = 0; i < METRIC_MAX_FUNC_CODES; i++)
+    {
+        if (me->handlerLatency[i] != NULL)
+        {
+            DelInstance(me->handlerLatency[i]);
+        }
+    }
+}
+
+MetricHistogram *StationMetrics_Handler(StationMetrics *const me, uint8_t funcCode)
+{
+    assert(me);
+    MetricHistogram *h = __atomic_load_n(&me->handlerLatency[funcCode], __ATOMIC_ACQUIRE);
+    if (h != NULL)
+    {
+        return h;
+    }
+    MetricHistogram *created = NewInstance(MetricHistogram);
+    if (created == NULL)
+    {
+        return NULL;
+    }
+    // 并发分配时只保留先写入的一个
+    if (!__atomic_compare_exchange_n(&me->handlerLatency[funcCode], &h, created, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        DelInstance(created);
+        return h;
+    }
+    return created;
+}
+// StationMetrics END
+
+// MetricsText
+void MetricsText_ctor(MetricsText *const me)
+{
+    assert(me);
+    me->buff = NULL;
+    me->len = 0;
+    me->size = 0;
+}
+
+void MetricsText_dtor(MetricsText *const me)
+{
+    assert(me);
+    if (me->buff != NULL)
+    {
+        DelInstance(me->buff);
+    }
+    me->len = 0;
+    me->size = 0;
+}
+
+bool MetricsText_Printf(MetricsText *const me, char const *fmt, ...)
+{
+    assert(me);
+    assert(fmt);
+    for (;;)
+    {
+        size_t left = me->size - me->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = left > 0 ? vsnprintf(me->buff + me->len, left, fmt, args) : vsnprintf(NULL, 0, fmt, args);
+        va_end(args);
+        if (n < 0)
+        {
+            return false;
+        }
+        if ((size_t)n < left)
+        {
+            me->len += n;
+            return true;
+        }
+        size_t size = me->size == 0 ? 4096 : me->size * 2;
+        while (size - me->len <= (size_t)n)
+        {
+            size *= 2;
+        }
+        char *buff = (char *)realloc(me->buff, size);
+        if (buff == NULL)
+        {
+            return false;
+        }
+        me->buff = buff;
+        me->size = size;
+    }
+}
+
+void MetricsText_Family(MetricsText *const me, char const *name, char const *type, char const *help)
+{
+    MetricsText_Printf(me, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void MetricsText_Sample(MetricsText *const me, char const *name, char const *labels, uint64_t value)
+{
+    if (labels != NULL && labels[0] != '\0')
+    {
+        MetricsText_Printf(me, "%s{%s} %llu\n", name, labels, (unsigned long long)value);
+    }
+    else
+    {
+        MetricsText_Printf(me, "%s %llu\n", name, (unsigned long long)value);
+    }
+}
+
+void MetricsText_Histogram(MetricsText *const me, char const *name, char const *labels, MetricHistogram *const h)
+{
+    assert(h);
+    char const *sep = labels != NULL && labels[0] != '\0' ? "," : "";
+    labels = labels != NULL ? labels : "";
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRIC_HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += Metric_Get(&h->buckets[i]);
+        if (i < METRIC_HISTOGRAM_BUCKETS - 1)
+        {
+            // 边界按秒输出
+            MetricsText_Printf(me, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep,
+                               METRIC_HISTOGRAM_BOUNDS[i] / 1e6, (unsigned long long)cumulative);
+        }
+        else
+        {
+            MetricsText_Printf(me, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep,
+                               (unsigned long long)cumulative);
+        }
+    }
+    char const *open = labels[0] != '\0' ? "{" : "";
+    char const *close = labels[0] != '\0' ? "}" : "";
+    MetricsText_Printf(me, "%s_sum%s%s%s %.6f\n", name, open, labels, close, Metric_Get(&h->sum) / 1e6);
+    MetricsText_Printf(me, "%s_count%s%s%s %llu\n", name, open, labels, close,
+                       (unsigned long long)Metric_Get(&h->count));
+}
+// MetricsText END
+
+// MetricsServer
+static void MetricsServer_Close(int fd)
+{
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+// fd 可读时返回 true
+static bool MetricsServer_Wait(int fd, int timeout)
+{
+#ifdef _WIN32
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval tv = {timeout / 1000, (timeout % 1000) * 1000};
+    return select(fd + 1, &fds, NULL, NULL, &tv) > 0;
+#else
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, timeout) > 0;
+#endif
+}
+
+static bool MetricsServer_WriteAll(int fd, char const *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void MetricsServer_Serve(MetricsServer *const me, int fd)
+{
+    char request[METRICS_REQUEST_BUFF_SIZE] = {0};
+    // 请求内容不重要，只区分是否为 HTTP
+    if (MetricsServer_Wait(fd, METRICS_REQUEST_TIMEOUT))
+    {
+        ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+        if (n < 0)
+        {
+            return;
+        }
+    }
+    MetricsText text;
+    MetricsText_ctor(&text);
+    me->render(me->data, &text);
+    if (strncmp(request, "GET ", 4) == 0)
+    {
+        char head[128];
+        int len = snprintf(head, sizeof(head),
+                           "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: %zu\r\n\r\n",
+                           text.len);
+        if (!MetricsServer_WriteAll(fd, head, len))
+        {
+            MetricsText_dtor(&text);
+            return;
+        }
+    }
+    MetricsServer_WriteAll(fd, text.buff != NULL ? text.buff : "", text.len);
+    MetricsText_dtor(&text);
+}
+
+static void *MetricsServer_Run(void *data)
+{
+    MetricsServer *me = (MetricsServer *)data;
+    while (!__atomic_load_n(&me->stopping, __ATOMIC_ACQUIRE))
+    {
+        if (!MetricsServer_Wait(me->fd, METRICS_POLL_TIMEOUT))
+        {
+            continue;
+        }
+        int fd = accept(me->fd, NULL, NULL);
+        if (fd < 0)
+        {
+            continue;
+        }
+        MetricsServer_Serve(me, fd);
+        MetricsServer_Close(fd);
+    }
+    return NULL;
+}
+
+static int MetricsServer_Listen(char const *socketPath, uint16_t port)
+{
+    int fd = -1;
+    bool bound = false;
+    if (socketPath != NULL)
+    {
+#ifdef _WIN32
+        return -1; // 不支持 Unix socket，需配置 port
+#else
+        struct sockaddr_un addr;
+        if (strlen(socketPath) >= sizeof(addr.sun_path))
+        {
+            return -1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, socketPath);
+        unlink(socketPath); // 上次没有正常退出
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bound = fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+#endif
+    }
+    else
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // 只对本机开放
+        addr.sin_port = htons(port);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int on = 1;
+        bound = fd >= 0 &&
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char const *)&on, sizeof(on)) == 0 &&
+                bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    }
+    if (bound && listen(fd, 8) == 0)
+    {
+        return fd;
+    }
+    if (fd >= 0)
+    {
+        MetricsServer_Close(fd);
+    }
+    return -1;
+}
+
+bool MetricsServer_Open(MetricsServer *const me, char const *socketPath, uint16_t port,
+                        MetricsRender render, void *data)
+{
+    assert(me);
+    assert(render);
+    me->socketPath = NULL;
+    me->thread = NULL;
+    me->stopping = false;
+    me->render = render;
+    me->data = data;
+    me->fd = MetricsServer_Listen(socketPath, port);
+    if (me->fd < 0)
+    {
+        return false;
+    }
+    if (socketPath != NULL)
+    {
+        me->socketPath = strdup(socketPath);
+    }
+    pthread_t *thread = NewInstance(pthread_t);
+    if (pthread_create(thread, NULL, &MetricsServer_Run, me) != 0)
+    {
+        DelInstance(thread);
+        MetricsServer_dtor(me);
+        return false;
+    }
+    me->thread = thread;
+    return true;
+}
+
+void MetricsServer_dtor(MetricsServer *const me)
+{
+    assert(me);
+    __atomic_store_n(&me->stopping, true, __ATOMIC_RELEASE);
+    if (me->thread != NULL)
+    {
+        pthread_join(*me->thread, NULL);
+        DelInstance(me->thread);
+    }
+    if (me->fd >= 0)
+    {
+        MetricsServer_Close(me->fd);
+        me->fd = -1;
+    }
+    if (me->socketPath != NULL)
+    {
+        unlink(me->socketPath);
+        DelInstance(me->socketPath);
+    }
+}
+// MetricsServer END
@@ -0,0 +1,356 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "common/class.h"
+#include "tinydir/tinydir.h"
+#include "outbox.h"
+
+#define OUTBOX_POLL_TIMEOUT 200 // ms, 检查 stopping
+#define OUTBOX_EVENT_BUFF_SIZE 4096
+
+// OutboxFile
+static OutboxFile *OutboxFile_New(char const *dir, char const *name)
+{
+    size_t dirLen = strlen(dir);
+    size_t len = dirLen + 1 + strlen(name) + 1;
+    OutboxFile *file = (OutboxFile *)malloc(sizeof(OutboxFile) + len);
+    snprintf(file->path, len, "%s/%s", dir, name);
+    file->name = file->path + dirLen + 1;
+    return file;
+}
+
+static int OutboxFile_Compare(const void *a, const void *b)
+{
+    OutboxFile const *fa = *(OutboxFile *const *)a;
+    OutboxFile const *fb = *(OutboxFile *const *)b;
+    return strcmp(fa->name, fb->name); // 与 tinydir_open_sorted 一致
+}
+
+static bool Outbox_IsRegularFile(char const *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+// OutboxFile END
+
+/**
+ * 第一个 name >= 目标的位置，需持有锁
+ */
+static int Outbox_LowerBound(Outbox const *const me, char const *name, bool *found)
+{
+    int lo = 0;
+    int hi = me->files.length;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(me->files.data[mid]->name, name) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *found = lo < me->files.length && strcmp(me->files.data[lo]->name, name) == 0;
+    return lo;
+}
+
+/**
+ * 新文件不在所有加入过的文件之后时，cursor 可能已经越过它，需持有锁
+ */
+static void Outbox_Track(Outbox *const me, char const *name)
+{
+    if (me->last != NULL && strcmp(name, me->last) <= 0)
+    {
+        me->epoch++;
+        return;
+    }
+    free(me->last);
+    me->last = strdup(name);
+}
+
+static void Outbox_ClearFiles(OutboxFilePtrVector *files)
+{
+    int i;
+    OutboxFile *f = NULL;
+    vec_foreach(files, f, i)
+    {
+        free(f);
+    }
+    vec_deinit(files);
+}
+
+bool Outbox_Scan(Outbox *const me)
+{
+    assert(me);
+    tinydir_dir dir;
+    if (tinydir_open(&dir, me->dir) != 0)
+    {
+        return false;
+    }
+    OutboxFilePtrVector files;
+    vec_init(&files);
+    while (dir.has_next)
+    {
+        tinydir_file file;
+        if (tinydir_readfile(&dir, &file) == 0 && !file.is_dir)
+        {
+            vec_push(&files, OutboxFile_New(me->dir, file.name));
+        }
+        tinydir_next(&dir);
+    }
+    tinydir_close(&dir);
+    vec_sort(&files, OutboxFile_Compare); // 只在扫描时排序一次
+    pthread_mutex_lock(&me->mutex);
+    OutboxFilePtrVector old = me->files;
+    me->files = files;
+    me->epoch++;
+    free(me->last);
+    me->last = files.length > 0 ? strdup(files.data[files.length - 1]->name) : NULL;
+    pthread_mutex_unlock(&me->mutex);
+    Outbox_ClearFiles(&old);
+    return true;
+}
+
+void Outbox_Add(Outbox *const me, char const *const name)
+{
+    assert(me);
+    assert(name);
+    OutboxFile *file = OutboxFile_New(me->dir, name);
+    if (!Outbox_IsRegularFile(file->path))
+    {
+        free(file);
+        return;
+    }
+    bool found = false;
+    pthread_mutex_lock(&me->mutex);
+    int i = Outbox_LowerBound(me, name, &found);
+    if (!found)
+    {
+        vec_insert(&me->files, i, file);
+        Outbox_Track(me, name);
+        file = NULL;
+    }
+    pthread_mutex_unlock(&me->mutex);
+    if (file != NULL)
+    {
+        free(file);
+    }
+}
+
+void Outbox_Remove(Outbox *const me, char const *const name)
+{
+    assert(me);
+    assert(name);
+    OutboxFile *file = NULL;
+    bool found = false;
+    pthread_mutex_lock(&me->mutex);
+    int i = Outbox_LowerBound(me, name, &found);
+    if (found)
+    {
+        file = me->files.data[i];
+        vec_splice(&me->files, i, 1);
+    }
+    pthread_mutex_unlock(&me->mutex);
+    if (file != NULL)
+    {
+        free(file);
+    }
+}
+
+// OutboxCursor
+void OutboxCursor_ctor(OutboxCursor *const me)
+{
+    assert(me);
+    me->epoch = 0;
+    me->name = NULL;
+}
+
+void OutboxCursor_dtor(OutboxCursor *const me)
+{
+    assert(me);
+    if (me->name != NULL)
+    {
+        DelInstance(me->name);
+    }
+}
+// OutboxCursor END
+
+bool Outbox_Next(Outbox *const me, OutboxCursor *const cursor, OutboxSkip skip, void *ctx,
+                 char *path, size_t size)
+{
+    assert(me);
+    assert(path);
+    bool res = false;
+    int i = 0;
+    OutboxFile *skipped = NULL;
+    pthread_mutex_lock(&me->mutex);
+    if (cursor != NULL && cursor->epoch != me->epoch)
+    {
+        OutboxCursor_dtor(cursor);
+        cursor->epoch = me->epoch;
+    }
+    if (cursor != NULL && cursor->name != NULL)
+    {
+        bool found = false;
+        i = Outbox_LowerBound(me, cursor->name, &found);
+        i += found ? 1 : 0;
+    }
+    for (; i < me->files.length; i++)
+    {
+        OutboxFile *f = me->files.data[i];
+        if (skip == NULL || !skip(ctx, f->path))
+        {
+            snprintf(path, size, "%s", f->path);
+            res = true;
+            break;
+        }
+        skipped = f;
+    }
+    if (cursor != NULL && skipped != NULL)
+    {
+        OutboxCursor_dtor(cursor);
+        cursor->name = strdup(skipped->name);
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return res;
+}
+
+size_t Outbox_Size(Outbox *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    size_t size = me->files.length;
+    pthread_mutex_unlock(&me->mutex);
+    return size;
+}
+
+#ifdef __linux
+static void *Outbox_Watch(void *data)
+{
+    Outbox *me = (Outbox *)data;
+    // inotify_event 需要对齐
+    char buff[OUTBOX_EVENT_BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = {me->inotifyFd, POLLIN, 0};
+    while (!__atomic_load_n(&me->stopping, __ATOMIC_ACQUIRE))
+    {
+        if (poll(&pfd, 1, OUTBOX_POLL_TIMEOUT) <= 0)
+        {
+            continue;
+        }
+        ssize_t len = read(me->inotifyFd, buff, sizeof(buff));
+        if (len <= 0)
+        {
+            continue;
+        }
+        bool added = false;
+        for (char *p = buff; p < buff + len;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) // 丢失了事件
+            {
+                Outbox_Scan(me);
+                added = true;
+                continue;
+            }
+            if (ev->len == 0 || (ev->mask & IN_ISDIR))
+            {
+                continue;
+            }
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) // 写完才加入，避免发送半个文件
+            {
+                Outbox_Add(me, ev->name);
+                added = true;
+            }
+            else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                Outbox_Remove(me, ev->name);
+            }
+        }
+        if (added && me->notify != NULL)
+        {
+            me->notify(me->notifyData);
+        }
+    }
+    return NULL;
+}
+#endif
+
+bool Outbox_Open(Outbox *const me, char const *const dir, OutboxNotify notify, void *notifyData)
+{
+    assert(me);
+    assert(dir);
+    me->dir = strdup(dir);
+    vec_init(&me->files);
+    me->last = NULL;
+    me->epoch = 0;
+    pthread_mutex_init(&me->mutex, NULL);
+    me->inotifyFd = -1;
+    me->watcher = NULL;
+    me->stopping = false;
+    me->notify = notify;
+    me->notifyData = notifyData;
+#ifdef __linux
+    // 先注册再扫描，扫描期间的新文件不会丢失(重复的由 Outbox_Add 去重)
+    me->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (me->inotifyFd >= 0 &&
+        inotify_add_watch(me->inotifyFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0)
+    {
+        close(me->inotifyFd);
+        me->inotifyFd = -1;
+    }
+#endif
+    if (!Outbox_Scan(me))
+    {
+        return false;
+    }
+#ifdef __linux
+    if (me->inotifyFd >= 0)
+    {
+        pthread_t *thread = NewInstance(pthread_t);
+        if (pthread_create(thread, NULL, &Outbox_Watch, me) == 0)
+        {
+            me->watcher = thread;
+        }
+        else
+        {
+            DelInstance(thread);
+        }
+    }
+#endif
+    return true;
+}
+
+void Outbox_dtor(Outbox *const me)
+{
+    assert(me);
+    __atomic_store_n(&me->stopping, true, __ATOMIC_RELEASE);
+    if (me->watcher != NULL)
+    {
+        pthread_join(*me->watcher, NULL);
+        DelInstance(me->watcher);
+    }
+    if (me->inotifyFd >= 0)
+    {
+        close(me->inotifyFd);
+        me->inotifyFd = -1;
+    }
+    Outbox_ClearFiles(&me->files);
+    free(me->last);
+    me->last = NULL;
+    pthread_mutex_destroy(&me->mutex);
+    if (me->dir != NULL)
+    {
+        DelInstance(me->dir);
+    }
+}
@@ -0,0 +1,632 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "common/class.h"
+#include "package_reader.h"
+
+typedef enum
+{
+    READER_VALUE_NUMBER,
+    READER_VALUE_STRING,
+    READER_VALUE_LITERAL, // true / false / null
+} ReaderValueType;
+
+typedef struct
+{
+    ReaderValueType type;
+    double number;
+    char text[PACKAGE_READER_TOKEN_SIZE];
+} ReaderValue;
+
+// 一个 element 对象中识别的字段，顺序不定，对象结束后再创建
+typedef struct
+{
+    char t[PACKAGE_READER_TOKEN_SIZE];
+    char step[PACKAGE_READER_TOKEN_SIZE];
+    char vText[PACKAGE_READER_TOKEN_SIZE];
+    uint8_t id;
+    uint8_t vt;
+    bool sign;
+    double v;
+    size_t count; // v 为数组时的大小
+} ElementFields;
+
+// Stream
+static int PackageReader_Peek(PackageReader *const me)
+{
+    if (me->pos >= me->len)
+    {
+        if (me->file == NULL)
+        {
+            return -1;
+        }
+        me->offset += me->len;
+        me->pos = 0;
+        me->len = fread(me->buff, 1, PACKAGE_READER_BUFF_SIZE, me->file);
+        me->window = me->buff;
+        if (me->len == 0)
+        {
+            return -1;
+        }
+    }
+    return me->window[me->pos];
+}
+
+static int PackageReader_Get(PackageReader *const me)
+{
+    int c = PackageReader_Peek(me);
+    if (c >= 0)
+    {
+        me->pos++;
+    }
+    return c;
+}
+
+// 跳过空白
+static int PackageReader_PeekToken(PackageReader *const me)
+{
+    int c = PackageReader_Peek(me);
+    while (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        me->pos++;
+        c = PackageReader_Peek(me);
+    }
+    return c;
+}
+// Stream END
+
+// Tokens
+/**
+ * 超出 size 的部分丢弃，\u 转义替换为 '?'
+ */
+static bool PackageReader_ReadString(PackageReader *const me, char *out, size_t size)
+{
+    if (PackageReader_Get(me) != '"')
+    {
+        return false;
+    }
+    size_t n = 0;
+    int c;
+    while ((c = PackageReader_Get(me)) != '"')
+    {
+        if (c < 0)
+        {
+            return false;
+        }
+        if (c == '\\')
+        {
+            c = PackageReader_Get(me);
+            switch (c)
+            {
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u':
+                for (int i = 0; i < 4; i++)
+                {
+                    if (PackageReader_Get(me) < 0)
+                    {
+                        return false;
+                    }
+                }
+                c = '?';
+                break;
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            default:
+                return false;
+            }
+        }
+        if (n + 1 < size)
+        {
+            out[n++] = (char)c;
+        }
+    }
+    out[n] = '\0';
+    return true;
+}
+
+static bool PackageReader_ReadValue(PackageReader *const me, ReaderValue *const value)
+{
+    int c = PackageReader_PeekToken(me);
+    if (c == '"')
+    {
+        value->type = READER_VALUE_STRING;
+        return PackageReader_ReadString(me, value->text, sizeof(value->text));
+    }
+    size_t n = 0;
+    bool literal = c >= 'a' && c <= 'z';
+    while ((literal && c >= 'a' && c <= 'z') ||
+           (!literal && c >= 0 && strchr("+-0123456789.eE", c) != NULL))
+    {
+        if (n + 1 < sizeof(value->text))
+        {
+            value->text[n++] = (char)c;
+        }
+        me->pos++;
+        c = PackageReader_Peek(me);
+    }
+    value->text[n] = '\0';
+    if (n == 0)
+    {
+        return false;
+    }
+    if (literal)
+    {
+        value->type = READER_VALUE_LITERAL;
+        value->number = strcmp(value->text, "true") == 0 ? 1 : 0;
+        return strcmp(value->text, "true") == 0 ||
+               strcmp(value->text, "false") == 0 ||
+               strcmp(value->text, "null") == 0;
+    }
+    char *end = NULL;
+    value->type = READER_VALUE_NUMBER;
+    value->number = strtod(value->text, &end);
+    return end != NULL && *end == '\0';
+}
+
+// 不关心的值，对象/数组整体跳过
+static bool PackageReader_SkipValue(PackageReader *const me)
+{
+    ReaderValue ignored;
+    int depth = 0;
+    do
+    {
+        int c = PackageReader_PeekToken(me);
+        if (c == '{' || c == '[')
+        {
+            me->pos++;
+            depth++;
+        }
+        else if (c == '}' || c == ']' || c == ',' || c == ':')
+        {
+            if (depth == 0)
+            {
+                return false;
+            }
+            me->pos++;
+            depth -= (c == '}' || c == ']') ? 1 : 0;
+        }
+        else if (!PackageReader_ReadValue(me, &ignored))
+        {
+            return false;
+        }
+    } while (depth > 0);
+    return true;
+}
+
+/**
+ * 对象已读过 '{'
+ * @return 1: 读到 key，之后是值; 0: 对象结束; -1: 语法错误
+ */
+static int PackageReader_NextKey(PackageReader *const me, char *key, bool *first)
+{
+    int c = PackageReader_PeekToken(me);
+    if (c == '}')
+    {
+        me->pos++;
+        return 0;
+    }
+    if (!*first)
+    {
+        if (c != ',')
+        {
+            return -1;
+        }
+        me->pos++;
+        c = PackageReader_PeekToken(me);
+    }
+    *first = false;
+    if (c != '"' ||
+        !PackageReader_ReadString(me, key, PACKAGE_READER_TOKEN_SIZE) ||
+        PackageReader_PeekToken(me) != ':')
+    {
+        return -1;
+    }
+    me->pos++;
+    return 1;
+}
+
+/**
+ * 数组已读过 '['
+ * @return 1: 之后是元素; 0: 数组结束; -1: 语法错误
+ */
+static int PackageReader_NextItem(PackageReader *const me, bool *first)
+{
+    int c = PackageReader_PeekToken(me);
+    if (c == ']')
+    {
+        me->pos++;
+        return 0;
+    }
+    if (!*first)
+    {
+        if (c != ',')
+        {
+            return -1;
+        }
+        me->pos++;
+    }
+    *first = false;
+    return 1;
+}
+
+// 与 cJSON_GET_NUMBER 一致: 数字直接转换，字符串按 base 解析
+static long ReaderValue_ToNumber(ReaderValue const *const value, int base)
+{
+    switch (value->type)
+    {
+    case READER_VALUE_NUMBER:
+        return (long)value->number;
+    case READER_VALUE_STRING:
+        return strtol(value->text, NULL, base);
+    default:
+        return 0;
+    }
+}
+// Tokens END
+
+// Schema
+static bool PackageReader_ReadValues(PackageReader *const me, ElementFields *const fields)
+{
+    me->pos++; // [
+    bool first = true;
+    int next;
+    while ((next = PackageReader_NextItem(me, &first)) == 1)
+    {
+        ReaderValue value;
+        int c = PackageReader_PeekToken(me);
+        if (c == '{' || c == '[')
+        {
+            if (!PackageReader_SkipValue(me))
+            {
+                return false;
+            }
+            value.number = 0; // 与 cJSON 的 valuedouble 一致
+        }
+        else if (!PackageReader_ReadValue(me, &value))
+        {
+            return false;
+        }
+        else if (value.type != READER_VALUE_NUMBER)
+        {
+            value.number = 0;
+        }
+        if (fields->count < ELEMENT_MAX_VALUES)
+        {
+            me->values[fields->count] = value.number;
+        }
+        fields->count++;
+    }
+    return next == 0;
+}
+
+static Element *ElementFields_Create(ElementFields const *const fields, double const *values)
+{
+    if (strcmp(fields->t, "number") == 0)
+    {
+        return createNumberElement(fields->id, fields->vt, fields->sign, fields->v);
+    }
+    if (strcmp(fields->t, "time_step_code") == 0)
+    {
+        return createTimeStepCodeElement(fields->step[0] != '\0' ? fields->step : NULL,
+                                         fields->id, fields->vt, fields->sign, values, fields->count);
+    }
+    if (strcmp(fields->t, "observetime") == 0)
+    {
+        return createObserveTimeElement(fields->vText);
+    }
+    if (strcmp(fields->t, "rain_hour_5min") == 0)
+    {
+        return createDRP5MINElement(values, fields->count);
+    }
+    if (strcmp(fields->t, "water_hour_5min") == 0)
+    {
+        return createRelativeWaterLevelElement(fields->id, values, fields->count);
+    }
+    return NULL;
+}
+
+/**
+ * @param el 无效的 element 为 NULL
+ */
+static bool PackageReader_ReadElement(PackageReader *const me, Element **el)
+{
+    *el = NULL;
+    if (PackageReader_PeekToken(me) != '{')
+    {
+        return PackageReader_SkipValue(me); // 无效，但不是语法错误
+    }
+    me->pos++;
+    ElementFields fields;
+    memset(&fields, 0, sizeof(ElementFields));
+    char key[PACKAGE_READER_TOKEN_SIZE];
+    bool first = true;
+    int next;
+    while ((next = PackageReader_NextKey(me, key, &first)) == 1)
+    {
+        ReaderValue value;
+        int c = PackageReader_PeekToken(me);
+        if (strcasecmp(key, "v") == 0 && c == '[')
+        {
+            if (!PackageReader_ReadValues(me, &fields))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[')
+        {
+            if (!PackageReader_SkipValue(me))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (!PackageReader_ReadValue(me, &value))
+        {
+            return false;
+        }
+        bool isString = value.type == READER_VALUE_STRING;
+        if (strcasecmp(key, "t") == 0 && isString)
+        {
+            strcpy(fields.t, value.text);
+        }
+        else if (strcasecmp(key, "step") == 0 && isString)
+        {
+            strcpy(fields.step, value.text);
+        }
+        else if (strcasecmp(key, "id") == 0)
+        {
+            fields.id = ReaderValue_ToNumber(&value, 16);
+        }
+        else if (strcasecmp(key, "vt") == 0)
+        {
+            fields.vt = ReaderValue_ToNumber(&value, 16);
+        }
+        else if (strcasecmp(key, "sign") == 0)
+        {
+            fields.sign = ReaderValue_ToNumber(&value, 16) != 0;
+        }
+        else if (strcasecmp(key, "v") == 0)
+        {
+            fields.v = value.type == READER_VALUE_NUMBER ? value.number : 0;
+            if (isString)
+            {
+                strcpy(fields.vText, value.text);
+            }
+        }
+    }
+    if (next < 0)
+    {
+        return false;
+    }
+    *el = ElementFields_Create(&fields, me->values);
+    return true;
+}
+
+static void PackageReader_ClearElements(PackageReader *const me)
+{
+    Element *el;
+    size_t i;
+    vec_foreach(&me->elements, el, i)
+    {
+        el->vptr->dtor(el);
+        DelInstance(el);
+    }
+    vec_clear(&me->elements);
+}
+
+static bool PackageReader_ReadElements(PackageReader *const me, bool *valid)
+{
+    me->pos++; // [
+    bool first = true;
+    int next;
+    while ((next = PackageReader_NextItem(me, &first)) == 1)
+    {
+        Element *el = NULL;
+        if (!PackageReader_ReadElement(me, &el))
+        {
+            return false;
+        }
+        if (el == NULL || !*valid)
+        {
+            *valid = false; // 与 createPackage 一致，一个无效则整个报文无效
+            if (el != NULL)
+            {
+                el->vptr->dtor(el);
+                DelInstance(el);
+            }
+            continue;
+        }
+        vec_push(&me->elements, el);
+    }
+    return next == 0;
+}
+
+static bool PackageReader_ReadPackage(PackageReader *const me, Package **pkg)
+{
+    *pkg = NULL;
+    me->pos++; // {
+    Direction direction = Up;
+    uint8_t fcode = 0;
+    uint8_t stxFlag = STX;
+    uint8_t etxFlag = ETX;
+    char observetime[PACKAGE_READER_TOKEN_SIZE] = {0};
+    bool valid = true;
+    char key[PACKAGE_READER_TOKEN_SIZE];
+    bool first = true;
+    int next;
+    while ((next = PackageReader_NextKey(me, key, &first)) == 1)
+    {
+        ReaderValue value;
+        int c = PackageReader_PeekToken(me);
+        if (strcasecmp(key, "elements") == 0 && c == '[')
+        {
+            if (!PackageReader_ReadElements(me, &valid))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[')
+        {
+            if (!PackageReader_SkipValue(me))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (!PackageReader_ReadValue(me, &value))
+        {
+            return false;
+        }
+        if (strcasecmp(key, "direction") == 0)
+        {
+            direction = value.type == READER_VALUE_NUMBER ? (Direction)value.number : Up;
+        }
+        else if (strcasecmp(key, "fcode") == 0)
+        {
+            fcode = ReaderValue_ToNumber(&value, 16);
+        }
+        else if (strcasecmp(key, "stxFlag") == 0)
+        {
+            stxFlag = ReaderValue_ToNumber(&value, 16);
+        }
+        else if (strcasecmp(key, "etxFlag") == 0)
+        {
+            etxFlag = ReaderValue_ToNumber(&value, 16);
+        }
+        else if (strcasecmp(key, "observetime") == 0 && value.type == READER_VALUE_STRING)
+        {
+            strcpy(observetime, value.text);
+        }
+    }
+    if (next < 0)
+    {
+        return false;
+    }
+    if (!valid)
+    {
+        PackageReader_ClearElements(me);
+        return true;
+    }
+    // direction 可能在 elements 之后，结束时才创建报文
+    *pkg = createPackageHead(direction, observetime[0] != '\0' ? observetime : NULL);
+    Element *el;
+    size_t i;
+    vec_foreach(&me->elements, el, i)
+    {
+        el->direction = direction;
+        LinkMessage_PushElement((LinkMessage *)*pkg, el);
+    }
+    vec_clear(&me->elements);
+    (*pkg)->head.funcCode = fcode;
+    (*pkg)->head.stxFlag = stxFlag;
+    (*pkg)->tail.etxFlag = etxFlag;
+    return true;
+}
+// Schema END
+
+static void PackageReader_init(PackageReader *const me)
+{
+    me->file = NULL;
+    me->window = NULL;
+    me->len = 0;
+    me->pos = 0;
+    me->inArray = false;
+    me->first = true;
+    me->status = PACKAGE_READER_OK;
+    me->offset = 0;
+    vec_init(&me->elements);
+}
+
+void PackageReader_ctor(PackageReader *const me, FILE *file)
+{
+    assert(me);
+    assert(file);
+    PackageReader_init(me);
+    me->file = file;
+}
+
+void PackageReader_ctor_memory(PackageReader *const me, char const *data, size_t len)
+{
+    assert(me);
+    assert(data);
+    PackageReader_init(me);
+    me->window = (uint8_t const *)data;
+    me->len = len;
+}
+
+void PackageReader_dtor(PackageReader *const me)
+{
+    assert(me);
+    PackageReader_ClearElements(me);
+    vec_deinit(&me->elements);
+}
+
+bool PackageReader_Next(PackageReader *const me, Package **pkg)
+{
+    assert(me);
+    assert(pkg);
+    *pkg = NULL;
+    while (me->status == PACKAGE_READER_OK)
+    {
+        int c = PackageReader_PeekToken(me);
+        if (me->inArray)
+        {
+            int next = PackageReader_NextItem(me, &me->first);
+            if (next == 0)
+            {
+                me->inArray = false;
+                continue;
+            }
+            c = next < 0 ? -1 : PackageReader_PeekToken(me);
+            if (c != '{')
+            {
+                me->status = PACKAGE_READER_SYNTAX_ERROR; // 数组未结束或元素不是对象
+                break;
+            }
+        }
+        else if (c < 0)
+        {
+            me->status = PACKAGE_READER_END;
+            break;
+        }
+        else if (c == '[')
+        {
+            me->pos++;
+            me->inArray = true;
+            me->first = true;
+            continue;
+        }
+        else if (c != '{')
+        {
+            me->status = PACKAGE_READER_SYNTAX_ERROR;
+            break;
+        }
+        if (PackageReader_ReadPackage(me, pkg))
+        {
+            return true;
+        }
+        PackageReader_ClearElements(me);
+        me->status = PACKAGE_READER_SYNTAX_ERROR;
+    }
+    return false;
+}
@@ -1,9 +1,164 @@
 #include <assert.h>
 #include <stdio.h>
+#include <math.h>
 #include "cJSON/cJSON_Helper.h"
 #include "common/class.h"
 #include "packet_creator.h"
 
+// Element Factories
+Element *createNumberElement(uint8_t id, uint8_t vt, bool sign, double value)
+{
+    if (id == 0 || vt == 0)
+    {
+        return NULL;
+    }
+    Element *el = (Element *)NewInstance(NumberElement);
+    NumberElement_ctor((NumberElement *)el, id, vt, sign);
+    if ((vt & NUMBER_ELEMENT_PRECISION_MASK) == 0)
+    {
+        NumberElement_SetInteger((NumberElement *)el, value);
+    }
+    else
+    {
+        NumberElement_SetDouble((NumberElement *)el, value);
+    }
+    return el;
+}
+
+Element *createTimeStepCodeElement(char const *step, uint8_t id, uint8_t vt, bool sign, double const *values, size_t count)
+{
+    if (step == NULL ||
+        strlen(step) != 6 ||
+        id == 0 ||
+        vt == 0 ||
+        count <= 0 ||
+        count > ELEMENT_MAX_VALUES)
+    {
+        return NULL;
+    }
+    ByteBuffer buff = {0};
+    BB_ctor_fromHexStr(&buff, step, 6);
+    BB_Flip(&buff);
+    TimeStepCodeElement *el = NewInstance(TimeStepCodeElement);
+    TimeStepCodeElement_ctor(el, sign);
+    TimeStepCode_Decode(&el->timeStepCode, &buff);
+    BB_dtor(&buff);
+    NumberListElement_ctor(&el->numberListElement, id, vt, sign, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((vt & NUMBER_ELEMENT_PRECISION_MASK) == 0)
+        {
+            NumberListElement_SetIntegerAt(&el->numberListElement, i, values[i]);
+        }
+        else
+        {
+            NumberListElement_SetDoubleAt(&el->numberListElement, i, values[i]);
+        }
+    }
+    return (Element *)el;
+}
+
+Element *createObserveTimeElement(char const *observetime)
+{
+    if (observetime == NULL || strlen(observetime) != 10)
+    {
+        return NULL;
+    }
+    ByteBuffer buff = {0};
+    BB_ctor_fromHexStr(&buff, observetime, 10);
+    BB_Flip(&buff);
+    ObserveTimeElement *el = NewInstance(ObserveTimeElement);
+    ObserveTimeElement_ctor(el);
+    ObserveTime_Decode(&el->observeTime, &buff);
+    BB_dtor(&buff);
+    return (Element *)el;
+}
+
+Element *createDRP5MINElement(double const *values, size_t count)
+{
+    if (count != 12)
+    {
+        return NULL;
+    }
+    DRP5MINElement *el = NewInstance(DRP5MINElement);
+    DRP5MINElement_ctor(el);
+    for (size_t i = 0; i < count; i++)
+    {
+        DRP5MINElement_SetValueAt(el, i, values[i]);
+    }
+    return (Element *)el;
+}
+
+Element *createRelativeWaterLevelElement(uint8_t id, double const *values, size_t count)
+{
+    if (id == 0 || count != 12)
+    {
+        return NULL;
+    }
+    RelativeWaterLevelElement *el = NewInstance(RelativeWaterLevelElement);
+    RelativeWaterLevelElement_ctor(el, id);
+    for (size_t i = 0; i < count; i++)
+    {
+        RelativeWaterLevelElement_SetValueAt(el, i, values[i]);
+    }
+    return (Element *)el;
+}
+
+Package *createPackageHead(Direction direction, char const *observetime)
+{
+    Package *pkg = NULL;
+    if (direction == Down)
+    {
+        DownlinkMessage *msg = NewInstance(DownlinkMessage);
+        DownlinkMessage_ctor((DownlinkMessage *)msg, DEFAULT_ELEMENT_NUMBER);
+        pkg = (Package *)msg;
+    }
+    else
+    {
+        UplinkMessage *msg = NewInstance(UplinkMessage);
+        UplinkMessage_ctor((UplinkMessage *)msg, DEFAULT_ELEMENT_NUMBER);
+        pkg = (Package *)msg;
+        if (observetime != NULL && strlen(observetime) == 10)
+        {
+            ByteBuffer buff = {0};
+            BB_ctor_fromHexStr(&buff, observetime, 10);
+            BB_Flip(&buff);
+            ObserveTime_Decode(&msg->messageHead.observeTimeElement.observeTime, &buff);
+            BB_dtor(&buff);
+        }
+        else
+        {
+            ObserveTime_now(&msg->messageHead.observeTimeElement.observeTime);
+        }
+    }
+    return pkg;
+}
+
+/**
+ * cJSON 数组转为 double，最多 ELEMENT_MAX_VALUES 个
+ * @return 数组大小，不是数组时为 0
+ */
+static size_t copyArrayValues(cJSON *const values, double *out)
+{
+    if (values == NULL || values->type != cJSON_Array)
+    {
+        return 0;
+    }
+    size_t count = cJSON_GetArraySize(values);
+    size_t i = 0;
+    cJSON *v;
+    cJSON_ArrayForEach(v, values)
+    {
+        if (i >= ELEMENT_MAX_VALUES)
+        {
+            break;
+        }
+        out[i++] = v->valuedouble;
+    }
+    return count;
+}
+// Element Factories END
+
 // Element Creators
 // ElementCreator Interface
 void ElementCreator_ctor(ElementCreator *const me)
@@ -25,23 +180,9 @@ Element *NumberElementCreator_createElement(ElementCreator *const me, cJSON *con
     cJSON_GET_NUMBER(id, uint8_t, data, 0, 16);
     cJSON_GET_NUMBER(vt, uint8_t, data, 0, 16);
     cJSON_GET_NUMBER(sign, bool, data, 0, 16);
-    if (id == 0 || vt == 0)
-    {
-        return NULL;
-    }
     double value = 0;
     cJSON_COPY_VALUE(value, v, data, valuedouble);
-    Element *el = (Element *)NewInstance(NumberElement);
-    NumberElement_ctor((NumberElement *)el, id, vt, sign);
-    if ((vt & NUMBER_ELEMENT_PRECISION_MASK) == 0)
-    {
-        NumberElement_SetInteger((NumberElement *)el, value);
-    }
-    else
-    {
-        NumberElement_SetDouble((NumberElement *)el, value);
-    }
-    return el;
+    return createNumberElement(id, vt, sign, value);
 }
 
 void NumberElementCreator_dtor(ElementCreator *const me)
@@ -69,41 +210,10 @@ Element *TimeStepCodeElementCreator_createElement(ElementCreator *const me, cJSO
     cJSON_GET_VALUE(step, char *, data, valuestring, NULL);
     cJSON_GET_NUMBER(id, uint8_t, data, 0, 16);
     cJSON_GET_NUMBER(vt, uint8_t, data, 0, 16);
-    cJSON *values = cJSON_GetObjectItem(data, "v");
-    if (step == NULL ||
-        strlen(step) != 6 ||
-        id == 0 ||
-        vt == 0 ||
-        values == NULL ||
-        values->type != cJSON_Array ||
-        cJSON_GetArraySize(values) <= 0)
-    {
-        return NULL;
-    }
-    ByteBuffer buff = {0};
-    BB_ctor_fromHexStr(&buff, step, 6);
-    BB_Flip(&buff);
     cJSON_GET_NUMBER(sign, bool, data, 0, 16);
-    TimeStepCodeElement *el = NewInstance(TimeStepCodeElement);
-    TimeStepCodeElement_ctor(el, sign);
-    TimeStepCode_Decode(&el->timeStepCode, &buff);
-    BB_dtor(&buff);
-    NumberListElement_ctor(&el->numberListElement, id, vt, sign, cJSON_GetArraySize(values));
-    cJSON *v;
-    size_t i = 0;
-    cJSON_ArrayForEach(v, values)
-    {
-        if ((vt & NUMBER_ELEMENT_PRECISION_MASK) == 0)
-        {
-            NumberListElement_SetIntegerAt(&el->numberListElement, i, v->valuedouble);
-        }
-        else
-        {
-            NumberListElement_SetDoubleAt(&el->numberListElement, i, v->valuedouble);
-        }
-        i++;
-    }
-    return (Element *)el;
+    double values[ELEMENT_MAX_VALUES];
+    size_t count = copyArrayValues(cJSON_GetObjectItem(data, "v"), values);
+    return createTimeStepCodeElement(step, id, vt, sign, values, count);
 }
 
 void TimeStepCodeElementCreator_dtor(ElementCreator *const me)
@@ -129,21 +239,7 @@ Element *ObserveTimeElementCreator_createElement(ElementCreator *const me, cJSON
     assert(me);
     assert(data);
     cJSON_GET_VALUE(v, char *, data, valuestring, NULL);
-    if (v != NULL && strlen(v) == 10)
-    {
-        ByteBuffer buff = {0};
-        BB_ctor_fromHexStr(&buff, v, 10);
-        BB_Flip(&buff);
-        ObserveTimeElement *el = NewInstance(ObserveTimeElement);
-        ObserveTimeElement_ctor(el);
-        ObserveTime_Decode(&el->observeTime, &buff);
-        BB_dtor(&buff);
-        return (Element *)el;
-    }
-    else
-    {
-        return NULL;
-    }
+    return createObserveTimeElement(v);
 }
 
 void ObserveTimeElementCreator_dtor(ElementCreator *const me)
@@ -168,23 +264,9 @@ Element *DRP5MINElementCreator_createElement(ElementCreator *const me, cJSON *co
 {
     assert(me);
     assert(data);
-    cJSON *values = cJSON_GetObjectItem(data, "v");
-    if (values == NULL ||
-        values->type != cJSON_Array ||
-        cJSON_GetArraySize(values) != 12)
-    {
-        return NULL;
-    }
-    DRP5MINElement *el = NewInstance(DRP5MINElement);
-    DRP5MINElement_ctor(el);
-    cJSON *v;
-    size_t i = 0;
-    cJSON_ArrayForEach(v, values)
-    {
-        DRP5MINElement_SetValueAt(el, i, v->valuedouble);
-        i++;
-    }
-    return (Element *)el;
+    double values[ELEMENT_MAX_VALUES];
+    size_t count = copyArrayValues(cJSON_GetObjectItem(data, "v"), values);
+    return createDRP5MINElement(values, count);
 }
 
 void DRP5MINElementCreator_dtor(ElementCreator *const me)
@@ -210,24 +292,9 @@ Element *RelativeWaterLevelElementCreator_createElement(ElementCreator *const me
     assert(me);
     assert(data);
     cJSON_GET_NUMBER(id, uint8_t, data, 0, 16);
-    cJSON *values = cJSON_GetObjectItem(data, "v");
-    if (id == 0 ||
-        values == NULL ||
-        values->type != cJSON_Array ||
-        cJSON_GetArraySize(values) != 12)
-    {
-        return NULL;
-    }
-    RelativeWaterLevelElement *el = NewInstance(RelativeWaterLevelElement);
-    RelativeWaterLevelElement_ctor(el, id);
-    cJSON *v;
-    size_t i = 0;
-    cJSON_ArrayForEach(v, values)
-    {
-        RelativeWaterLevelElement_SetValueAt(el, i, v->valuedouble);
-        i++;
-    }
-    return (Element *)el;
+    double values[ELEMENT_MAX_VALUES];
+    size_t count = copyArrayValues(cJSON_GetObjectItem(data, "v"), values);
+    return createRelativeWaterLevelElement(id, values, count);
 }
 
 void RelativeWaterLevelElementCreator_dtor(ElementCreator *const me)
@@ -255,37 +322,11 @@ Package *createPackage(cJSON *const schema)
         return NULL;
     }
     // RT_ASSERT(data);
-    Package *pkg = NULL;
-    LinkMessage *linkMsg = NULL;
     // functionCode 不做有效性判断
     cJSON_GET_VALUE(direction, Direction, schema, valuedouble, Up);
-    if (direction == Down)
-    {
-        DownlinkMessage *msg = NewInstance(DownlinkMessage);
-        DownlinkMessage_ctor((DownlinkMessage *)msg, DEFAULT_ELEMENT_NUMBER);
-        pkg = (Package *)msg;
-        linkMsg = (LinkMessage *)msg;
-    }
-    else
-    {
-        UplinkMessage *msg = NewInstance(UplinkMessage);
-        UplinkMessage_ctor((UplinkMessage *)msg, DEFAULT_ELEMENT_NUMBER);
-        pkg = (Package *)msg;
-        linkMsg = (LinkMessage *)msg;
-        cJSON_GET_VALUE(observetime, char *, schema, valuestring, NULL);
-        if (observetime != NULL && strlen(observetime) == 10)
-        {
-            ByteBuffer buff = {0};
-            BB_ctor_fromHexStr(&buff, observetime, 10);
-            BB_Flip(&buff);
-            ObserveTime_Decode(&msg->messageHead.observeTimeElement.observeTime, &buff);
-            BB_dtor(&buff);
-        }
-        else
-        {
-            ObserveTime_now(&msg->messageHead.observeTimeElement.observeTime);
-        }
-    }
+    cJSON_GET_VALUE(observetime, char *, schema, valuestring, NULL);
+    Package *pkg = createPackageHead(direction, observetime);
+    LinkMessage *linkMsg = (LinkMessage *)pkg;
     bool validSchema = true;
     cJSON *elements = cJSON_GetObjectItem(schema, "elements");
     if (elements != NULL && elements->type == cJSON_Array)
@@ -363,4 +404,331 @@ Package *createPackage(cJSON *const schema)
         DelInstance(pkg);
     }
     return pkg;
-}
\ No newline at end of file
+}
+// ReportTemplate
+#define REPORT_TEMPLATE_STATION_ADDR_AT 3 // SOH(2) + 中心站地址(1)
+#define REPORT_TEMPLATE_PASSWORD_AT (REPORT_TEMPLATE_STATION_ADDR_AT + REMOTE_STATION_ADDR_LEN)
+
+/**
+ * 每种 element 的值都在 element 的末尾，count 个，每个 size 字节
+ * @return 值的个数，-1 表示不支持的类型
+ */
+static int ReportTemplate_ElementSlots(cJSON *const elementSchema, Element *const el, ReportSlot *slot)
+{
+    cJSON_GET_VALUE(t, char *, elementSchema, valuestring, NULL);
+    cJSON *values = cJSON_GetObjectItem(elementSchema, "v");
+    slot->kind = REPORT_SLOT_BCD;
+    slot->size = el->dataDef >> NUMBER_ELEMENT_LEN_OFFSET;
+    slot->scale = pow(10, el->dataDef & NUMBER_ELEMENT_PRECISION_MASK);
+    if (strcmp(t, "number") == 0)
+    {
+        return 1;
+    }
+    if (strcmp(t, "time_step_code") == 0)
+    {
+        TimeStepCodeElement *tsc = (TimeStepCodeElement *)el;
+        uint8_t dataDef = tsc->numberListElement.super.dataDef;
+        slot->size = dataDef >> NUMBER_ELEMENT_LEN_OFFSET;
+        slot->scale = pow(10, dataDef & NUMBER_ELEMENT_PRECISION_MASK);
+        return cJSON_GetArraySize(values);
+    }
+    if (strcmp(t, "rain_hour_5min") == 0)
+    {
+        slot->kind = REPORT_SLOT_DRP5MIN;
+        slot->size = 1;
+        slot->scale = 10;
+        return cJSON_GetArraySize(values);
+    }
+    if (strcmp(t, "water_hour_5min") == 0)
+    {
+        slot->kind = REPORT_SLOT_WATER5MIN;
+        slot->size = 2;
+        slot->scale = 100;
+        return cJSON_GetArraySize(values);
+    }
+    if (strcmp(t, "observetime") == 0)
+    {
+        return 0;
+    }
+    return -1;
+}
+
+static bool ReportTemplate_Layout(ReportTemplate *const me, cJSON *const schema, LinkMessage *const linkMsg)
+{
+    uint32_t limit = BB_Limit(&me->frame);
+    uint32_t bodySize = 0;
+    Element *el;
+    size_t i;
+    vec_foreach(&linkMsg->elements, el, i)
+    {
+        bodySize += el->vptr->size(el);
+    }
+    uint32_t at = limit - PACKAGE_TAIL_LEN - bodySize;
+    ReportSlot *slots = (ReportSlot *)malloc(sizeof(ReportSlot) * MAX_ELEMENT_NUMBER);
+    size_t capacity = MAX_ELEMENT_NUMBER;
+    size_t count = 0;
+    cJSON *elementSchema = cJSON_GetObjectItem(schema, "elements");
+    elementSchema = elementSchema != NULL ? elementSchema->child : NULL;
+    bool res = true;
+    vec_foreach(&linkMsg->elements, el, i)
+    {
+        ReportSlot slot;
+        int n = elementSchema != NULL ? ReportTemplate_ElementSlots(elementSchema, el, &slot) : -1;
+        size_t size = el->vptr->size(el);
+        if (n < 0 || (size_t)n * slot.size > size - ELEMENT_IDENTIFER_LEN)
+        {
+            res = false;
+            break;
+        }
+        if (count + n > capacity)
+        {
+            capacity = count + n;
+            slots = (ReportSlot *)realloc(slots, sizeof(ReportSlot) * capacity);
+        }
+        for (int k = 0; k < n; k++)
+        {
+            slot.offset = at + size - (n - k) * slot.size;
+            slots[count++] = slot;
+        }
+        at += size;
+        elementSchema = elementSchema->next;
+    }
+    if (!res || count > UINT16_MAX)
+    {
+        free(slots);
+        return false;
+    }
+    me->slots = slots;
+    me->slotCount = count;
+    return true;
+}
+
+bool ReportTemplate_Compile(ReportTemplate *const me, cJSON *const schema)
+{
+    assert(me);
+    memset(me, 0, sizeof(ReportTemplate));
+    Package *pkg = createPackage(schema);
+    if (pkg == NULL)
+    {
+        return false;
+    }
+    if (pkg->head.direction != Up || pkg->head.stxFlag != STX)
+    {
+        pkg->vptr->dtor(pkg);
+        DelInstance(pkg);
+        return false;
+    }
+    ByteBuffer *buff = pkg->vptr->encode(pkg);
+    bool res = buff != NULL;
+    if (res)
+    {
+        BB_Flip(buff);
+        me->frame = *buff; // 接管内存
+        DelInstance(buff);
+        res = ReportTemplate_Layout(me, schema, (LinkMessage *)pkg);
+    }
+    if (res)
+    {
+        uint8_t funcCode = pkg->head.funcCode;
+        uint16_t at = PACKAGE_HEAD_STX_LEN + 2 + DATETIME_LEN; // 流水号 + 发报时间
+        if (isContainRemoteStationAddrElement(Up, funcCode))
+        {
+            me->stationAddrElementAt = at + ELEMENT_IDENTIFER_LEN;
+            at += ELEMENT_IDENTIFER_LEN + REMOTE_STATION_ADDR_LEN;
+        }
+        if (isContainStationCategoryField(funcCode))
+        {
+            me->categoryAt = at;
+            at += 1;
+        }
+        cJSON_GET_VALUE(observetime, char *, schema, valuestring, NULL);
+        if (isContainObserveTimeElement(funcCode) &&
+            (observetime == NULL || strlen(observetime) != 10))
+        {
+            me->observeTimeAt = at + ELEMENT_IDENTIFER_LEN;
+        }
+    }
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    if (!res)
+    {
+        ReportTemplate_dtor(me);
+    }
+    return res;
+}
+
+void ReportTemplate_dtor(ReportTemplate *const me)
+{
+    assert(me);
+    if (me->frame.buff != NULL)
+    {
+        BB_dtor(&me->frame);
+    }
+    if (me->slots != NULL)
+    {
+        DelInstance(me->slots);
+    }
+    me->slotCount = 0;
+}
+
+void ReportTemplate_SetStation(ReportTemplate *const me, RemoteStationAddr const *const stationAddr, uint16_t password, uint8_t category)
+{
+    assert(me);
+    assert(stationAddr);
+    ByteBuffer patch;
+    BB_ctor_wrapped(&patch, me->frame.buff + REPORT_TEMPLATE_STATION_ADDR_AT, REMOTE_STATION_ADDR_LEN + 2);
+    BB_Position(&patch) = 0; // wrapped 的 buffer 默认写满，回到开头覆盖
+    RemoteStationAddr_Encode(stationAddr, &patch);
+    BB_BE_PutUInt16(&patch, password);
+    if (me->stationAddrElementAt > 0)
+    {
+        BB_ctor_wrapped(&patch, me->frame.buff + me->stationAddrElementAt, REMOTE_STATION_ADDR_LEN);
+        BB_Position(&patch) = 0;
+        RemoteStationAddr_Encode(stationAddr, &patch);
+    }
+    if (me->categoryAt > 0)
+    {
+        me->frame.buff[me->categoryAt] = category;
+    }
+}
+
+bool ReportTemplate_Fill(ReportTemplate *const me, double const *values)
+{
+    assert(me);
+    assert(values || me->slotCount == 0);
+    uint8_t *frame = me->frame.buff;
+    if (frame == NULL)
+    {
+        return false;
+    }
+    // 模板中每个值的长度固定，放不下符号字节，负值在改写之前拒绝
+    for (uint16_t i = 0; i < me->slotCount; i++)
+    {
+        if (values[i] < 0)
+        {
+            return false;
+        }
+    }
+    ByteBuffer patch;
+    for (uint16_t i = 0; i < me->slotCount; i++)
+    {
+        ReportSlot const *slot = &me->slots[i];
+        double v = values[i];
+        switch (slot->kind)
+        {
+        case REPORT_SLOT_BCD:
+        {
+            uint64_t u64 = isnan(v) ? 0 : (uint64_t)(v * slot->scale);
+            BB_ctor_wrapped(&patch, frame + slot->offset, slot->size);
+            BB_Position(&patch) = 0;
+            BB_BE_BCDPutUInt(&patch, &u64, slot->size);
+            break;
+        }
+        case REPORT_SLOT_DRP5MIN:
+            // 与 DRP5MINElement_SetValueAt 一致，按 float 换算
+            frame[slot->offset] = isnan(v) ? 0xFF : (uint8_t)((float)v * 10);
+            break;
+        case REPORT_SLOT_WATER5MIN:
+        {
+            uint16_t u16 = isnan(v) ? 0xFFFF : (uint16_t)((float)v * 100);
+            frame[slot->offset] = u16 >> 8;
+            frame[slot->offset + 1] = u16 & 0xFF;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    if (me->observeTimeAt > 0)
+    {
+        ObserveTime now;
+        ObserveTime_now(&now);
+        BB_ctor_wrapped(&patch, frame + me->observeTimeAt, OBSERVETIME_LEN);
+        BB_Position(&patch) = 0;
+        BB_BCDPutUInt8(&patch, now.year);
+        BB_BCDPutUInt8(&patch, now.month);
+        BB_BCDPutUInt8(&patch, now.day);
+        BB_BCDPutUInt8(&patch, now.hour);
+        BB_BCDPutUInt8(&patch, now.minute);
+    }
+    uint32_t limit = BB_Limit(&me->frame);
+    uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, frame, limit - 2);
+    frame[limit - 2] = crc16 >> 8;
+    frame[limit - 1] = crc16 & 0xFF;
+    return true;
+}
+// ReportTemplate END
+
+// ReportSpec
+#define REPORT_FIELD_MAX_SIZE 8 // BB_BE_BCDPutUInt 最多 u64
+
+ByteBuffer *ReportSpec_Encode(ReportSpec const *const me, RemoteStationAddr const *const stationAddr, uint16_t password, uint8_t category)
+{
+    assert(me);
+    assert(stationAddr);
+    assert(me->fields || me->fieldCount == 0);
+    // 只用于编码报文头，不 ctor，没有 element
+    UplinkMessage msg;
+    memset(&msg, 0, sizeof(UplinkMessage));
+    Package *pkg = (Package *)&msg;
+    pkg->head.direction = Up;
+    pkg->head.stationAddr = *stationAddr;
+    pkg->head.password = password;
+    pkg->head.funcCode = me->funcCode;
+    pkg->head.stxFlag = STX;
+    pkg->tail.etxFlag = ETX;
+    msg.messageHead.stationAddrElement.stationAddr = *stationAddr;
+    msg.messageHead.stationCategory = category;
+    if (me->observeTime != NULL)
+    {
+        msg.messageHead.observeTimeElement.observeTime = *me->observeTime;
+    }
+    else
+    {
+        ObserveTime_now(&msg.messageHead.observeTimeElement.observeTime);
+    }
+    uint32_t size = PACKAGE_WRAPPER_LEN + 2 + DATETIME_LEN +
+                    (isContainRemoteStationAddrElement(Up, me->funcCode) ? ELEMENT_IDENTIFER_LEN + REMOTE_STATION_ADDR_LEN : 0) +
+                    (isContainStationCategoryField(me->funcCode) ? 1 : 0) +
+                    (isContainObserveTimeElement(me->funcCode) ? ELEMENT_IDENTIFER_LEN + OBSERVETIME_LEN : 0);
+    for (uint16_t i = 0; i < me->fieldCount; i++)
+    {
+        ReportField const *field = &me->fields[i];
+        uint8_t fieldSize = field->dataDef >> NUMBER_ELEMENT_LEN_OFFSET;
+        if (fieldSize == 0 || fieldSize > REPORT_FIELD_MAX_SIZE ||
+            (field->value < 0 && !field->supportSignedFlag))
+        {
+            return NULL;
+        }
+        size += ELEMENT_IDENTIFER_LEN + fieldSize + (field->value < 0 ? 1 : 0);
+    }
+    if (size - PACKAGE_WRAPPER_LEN > PACKAGE_HEAD_STX_BODY_LEN_MASK)
+    {
+        return NULL;
+    }
+    pkg->head.len = size - PACKAGE_WRAPPER_LEN;
+    ByteBuffer *buff = NewInstance(ByteBuffer);
+    BB_ctor(buff, size);
+    bool res = UplinkMessage_EncodeHead(&msg, buff);
+    for (uint16_t i = 0; res && i < me->fieldCount; i++)
+    {
+        ReportField const *field = &me->fields[i];
+        uint8_t fieldSize = field->dataDef >> NUMBER_ELEMENT_LEN_OFFSET;
+        double v = field->value * pow(10, field->dataDef & NUMBER_ELEMENT_PRECISION_MASK);
+        // 与 decodeBCDNumber 一致: 负值为 0xFF + 绝对值，dataDef 中的字节数不含符号字节
+        uint64_t u64 = isnan(v) ? 0 : (uint64_t)fabs(v);
+        res = BB_PutUInt8(buff, field->id) == 1 &&
+              BB_PutUInt8(buff, field->dataDef) == 1 &&
+              (field->value < 0 ? BB_PutUInt8(buff, 0xFF) == 1 : true) &&
+              BB_BE_BCDPutUInt(buff, &u64, fieldSize) == fieldSize;
+    }
+    if (!(res && Package_EncodeTail(pkg, buff)))
+    {
+        BB_dtor(buff);
+        DelInstance(buff);
+        return NULL;
+    }
+    BB_Flip(buff);
+    return buff;
+}
+// ReportSpec END
@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/class.h"
+#include "rcu.h"
+
+void Rcu_ctor(Rcu *const me, void *initial, RcuFree free)
+{
+    assert(me);
+    assert(free);
+    me->current = initial;
+    me->epoch = 1;
+    memset(me->readers, 0, sizeof(me->readers));
+    memset(me->used, 0, sizeof(me->used));
+    me->inside = 0;
+    me->retired = NULL;
+    me->free = free;
+    pthread_mutex_init(&me->mutex, NULL);
+}
+
+void Rcu_dtor(Rcu *const me)
+{
+    assert(me);
+    RcuRetired *r = me->retired;
+    while (r != NULL)
+    {
+        RcuRetired *next = r->next;
+        r->free(r->ptr);
+        DelInstance(r);
+        r = next;
+    }
+    me->retired = NULL;
+    if (me->current != NULL)
+    {
+        me->free(me->current);
+        me->current = NULL;
+    }
+    pthread_mutex_destroy(&me->mutex);
+}
+
+/**
+ * 所有 online reader 的最小 epoch，有未注册线程在读时返回 0
+ * 需持有锁
+ */
+static uint64_t Rcu_MinEpoch(Rcu *const me)
+{
+    if (__atomic_load_n(&me->inside, __ATOMIC_SEQ_CST) > 0)
+    {
+        return 0;
+    }
+    uint64_t min = UINT64_MAX;
+    for (int i = 0; i < RCU_MAX_READERS; i++)
+    {
+        uint64_t epoch = __atomic_load_n(&me->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (me->used[i] && epoch != 0 && epoch < min)
+        {
+            min = epoch;
+        }
+    }
+    return min;
+}
+
+static size_t Rcu_ReclaimLocked(Rcu *const me)
+{
+    uint64_t min = Rcu_MinEpoch(me);
+    size_t left = 0;
+    RcuRetired **p = &me->retired;
+    while (*p != NULL)
+    {
+        RcuRetired *r = *p;
+        if (r->epoch <= min) // 所有 reader 都在替换之后经过了静止状态
+        {
+            *p = r->next;
+            r->free(r->ptr);
+            DelInstance(r);
+        }
+        else
+        {
+            p = &r->next;
+            left++;
+        }
+    }
+    return left;
+}
+
+// 需持有锁
+static void Rcu_RetireLocked(Rcu *const me, void *ptr, RcuFree free, uint64_t epoch)
+{
+    RcuRetired *r = NewInstance(RcuRetired);
+    r->ptr = ptr;
+    r->free = free;
+    r->epoch = epoch;
+    r->next = me->retired;
+    me->retired = r;
+}
+
+void Rcu_Publish(Rcu *const me, void *next)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    void *old = __atomic_exchange_n(&me->current, next, __ATOMIC_SEQ_CST);
+    uint64_t epoch = __atomic_add_fetch(&me->epoch, 1, __ATOMIC_SEQ_CST);
+    if (old != NULL)
+    {
+        Rcu_RetireLocked(me, old, me->free, epoch);
+    }
+    Rcu_ReclaimLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+}
+
+void Rcu_Retire(Rcu *const me, void *ptr, RcuFree free)
+{
+    assert(me);
+    assert(free);
+    pthread_mutex_lock(&me->mutex);
+    // 摘除发生在 epoch + 1 之前，之后 online 的 reader 不会再读到它
+    uint64_t epoch = __atomic_add_fetch(&me->epoch, 1, __ATOMIC_SEQ_CST);
+    Rcu_RetireLocked(me, ptr, free, epoch);
+    Rcu_ReclaimLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+}
+
+size_t Rcu_Reclaim(Rcu *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    size_t left = Rcu_ReclaimLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+    return left;
+}
+
+RcuReader *Rcu_Register(Rcu *const me)
+{
+    assert(me);
+    RcuReader *reader = NULL;
+    pthread_mutex_lock(&me->mutex);
+    for (int i = 0; i < RCU_MAX_READERS; i++)
+    {
+        if (!me->used[i])
+        {
+            me->used[i] = true;
+            reader = &me->readers[i];
+            __atomic_store_n(&reader->epoch, __atomic_load_n(&me->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return reader;
+}
+
+void Rcu_Unregister(Rcu *const me, RcuReader *const reader)
+{
+    assert(me);
+    if (reader == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&me->mutex);
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_SEQ_CST);
+    me->used[reader - me->readers] = false;
+    Rcu_ReclaimLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+}
+
+void Rcu_Online(Rcu *const me, RcuReader *const reader)
+{
+    // seq_cst: 之后读到的指针一定不早于这个 epoch 时的发布
+    __atomic_store_n(&reader->epoch, __atomic_load_n(&me->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,255 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef __linux
+#include <sched.h>
+#endif
+
+#include "common/class.h"
+#include "reactor.h"
+
+// ReactorTask
+void ReactorTask_ctor(ReactorTask *const me, void (*run)(ReactorTask *const me), void *data)
+{
+    assert(me);
+    assert(run);
+    me->next = NULL;
+    me->run = run;
+    me->data = data;
+    me->queued = 0;
+}
+// ReactorTask END
+
+// ReactorShard
+static void ReactorShard_OnWakeup(Reactor *reactor, ev_async *w, int revents)
+{
+    ReactorShard *shard = (ReactorShard *)w->data;
+    if (__atomic_load_n(&shard->stopping, __ATOMIC_ACQUIRE))
+    {
+        ev_break(reactor, EVBREAK_ALL);
+        return;
+    }
+    // take all, the stack is LIFO, reverse it to keep the post order
+    ReactorTask *task = __atomic_exchange_n(&shard->tasks, (ReactorTask *)NULL, __ATOMIC_ACQUIRE);
+    ReactorTask *ordered = NULL;
+    while (task != NULL)
+    {
+        ReactorTask *next = task->next;
+        task->next = ordered;
+        ordered = task;
+        task = next;
+    }
+    while (ordered != NULL)
+    {
+        ReactorTask *next = ordered->next;
+        ordered->next = NULL;
+        // 先清除标记再执行，执行期间的投递会再次入队，不会丢失
+        __atomic_store_n(&ordered->queued, 0, __ATOMIC_RELEASE);
+        ordered->run(ordered);
+        ordered = next;
+    }
+}
+
+void ReactorShard_ctor(ReactorShard *const me, uint16_t id, int16_t cpu)
+{
+    assert(me);
+    me->id = id;
+    me->cpu = cpu;
+    me->loop = ev_loop_new(0);
+    me->thread = NULL;
+    me->tasks = NULL;
+    me->stopping = 0;
+    me->load = 0;
+    ev_async_init(&me->wakeup, &ReactorShard_OnWakeup);
+    me->wakeup.data = me;
+    if (me->loop != NULL)
+    {
+        ev_async_start(me->loop, &me->wakeup);
+    }
+}
+
+void ReactorShard_dtor(ReactorShard *const me)
+{
+    assert(me);
+    if (me->thread != NULL)
+    {
+        DelInstance(me->thread);
+    }
+    if (me->loop != NULL)
+    {
+        ev_async_stop(me->loop, &me->wakeup);
+        ev_loop_destroy(me->loop);
+        me->loop = NULL;
+    }
+}
+
+bool ReactorShard_Post(ReactorShard *const me, ReactorTask *const task)
+{
+    assert(me);
+    assert(task);
+    if (__atomic_exchange_n(&task->queued, 1, __ATOMIC_ACQ_REL))
+    {
+        return false; // already in queue
+    }
+    ReactorTask *head = __atomic_load_n(&me->tasks, __ATOMIC_RELAXED);
+    do
+    {
+        task->next = head;
+    } while (!__atomic_compare_exchange_n(&me->tasks, &head, task, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if (head == NULL) // 队列非空时，之前的投递者已经唤醒过
+    {
+        ev_async_send(me->loop, &me->wakeup);
+    }
+    return true;
+}
+
+void ReactorShard_Stop(ReactorShard *const me)
+{
+    assert(me);
+    __atomic_store_n(&me->stopping, 1, __ATOMIC_RELEASE);
+    if (me->loop != NULL)
+    {
+        ev_async_send(me->loop, &me->wakeup);
+    }
+}
+
+static void *ReactorShard_Run(void *arg)
+{
+    ReactorShard *me = (ReactorShard *)arg;
+#ifdef __linux
+    if (me->cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(me->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        {
+            printf("reactor[%2d] pin to cpu %d failed.\r\n", me->id, me->cpu);
+        }
+    }
+#endif
+    ev_run(me->loop, 0);
+    return NULL;
+}
+// ReactorShard END
+
+// ReactorPool
+void ReactorPool_ctor(ReactorPool *const me, uint16_t count, bool pin)
+{
+    assert(me);
+    me->shards = NULL;
+    me->count = 0;
+    if (count == 0)
+    {
+        return;
+    }
+    if (count > REACTOR_MAX_SHARDS)
+    {
+        count = REACTOR_MAX_SHARDS;
+    }
+    long cpus = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+    {
+        cpus = 1;
+    }
+#endif
+    me->shards = (ReactorShard *)malloc(sizeof(ReactorShard) * count);
+    memset(me->shards, 0, sizeof(ReactorShard) * count);
+    uint16_t i;
+    for (i = 0; i < count; i++)
+    {
+        ReactorShard_ctor(&me->shards[i], i, pin ? (int16_t)(i % cpus) : -1);
+    }
+    me->count = count;
+}
+
+void ReactorPool_dtor(ReactorPool *const me)
+{
+    assert(me);
+    uint16_t i;
+    for (i = 0; i < me->count; i++)
+    {
+        ReactorShard_dtor(&me->shards[i]);
+    }
+    if (me->shards != NULL)
+    {
+        DelInstance(me->shards);
+    }
+    me->count = 0;
+}
+
+bool ReactorPool_Start(ReactorPool *const me)
+{
+    assert(me);
+    bool res = true;
+    uint16_t i;
+    for (i = 0; i < me->count; i++)
+    {
+        ReactorShard *shard = &me->shards[i];
+        if (shard->loop == NULL)
+        {
+            res = false;
+            continue;
+        }
+        pthread_t *thread = NewInstance(pthread_t);
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, REACTOR_THREAD_STACK_SIZE);
+        if (pthread_create(thread, &attr, &ReactorShard_Run, shard))
+        {
+            printf("reactor[%2d] start failed.\r\n", shard->id);
+            DelInstance(thread);
+            res = false;
+        }
+        else
+        {
+            shard->thread = thread;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return res;
+}
+
+void ReactorPool_Join(ReactorPool *const me)
+{
+    assert(me);
+    uint16_t i;
+    for (i = 0; i < me->count; i++)
+    {
+        ReactorShard *shard = &me->shards[i];
+        if (shard->thread != NULL)
+        {
+            pthread_join(*shard->thread, NULL);
+            DelInstance(shard->thread);
+        }
+    }
+}
+
+void ReactorPool_Stop(ReactorPool *const me)
+{
+    assert(me);
+    uint16_t i;
+    for (i = 0; i < me->count; i++)
+    {
+        ReactorShard_Stop(&me->shards[i]);
+    }
+}
+
+ReactorShard *ReactorPool_LeastLoaded(ReactorPool *const me)
+{
+    assert(me);
+    ReactorShard *least = NULL;
+    uint16_t i;
+    for (i = 0; i < me->count; i++)
+    {
+        ReactorShard *shard = &me->shards[i];
+        if (shard->loop != NULL && (least == NULL || shard->load < least->load))
+        {
+            least = shard;
+        }
+    }
+    return least;
+}
+// ReactorPool END
@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+
+#include "common/class.h"
+#include "resolver.h"
+
+#define RESOLVER_HOSTS_LINE_SIZE 512
+
+static int64_t Resolver_NowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint8_t Resolver_LookupHostsFile(char const *const path, char const *const host, struct in_addr *addrs, uint8_t max)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return 0;
+    }
+    uint8_t count = 0;
+    char line[RESOLVER_HOSTS_LINE_SIZE];
+    while (count < max && fgets(line, sizeof(line), f) != NULL)
+    {
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+        char *save = NULL;
+        char *ip = strtok_r(line, " \t\r\n", &save);
+        struct in_addr addr;
+        if (ip == NULL || inet_pton(AF_INET, ip, &addr) != 1)
+        {
+            continue; // 空行或 ipv6
+        }
+        char *name;
+        while ((name = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+        {
+            if (strcasecmp(name, host) == 0)
+            {
+                addrs[count++] = addr;
+                break;
+            }
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static uint8_t Resolver_LookupSystem(char const *const host, struct in_addr *addrs, uint8_t max)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0)
+    {
+        return 0;
+    }
+    uint8_t count = 0;
+    for (struct addrinfo *ai = res; ai != NULL && count < max; ai = ai->ai_next)
+    {
+        struct in_addr addr = ((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+        bool duplicated = false;
+        for (uint8_t i = 0; i < count && !duplicated; i++)
+        {
+            duplicated = addrs[i].s_addr == addr.s_addr;
+        }
+        if (!duplicated)
+        {
+            addrs[count++] = addr;
+        }
+    }
+    freeaddrinfo(res);
+    return count;
+}
+
+static uint8_t Resolver_Lookup(Resolver *const me, char const *const host, struct in_addr *addrs, uint32_t *ttl)
+{
+    if (me->lookup != NULL)
+    {
+        return me->lookup(me->data, host, addrs, RESOLVER_MAX_ADDRS, ttl);
+    }
+    uint8_t count = 0;
+    if (me->hostsFile != NULL)
+    {
+        count = Resolver_LookupHostsFile(me->hostsFile, host, addrs, RESOLVER_MAX_ADDRS);
+    }
+    return count > 0 ? count : Resolver_LookupSystem(host, addrs, RESOLVER_MAX_ADDRS);
+}
+
+// 需持有锁
+static ResolverEntry *Resolver_FindPending(Resolver *const me)
+{
+    for (ResolverEntry *entry = me->entries; entry != NULL; entry = entry->next)
+    {
+        if (entry->pending)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void *Resolver_Run(void *data)
+{
+    Resolver *me = (Resolver *)data;
+    pthread_mutex_lock(&me->mutex);
+    while (!me->stopping)
+    {
+        ResolverEntry *entry = Resolver_FindPending(me);
+        if (entry == NULL)
+        {
+            pthread_cond_wait(&me->cond, &me->mutex);
+            continue;
+        }
+        uint32_t ttl = me->ttl;
+        ResolverAddrs addrs;
+        pthread_mutex_unlock(&me->mutex); // host 不会被修改，解析时不持有锁
+        addrs.count = Resolver_Lookup(me, entry->host, addrs.addrs, &ttl);
+        pthread_mutex_lock(&me->mutex);
+        if (addrs.count > 0)
+        {
+            if (addrs.count != entry->addrs.count ||
+                memcmp(addrs.addrs, entry->addrs.addrs, sizeof(struct in_addr) * addrs.count) != 0)
+            {
+                entry->version++;
+            }
+            entry->addrs = addrs;
+            entry->expireAt = Resolver_NowMs() + (int64_t)ttl * 1000;
+        }
+        else
+        {
+            entry->expireAt = Resolver_NowMs() + RESOLVER_RETRY_INTERVAL * 1000;
+        }
+        entry->pending = false;
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return NULL;
+}
+
+void Resolver_ctor(Resolver *const me)
+{
+    assert(me);
+    me->entries = NULL;
+    me->thread = NULL;
+    pthread_mutex_init(&me->mutex, NULL);
+    pthread_cond_init(&me->cond, NULL);
+    me->stopping = false;
+    me->hostsFile = NULL;
+    me->lookup = NULL;
+    me->data = NULL;
+    me->ttl = RESOLVER_DEFAULT_TTL;
+}
+
+void Resolver_dtor(Resolver *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    me->stopping = true;
+    pthread_cond_signal(&me->cond);
+    pthread_mutex_unlock(&me->mutex);
+    if (me->thread != NULL)
+    {
+        pthread_join(*me->thread, NULL); // 正在进行的 getaddrinfo 返回后退出
+        DelInstance(me->thread);
+    }
+    ResolverEntry *entry = me->entries;
+    while (entry != NULL)
+    {
+        ResolverEntry *next = entry->next;
+        DelInstance(entry->host);
+        DelInstance(entry);
+        entry = next;
+    }
+    me->entries = NULL;
+    if (me->hostsFile != NULL)
+    {
+        DelInstance(me->hostsFile);
+    }
+    pthread_cond_destroy(&me->cond);
+    pthread_mutex_destroy(&me->mutex);
+}
+
+void Resolver_SetHostsFile(Resolver *const me, char const *const path)
+{
+    assert(me);
+    assert(me->thread == NULL); // resolver 线程会读取
+    if (me->hostsFile != NULL)
+    {
+        DelInstance(me->hostsFile);
+    }
+    me->hostsFile = path != NULL ? strdup(path) : NULL;
+}
+
+ResolverEntry *Resolver_Add(Resolver *const me, char const *const host)
+{
+    assert(me);
+    assert(host);
+    pthread_mutex_lock(&me->mutex);
+    ResolverEntry *entry = me->entries;
+    while (entry != NULL && strcasecmp(entry->host, host) != 0)
+    {
+        entry = entry->next;
+    }
+    if (entry == NULL)
+    {
+        entry = NewInstance(ResolverEntry);
+        entry->host = strdup(host);
+        entry->pending = true;
+        entry->next = me->entries;
+        me->entries = entry;
+        pthread_cond_signal(&me->cond);
+    }
+    if (me->thread == NULL && !me->stopping)
+    {
+        pthread_t *thread = NewInstance(pthread_t);
+        if (pthread_create(thread, NULL, &Resolver_Run, me) == 0)
+        {
+            me->thread = thread;
+        }
+        else
+        {
+            DelInstance(thread); // 下一次 Add 重试
+        }
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return entry;
+}
+
+uint8_t Resolver_Get(Resolver *const me, ResolverEntry *const entry, ResolverAddrs *const out)
+{
+    assert(me);
+    assert(entry);
+    assert(out);
+    pthread_mutex_lock(&me->mutex);
+    *out = entry->addrs;
+    if (!entry->pending && Resolver_NowMs() >= entry->expireAt)
+    {
+        entry->pending = true;
+        pthread_cond_signal(&me->cond);
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return out->count;
+}
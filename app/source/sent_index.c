@@ -0,0 +1,334 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "cJSON/cJSON_Helper.h"
+#include "common/class.h"
+#include "sent_index.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define SLOT_EMPTY 0
+#define SLOT_DELETED 1
+
+// FNV-1a
+uint64_t SentIndex_Hash(char const *const path)
+{
+    assert(path);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char const *p = path; *p != '\0'; p++)
+    {
+        hash ^= (uint8_t)*p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash <= SLOT_DELETED ? hash + 2 : hash; // 保留 0 / 1
+}
+
+void SentIndex_ctor(SentIndex *const me)
+{
+    assert(me);
+    me->capacity = SENT_INDEX_INIT_CAPACITY;
+    me->slots = (uint64_t *)malloc(sizeof(uint64_t) * me->capacity);
+    memset(me->slots, 0, sizeof(uint64_t) * me->capacity);
+    me->count = 0;
+    me->tombstones = 0;
+    me->file = NULL;
+    me->fd = -1;
+    me->logRecords = 0;
+}
+
+void SentIndex_dtor(SentIndex *const me)
+{
+    assert(me);
+    if (me->fd >= 0)
+    {
+        close(me->fd);
+        me->fd = -1;
+    }
+    if (me->file != NULL)
+    {
+        DelInstance(me->file);
+    }
+    if (me->slots != NULL)
+    {
+        DelInstance(me->slots);
+    }
+}
+
+// HashSet
+static size_t SentIndex_Find(SentIndex const *const me, uint64_t hash, bool forInsert)
+{
+    size_t mask = me->capacity - 1;
+    size_t i = hash & mask;
+    size_t firstDeleted = me->capacity;
+    for (;;)
+    {
+        uint64_t slot = me->slots[i];
+        if (slot == hash)
+        {
+            return i;
+        }
+        if (slot == SLOT_EMPTY)
+        {
+            return forInsert && firstDeleted != me->capacity ? firstDeleted : i;
+        }
+        if (slot == SLOT_DELETED && firstDeleted == me->capacity)
+        {
+            firstDeleted = i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static void SentIndex_Rehash(SentIndex *const me, size_t capacity)
+{
+    uint64_t *old = me->slots;
+    size_t oldCapacity = me->capacity;
+    me->slots = (uint64_t *)malloc(sizeof(uint64_t) * capacity);
+    memset(me->slots, 0, sizeof(uint64_t) * capacity);
+    me->capacity = capacity;
+    me->tombstones = 0;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (old[i] > SLOT_DELETED)
+        {
+            me->slots[SentIndex_Find(me, old[i], true)] = old[i];
+        }
+    }
+    DelInstance(old);
+}
+
+static bool SentIndex_Insert(SentIndex *const me, uint64_t hash)
+{
+    // 负载因子 < 0.75 (含删除标记)
+    if ((me->count + me->tombstones + 1) * 4 > me->capacity * 3)
+    {
+        SentIndex_Rehash(me, me->count * 2 + 1 > me->capacity / 2 ? me->capacity * 2 : me->capacity);
+    }
+    size_t i = SentIndex_Find(me, hash, true);
+    if (me->slots[i] == hash)
+    {
+        return false;
+    }
+    if (me->slots[i] == SLOT_DELETED)
+    {
+        me->tombstones--;
+    }
+    me->slots[i] = hash;
+    me->count++;
+    return true;
+}
+
+static bool SentIndex_Erase(SentIndex *const me, uint64_t hash)
+{
+    size_t i = SentIndex_Find(me, hash, false);
+    if (me->slots[i] != hash)
+    {
+        return false;
+    }
+    me->slots[i] = SLOT_DELETED;
+    me->count--;
+    me->tombstones++;
+    return true;
+}
+// HashSet END
+
+// Log
+static void SentIndex_EncodeRecord(uint8_t *record, uint8_t op, uint64_t hash)
+{
+    record[0] = op;
+    for (int i = 0; i < 8; i++)
+    {
+        record[1 + i] = (hash >> (i * 8)) & 0xFF; // little endian
+    }
+}
+
+static bool SentIndex_AppendRecord(SentIndex *const me, uint8_t op, uint64_t hash)
+{
+    if (me->fd < 0)
+    {
+        return true; // memory only
+    }
+    uint8_t record[SENT_INDEX_RECORD_LEN];
+    SentIndex_EncodeRecord(record, op, hash);
+    if (write(me->fd, record, SENT_INDEX_RECORD_LEN) != SENT_INDEX_RECORD_LEN)
+    {
+        return false;
+    }
+    me->logRecords++;
+    if (me->logRecords > me->count + SENT_INDEX_COMPACT_THRESHOLD)
+    {
+        SentIndex_Compact(me);
+    }
+    return true;
+}
+
+bool SentIndex_Open(SentIndex *const me, char const *const file)
+{
+    assert(me);
+    assert(file);
+    if (me->file != NULL)
+    {
+        return me->fd >= 0; // 已经打开
+    }
+    me->file = strdup(file);
+    me->fd = open(file, O_RDWR | O_CREAT | O_APPEND | O_BINARY, 0644);
+    if (me->fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(me->fd, &st) != 0)
+    {
+        return false;
+    }
+    size_t size = st.st_size;
+    size_t valid = size - size % SENT_INDEX_RECORD_LEN; // 丢弃不完整的记录
+    if (valid > 0)
+    {
+        uint8_t *buff = (uint8_t *)malloc(valid);
+        if (pread(me->fd, buff, valid, 0) != (ssize_t)valid)
+        {
+            DelInstance(buff);
+            return false;
+        }
+        for (size_t off = 0; off < valid; off += SENT_INDEX_RECORD_LEN)
+        {
+            uint64_t hash = 0;
+            for (int i = 7; i >= 0; i--)
+            {
+                hash = (hash << 8) | buff[off + 1 + i];
+            }
+            if (buff[off] == SENT_INDEX_OP_ADD)
+            {
+                SentIndex_Insert(me, hash);
+            }
+            else if (buff[off] == SENT_INDEX_OP_DEL)
+            {
+                SentIndex_Erase(me, hash);
+            }
+        }
+        DelInstance(buff);
+    }
+    me->logRecords = valid / SENT_INDEX_RECORD_LEN;
+    if (valid != size)
+    {
+        if (ftruncate(me->fd, valid) != 0)
+        {
+            return false;
+        }
+    }
+    if (me->logRecords > me->count + SENT_INDEX_COMPACT_THRESHOLD)
+    {
+        SentIndex_Compact(me);
+    }
+    return true;
+}
+
+bool SentIndex_Compact(SentIndex *const me)
+{
+    assert(me);
+    if (me->file == NULL)
+    {
+        return false;
+    }
+    size_t len = strlen(me->file) + 5;
+    char *tmp = (char *)malloc(len);
+    snprintf(tmp, len, "%s.tmp", me->file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0)
+    {
+        DelInstance(tmp);
+        return false;
+    }
+    size_t size = me->count * SENT_INDEX_RECORD_LEN;
+    uint8_t *buff = (uint8_t *)malloc(size > 0 ? size : 1);
+    size_t off = 0;
+    for (size_t i = 0; i < me->capacity; i++)
+    {
+        if (me->slots[i] > SLOT_DELETED)
+        {
+            SentIndex_EncodeRecord(buff + off, SENT_INDEX_OP_ADD, me->slots[i]);
+            off += SENT_INDEX_RECORD_LEN;
+        }
+    }
+    bool res = write(fd, buff, size) == (ssize_t)size;
+#ifndef _WIN32
+    res = res && fsync(fd) == 0;
+#endif
+    close(fd);
+    DelInstance(buff);
+    if (res && me->fd >= 0)
+    {
+        close(me->fd); // windows 下打开的文件不能被替换
+        me->fd = -1;
+    }
+    res = res && rename(tmp, me->file) == 0;
+    DelInstance(tmp);
+    if (me->fd < 0)
+    {
+        me->fd = open(me->file, O_RDWR | O_CREAT | O_APPEND | O_BINARY, 0644);
+    }
+    if (res)
+    {
+        me->logRecords = me->count;
+    }
+    // 删除标记也一并清理
+    if (me->tombstones > 0)
+    {
+        SentIndex_Rehash(me, me->capacity);
+    }
+    return res && me->fd >= 0;
+}
+// Log END
+
+bool SentIndex_ImportJSON(SentIndex *const me, char const *const jsonFile)
+{
+    assert(me);
+    assert(jsonFile);
+    cJSON *json = cJSON_FromFile(jsonFile);
+    if (json == NULL)
+    {
+        return false;
+    }
+    cJSON *records = cJSON_GetObjectItem(json, "records");
+    cJSON *record = NULL;
+    cJSON_ArrayForEach(record, records)
+    {
+        if (record->string != NULL)
+        {
+            SentIndex_Insert(me, SentIndex_Hash(record->string));
+        }
+    }
+    cJSON_Delete(json);
+    return SentIndex_Compact(me);
+}
+
+bool SentIndex_Contains(SentIndex const *const me, char const *const path)
+{
+    assert(me);
+    assert(path);
+    uint64_t hash = SentIndex_Hash(path);
+    return me->slots[SentIndex_Find(me, hash, false)] == hash;
+}
+
+bool SentIndex_Add(SentIndex *const me, char const *const path)
+{
+    assert(me);
+    assert(path);
+    uint64_t hash = SentIndex_Hash(path);
+    return !SentIndex_Insert(me, hash) || SentIndex_AppendRecord(me, SENT_INDEX_OP_ADD, hash);
+}
+
+bool SentIndex_Remove(SentIndex *const me, char const *const path)
+{
+    assert(me);
+    assert(path);
+    uint64_t hash = SentIndex_Hash(path);
+    return !SentIndex_Erase(me, hash) || SentIndex_AppendRecord(me, SENT_INDEX_OP_DEL, hash);
+}
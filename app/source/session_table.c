@@ -0,0 +1,517 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "common/class.h"
+#include "session_table.h"
+
+#define SESSION_TABLE_MAX_LOAD_NUM 3 // 负载因子 < 3/4
+#define SESSION_TABLE_MAX_LOAD_DEN 4
+#define SESSION_TABLE_MPH_BUCKET_KEYS 4 // 平均每个位移桶的 key 数
+#define SESSION_TABLE_MPH_SEEDS 8       // 找不到位移时换 seed 重试的次数
+#define SESSION_TABLE_MPH_MAX_DISP (1u << 24)
+#define SESSION_TABLE_GOLDEN 0x9E3779B97F4A7C15ULL
+
+// murmur3 fmix64，地址的各字节都是小数字，需要充分混合
+static inline uint64_t SessionTable_Mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// [0, n)，不用取模
+static inline uint32_t SessionTable_Range(uint64_t hash, uint32_t n)
+{
+    return (uint32_t)(((hash >> 32) * n) >> 32);
+}
+
+uint64_t SessionTable_Key(RemoteStationAddr const *const addr)
+{
+    assert(addr);
+    return SESSION_TABLE_KEY_TAG |
+           ((uint64_t)addr->A5 << 32) | ((uint64_t)addr->A4 << 24) |
+           ((uint64_t)addr->A3 << 16) | ((uint64_t)addr->A2 << 8) | addr->A1;
+}
+
+// Data
+static SessionBucket *SessionBucket_Alloc(size_t count)
+{
+    void *ptr = NULL;
+#ifdef _WIN32
+    ptr = _aligned_malloc(sizeof(SessionBucket) * count, RCU_CACHE_LINE_SIZE);
+#else
+    if (posix_memalign(&ptr, RCU_CACHE_LINE_SIZE, sizeof(SessionBucket) * count) != 0)
+    {
+        ptr = NULL;
+    }
+#endif
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, sizeof(SessionBucket) * count);
+    }
+    return (SessionBucket *)ptr;
+}
+
+static void SessionBucket_Free(SessionBucket *buckets)
+{
+#ifdef _WIN32
+    _aligned_free(buckets);
+#else
+    free(buckets);
+#endif
+}
+
+static void SessionTableData_Free(void *ptr)
+{
+    SessionTableData *me = (SessionTableData *)ptr;
+    if (me->buckets != NULL)
+    {
+        SessionBucket_Free(me->buckets);
+    }
+    if (me->keys != NULL)
+    {
+        DelInstance(me->keys);
+    }
+    if (me->values != NULL)
+    {
+        DelInstance(me->values);
+    }
+    if (me->disps != NULL)
+    {
+        DelInstance(me->disps);
+    }
+    DelInstance(me);
+}
+
+static SessionTableData *SessionTableData_New(size_t capacity)
+{
+    size_t buckets = 1;
+    while (buckets * SESSION_TABLE_BUCKET_SLOTS * SESSION_TABLE_MAX_LOAD_NUM < capacity * SESSION_TABLE_MAX_LOAD_DEN)
+    {
+        buckets *= 2;
+    }
+    SessionTableData *me = NewInstance(SessionTableData);
+    if (me == NULL)
+    {
+        return NULL;
+    }
+    me->buckets = SessionBucket_Alloc(buckets);
+    if (me->buckets == NULL)
+    {
+        DelInstance(me);
+        return NULL;
+    }
+    me->mask = buckets - 1;
+    return me;
+}
+
+/**
+ * 桶内等于 key 的槽位掩码，empty 为空槽位掩码
+ * 写入方先写 value 再 release 写 key，这里读完 key 后 acquire
+ */
+static inline uint32_t SessionBucket_Match(SessionBucket const *const me, uint64_t key, uint32_t *empty)
+{
+    uint32_t match = 0;
+#if defined(__AVX2__)
+    __m256i k = _mm256_set1_epi64x((long long)key);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_load_si256((__m256i const *)me->keys);
+    __m256i hi = _mm256_load_si256((__m256i const *)(me->keys + 4));
+    match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, k))) |
+            (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, k))) << 4);
+    *empty = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, zero))) |
+             (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, zero))) << 4);
+#elif defined(__SSE4_1__)
+    __m128i k = _mm_set1_epi64x((long long)key);
+    __m128i zero = _mm_setzero_si128();
+    *empty = 0;
+    for (int i = 0; i < SESSION_TABLE_BUCKET_SLOTS; i += 2)
+    {
+        __m128i keys = _mm_load_si128((__m128i const *)(me->keys + i));
+        match |= _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(keys, k))) << i;
+        *empty |= _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(keys, zero))) << i;
+    }
+#else
+    *empty = 0;
+    for (int i = 0; i < SESSION_TABLE_BUCKET_SLOTS; i++)
+    {
+        uint64_t slot = __atomic_load_n(&me->keys[i], __ATOMIC_RELAXED);
+        match |= (uint32_t)(slot == key) << i;
+        *empty |= (uint32_t)(slot == SESSION_TABLE_KEY_EMPTY) << i;
+    }
+#endif
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return match;
+}
+
+// 开放寻址，key 不存在时返回探测序列上第一个空槽位，*slot 为槽位序号
+static SessionBucket *SessionTableData_Probe(SessionTableData *const me, uint64_t key, int *slot)
+{
+    size_t i = SessionTable_Mix(key) & me->mask;
+    for (size_t probes = 0; probes <= me->mask; probes++)
+    {
+        SessionBucket *bucket = &me->buckets[i];
+        uint32_t empty = 0;
+        uint32_t match = SessionBucket_Match(bucket, key, &empty);
+        if (match != 0)
+        {
+            *slot = __builtin_ctz(match);
+            return bucket;
+        }
+        if (empty != 0)
+        {
+            *slot = __builtin_ctz(empty); // 没有删除，空槽位之后不会再有这个 key
+            return bucket;
+        }
+        i = (i + 1) & me->mask;
+    }
+    return NULL;
+}
+
+// 写锁内调用，新 key 先写 value 再发布 key
+static void SessionTableData_Put(SessionTableData *const me, uint64_t key, void *value)
+{
+    int slot = 0;
+    SessionBucket *bucket = SessionTableData_Probe(me, key, &slot);
+    assert(bucket != NULL);
+    __atomic_store_n(&bucket->values[slot], value, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket->keys[slot], key, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t SessionTableData_MphSlot(uint64_t key, uint64_t seed, uint32_t disp, uint32_t n)
+{
+    return SessionTable_Range(SessionTable_Mix(key ^ (seed + disp * SESSION_TABLE_GOLDEN)), n);
+}
+
+// 只访问一个槽位，key 不在名单中时比较失败
+static void *SessionTableData_FindFrozen(SessionTableData const *const me, uint64_t key)
+{
+    if (me->slotCount == 0)
+    {
+        return NULL;
+    }
+    uint32_t disp = me->disps[SessionTable_Range(SessionTable_Mix(key ^ me->seed), me->dispCount)];
+    uint32_t slot = SessionTableData_MphSlot(key, me->seed, disp, me->slotCount);
+    return me->keys[slot] == key ? me->values[slot] : NULL;
+}
+
+static void SessionTableData_ForEach(SessionTableData const *const me, SessionTableVisit visit, void *data)
+{
+    if (me->buckets != NULL)
+    {
+        for (size_t i = 0; i <= me->mask; i++)
+        {
+            for (int slot = 0; slot < SESSION_TABLE_BUCKET_SLOTS; slot++)
+            {
+                if (me->buckets[i].keys[slot] != SESSION_TABLE_KEY_EMPTY)
+                {
+                    visit(me->buckets[i].keys[slot], me->buckets[i].values[slot], data);
+                }
+            }
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < me->slotCount; i++)
+    {
+        visit(me->keys[i], me->values[i], data);
+    }
+}
+
+static void SessionTableData_CopyVisit(uint64_t key, void *value, void *data)
+{
+    SessionTableData_Put((SessionTableData *)data, key, value);
+}
+// Data END
+
+// MPH
+typedef struct
+{
+    uint32_t bucket;
+    uint32_t size;
+} SessionMphBucket;
+
+static int SessionMphBucket_Compare(void const *a, void const *b)
+{
+    SessionMphBucket const *x = (SessionMphBucket const *)a;
+    SessionMphBucket const *y = (SessionMphBucket const *)b;
+    if (x->size != y->size)
+    {
+        return x->size > y->size ? -1 : 1; // 大桶先放
+    }
+    return x->bucket < y->bucket ? -1 : (x->bucket > y->bucket ? 1 : 0);
+}
+
+/**
+ * hash and displace: 按 seed 把 key 分到 dispCount 个桶，从大桶开始，
+ * 为每个桶找一个位移，使桶内所有 key 落到 n 个槽位中空闲且互不相同的位置
+ */
+static bool SessionTableData_BuildMph(SessionTableData *const me, uint64_t const *keys, void *const *values, uint32_t n, uint64_t seed)
+{
+    uint32_t dispCount = (n + SESSION_TABLE_MPH_BUCKET_KEYS - 1) / SESSION_TABLE_MPH_BUCKET_KEYS;
+    uint32_t *bucketOf = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    uint32_t *starts = (uint32_t *)calloc(dispCount + 1, sizeof(uint32_t));
+    uint32_t *members = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    SessionMphBucket *order = (SessionMphBucket *)malloc(sizeof(SessionMphBucket) * dispCount);
+    bool *taken = (bool *)calloc(n, sizeof(bool));
+    uint32_t slots[SESSION_TABLE_MPH_BUCKET_KEYS * 16];
+    bool res = bucketOf != NULL && starts != NULL && members != NULL && order != NULL && taken != NULL;
+    // 按桶计数排序
+    for (uint32_t i = 0; res && i < n; i++)
+    {
+        bucketOf[i] = SessionTable_Range(SessionTable_Mix(keys[i] ^ seed), dispCount);
+        starts[bucketOf[i] + 1]++;
+    }
+    for (uint32_t b = 0; res && b < dispCount; b++)
+    {
+        order[b].bucket = b;
+        order[b].size = starts[b + 1];
+        res = order[b].size <= sizeof(slots) / sizeof(slots[0]);
+        starts[b + 1] += starts[b];
+    }
+    if (res)
+    {
+        uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * dispCount);
+        res = fill != NULL;
+        for (uint32_t b = 0; res && b < dispCount; b++)
+        {
+            fill[b] = starts[b];
+        }
+        for (uint32_t i = 0; res && i < n; i++)
+        {
+            members[fill[bucketOf[i]]++] = i;
+        }
+        if (fill != NULL)
+        {
+            DelInstance(fill);
+        }
+        qsort(order, dispCount, sizeof(SessionMphBucket), &SessionMphBucket_Compare);
+    }
+    me->disps = res ? (uint32_t *)calloc(dispCount, sizeof(uint32_t)) : NULL;
+    me->keys = res ? (uint64_t *)calloc(n, sizeof(uint64_t)) : NULL;
+    me->values = res ? (void **)calloc(n, sizeof(void *)) : NULL;
+    res = res && me->disps != NULL && me->keys != NULL && me->values != NULL;
+    for (uint32_t o = 0; res && o < dispCount && order[o].size > 0; o++)
+    {
+        uint32_t b = order[o].bucket;
+        uint32_t size = order[o].size;
+        bool placed = false;
+        for (uint32_t disp = 0; !placed && disp < SESSION_TABLE_MPH_MAX_DISP; disp++)
+        {
+            placed = true;
+            for (uint32_t k = 0; placed && k < size; k++)
+            {
+                uint64_t key = keys[members[starts[b] + k]];
+                slots[k] = SessionTableData_MphSlot(key, seed, disp, n);
+                placed = !taken[slots[k]];
+                for (uint32_t j = 0; placed && j < k; j++)
+                {
+                    placed = slots[j] != slots[k];
+                }
+            }
+            if (placed)
+            {
+                me->disps[b] = disp;
+                for (uint32_t k = 0; k < size; k++)
+                {
+                    taken[slots[k]] = true;
+                    me->keys[slots[k]] = keys[members[starts[b] + k]];
+                    me->values[slots[k]] = values[members[starts[b] + k]];
+                }
+            }
+        }
+        res = placed;
+    }
+    if (res)
+    {
+        me->dispCount = dispCount;
+        me->slotCount = n;
+        me->seed = seed;
+    }
+    free(bucketOf);
+    free(starts);
+    free(members);
+    free(order);
+    free(taken);
+    return res;
+}
+
+typedef struct
+{
+    uint64_t *keys;
+    void **values;
+    uint32_t count;
+} SessionMphInput;
+
+static void SessionMphInput_Visit(uint64_t key, void *value, void *data)
+{
+    SessionMphInput *input = (SessionMphInput *)data;
+    input->keys[input->count] = key;
+    input->values[input->count] = value;
+    input->count++;
+}
+// MPH END
+
+void SessionTable_ctor(SessionTable *const me, size_t capacity)
+{
+    assert(me);
+    Rcu_ctor(&me->rcu, SessionTableData_New(capacity > 0 ? capacity : SESSION_TABLE_INIT_CAPACITY), &SessionTableData_Free);
+    pthread_mutex_init(&me->mutex, NULL);
+    me->count = 0;
+}
+
+void SessionTable_dtor(SessionTable *const me)
+{
+    assert(me);
+    Rcu_dtor(&me->rcu);
+    pthread_mutex_destroy(&me->mutex);
+    me->count = 0;
+}
+
+void *SessionTable_Find(SessionTable *const me, uint64_t key)
+{
+    assert(me);
+    SessionTableData *data = (SessionTableData *)Rcu_Dereference(&me->rcu);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    if (data->buckets == NULL)
+    {
+        return SessionTableData_FindFrozen(data, key);
+    }
+    int slot = 0;
+    SessionBucket *bucket = SessionTableData_Probe(data, key, &slot);
+    if (bucket == NULL || __atomic_load_n(&bucket->keys[slot], __ATOMIC_ACQUIRE) != key)
+    {
+        return NULL;
+    }
+    return __atomic_load_n(&bucket->values[slot], __ATOMIC_RELAXED);
+}
+
+void *SessionTable_Insert(SessionTable *const me, uint64_t key, void *value)
+{
+    assert(me);
+    assert(key != SESSION_TABLE_KEY_EMPTY);
+    assert(value);
+    pthread_mutex_lock(&me->mutex);
+    SessionTableData *data = (SessionTableData *)me->rcu.current;
+    void *existing = NULL;
+    int slot = 0;
+    SessionBucket *bucket = NULL;
+    if (data != NULL && data->buckets == NULL)
+    {
+        existing = SessionTableData_FindFrozen(data, key);
+    }
+    else if (data != NULL)
+    {
+        bucket = SessionTableData_Probe(data, key, &slot);
+        if (bucket != NULL && bucket->keys[slot] == key)
+        {
+            existing = bucket->values[slot];
+        }
+    }
+    if (existing != NULL)
+    {
+        pthread_mutex_unlock(&me->mutex);
+        return existing;
+    }
+    size_t count = me->count + 1;
+    size_t slots = data != NULL && data->buckets != NULL ? (data->mask + 1) * SESSION_TABLE_BUCKET_SLOTS : 0;
+    if (count * SESSION_TABLE_MAX_LOAD_DEN > slots * SESSION_TABLE_MAX_LOAD_NUM)
+    {
+        // 扩容或者从最小完美哈希退回开放寻址，整体发布
+        SessionTableData *next = SessionTableData_New(count * 2);
+        if (next == NULL)
+        {
+            pthread_mutex_unlock(&me->mutex);
+            return NULL;
+        }
+        if (data != NULL)
+        {
+            SessionTableData_ForEach(data, &SessionTableData_CopyVisit, next);
+        }
+        SessionTableData_Put(next, key, value);
+        Rcu_Publish(&me->rcu, next);
+    }
+    else
+    {
+        __atomic_store_n(&bucket->values[slot], value, __ATOMIC_RELAXED);
+        __atomic_store_n(&bucket->keys[slot], key, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&me->count, count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&me->mutex);
+    return value;
+}
+
+bool SessionTable_Freeze(SessionTable *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    SessionTableData *data = (SessionTableData *)me->rcu.current;
+    bool res = data != NULL && data->buckets == NULL; // 已经是
+    if (!res && data != NULL && me->count > 0 && me->count < UINT32_MAX)
+    {
+        SessionMphInput input;
+        input.keys = (uint64_t *)malloc(sizeof(uint64_t) * me->count);
+        input.values = (void **)malloc(sizeof(void *) * me->count);
+        input.count = 0;
+        SessionTableData *next = NewInstance(SessionTableData);
+        if (input.keys != NULL && input.values != NULL && next != NULL)
+        {
+            SessionTableData_ForEach(data, &SessionMphInput_Visit, &input);
+            for (int attempt = 0; !res && attempt < SESSION_TABLE_MPH_SEEDS; attempt++)
+            {
+                res = SessionTableData_BuildMph(next, input.keys, input.values, input.count, SessionTable_Mix(SESSION_TABLE_GOLDEN * (attempt + 1)));
+                if (!res)
+                {
+                    free(next->keys);
+                    free(next->values);
+                    free(next->disps);
+                    memset(next, 0, sizeof(SessionTableData));
+                }
+            }
+        }
+        if (res)
+        {
+            Rcu_Publish(&me->rcu, next);
+        }
+        else if (next != NULL)
+        {
+            DelInstance(next);
+        }
+        free(input.keys);
+        free(input.values);
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return res;
+}
+
+bool SessionTable_IsFrozen(SessionTable *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    SessionTableData *data = (SessionTableData *)me->rcu.current;
+    bool frozen = data != NULL && data->buckets == NULL;
+    pthread_mutex_unlock(&me->mutex);
+    return frozen;
+}
+
+void SessionTable_ForEach(SessionTable *const me, SessionTableVisit visit, void *data)
+{
+    assert(me);
+    assert(visit);
+    pthread_mutex_lock(&me->mutex);
+    SessionTableData *current = (SessionTableData *)me->rcu.current;
+    if (current != NULL)
+    {
+        SessionTableData_ForEach(current, visit, data);
+    }
+    pthread_mutex_unlock(&me->mutex);
+}
@@ -13,6 +13,7 @@
 #else
 #include <netdb.h>
 #include <netinet/tcp.h>
+#include <sys/mman.h>
 #endif
 
 #include "cJSON/cJSON_Utils.h"
@@ -20,26 +21,6 @@
 #include "common/class.h"
 
 #include "station.h"
-// string util
-void string2hexString(char *input, char *output, size_t size)
-{
-    int loop;
-    int i;
-
-    i = 0;
-    loop = 0;
-
-    while (loop < size)
-    {
-        sprintf((char *)(output + i), "%02X", input[loop]);
-        loop += 1;
-        i += 2;
-    }
-    //insert NULL at the end of the output string
-    output[i++] = '\0';
-}
-//
-
 // file system util
 typedef struct stat Stat;
 #ifdef _WIN32
@@ -93,13 +74,76 @@ int mkpath(const char *path, mode_t mode)
 }
 // file system util END
 
+// Events
+static EventDef const STATION_EVENTS[STATION_EVENT_COUNT] = {
+    {EVENT_LEVEL_INFO, EVENT_DATA_NONE, "handled request[%4llX] stx[%4llX] ext[%4llX] crc[%4llx]"}, // FRAME_HANDLED
+    {EVENT_LEVEL_INFO, EVENT_DATA_NONE, " droped request[%4llX] stx[%4llX] ext[%4llX] crc[%4llx]"}, // FRAME_DROPPED
+    {EVENT_LEVEL_WARN, EVENT_DATA_HEX, "invalid request, hex:[%s], errno:[%3llu], len:[%llu]"},     // FRAME_INVALID
+    {EVENT_LEVEL_INFO, EVENT_DATA_NONE, "connecting to %llu.%llu.%llu.%llu:%llu"},                  // CONNECTING
+    {EVENT_LEVEL_WARN, EVENT_DATA_STR, "breaking with %s, error [%02llu]"},                         // BREAKING
+    {EVENT_LEVEL_ERROR, EVENT_DATA_NONE, "socket send error %llu, close it"},                       // SEND_ERROR
+    {EVENT_LEVEL_INFO, EVENT_DATA_STR, "pick up file[%s] to send."},                                // FILE_PICKED
+    {EVENT_LEVEL_INFO, EVENT_DATA_STR, "sending file[%s]"},                                         // FILE_PKG_SENDING
+    {EVENT_LEVEL_INFO, EVENT_DATA_STR, "resume file[%s] from %llu/%llu"},                           // FILE_RESUMED
+    {EVENT_LEVEL_WARN, EVENT_DATA_NONE, "send ring is full, drop packet."},                         // SEND_RING_FULL
+    {EVENT_LEVEL_ERROR, EVENT_DATA_NONE, "wal append failed, log is full."},                        // WAL_FULL
+    {EVENT_LEVEL_WARN, EVENT_DATA_NONE, "connect to %llu.%llu.%llu.%llu failed, error [%llu]"},     // CONNECT_FAILED
+    {EVENT_LEVEL_INFO, EVENT_DATA_NONE, "reconnect in %llu ms, failures [%llu]"},                   // RECONNECT
+};
+
+static char const *Station_BaseName(char const *path)
+{
+    char const *name = strrchr(path, '/');
+    return name != NULL ? name + 1 : path;
+}
+// Events END
+
+// 单调时钟，用于统计耗时
+static uint64_t Station_NowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 // Virtual Channel
+static uint8_t ConfigSnapshot_CenterAddr(ConfigSnapshot const *const me, uint8_t id);
+/**
+ * 在 channel 所在的 loop 中读取当前配置，不加锁
+ * 版本变化时刷新缓存的中心站地址
+ */
+static ConfigSnapshot const *Channel_Config(Channel *const me)
+{
+    ConfigSnapshot const *config = Config_Current(&me->station->config);
+    if (config->version != me->configVersion)
+    {
+        me->configVersion = config->version;
+        uint8_t id = (me->id / 2) - 1;
+        me->centerAddr = ConfigSnapshot_CenterAddr(config, id);
+    }
+    return config;
+}
+
+/**
+ * 完整的配置，从缓存启动时第一次使用才加载
+ */
+static cJSON *Channel_ConfigJSON(Channel *const me)
+{
+    ConfigSnapshot const *config = Channel_Config(me);
+    if (config->configInJSON == NULL)
+    {
+        Config_Reload(&me->station->config);
+        config = Channel_Config(me);
+    }
+    return config->configInJSON;
+}
+
 void Channel_FillUplinkMessageHead(Channel *const me, UplinkMessage *const upMsg)
 {
     assert(me);
     assert(upMsg);
     Package *pkg = (Package *)upMsg;
-    Config *config = &me->station->config;
+    ConfigSnapshot const *config = Channel_Config(me);
     pkg->head.centerAddr = me->centerAddr;
     pkg->head.stationAddr = *config->stationAddr;
     pkg->head.password = *config->password;
@@ -113,7 +157,7 @@ void Channel_FillPackageHead(Channel *const me, Package *const pkg)
 {
     assert(me);
     assert(pkg);
-    Config *config = &me->station->config;
+    ConfigSnapshot const *config = Channel_Config(me);
     pkg->head.centerAddr = me->centerAddr;
     pkg->head.stationAddr = *config->stationAddr;
     pkg->head.password = *config->password;
@@ -161,14 +205,8 @@ void Channel_Close(Channel *const me)
     assert(0);
 }
 
-void Channel_Keepalive(Channel *const me)
+static ByteBuffer *Channel_EncodeKeepalive(Channel *const me)
 {
-    assert(me);
-    assert(me->station);
-    if (!me->isConnected)
-    {
-        return;
-    }
     // create keepalive package
     UplinkMessage *msg = NewInstance(UplinkMessage); // 选择是上行还是下行
     UplinkMessage_ctor(msg, 0);                      // 调用构造函数,如果有要素，需要指定要素数量
@@ -176,15 +214,75 @@ void Channel_Keepalive(Channel *const me)
     Head *head = &pkg->head;                         // 获取Head结构
     Channel_FillUplinkMessageHead(me, msg);          // Fill head by config
     head->funcCode = KEEPALIVE;                      // 心跳功能码功能码
-    msg->messageHead.seq = Channel_LastSeq(me);      // 根据功能码填写报文头
     pkg->tail.etxFlag = ETX;                         // 截止符
     ByteBuffer *byteOut = pkg->vptr->encode(pkg);    // 编码
-    BB_Flip(byteOut);                                // 转为读模式
-    me->vptr->send(me, byteOut);                     // 调用发送实现
-    UplinkMessage_dtor((Package *)msg);              // 析构
-    DelInstance(msg);                                // free
-    BB_dtor(byteOut);                                // 析构
-    DelInstance(byteOut);                            // free
+    if (byteOut != NULL)
+    {
+        BB_Flip(byteOut); // 转为读模式
+    }
+    UplinkMessage_dtor((Package *)msg); // 析构
+    DelInstance(msg);                   // free
+    return byteOut;
+}
+
+static ByteBuffer *Channel_EncodeTEST(Channel *const me);
+
+static void Channel_ReleaseFrames(Channel *const me)
+{
+    if (me->keepaliveFrame != NULL)
+    {
+        BB_dtor(me->keepaliveFrame);
+        DelInstance(me->keepaliveFrame);
+    }
+    if (me->testFrame != NULL)
+    {
+        BB_dtor(me->testFrame);
+        DelInstance(me->testFrame);
+    }
+}
+
+/**
+ * 遥测站地址、密码、分类码变化后重新编码，中心站地址在发送时改写
+ */
+static void Channel_RefreshFrames(Channel *const me)
+{
+    ConfigSnapshot const *config = Channel_Config(me);
+    if (config->version == me->framesVersion)
+    {
+        return;
+    }
+    Channel_ReleaseFrames(me);
+    me->keepaliveFrame = Channel_EncodeKeepalive(me);
+    me->testFrame = Channel_EncodeTEST(me);
+    me->framesVersion = config->version;
+}
+
+/**
+ * 改写预编码报文的流水号、发报时间和 CRC 后发送
+ */
+static bool Channel_SendEncoded(Channel *const me, ByteBuffer *const frame, uint16_t seq)
+{
+    if (frame == NULL)
+    {
+        return false;
+    }
+    DateTime now;
+    DateTime_now(&now);
+    BB_Position(frame) = 0;
+    return Package_PatchEncoded(frame, me->centerAddr, seq, &now) &&
+           me->vptr->send(me, frame); // send 复制后入队，frame 可以复用
+}
+
+void Channel_Keepalive(Channel *const me)
+{
+    assert(me);
+    assert(me->station);
+    if (!me->isConnected)
+    {
+        return;
+    }
+    Channel_RefreshFrames(me);
+    Channel_SendEncoded(me, me->keepaliveFrame, Channel_LastSeq(me));
 }
 
 ByteBuffer *Channel_OnRead(Channel *const me)
@@ -211,6 +309,12 @@ bool Channel_Send(Channel *const me, ByteBuffer *const buff)
     return false;
 }
 
+ssize_t Channel_Sendv(Channel *const me, struct iovec *const iov, int iovcnt)
+{
+    assert(0);
+    return -1;
+}
+
 bool Channel_ExpandEncode(Channel *const me, ByteBuffer *const buff)
 {
     assert(0);
@@ -227,8 +331,7 @@ bool Channel_IsFileSent(Channel *const me, tinydir_file *file)
     assert(me);
     assert(file);
     pthread_mutex_lock(&me->cleanUpMutex);
-    cJSON *records = cJSON_GetObjectItem(me->recordsFileInJSON, "records");
-    bool res = records != NULL && cJSON_HasObjectItem(records, file->path);
+    bool res = SentIndex_Contains(&me->sentIndex, file->path);
     pthread_mutex_unlock(&me->cleanUpMutex);
     return res;
 }
@@ -237,9 +340,7 @@ void Channel_RecordCurrentSentFile(Channel *const me)
 {
     assert(me);
     pthread_mutex_lock(&me->cleanUpMutex);
-    cJSON *records = cJSON_GetObjectItem(me->recordsFileInJSON, "records");
-    cJSON_AddItemToObject(records, me->currentFile->path, cJSON_CreateObject());
-    cJSON_WriteFile(me->recordsFileInJSON, me->recordsFile);
+    SentIndex_Add(&me->sentIndex, me->currentFile->path);
     pthread_mutex_unlock(&me->cleanUpMutex);
 }
 
@@ -248,9 +349,7 @@ void Channel_RecordSentFile(Channel *const me, tinydir_file *const file)
     assert(me);
     assert(file);
     pthread_mutex_lock(&me->cleanUpMutex);
-    cJSON *records = cJSON_GetObjectItem(me->recordsFileInJSON, "records");
-    cJSON_AddItemToObject(records, file->path, cJSON_CreateObject());
-    cJSON_WriteFile(me->recordsFileInJSON, me->recordsFile);
+    SentIndex_Add(&me->sentIndex, file->path);
     pthread_mutex_unlock(&me->cleanUpMutex);
 }
 
@@ -259,236 +358,652 @@ void Channel_ClearSentFileRecord(Channel *const me, tinydir_file const *file)
     assert(me);
     assert(file);
     pthread_mutex_lock(&me->cleanUpMutex);
-    cJSON *records = cJSON_GetObjectItem(me->recordsFileInJSON, "records");
-    cJSON_DeleteItemFromObject(records, file->path);
-    cJSON_WriteFile(me->recordsFileInJSON, me->recordsFile);
+    SentIndex_Remove(&me->sentIndex, file->path);
     pthread_mutex_unlock(&me->cleanUpMutex);
 }
 
-bool Channel_SendFileByFd(Channel *const me, struct stat *fStat, int fd, const char *file)
+/**
+ * 编码文件第一包的报文头(包括报文头和图片要素标识符)作为模板
+ * 后续包只使用前 PACKAGE_HEAD_SYN_LEN 字节
+ * @return 第一包报文头长度，0 表示失败
+ */
+static uint32_t Channel_EncodeFileHead(Channel *const me, uint16_t pkgCount, uint16_t imgseq, uint8_t *const out, uint32_t size)
 {
-    assert(me);
-    assert(fStat);
-    if (fStat->st_size <= 0)
-    {
-        return true;
-    }
-    uint16_t pkgCount = fStat->st_size / me->buffSize;
-    if (fStat->st_size % me->buffSize != 0)
-    {
-        pkgCount++;
-    }
-    uint16_t pkgNo = 1;
-    ssize_t readBytes = -1;
-    uint16_t imgseq = Channel_NextSeq(me);
-    while ((readBytes = read(fd, me->buff, me->buffSize)) > 0 && me->isConnected)
+    UplinkMessage *upMsg = NewInstance(UplinkMessage); // 选择是上行还是下行
+    UplinkMessage_ctor(upMsg, 1);                      // 调用构造函数,如果有要素，需要指定要素数量
+    Package *pkg = (Package *)upMsg;                   // 获取父结构Package
+    Head *head = &pkg->head;                           // 获取Head结构
+    Channel_FillUplinkMessageHead(me, upMsg);          // Fill head by config
+    head->funcCode = PICTURE;                          // 图片功能码
+    head->stxFlag = SYN;
+    head->sequence.count = pkgCount;
+    head->sequence.seq = 1;
+    upMsg->messageHead.seq = imgseq; // 根据功能码填写报文头
+    pkg->tail.etxFlag = ETX;
+    PictureElement *picEl = NewInstance(PictureElement);
+    PictureElement_ctor(picEl, 1);
+    uint8_t placeholder = 0;
+    picEl->buff = NewInstance(ByteBuffer);
+    BB_ctor_copy(picEl->buff, &placeholder, 1); // 不能编码空的图片数据，占一个字节
+    BB_Flip(picEl->buff);
+    LinkMessage_PushElement((LinkMessage *)upMsg, (Element *const)picEl);
+    ByteBuffer *byteOut = pkg->vptr->encode(pkg); // 编码
+    uint32_t len = 0;
+    if (byteOut != NULL)
     {
-        if (me->status == CHANNEL_STATUS_STOP)
+        len = BB_Size(byteOut) - PACKAGE_TAIL_LEN - 1;
+        if (len <= size)
         {
-            // break
-            return false;
-        }
-        // create package
-        UplinkMessage *upMsg = NewInstance(UplinkMessage); // 选择是上行还是下行
-        UplinkMessage_ctor(upMsg, 0);                      // 调用构造函数,如果有要素，需要指定要素数量
-        Package *pkg = (Package *)upMsg;                   // 获取父结构Package
-        Head *head = &pkg->head;                           // 获取Head结构
-        Channel_FillUplinkMessageHead(me, upMsg);          // Fill head by config
-        head->funcCode = PICTURE;                          // 心跳功能码功能码
-        head->stxFlag = SYN;
-        head->sequence.count = pkgCount;
-        head->sequence.seq = pkgNo;
-        upMsg->messageHead.seq = imgseq; // 根据功能码填写报文头
-        if (pkgNo != pkgCount)
-        {
-            pkg->tail.etxFlag = ETB; // 截止符
+            memcpy(out, byteOut->buff, len);
         }
         else
         {
-            pkg->tail.etxFlag = ETX; // 截止符
-        }
-        LinkMessage *uplinkMsg = (LinkMessage *)upMsg;
-        PictureElement *picEl = NewInstance(PictureElement);
-        PictureElement_ctor(picEl, pkgNo);
-        ByteBuffer *rawBuff = picEl->buff = NewInstance(ByteBuffer);
-        BB_ctor_wrapped(rawBuff, (uint8_t *)me->buff, readBytes);
-        BB_Flip(rawBuff);
-        LinkMessage_PushElement(uplinkMsg, (Element *const)picEl);
-        ByteBuffer *byteOut = pkg->vptr->encode(pkg); // 编码
-        BB_Flip(byteOut);                             // 转为读模式
-        bool res = me->vptr->send(me, byteOut);       // 调用发送实现
-        UplinkMessage_dtor((Package *)upMsg);         // 析构
-        DelInstance(upMsg);                           // free
-        BB_dtor(byteOut);                             // 析构
-        DelInstance(byteOut);                         // free
-        if (!res)
-        {
-            return false;
+            len = 0;
         }
-        // else if (me->station->config.waitFileSendAckEveryPack)
-        // {
-        //     ByteBuffer *buff = me->vptr->onRead(me);
-        //     if (buff == NULL)
-        //     {
-        //         return false;
-        //     }
-        //     Package *pkg = decodePackage(buff);
-        //     if (pkg == NULL)
-        //     {
-        //         BB_dtor(buff);
-        //         DelInstance(buff);
-        //         return false;
-        //     }
-        //     printf("ch[%2d] recv file send ack [%2x].\r\n", me->id, pkg->head.funcCode);
-        //     Package_dtor(pkg);
-        //     DelInstance(pkg);
-        // }
-        usleep(me->msgSendInterval * 1000);
-        pkgNo++;
+        BB_dtor(byteOut);
+        DelInstance(byteOut);
     }
-    return pkgNo == pkgCount + 1;
+    UplinkMessage_dtor((Package *)upMsg);
+    DelInstance(upMsg);
+    return len;
 }
 
-void Channel_SendFile(Channel *const me, tinydir_file *file)
+// WriteQueue
+static void Channel_ClearFrames(ByteBufferPtrVector *frames)
 {
-    assert(me);
-    assert(file);
-    // if (Channel_IsFileSent(me, file))
-    // {
-    //     return;
-    // }
-    if (me->status != CHANNEL_STATUS_RUNNING || me->status == CHANNEL_STATUS_STOP)
+    ByteBuffer *frame = NULL;
+    int i;
+    vec_foreach(frames, frame, i)
     {
-        return;
+        BB_dtor(frame);
+        DelInstance(frame);
     }
-    // printf("ch[%2d] pick up file [%s] to send.\r\n", me->id, file->path);
-    memset(me->buff, 0, me->buffSize);
-    struct stat fStat = {0};
-    int fd = 0;
-#ifndef WIN32
-#ifndef O_BINARY
-#define O_BINARY 0
-#endif
-#endif
-    if (stat(file->path, &fStat) == SL651_APP_ERROR_SUCCESS &&
-        (fd = open(file->path, O_RDONLY | O_BINARY)))
+    vec_clear(frames);
+}
+
+/**
+ * 写出一个报文，没有写完的部分复制到 writeQueue，等待可写后继续
+ * 调用前 writeQueue 必须为空，保证报文顺序
+ * @return false 连接已关闭
+ */
+static bool Channel_WriteFrame(Channel *const me, struct iovec *const iov, int iovcnt)
+{
+    assert(me->writeQueue.length == 0);
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++)
     {
-        if (fStat.st_size <= 0) // 0 字节文件
+        len += iov[i].iov_len;
+    }
+    ssize_t sent = me->vptr->sendv(me, iov, iovcnt);
+    if (sent < 0)
+    {
+        return false;
+    }
+    Metric_Inc(&me->metrics.framesOut);
+    Metric_Add(&me->metrics.bytesOut, sent);
+    if ((size_t)sent == len)
+    {
+        return true;
+    }
+    ByteBuffer *rest = NewInstance(ByteBuffer);
+    BB_ctor(rest, len - sent);
+    size_t skip = sent;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        if (skip >= iov[i].iov_len)
         {
-            if (!Station_IsFileSentByAllChannel((Station *const)me->station, (tinydir_file *const)file, me))
-            {
-                Channel_RecordSentFile(me, (tinydir_file *const)file);
-            }
-            me->status = CHANNEL_STATUS_RUNNING;
-            return;
+            skip -= iov[i].iov_len;
+            continue;
         }
+        memcpy(rest->buff + rest->position, (uint8_t *)iov[i].iov_base + skip, iov[i].iov_len - skip);
+        rest->position += iov[i].iov_len - skip;
+        skip = 0;
+    }
+    BB_Flip(rest);
+    vec_push(&me->writeQueue, rest);
+    me->outBytes += BB_Available(rest);
+    return true;
+}
 
-        if (Channel_SendFileByFd(me, &fStat, fd, file->path))
+/**
+ * writeQueue 中的报文一次 writev 写出，部分写出时记录在队首报文的 position
+ * @return false 连接已关闭
+ */
+static bool Channel_FlushWriteQueue(Channel *const me)
+{
+    struct iovec iov[CHANNEL_MAX_IOV];
+    int n = 0;
+    for (int i = 0; i < me->writeQueue.length && n < CHANNEL_MAX_IOV; i++, n++)
+    {
+        ByteBuffer *frame = me->writeQueue.data[i];
+        iov[n].iov_base = frame->buff + frame->position;
+        iov[n].iov_len = BB_Available(frame);
+    }
+    if (n == 0)
+    {
+        return true;
+    }
+    ssize_t sent = me->vptr->sendv(me, iov, n);
+    if (sent < 0)
+    {
+        return false;
+    }
+    Metric_Add(&me->metrics.bytesOut, sent);
+    me->outBytes -= sent;
+    while (sent > 0)
+    {
+        ByteBuffer *frame = me->writeQueue.data[0];
+        uint32_t avail = BB_Available(frame);
+        if ((size_t)sent < avail)
         {
-            if (me->station->config.waitFileSendAck) // 等待应答
-            {
-                me->status = CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK;
-                me->currentFile = NewInstance(tinydir_file);
-                memcpy(me->currentFile, file, sizeof(tinydir_file));
-            }
-            else // 不等待应答
-            {
-                me->status = CHANNEL_STATUS_RUNNING;
-                if (!Station_IsFileSentByAllChannel((Station *const)me->station, (tinydir_file *const)file, me))
-                {
-                    Channel_RecordSentFile(me, (tinydir_file *const)file);
-                }
-            }
+            frame->position += sent;
+            break;
         }
-        close(fd);
-        // @Todo 隔段时间 做一次反向清理同步
+        sent -= avail;
+        vec_splice(&me->writeQueue, 0, 1);
+        BB_dtor(frame);
+        DelInstance(frame);
     }
+    return true;
 }
+// WriteQueue END
 
-FilePkgSendStatus Channel_SendFilePkg(Channel *const me, FilePkg *const filePkg)
+/**
+ * 文件 mmap 后按 buffSize 分包，每包由 报文头模板 + 映射内存 + 报文尾 三段 gather write 发送
+ * CRC 在三段上增量计算，每包不再分配内存、不复制数据
+ * 不能 mmap 时(如 Windows)读入 me->buff
+ * 只做准备，由发送调度器调用 Channel_SendFileChunk 逐包发送，fd 由 transfer 关闭
+ * 窗口模式下有断点时从最后确认的包之后继续
+ */
+static bool Channel_StartFileTransfer(Channel *const me, struct stat *fStat, int fd, char const *path)
 {
     assert(me);
-    assert(filePkg);
-    if (me->status != CHANNEL_STATUS_RUNNING)
+    assert(fStat);
+    assert(me->transfer == NULL);
+    if (fStat->st_size <= 0)
     {
-        return FILE_SEND_FAIL;
+        return false;
+    }
+    FileTransfer *t = NewInstance(FileTransfer);
+    t->fd = fd;
+    t->size = fStat->st_size;
+    t->pkgCount = t->size / me->buffSize;
+    if (t->size % me->buffSize != 0)
+    {
+        t->pkgCount++;
+    }
+    t->pkgNo = 1;
+    t->window = me->station->config.fileWindow;
+    t->fileHash = SentIndex_Hash(path);
+    t->mtime = fStat->st_mtime;
+    TransferCheckpoint const *cp = NULL;
+    if (t->window > 0)
+    {
+        cp = CheckpointStore_Find(&me->checkpoints, t->fileHash, t->size, t->mtime, me->buffSize);
+    }
+    if (cp != NULL && cp->pkgCount == t->pkgCount && cp->acked < t->pkgCount)
+    {
+        t->seq = cp->seq;
+        t->saved = cp->acked;
+        t->pkgNo = cp->acked + 1;
+        char const *name = Station_BaseName(path);
+        EventLog_EmitData(&me->station->log, STATION_EVENT_FILE_RESUMED, me->id, name, strlen(name),
+                          t->pkgNo, t->pkgCount);
+    }
+    else
+    {
+        t->seq = Channel_NextSeq(me);
+    }
+    t->firstHeadLen = Channel_EncodeFileHead(me, t->pkgCount, t->seq, t->head, sizeof(t->head));
+    if (t->firstHeadLen < PACKAGE_HEAD_SYN_LEN)
+    {
+        DelInstance(t);
+        return false;
+    }
+    if (t->window > 0)
+    {
+        size_t bitmapSize = (t->pkgCount + 7) / 8;
+        t->acked = (uint8_t *)malloc(bitmapSize * 2);
+        memset(t->acked, 0, bitmapSize * 2);
+        t->resend = t->acked + bitmapSize;
+        t->base = t->pkgNo;
+    }
+#ifndef _WIN32
+    void *addr = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+        t->mapped = (uint8_t const *)addr;
+        madvise(addr, t->size, MADV_SEQUENTIAL);
     }
-    memset(me->buff, 0, me->buffSize);
-    struct stat fStat = {0};
-    int fd = 0;
-#ifndef WIN32
-#ifndef O_BINARY
-#define O_BINARY 0
 #endif
+    me->transfer = t;
+    me->status = CHANNEL_STATUS_SENDING_FILE;
+    return true;
+}
+
+/**
+ * 保存窗口模式的断点(已确认到 base - 1)
+ */
+static void Channel_SaveCheckpoint(Channel *const me, FileTransfer *const t)
+{
+    uint16_t acked = t->base - 1;
+    if (t->window == 0 || acked == t->saved)
+    {
+        return;
+    }
+    TransferCheckpoint cp = {0};
+    cp.fileHash = t->fileHash;
+    cp.fileSize = t->size;
+    cp.mtime = t->mtime;
+    cp.chunkSize = me->buffSize;
+    cp.pkgCount = t->pkgCount;
+    cp.acked = acked;
+    cp.seq = t->seq;
+    if (CheckpointStore_Save(&me->checkpoints, &cp))
+    {
+        t->saved = acked;
+    }
+}
+
+/**
+ * 结束文件发送，释放资源，按发送方式记录结果
+ */
+static void Channel_FinishFileTransfer(Channel *const me, bool result)
+{
+    assert(me);
+    FileTransfer *t = me->transfer;
+    if (t == NULL)
+    {
+        return;
+    }
+    me->transfer = NULL;
+    if (result)
+    {
+        CheckpointStore_Remove(&me->checkpoints, t->fileHash);
+        Metric_Inc(&me->metrics.filesSent);
+    }
+    else
+    {
+        Channel_SaveCheckpoint(me, t); // 断线或超时，下次续传
+        Metric_Inc(&me->metrics.filesFailed);
+    }
+#ifndef _WIN32
+    if (t->mapped != NULL)
+    {
+        munmap((void *)t->mapped, t->size);
+    }
 #endif
-    FilePkgSendStatus res = FILE_SEND_SUCCESS;
-    if (stat(filePkg->file, &fStat) == SL651_APP_ERROR_SUCCESS &&
-        (fd = open(filePkg->file, O_RDONLY | O_BINARY)))
+    close(t->fd);
+    if (t->acked != NULL)
     {
-        if (fStat.st_size <= 0) // 0 字节文件
+        DelInstance(t->acked);
+    }
+    if (me->status == CHANNEL_STATUS_SENDING_FILE)
+    {
+        me->status = CHANNEL_STATUS_RUNNING;
+    }
+    // 窗口模式已经逐包确认
+    bool waitAck = result && t->window == 0 && me->station->config.waitFileSendAck && me->status == CHANNEL_STATUS_RUNNING;
+    if (t->file != NULL) // 扫描式
+    {
+        if (waitAck) // 等待应答
         {
-            // Station_MarkFilePkgSent(me->station, me, filePkg, true);
-            me->status = CHANNEL_STATUS_RUNNING;
-            res = FILE_SEND_SUCCESS;
+            me->status = CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK;
+            me->currentFile = t->file;
+            t->file = NULL;
         }
-
-        if (Channel_SendFileByFd(me, &fStat, fd, filePkg->file))
+        else if (result) // 不等待应答
         {
-            if (me->station->config.waitFileSendAck) // 等待应答
-            {
-                me->status = CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK;
-                me->currentFilePkg = filePkg;
-                res = FILE_SEND_WAIT_ACK;
-            }
-            else // 不等待应答
+            if (!Station_IsFileSentByAllChannel((Station *const)me->station, t->file, me))
             {
-                me->status = CHANNEL_STATUS_RUNNING;
-                // Station_MarkFilePkgSent(me->station, me, filePkg, true);
-                res = FILE_SEND_SUCCESS;
+                Channel_RecordSentFile(me, t->file);
             }
         }
+        if (t->file != NULL)
+        {
+            DelInstance(t->file);
+        }
+    }
+    else if (t->filePkg != NULL) // 触发式
+    {
+        if (waitAck) // 应答或超时后记录
+        {
+            me->status = CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK;
+            me->currentFilePkg = t->filePkg;
+        }
         else
         {
-            me->status = CHANNEL_STATUS_RUNNING;
-            res = FILE_SEND_FAIL;
+            Station_MarkFilePkgSent(me->station, me, t->filePkg, result);
         }
-        close(fd);
     }
-    return res;
+    DelInstance(t);
 }
 
-void Channel_dtor(Channel *const me)
+static bool Channel_ReadFileAt(int fd, char *buff, uint32_t len, size_t offset)
 {
-    assert(me);
-    if (me->recordsFile != NULL)
+#ifdef _WIN32
+    return lseek(fd, offset, SEEK_SET) == (off_t)offset && read(fd, buff, len) == (int)len;
+#else
+    return pread(fd, buff, len, offset) == (ssize_t)len;
+#endif
+}
+
+#define Bitmap_Test(b_, i_) (((b_)[(i_) >> 3] >> ((i_)&7)) & 1)
+#define Bitmap_Set(b_, i_) ((b_)[(i_) >> 3] |= (uint8_t)(1 << ((i_)&7)))
+#define Bitmap_Clear(b_, i_) ((b_)[(i_) >> 3] &= (uint8_t) ~(1 << ((i_)&7)))
+
+/**
+ * 写出文件的第 pkgNo 包，没有写完的部分进入 writeQueue
+ */
+static bool Channel_WriteFileChunk(Channel *const me, uint16_t pkgNo)
+{
+    FileTransfer *t = me->transfer;
+    size_t offset = (size_t)(pkgNo - 1) * me->buffSize;
+    uint32_t len = t->size - offset < me->buffSize ? t->size - offset : me->buffSize;
+    uint8_t const *data = t->mapped != NULL ? t->mapped + offset : (uint8_t const *)me->buff;
+    if (t->mapped == NULL && !Channel_ReadFileAt(t->fd, me->buff, len, offset))
     {
-        DelInstance(me->recordsFile);
+        return false;
     }
-    if (me->recordsFileInJSON != NULL)
+    uint32_t headLen = pkgNo == 1 ? t->firstHeadLen : PACKAGE_HEAD_SYN_LEN; // 第二包开始没有报文头
+    if (!Package_PatchSynHead(t->head, headLen + len - PACKAGE_HEAD_STX_LEN, t->pkgCount, pkgNo))
     {
-        cJSON_Delete(me->recordsFileInJSON);
-        me->recordsFileInJSON = NULL;
+        return false;
     }
-    pthread_mutex_destroy(&me->cleanUpMutex);
+    uint8_t tail[PACKAGE_TAIL_LEN];
+    tail[0] = pkgNo == t->pkgCount ? ETX : ETB; // 截止符
+    uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, t->head, headLen);
+    crc16 = CRC16_Update(crc16, data, len);
+    crc16 = CRC16_Update(crc16, tail, 1);
+    tail[1] = crc16 >> 8;
+    tail[2] = crc16 & 0xFF;
+    struct iovec iov[3] = {
+        {t->head, headLen},
+        {(void *)data, len},
+        {tail, PACKAGE_TAIL_LEN}};
+    if (!Channel_WriteFrame(me, iov, 3))
+    {
+        return false;
+    }
+    Metric_Add(&me->metrics.fileBytes, len);
+    return true;
+}
+
+/**
+ * 窗口模式下下一个要发送的包，优先重发，0 表示等待确认
+ */
+static uint16_t Channel_NextFileChunk(Channel *const me)
+{
+    FileTransfer *t = me->transfer;
+    if (t->window == 0)
+    {
+        return t->pkgNo <= t->pkgCount ? t->pkgNo : 0;
+    }
+    for (uint16_t no = t->base; no < t->pkgNo; no++)
+    {
+        if (Bitmap_Test(t->resend, no - 1))
+        {
+            return no;
+        }
+    }
+    return t->pkgNo <= t->pkgCount && t->pkgNo < t->base + t->window ? t->pkgNo : 0;
+}
+
+static bool Channel_HasFileChunk(Channel *const me)
+{
+    assert(me);
+    return me->transfer != NULL &&
+           (me->status == CHANNEL_STATUS_STOP || Channel_NextFileChunk(me) != 0);
+}
+
+/**
+ * 发送文件的下一包(窗口模式下可能是重发的包)，没有写完的部分进入 writeQueue
+ * @return false 连接已关闭
+ */
+static bool Channel_SendFileChunk(Channel *const me)
+{
+    assert(me);
+    FileTransfer *t = me->transfer;
+    assert(t);
+    uint16_t pkgNo = Channel_NextFileChunk(me);
+    if (me->status == CHANNEL_STATUS_STOP || pkgNo == 0)
+    {
+        Channel_FinishFileTransfer(me, false);
+        return true;
+    }
+    if (!Channel_WriteFileChunk(me, pkgNo))
+    {
+        Channel_FinishFileTransfer(me, false);
+        return me->isConnected;
+    }
+    if (pkgNo == t->pkgNo)
+    {
+        t->pkgNo++;
+    }
+    else
+    {
+        Bitmap_Clear(t->resend, pkgNo - 1);
+        Metric_Inc(&me->metrics.retransmits);
+    }
+    if (t->window == 0 && t->pkgNo > t->pkgCount)
+    {
+        Channel_FinishFileTransfer(me, true);
+    }
+    return true;
+}
+
+/**
+ * 窗口模式下中心站对单包的应答
+ * ACK/EOT/ESC 确认该包，NAK 要求重发；STX 报文的 EOT 表示全部收到
+ */
+static void Channel_OnFileAck(Channel *const me, Package *const ack)
+{
+    assert(me);
+    assert(ack);
+    FileTransfer *t = me->transfer;
+    if (t == NULL || t->window == 0)
+    {
+        return;
+    }
+    uint8_t etx = ack->tail.etxFlag;
+    if (ack->head.stxFlag != SYN)
+    {
+        if (etx == EOT)
+        {
+            t->base = t->pkgCount + 1;
+        }
+    }
+    else
+    {
+        uint16_t no = ack->head.sequence.seq;
+        if (no < t->base || no >= t->pkgNo) // 重复的或者还没有发送
+        {
+            return;
+        }
+        if (etx == NAK)
+        {
+            Bitmap_Set(t->resend, no - 1);
+        }
+        else if (etx == ACK || etx == EOT || etx == ESC)
+        {
+            Bitmap_Set(t->acked, no - 1);
+            Bitmap_Clear(t->resend, no - 1);
+            t->retries = 0;
+            while (t->base <= t->pkgCount && Bitmap_Test(t->acked, t->base - 1))
+            {
+                t->base++;
+            }
+            if (t->base - 1 - t->saved >= CHANNEL_CHECKPOINT_INTERVAL)
+            {
+                Channel_SaveCheckpoint(me, t);
+            }
+        }
+    }
+    if (t->base > t->pkgCount)
+    {
+        Channel_FinishFileTransfer(me, true);
+    }
+    me->vptr->notifyData(me);
+}
+
+/**
+ * 窗口模式下等待确认超时，重发所有未确认的包
+ * @return false 超过重试次数，传输已结束
+ */
+static bool Channel_OnFileAckTimeout(Channel *const me)
+{
+    assert(me);
+    FileTransfer *t = me->transfer;
+    if (t == NULL || t->window == 0)
+    {
+        return false;
+    }
+    if (++t->retries > me->station->config.sendRetryCounts)
+    {
+        Channel_FinishFileTransfer(me, false);
+        return false;
+    }
+    for (uint16_t no = t->base; no < t->pkgNo; no++)
+    {
+        if (!Bitmap_Test(t->acked, no - 1))
+        {
+            Bitmap_Set(t->resend, no - 1);
+        }
+    }
+    return true;
+}
+
+void Channel_SendFile(Channel *const me, tinydir_file *file)
+{
+    assert(me);
+    assert(file);
+    // if (Channel_IsFileSent(me, file))
+    // {
+    //     return;
+    // }
+    if (me->status != CHANNEL_STATUS_RUNNING || me->status == CHANNEL_STATUS_STOP)
+    {
+        return;
+    }
+    // printf("ch[%2d] pick up file [%s] to send.\r\n", me->id, file->path);
+    memset(me->buff, 0, me->buffSize);
+    struct stat fStat = {0};
+    int fd = 0;
+#ifndef WIN32
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#endif
+    if (stat(file->path, &fStat) == SL651_APP_ERROR_SUCCESS &&
+        (fd = open(file->path, O_RDONLY | O_BINARY)) >= 0)
+    {
+        if (fStat.st_size <= 0) // 0 字节文件
+        {
+            close(fd);
+            if (!Station_IsFileSentByAllChannel((Station *const)me->station, (tinydir_file *const)file, me))
+            {
+                Channel_RecordSentFile(me, (tinydir_file *const)file);
+            }
+            me->status = CHANNEL_STATUS_RUNNING;
+            return;
+        }
+        if (Channel_StartFileTransfer(me, &fStat, fd, file->path)) // 完成后记录或等待应答
+        {
+            me->transfer->file = NewInstance(tinydir_file);
+            memcpy(me->transfer->file, file, sizeof(tinydir_file));
+            return;
+        }
+        close(fd);
+        // @Todo 隔段时间 做一次反向清理同步
+    }
+}
+
+FilePkgSendStatus Channel_SendFilePkg(Channel *const me, FilePkg *const filePkg)
+{
+    assert(me);
+    assert(filePkg);
+    if (me->status == CHANNEL_STATUS_SENDING_FILE ||
+        me->status == CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK ||
+        me->status == CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK)
+    {
+        return FILE_SEND_BUSY;
+    }
+    if (me->status != CHANNEL_STATUS_RUNNING)
+    {
+        return FILE_SEND_FAIL;
+    }
+    struct stat fStat = {0};
+    int fd = 0;
+#ifndef WIN32
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#endif
+    FilePkgSendStatus res = FILE_SEND_FAIL;
+    if (stat(filePkg->file, &fStat) == SL651_APP_ERROR_SUCCESS &&
+        (fd = open(filePkg->file, O_RDONLY | O_BINARY)) >= 0)
+    {
+        if (fStat.st_size <= 0) // 0 字节文件
+        {
+            res = FILE_SEND_SUCCESS;
+        }
+        else if (Channel_StartFileTransfer(me, &fStat, fd, filePkg->file))
+        {
+            me->transfer->filePkg = filePkg;
+            return FILE_SEND_PENDING;
+        }
+        close(fd);
+    }
+    return res;
+}
+
+void Channel_dtor(Channel *const me)
+{
+    assert(me);
+    SentIndex_dtor(&me->sentIndex);
+    OutboxCursor_dtor(&me->outboxCursor);
+    CheckpointStore_dtor(&me->checkpoints);
+    pthread_mutex_destroy(&me->cleanUpMutex);
+    // 未发送的 Packet
+    Packet *packet = NULL;
+    while ((packet = (Packet *)Ring_Pop(&me->sendRing)) != NULL)
+    {
+        Packet_Release(packet, me->id);
+    }
+    Ring_dtor(&me->sendRing);
+    if (me->transfer != NULL)
+    {
+        me->transfer->filePkg = NULL; // 由 Station 清理
+        Channel_FinishFileTransfer(me, false);
+    }
+    Channel_ClearFrames(&me->outFrames);
+    vec_deinit(&me->outFrames);
+    Channel_ClearFrames(&me->writeQueue);
+    vec_deinit(&me->writeQueue);
     if (me->thread != NULL)
     {
         // rt_thread_delete(me->thread);
         // DelInstance(me->thread);
         me->thread = NULL;
     }
-    vec_deinit(&me->handlers);
+    if (me->handlers != NULL)
+    {
+        DelInstance(me->handlers);
+    }
     if (me->buff != NULL)
     {
         DelInstance(me->buff);
     }
+    Channel_ReleaseFrames(me);
 }
 
-// 工作方式 1/2 主动上报
-bool Channel_TEST(Channel *const me, uint16_t seq)
+#define CHANNEL_TEST_OBSERVETIME_AT (PACKAGE_HEAD_STX_LEN + 2 + DATETIME_LEN +             \
+                                     ELEMENT_IDENTIFER_LEN + REMOTE_STATION_ADDR_LEN + 1 + \
+                                     ELEMENT_IDENTIFER_LEN)
+
+static ByteBuffer *Channel_EncodeTEST(Channel *const me)
 {
-    assert(me);
     Package *pkg = NULL;
-    LinkMessage *linkMsg = NULL;
     UplinkMessage *upMsg = NULL;
     ByteBuffer *byteBuff = NewInstance(ByteBuffer);
     // FROM AN FIX TEST PKG
@@ -519,27 +1034,49 @@ bool Channel_TEST(Channel *const me, uint16_t seq)
                        120);
     BB_Flip(byteBuff);
     pkg = decodePackage(byteBuff);
-    linkMsg = (LinkMessage *)pkg;
+    BB_dtor(byteBuff);
+    DelInstance(byteBuff);
+    if (pkg == NULL)
+    {
+        return NULL;
+    }
     upMsg = (UplinkMessage *)pkg;
     // CHANGE VALUE BY CONFIG
     Channel_FillUplinkMessageHead(me, upMsg);
-    upMsg->messageHead.seq = seq;
     // encode
     ByteBuffer *sendBuff = pkg->vptr->encode(pkg);
-    bool res = false;
     if (sendBuff != NULL)
     {
         BB_Flip(sendBuff);
-        res = me->vptr->send(me, sendBuff);
-        BB_dtor(sendBuff);
-        DelInstance(sendBuff);
     }
     //release
-    BB_dtor(byteBuff);
-    DelInstance(byteBuff);
     pkg->vptr->dtor(pkg);
     DelInstance(pkg);
-    return res;
+    return sendBuff;
+}
+
+// 工作方式 1/2 主动上报
+bool Channel_TEST(Channel *const me, uint16_t seq)
+{
+    assert(me);
+    Channel_RefreshFrames(me);
+    ByteBuffer *frame = me->testFrame;
+    if (frame == NULL || BB_Limit(frame) < CHANNEL_TEST_OBSERVETIME_AT + OBSERVETIME_LEN)
+    {
+        return false;
+    }
+    // 观测时间，CRC 由 Channel_SendEncoded 计算
+    ObserveTime now;
+    ObserveTime_now(&now);
+    ByteBuffer patch;
+    BB_ctor_wrapped(&patch, frame->buff + CHANNEL_TEST_OBSERVETIME_AT, OBSERVETIME_LEN);
+    BB_Position(&patch) = 0;
+    BB_BCDPutUInt8(&patch, now.year);
+    BB_BCDPutUInt8(&patch, now.month);
+    BB_BCDPutUInt8(&patch, now.day);
+    BB_BCDPutUInt8(&patch, now.hour);
+    BB_BCDPutUInt8(&patch, now.minute);
+    return Channel_SendEncoded(me, frame, seq);
 }
 
 bool Channel_BASIC_CONFIG(Channel *const me)
@@ -556,36 +1093,37 @@ bool Channel_BASIC_CONFIG(Channel *const me)
     ByteBuffer *rawBuff = uplinkMsg->rawBuff = NewInstance(ByteBuffer);
     BB_ctor(rawBuff, 0);
     Config *config = &me->station->config;
-    if (config->centerAddrs != NULL)
+    ConfigSnapshot const *snapshot = Channel_Config(me);
+    if (snapshot->centerAddrs != NULL)
     {
         BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 4); // 2+4
         BB_PutUInt8(rawBuff, CONFIG_CENTER_ADDRS);
         BB_PutUInt8(rawBuff, 4 << NUMBER_ELEMENT_LEN_OFFSET); // 0x20
-        BB_PutUInt8(rawBuff, config->centerAddrs->addr1);
-        BB_PutUInt8(rawBuff, config->centerAddrs->addr2);
-        BB_PutUInt8(rawBuff, config->centerAddrs->addr3);
-        BB_PutUInt8(rawBuff, config->centerAddrs->addr4);
+        BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr1);
+        BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr2);
+        BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr3);
+        BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr4);
     }
-    if (config->stationAddr != NULL)
+    if (snapshot->stationAddr != NULL)
     {
         BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + REMOTE_STATION_ADDR_LEN); // 2+5
         BB_PutUInt8(rawBuff, CONFIG_REMOTESTATION_ADDR);
         BB_PutUInt8(rawBuff, 5 << NUMBER_ELEMENT_LEN_OFFSET); // 0x28
-        RemoteStationAddr_Encode(config->stationAddr, rawBuff);
+        RemoteStationAddr_Encode(snapshot->stationAddr, rawBuff);
     }
-    if (config->password != NULL)
+    if (snapshot->password != NULL)
     {
         BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 2); // 2+2
         BB_PutUInt8(rawBuff, CONFIG_PASSWORD);
         BB_PutUInt8(rawBuff, 2 << 3); // 0x10
-        BB_BE_PutUInt16(rawBuff, *config->password);
+        BB_BE_PutUInt16(rawBuff, *snapshot->password);
     }
-    if (config->workMode != NULL)
+    if (snapshot->workMode != NULL)
     {
         BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 1); // 2+1
         BB_PutUInt8(rawBuff, CONFIG_WORK_MODE);
         BB_PutUInt8(rawBuff, 1 << 3); // 0x08
-        BB_BCDPutUInt8(rawBuff, *config->workMode);
+        BB_BCDPutUInt8(rawBuff, *snapshot->workMode);
     }
     size_t i;
     Channel *ch = NULL;
@@ -625,7 +1163,8 @@ bool handleTEST(Channel *const ch, Package *const request)
     assert(ch);
     assert(request);
     assert(request->head.funcCode == TEST);
-    if (*ch->station->config.workMode == REPORT || *ch->station->config.workMode == REPORT_CONFIRM)
+    uint8_t workMode = *Channel_Config(ch)->workMode;
+    if (workMode == REPORT || workMode == REPORT_CONFIRM)
     {
         return true;
     }
@@ -658,6 +1197,7 @@ bool handleBASIC_CONFIG(Channel *const ch, Package *const request)
         ByteBuffer *rawBuff = uplinkMsg->rawBuff = NewInstance(ByteBuffer);
         BB_ctor(rawBuff, 0);
         Config *config = &ch->station->config;
+        ConfigSnapshot const *snapshot = Channel_Config(ch);
         while (BB_Available(reqBuff) >= 2) // 标识符两个字节，前一个是标识符，后一个固定为 0；成对，如果多余，就丢弃
         {
             uint8_t identifier = 0;
@@ -667,42 +1207,42 @@ bool handleBASIC_CONFIG(Channel *const ch, Package *const request)
             switch (identifier)
             {
             case CONFIG_CENTER_ADDRS:
-                if (config->centerAddrs != NULL)
+                if (snapshot->centerAddrs != NULL)
                 {
                     BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 4); // 2+4
                     BB_PutUInt8(rawBuff, CONFIG_CENTER_ADDRS);
                     BB_PutUInt8(rawBuff, 4 << NUMBER_ELEMENT_LEN_OFFSET); // 0x20
-                    BB_PutUInt8(rawBuff, config->centerAddrs->addr1);
-                    BB_PutUInt8(rawBuff, config->centerAddrs->addr2);
-                    BB_PutUInt8(rawBuff, config->centerAddrs->addr3);
-                    BB_PutUInt8(rawBuff, config->centerAddrs->addr4);
+                    BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr1);
+                    BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr2);
+                    BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr3);
+                    BB_PutUInt8(rawBuff, snapshot->centerAddrs->addr4);
                 }
                 break;
             case CONFIG_REMOTESTATION_ADDR:
-                if (config->stationAddr != NULL)
+                if (snapshot->stationAddr != NULL)
                 {
                     BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + REMOTE_STATION_ADDR_LEN); // 2+5
                     BB_PutUInt8(rawBuff, CONFIG_REMOTESTATION_ADDR);
                     BB_PutUInt8(rawBuff, 5 << NUMBER_ELEMENT_LEN_OFFSET); // 0x28
-                    RemoteStationAddr_Encode(config->stationAddr, rawBuff);
+                    RemoteStationAddr_Encode(snapshot->stationAddr, rawBuff);
                 }
                 break;
             case CONFIG_PASSWORD:
-                if (config->password != NULL)
+                if (snapshot->password != NULL)
                 {
                     BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 2); // 2+2
                     BB_PutUInt8(rawBuff, CONFIG_PASSWORD);
                     BB_PutUInt8(rawBuff, 2 << 3); // 0x10
-                    BB_BE_PutUInt16(rawBuff, *config->password);
+                    BB_BE_PutUInt16(rawBuff, *snapshot->password);
                 }
                 break;
             case CONFIG_WORK_MODE:
-                if (config->workMode != NULL)
+                if (snapshot->workMode != NULL)
                 {
                     BB_Expand(rawBuff, ELEMENT_IDENTIFER_LEN + 1); // 2+1
                     BB_PutUInt8(rawBuff, CONFIG_WORK_MODE);
                     BB_PutUInt8(rawBuff, 1 << 3); // 0x08
-                    BB_BCDPutUInt8(rawBuff, *config->workMode);
+                    BB_BCDPutUInt8(rawBuff, *snapshot->workMode);
                 }
             case CONFIG_CHANNEL_1_MASTER ... CONFIG_CHANNEL_4_SLAVE:
                 ch = Config_FindChannel(config, identifier);
@@ -903,12 +1443,13 @@ bool handleMODIFY_BASIC_CONFIG(Channel *const ch, Package *const request)
         char *jsonStr = cJSON_Print(patches);
         printf("ch[%2d] config patches:      \r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
         DelInstance(jsonStr);
-        cJSONUtils_ApplyPatchesCaseSensitive(config->configInJSON, patches);
-        jsonStr = cJSON_Print(config->configInJSON);
-        printf("ch[%2d] config after patched:\r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
-        DelInstance(jsonStr);
+        if (Config_Update(config, patches)) // 发布新的版本，其他 channel 在下一次事件中看到
+        {
+            jsonStr = cJSON_Print(Channel_Config(ch)->configInJSON);
+            printf("ch[%2d] config after patched:\r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
+            DelInstance(jsonStr);
+        }
         cJSON_Delete(patches);
-        cJSON_WriteFile(config->configInJSON, config->configFile);
         // 应答
         UplinkMessage *upMsg = NewInstance(UplinkMessage);
         UplinkMessage_ctor(upMsg, 10);
@@ -960,8 +1501,7 @@ bool handleRUNTIME_CONFIG(Channel *const ch, Package *const request)
     Channel_FillUplinkMessageHead(ch, upMsg);     // Fill head by config
     head->funcCode = RUNTIME_CONFIG;              // 心跳功能码功能码
     upMsg->messageHead.seq = Channel_NextSeq(ch); // 根据功能码填写报文头 @Todo 这里是否要填写请求端对应的流水号
-    Config *config = &ch->station->config;
-    cJSON *params = cJSON_GetObjectItem(config->configInJSON, "runtimeParameters");
+    cJSON *params = cJSON_GetObjectItem(Channel_ConfigJSON(ch), "runtimeParameters");
     if (reqBuff != NULL && params != NULL)
     {
         LinkMessage *uplinkMsg = (LinkMessage *)upMsg;
@@ -1076,12 +1616,13 @@ bool handleMODIFY_RUNTIME_CONFIG(Channel *const ch, Package *const request)
         char *jsonStr = cJSON_Print(patches);
         printf("ch[%2d] config patches:      \r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
         DelInstance(jsonStr);
-        cJSONUtils_ApplyPatchesCaseSensitive(config->configInJSON, patches);
-        jsonStr = cJSON_Print(config->configInJSON);
-        printf("ch[%2d] config after patched:\r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
-        DelInstance(jsonStr);
+        if (Config_Update(config, patches)) // 发布新的版本，其他 channel 在下一次事件中看到
+        {
+            jsonStr = cJSON_Print(Channel_Config(ch)->configInJSON);
+            printf("ch[%2d] config after patched:\r\n%s\r\n ============================================ \r\n", ch->id, jsonStr);
+            DelInstance(jsonStr);
+        }
         cJSON_Delete(patches);
-        cJSON_WriteFile(config->configInJSON, config->configFile);
         // 应答
         UplinkMessage *upMsg = NewInstance(UplinkMessage);
         UplinkMessage_ctor(upMsg, 10);
@@ -1118,6 +1659,15 @@ bool handlePICTURE(Channel *const ch, Package *const request)
     assert(ch);
     assert(request);
     assert(request->head.funcCode == PICTURE);
+    if (ch->status == CHANNEL_STATUS_SENDING_FILE && ch->transfer != NULL && ch->transfer->window > 0) // 窗口模式逐包确认
+    {
+        if (request->tail.etxFlag == ENQ)
+        {
+            return false; // 不能交叉
+        }
+        Channel_OnFileAck(ch, request);
+        return true;
+    }
     if (ch->status == CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK) // 扫描式的
     {
         if (request->tail.etxFlag == ENQ)
@@ -1132,6 +1682,7 @@ bool handlePICTURE(Channel *const ch, Package *const request)
             }
             DelInstance(ch->currentFile);
             ch->status = CHANNEL_STATUS_RUNNING;
+            ch->vptr->notifyData(ch); // 尽快发送下一个文件
         }
         return true;
     }
@@ -1149,6 +1700,7 @@ bool handlePICTURE(Channel *const ch, Package *const request)
                 ch->currentFilePkg = NULL;
             }
             ch->status = CHANNEL_STATUS_RUNNING;
+            ch->vptr->notifyData(ch); // 尽快发送下一个文件
         }
         return true;
     }
@@ -1167,6 +1719,74 @@ bool handlePICTURE(Channel *const ch, Package *const request)
 }
 // HANDLERS END
 
+// Dispatch
+bool ChannelDispatch_Next(ChannelDispatch *const me, Channel *const ch, Package *const request)
+{
+    assert(me);
+    if (me->index < me->count)
+    {
+        ChannelMiddleware const *mw = me->middlewares[me->index++];
+        return mw->cb(mw, me, ch, request);
+    }
+    return me->handler != NULL && me->handler(ch, request);
+}
+
+ChannelHandleFunc Channel_SetHandler(Channel *const me, FunctionCode code, ChannelHandleFunc cb)
+{
+    assert(me);
+    ChannelHandleFunc old = Channel_FindHandler(me, code);
+    if (me->handlers == NULL)
+    {
+        if (cb == NULL)
+        {
+            return old;
+        }
+        me->handlers = (ChannelHandleFunc *)malloc(sizeof(ChannelHandleFunc) * CHANNEL_HANDLER_TABLE_SIZE);
+        memset(me->handlers, 0, sizeof(ChannelHandleFunc) * CHANNEL_HANDLER_TABLE_SIZE);
+    }
+    me->handlers[(uint8_t)code] = cb;
+    return old;
+}
+
+ChannelHandleFunc Channel_FindHandler(Channel *const me, uint8_t code)
+{
+    assert(me);
+    if (me->handlers != NULL && me->handlers[code] != NULL)
+    {
+        return me->handlers[code];
+    }
+    return me->station != NULL ? me->station->handlers[code] : NULL;
+}
+
+bool Channel_Dispatch(Channel *const me, Package *const request)
+{
+    assert(me);
+    assert(request);
+    Station *station = me->station;
+    ChannelHandleFunc handler = Channel_FindHandler(me, request->head.funcCode);
+    bool handled = handler != NULL;
+    bool res = false;
+    if (handled || station->middlewareCount > 0)
+    {
+        uint64_t begin = Station_NowUs();
+        ChannelDispatch dispatch = {station->middlewares, station->middlewareCount, 0, handler};
+        res = ChannelDispatch_Next(&dispatch, me, request);
+        MetricHistogram *latency = handled ? StationMetrics_Handler(&station->metrics, request->head.funcCode) : NULL;
+        if (latency != NULL)
+        {
+            MetricHistogram_Observe(latency, Station_NowUs() - begin);
+        }
+    }
+    EventLog_Emit(&station->log,
+                  handled ? STATION_EVENT_FRAME_HANDLED : STATION_EVENT_FRAME_DROPPED, me->id,
+                  request->head.funcCode,
+                  request->head.stxFlag,
+                  request->tail.etxFlag,
+                  request->tail.crc);
+    return res;
+}
+// Dispatch END
+
 void Channel_ctor(Channel *me, uint8_t id, Station *const station, size_t buffSize, uint8_t msgSendInterval)
 {
     assert(me);
@@ -1180,41 +1800,40 @@ void Channel_ctor(Channel *me, uint8_t id, Station *const station, size_t buffSi
         &Channel_Keepalive,
         &Channel_OnRead,
         &Channel_Send,
+        &Channel_Sendv,
         &Channel_ExpandEncode,
         &Channel_OnFilesQuery,
         &Channel_NotifyData,
         &Channel_SendFilePkg,
         &Channel_dtor};
     me->id = id;
-    me->recordsFileInJSON = NULL;
+    SentIndex_ctor(&me->sentIndex);
+    OutboxCursor_ctor(&me->outboxCursor);
+    CheckpointStore_ctor(&me->checkpoints);
     me->vptr = &vtbl;
     me->station = station;
     me->isConnected = false;
-    vec_init(&me->handlers);
-    vec_reserve(&me->handlers, CHANNEL_RESERVED_HANDLER_SIZE);
+    me->handlers = NULL;
     // init buff
     me->buff = (char *)malloc(buffSize);
     memset(me->buff, '\0', buffSize);
     me->buffSize = buffSize;
     me->msgSendInterval = msgSendInterval;
-    // register handler
-    static ChannelHandler const h_TEST = {TEST, &handleTEST}; // TEST
-    vec_push(&me->handlers, (ChannelHandler *)&h_TEST);
-    // BASIC_CONFIG
-    static ChannelHandler const h_BASIC_CONFIG = {BASIC_CONFIG, &handleBASIC_CONFIG}; // BASIC_CONFIG
-    vec_push(&me->handlers, (ChannelHandler *)&h_BASIC_CONFIG);
-    static ChannelHandler const h_MODIFY_BASIC_CONFIG = {MODIFY_BASIC_CONFIG, &handleMODIFY_BASIC_CONFIG}; // MODIFY_BASIC_CONFIG
-    vec_push(&me->handlers, (ChannelHandler *)&h_MODIFY_BASIC_CONFIG);
-    // RUNTIME_CONFIG
-    static ChannelHandler const h_RUNTIME_CONFIG = {RUNTIME_CONFIG, &handleRUNTIME_CONFIG}; // RUNTIME_CONFIG
-    vec_push(&me->handlers, (ChannelHandler *)&h_RUNTIME_CONFIG);
-    static ChannelHandler const h_MODIFY_RUNTIME_CONFIG = {MODIFY_RUNTIME_CONFIG, &handleMODIFY_RUNTIME_CONFIG}; // MODIFY_RUNTIME_CONFIG
-    vec_push(&me->handlers, (ChannelHandler *)&h_MODIFY_RUNTIME_CONFIG);
-    // PICTURE
-    static ChannelHandler const h_PICTRUE = {PICTURE, &handlePICTURE};
-    vec_push(&me->handlers, (ChannelHandler *)&h_PICTRUE);
+    me->configVersion = 0;
+    me->keepaliveFrame = NULL;
+    me->testFrame = NULL;
+    me->framesVersion = UINT64_MAX; // 第一次使用时编码
     me->status = CHANNEL_STATUS_RUNNING;
     me->thread = NULL;
+    me->shard = NULL;
+    Ring_ctor(&me->sendRing, CHANNEL_SEND_RING_SIZE);
+    TokenBucket_ctor(&me->pacer, msgSendInterval > 0 ? 1000. / msgSendInterval : 0, CHANNEL_PACE_BURST);
+    vec_init(&me->outFrames);
+    me->transfer = NULL;
+    vec_init(&me->writeQueue);
+    me->outBytes = 0;
+    me->outBlocked = false;
+    memset(&me->metrics, 0, sizeof(ChannelMetrics));
     // pthread_mutexattr_t mutexAttr;
     // pthread_mutexattr_init(&mutexAttr);
     // pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
@@ -1223,25 +1842,294 @@ void Channel_ctor(Channel *me, uint8_t id, Station *const station, size_t buffSi
 // Virtual Channel END
 
 // Abstract IOChannel
-void IOChannel_Start(Channel *const me)
+// Output
+static void IOChannel_DrainOutput(Channel *const me);
+
+static void IOChannel_OnPaceTimerEvent(Reactor *reactor, ev_timer *w, int revents)
+{
+    IOChannel_DrainOutput((Channel *)w->data);
+}
+
+/**
+ * 按令牌桶计算下一次发送时间，已在等待时不重复设置
+ */
+static void IOChannel_KickPacer(Channel *const me)
 {
-    assert(me);
     IOChannel *ioCh = (IOChannel *)me;
-    // 启动定时器，连接，如果出错，自动重连
-    ChannelConnectWatcher *connectWatcher = NewInstance(ChannelConnectWatcher);
-    if (connectWatcher != NULL)
+    if (ioCh->paceWatcher == NULL || ioCh->waitWritable || ev_is_active(ioCh->paceWatcher))
     {
-        ev_init(connectWatcher, ((IOChannelVtbl *)me->vptr)->onConnectTimerEvent);
-        connectWatcher->repeat = 1.; // start as fast as posible
-        // ioCh->reactor = me->station->reactor;
-        connectWatcher->data = (void *)me;
-        ioCh->connectWatcher = connectWatcher;
-        ev_timer_again(ioCh->reactor, connectWatcher);
+        return;
     }
-    // 创建文件夹扫描，不启动
-    ChannelFilesWatcher *filesWatcher = NewInstance(ChannelFilesWatcher);
-    if (filesWatcher != NULL)
-    {
+    ev_timer_set(ioCh->paceWatcher, TokenBucket_Delay(&me->pacer, ev_now(ioCh->reactor)), 0.);
+    ev_timer_start(ioCh->reactor, ioCh->paceWatcher);
+}
+
+/**
+ * 发送缓冲区已满，等待可写(EV_WRITE)后继续
+ */
+static void IOChannel_WaitWritable(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    if (ioCh->waitWritable || ioCh->dataWatcher == NULL)
+    {
+        return;
+    }
+    ioCh->waitWritable = true;
+    Metric_Inc(&me->metrics.sendBlocked);
+    ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
+    ev_io_set(ioCh->dataWatcher, ioCh->fd, EV_READ | EV_WRITE);
+    ev_io_start(ioCh->reactor, ioCh->dataWatcher);
+}
+
+/**
+ * 断开连接时丢弃未发送的报文，结束文件发送
+ */
+static void IOChannel_ResetOutput(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    if (ioCh->paceWatcher != NULL)
+    {
+        ev_timer_stop(ioCh->reactor, ioCh->paceWatcher);
+    }
+    ioCh->waitWritable = false;
+    Channel_ClearFrames(&me->outFrames);
+    Channel_ClearFrames(&me->writeQueue);
+    me->outBytes = 0;
+    __atomic_store_n(&me->outBlocked, false, __ATOMIC_RELEASE);
+    Channel_FinishFileTransfer(me, false);
+}
+
+/**
+ * 重连前等待，full jitter: [MIN, min(MAX, BASE * 2^failures)] 中随机
+ */
+static void IOChannel_ScheduleReconnect(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    double ceil = CHANNEL_BACKOFF_BASE * (double)(1u << (ioCh->connectFailures < 16 ? ioCh->connectFailures : 16));
+    if (ceil > CHANNEL_BACKOFF_MAX)
+    {
+        ceil = CHANNEL_BACKOFF_MAX;
+    }
+    // xorshift32，每个 channel 独立，不需要加锁
+    uint32_t x = ioCh->backoffSeed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ioCh->backoffSeed = x;
+    double delay = CHANNEL_BACKOFF_MIN + (ceil - CHANNEL_BACKOFF_MIN) * (x / (double)UINT32_MAX);
+    EventLog_Emit(&me->station->log, STATION_EVENT_RECONNECT, me->id,
+                  (uint64_t)(delay * 1000), (uint64_t)ioCh->connectFailures);
+    ioCh->connectWatcher->repeat = delay;
+    ev_timer_again(ioCh->reactor, ioCh->connectWatcher);
+}
+
+/**
+ * 所有地址都失败或者超时
+ */
+static void IOChannel_OnConnectFailed(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    ioCh->connecting = false;
+    if (ioCh->connectFailures < UINT8_MAX)
+    {
+        ioCh->connectFailures++;
+    }
+    IOChannel_ScheduleReconnect(me);
+}
+
+/**
+ * 由子类在非阻塞连接完成后调用，fd 已设置
+ */
+static void IOChannel_OnConnected(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    ioCh->connecting = false;
+    ioCh->connectFailures = 0;
+    me->isConnected = true;
+    Metric_Inc(&me->metrics.connects);
+    if (ioCh->dataWatcher == NULL)
+    {
+        ioCh->dataWatcher = NewInstance(ev_io);
+        ev_init(ioCh->dataWatcher, ((IOChannelVtbl *)me->vptr)->onIOReadEvent);
+        ioCh->dataWatcher->data = ioCh;
+    }
+    ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
+    ev_io_set(ioCh->dataWatcher, ioCh->fd, EV_READ);
+    ev_io_start(ioCh->reactor, ioCh->dataWatcher);
+    ioCh->connectWatcher->repeat = me->keepaliveTimer;
+    ev_timer_again(ioCh->reactor, ioCh->connectWatcher);
+    ioCh->filesWatcher->repeat = 1;
+    ev_timer_start(ioCh->reactor, ioCh->filesWatcher);
+    ConfigSnapshot const *config = Channel_Config(me);
+    if (config->workMode != NULL &&
+        (*config->workMode == REPORT || *config->workMode == REPORT_CONFIRM))
+    {
+        Channel_TEST(me, Channel_LastSeq(me));
+        // Channel_BASIC_CONFIG(ch);
+    }
+    if (me->station->wal != NULL) // 断线期间积压的报文
+    {
+        Station_SendPacketsToChannel(me->station, me);
+    }
+}
+
+/**
+ * 连接断开，稍后重连
+ */
+static void IOChannel_OnDisconnected(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
+    me->vptr->close(me);
+    me->isConnected = false;
+    Metric_Inc(&me->metrics.disconnects);
+    IOChannel_ResetOutput(me);
+    ioCh->connectFailures = 0; // 中心站重启时，各遥测站在 [MIN, BASE] 中分散重连
+    IOChannel_ScheduleReconnect(me);
+    // 停止 文件扫描
+    // printf("ch[%2d] stop file scan.\r\n", ch->id);
+    ev_timer_stop(ioCh->reactor, ioCh->filesWatcher);
+}
+
+static void IOChannel_OnFileTransferDone(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    if (me->status == CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK ||
+        me->status == CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK)
+    {
+        ioCh->filesWatcher->repeat = CHANNEL_FILE_ACK_TIMEOUT; // 复用这个定时器等应答
+        ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
+        return;
+    }
+    me->vptr->notifyData(me); // 继续发送后续文件
+}
+
+/**
+ * 先写完 writeQueue，再按令牌放行报文(报文优先，文件每次一包)
+ * 低于低水位时恢复消费上游的报文
+ */
+static void IOChannel_DrainOutput(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    for (;;)
+    {
+        if (!me->isConnected)
+        {
+            IOChannel_OnDisconnected(me);
+            return;
+        }
+        if (me->writeQueue.length > 0)
+        {
+            if (!Channel_FlushWriteQueue(me))
+            {
+                IOChannel_OnDisconnected(me);
+                return;
+            }
+            if (me->writeQueue.length > 0)
+            {
+                IOChannel_WaitWritable(me);
+                break;
+            }
+        }
+        ev_tstamp now = ev_now(ioCh->reactor);
+        while (me->outFrames.length > 0 &&
+               me->writeQueue.length < CHANNEL_MAX_IOV &&
+               TokenBucket_Take(&me->pacer, now))
+        {
+            vec_push(&me->writeQueue, me->outFrames.data[0]); // 报文已计入 outBytes
+            vec_splice(&me->outFrames, 0, 1);
+            Metric_Inc(&me->metrics.framesOut);
+        }
+        if (me->writeQueue.length > 0)
+        {
+            continue;
+        }
+        if (me->transfer == NULL && me->outFrames.length == 0)
+        {
+            break;
+        }
+        if (me->outFrames.length == 0 && !Channel_HasFileChunk(me)) // 窗口已满，等待确认
+        {
+            ioCh->filesWatcher->repeat = CHANNEL_FILE_ACK_TIMEOUT;
+            ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
+            break;
+        }
+        if (me->outFrames.length > 0 || !TokenBucket_Take(&me->pacer, now))
+        {
+            IOChannel_KickPacer(me);
+            break;
+        }
+        if (!Channel_SendFileChunk(me))
+        {
+            IOChannel_OnDisconnected(me);
+            return;
+        }
+        if (me->transfer == NULL)
+        {
+            IOChannel_OnFileTransferDone(me);
+        }
+    }
+    if (me->outBlocked && me->outBytes <= CHANNEL_OUT_LOW_WATERMARK)
+    {
+        __atomic_store_n(&me->outBlocked, false, __ATOMIC_RELEASE);
+        Station_SendPacketsToChannel(me->station, me);
+    }
+}
+
+/**
+ * 复制报文进入发送队列
+ */
+static bool IOChannel_QueueFrame(Channel *const me, ByteBuffer *const buff)
+{
+    uint32_t len = BB_Available(buff);
+    if (len == 0)
+    {
+        return true;
+    }
+    ByteBuffer *frame = NewInstance(ByteBuffer);
+    BB_ctor_copy(frame, buff->buff + buff->position, len);
+    BB_Flip(frame);
+    vec_push(&me->outFrames, frame);
+    me->outBytes += len;
+    if (me->outBytes >= CHANNEL_OUT_HIGH_WATERMARK)
+    {
+        __atomic_store_n(&me->outBlocked, true, __ATOMIC_RELEASE);
+    }
+    IOChannel_KickPacer(me);
+    return true;
+}
+// Output END
+
+void IOChannel_Start(Channel *const me)
+{
+    assert(me);
+    IOChannel *ioCh = (IOChannel *)me;
+    // 共享 reactor 模式使用分配的 loop，否则独占一个 loop
+    ioCh->reactor = me->shard != NULL ? me->shard->loop : ev_loop_new(0);
+    if (ioCh->reactor == NULL)
+    {
+        printf("ch[%2d] create reactor failed.\r\n", me->id);
+        return;
+    }
+    if (me->shard == NULL)
+    {
+        Config_AttachLoop(&me->station->config, ioCh->reactor);
+    }
+    // 启动定时器，连接，如果出错，自动重连
+    ChannelConnectWatcher *connectWatcher = NewInstance(ChannelConnectWatcher);
+    if (connectWatcher != NULL)
+    {
+        ev_init(connectWatcher, ((IOChannelVtbl *)me->vptr)->onConnectTimerEvent);
+        connectWatcher->repeat = 1.; // start as fast as posible
+        // ioCh->reactor = me->station->reactor;
+        connectWatcher->data = (void *)me;
+        ioCh->connectWatcher = connectWatcher;
+        ev_timer_again(ioCh->reactor, connectWatcher);
+    }
+    // 创建文件夹扫描，不启动
+    ChannelFilesWatcher *filesWatcher = NewInstance(ChannelFilesWatcher);
+    if (filesWatcher != NULL)
+    {
         ev_init(filesWatcher, ((IOChannelVtbl *)me->vptr)->onFilesScanTimerEvent);
         filesWatcher->repeat = 1.; // start as fast as posible
         // ioCh->reactor = me->station->reactor;
@@ -1249,21 +2137,36 @@ void IOChannel_Start(Channel *const me)
         ioCh->filesWatcher = filesWatcher;
         // ev_timer_again(ioCh->reactor, filesWatcher);
     }
+    // 发送调度，按需启动
+    ChannelPaceWatcher *paceWatcher = NewInstance(ChannelPaceWatcher);
+    if (paceWatcher != NULL)
+    {
+        ev_init(paceWatcher, &IOChannel_OnPaceTimerEvent);
+        paceWatcher->data = (void *)me;
+        ioCh->paceWatcher = paceWatcher;
+    }
     // load files index
     char recordsFile[300] = {0};
     uint8_t id = me->id; // @Todo 改为中心站对应的编号，还需要合并主备Channel
-    snprintf(recordsFile, 300, "%s/channels/%d/records.json", me->station->config.workDir, id);
-    me->recordsFile = strdup(recordsFile);
-    cJSON *json = cJSON_FromFile(recordsFile);
-    if (json == NULL)
-    {
-        snprintf(recordsFile, 300, "%s/channels/%d", me->station->config.workDir, id);
-        mode_t mode = S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH;
-        mkpath(recordsFile, mode);
-        json = cJSON_CreateObject();
-        cJSON_AddItemToObject(json, "records", cJSON_CreateObject());
-    }
-    me->recordsFileInJSON = json;
+    snprintf(recordsFile, 300, "%s/channels/%d", me->station->config.workDir, id);
+    mode_t mode = S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH;
+    mkpath(recordsFile, mode);
+    snprintf(recordsFile, 300, "%s/channels/%d/records.idx", me->station->config.workDir, id);
+    bool imported = access(recordsFile, F_OK) == 0;
+    SentIndex_Open(&me->sentIndex, recordsFile);
+    snprintf(recordsFile, 300, "%s/channels/%d/transfers.ckpt", me->station->config.workDir, id);
+    CheckpointStore_Open(&me->checkpoints, recordsFile);
+    if (!imported)
+    {
+        // 旧版本的 records.json 只导入一次
+        char jsonFile[300] = {0};
+        snprintf(jsonFile, 300, "%s/channels/%d/records.json", me->station->config.workDir, id);
+        if (SentIndex_ImportJSON(&me->sentIndex, jsonFile))
+        {
+            snprintf(recordsFile, 300, "%s.imported", jsonFile);
+            rename(jsonFile, recordsFile);
+        }
+    }
     // start async watcher
     ChannelAsyncWatcher *asyncWatcher = NewInstance(ChannelAsyncWatcher);
     if (asyncWatcher != NULL)
@@ -1273,7 +2176,11 @@ void IOChannel_Start(Channel *const me)
         ioCh->asyncWatcher = asyncWatcher;
         ev_async_start(ioCh->reactor, ioCh->asyncWatcher);
     }
-    ev_run(ioCh->reactor, 0);
+    if (me->shard == NULL) // 共享的 loop 由 ReactorPool 驱动
+    {
+        ev_run(ioCh->reactor, 0);
+        Config_DetachLoop(&me->station->config, ioCh->reactor);
+    }
 }
 
 void IOChannel_Stop(Channel *const me)
@@ -1284,11 +2191,24 @@ void IOChannel_Stop(Channel *const me)
         return;
     }
     IOChannel *ioCh = (IOChannel *)me;
-    ev_timer_stop(ioCh->reactor, ioCh->filesWatcher);
-    ev_timer_stop(ioCh->reactor, ioCh->connectWatcher);
-    ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
-    ev_async_stop(ioCh->reactor, ioCh->asyncWatcher);
-    ev_break(ioCh->reactor, EVBREAK_ALL);
+    if (ioCh->reactor != NULL)
+    {
+        ev_timer_stop(ioCh->reactor, ioCh->filesWatcher);
+        ev_timer_stop(ioCh->reactor, ioCh->connectWatcher);
+        if (ioCh->dataWatcher != NULL) // 连接成功后才分配
+        {
+            ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
+        }
+        ev_async_stop(ioCh->reactor, ioCh->asyncWatcher);
+        if (ioCh->paceWatcher != NULL)
+        {
+            ev_timer_stop(ioCh->reactor, ioCh->paceWatcher);
+        }
+        if (me->shard == NULL)
+        {
+            ev_break(ioCh->reactor, EVBREAK_ALL);
+        }
+    }
     me->vptr->close(me);
     me->status = CHANNEL_STATUS_STOP;
 }
@@ -1321,6 +2241,12 @@ bool IOChannel_Send(Channel *const me, ByteBuffer *buff)
     return false;
 }
 
+ssize_t IOChannel_Sendv(Channel *const me, struct iovec *const iov, int iovcnt)
+{
+    assert(0);
+    return -1;
+}
+
 bool IOChannel_ExpandEncode(Channel *const me, ByteBuffer *const buff)
 {
     assert(0);
@@ -1336,89 +2262,54 @@ void IOChannel_OnConnectTimerEvent(Reactor *reactor, ev_timer *w, int revents)
         Channel_Keepalive(ch);
         return;
     }
-    if (!ch->vptr->open(ch))
+    if (ioCh->connecting) // 连接超时
     {
-        w->repeat = 10; // slow down
-        ev_timer_again(reactor, w);
+        ch->vptr->close(ch);
+        IOChannel_OnConnectFailed(ch);
         return;
     }
-    int fd = ioCh->fd;
-    if (ioCh->dataWatcher != NULL)
-    {
-        ev_io_stop(reactor, ioCh->dataWatcher);
-        ev_io_set(ioCh->dataWatcher, fd, EV_READ | EV_WRITE);
-        ev_io_start(reactor, ioCh->dataWatcher);
-    }
-    else
+    // open 只开始连接，完成后子类调用 IOChannel_OnConnected
+    if (!ch->vptr->open(ch))
     {
-        ChannelDataWatcher *dataWatcher = NewInstance(ev_io);
-        if (dataWatcher != NULL)
-        {
-            ev_io_init(dataWatcher, ((IOChannelVtbl *)ch->vptr)->onIOReadEvent, fd, EV_READ | EV_WRITE);
-            ioCh->dataWatcher = dataWatcher;
-            dataWatcher->data = ioCh;
-            ev_io_start(reactor, ioCh->dataWatcher);
-        }
+        IOChannel_OnConnectFailed(ch);
+        return;
     }
-    ioCh->connectWatcher->repeat = ch->keepaliveTimer;
+    ioCh->connecting = true;
+    w->repeat = CHANNEL_CONNECT_TIMEOUT;
+    ev_timer_again(reactor, w);
 }
 
 void IOChannel_OnIOReadEvent(Reactor *reactor, ev_io *w, int revents)
 {
     IOChannel *ioCh = (IOChannel *)w->data;
     Channel *ch = (Channel *)ioCh;
-    if (revents == EV_WRITE)
+    if ((revents & EV_WRITE) && ch->isConnected) // 发送缓冲区可写
     {
-        ch->isConnected = true;
+        ioCh->waitWritable = false;
+        ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
         ev_io_set(ioCh->dataWatcher, ioCh->fd, EV_READ);
-        ioCh->filesWatcher->repeat = 1;
-        ev_timer_start(ioCh->reactor, ioCh->filesWatcher);
-        if (ch->station->config.workMode != NULL &&
-            (*ch->station->config.workMode == REPORT || *ch->station->config.workMode == REPORT_CONFIRM))
+        ev_io_start(ioCh->reactor, ioCh->dataWatcher);
+        IOChannel_DrainOutput(ch);
+        if (!(revents & EV_READ) || !ch->isConnected)
         {
-            Channel_TEST(ch, Channel_LastSeq(ch));
-            // Channel_BASIC_CONFIG(ch);
+            return;
         }
-        return;
     }
     int len = 0;
     ByteBuffer *buff = ch->vptr->onRead(ch);
     if (buff == NULL)
     {
-        ev_io_stop(ioCh->reactor, ioCh->dataWatcher);
-        ch->isConnected = false;
-        ch->vptr->close(ch);
-        ioCh->connectWatcher->repeat = 10;
-        ev_timer_again(ioCh->reactor, ioCh->connectWatcher);
-
-        // 停止 文件扫描
-        // printf("ch[%2d] stop file scan.\r\n", ch->id);
-        ev_timer_stop(ioCh->reactor, ioCh->filesWatcher);
+        IOChannel_OnDisconnected(ch);
         return;
     }
+    Metric_Add(&ch->metrics.bytesIn, BB_Limit(buff));
     while (BB_Available(buff) > 0)
     {
         Package *pkg = decodePackage(buff);
         if (pkg != NULL)
         {
-            int i = 0;
-            ChannelHandler *h = NULL;
-            bool handled = false;
-            vec_foreach(&ch->handlers, h, i)
-            {
-                if (h != NULL && h->cb != NULL && h->code == pkg->head.funcCode)
-                {
-                    handled = true;
-                    h->cb(ch, pkg);
-                    break;
-                }
-            }
-            printf("ch[%2d] %7s request[%4X] stx[%4X] ext[%4X] crc[%4x]\r\n", ch->id,
-                   handled == true ? "handled" : "droped",
-                   pkg->head.funcCode,
-                   pkg->head.stxFlag,
-                   pkg->tail.etxFlag,
-                   pkg->tail.crc);
+            Metric_Inc(&ch->metrics.framesIn);
+            Channel_Dispatch(ch, pkg);
             if (pkg->vptr->dtor != NULL) // 实现了析构函数
             {                            //
                 pkg->vptr->dtor(pkg);    // 调用析构，规范步骤
@@ -1427,10 +2318,11 @@ void IOChannel_OnIOReadEvent(Reactor *reactor, ev_io *w, int revents)
         }
         else
         {
-            int len = BB_Limit(buff);
-            char hexStr[(len * 2) + 1];
-            string2hexString(ch->buff, hexStr, len);
-            printf("ch[%2d] invalid request, errno:[%3d], hex:[%s]\r\n", ch->id, last_error(), hexStr);
+            uint32_t len = BB_Limit(buff);
+            ChannelMetrics_DecodeError(&ch->metrics, last_error());
+            // 只记录前 EVENT_DATA_LEN 字节，不在这里格式化
+            EventLog_EmitData(&ch->station->log, STATION_EVENT_FRAME_INVALID, ch->id, ch->buff, len,
+                              (uint64_t)last_error(), len);
             break;
         }
     }
@@ -1438,47 +2330,79 @@ void IOChannel_OnIOReadEvent(Reactor *reactor, ev_io *w, int revents)
     DelInstance(buff);
 }
 
-void IOChannel_OnFilesQuery(Channel *const me)
+static bool IOChannel_IsPathSent(void *ctx, char const *path)
+{
+    Channel *ch = (Channel *)ctx;
+    pthread_mutex_lock(&ch->cleanUpMutex);
+    bool res = SentIndex_Contains(&ch->sentIndex, path);
+    pthread_mutex_unlock(&ch->cleanUpMutex);
+    return res;
+}
+
+/**
+ * 从共享的 outbox 中取一个本 channel 未发送的文件发送
+ * @return 是否取到了文件
+ */
+static bool IOChannel_SendNextFile(Channel *const me)
 {
     assert(me);
-    IOChannel *ioCh = (IOChannel *)me;
-    // pick up one file from filesDir to send
-    tinydir_dir dir;
-    int i;
-    tinydir_open_sorted(&dir, me->station->config.filesDir);
-    for (i = 0; i < dir.n_files; i++)
+    Outbox *outbox = me->station->outbox;
+    if (outbox == NULL || me->status != CHANNEL_STATUS_RUNNING)
+    {
+        return false;
+    }
+    char path[_TINYDIR_PATH_MAX];
+    while (Outbox_Next(outbox, &me->outboxCursor, &IOChannel_IsPathSent, me, path, sizeof(path)))
     {
         tinydir_file file;
-        tinydir_readfile_n(&dir, &file, i);
-        if (!file.is_dir && !Channel_IsFileSent(me, &file))
-        {
-            ev_suspend(ioCh->reactor);
-            printf("ch[%2d] pick up file[%s] to send.\r\n", me->id, file.path);
-            Channel_SendFile(me, &file);
-            ev_resume(ioCh->reactor);
-            if (me->status == CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK)
-            {
-                ioCh->filesWatcher->repeat = 2.; // 复用这个定时器2秒等应答
-                ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
-            }
-            break;
+        if (tinydir_file_open(&file, path) != 0 || file.is_dir) // 已被移走
+        {
+            char const *name = strrchr(path, '/');
+            Outbox_Remove(outbox, name != NULL ? name + 1 : path);
+            continue;
+        }
+        EventLog_EmitData(&me->station->log, STATION_EVENT_FILE_PICKED, me->id, file.name, strlen(file.name), 0);
+        Channel_SendFile(me, &file);
+        if (me->status == CHANNEL_STATUS_SENDING_FILE)
+        {
+            IOChannel_KickPacer(me); // 由发送调度器逐包发送
         }
+        return true;
+    }
+    return false;
+}
+
+void IOChannel_OnFilesQuery(Channel *const me)
+{
+    IOChannel_SendNextFile(me);
+}
+
+/**
+ * outbox 有新文件，空闲时立即开始发送
+ */
+static void IOChannel_PollOutbox(Channel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    if (me->station->outbox == NULL ||
+        !me->station->config.scanFiles ||
+        !me->isConnected ||
+        me->status != CHANNEL_STATUS_RUNNING ||
+        ioCh->filesWatcher == NULL)
+    {
+        return;
     }
-    tinydir_close(&dir);
+    ioCh->filesWatcher->repeat = CHANNEL_FILES_NEXT_DELAY;
+    ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
 }
 
 FilePkgSendStatus IOChannel_SendFilePkg(Channel *const me, FilePkg *const filePkg)
 {
     assert(me);
     assert(filePkg);
-    IOChannel *ioCh = (IOChannel *)me;
-    ev_suspend(ioCh->reactor);
     FilePkgSendStatus res = Channel_SendFilePkg(me, filePkg);
-    ev_resume(ioCh->reactor);
-    if (me->status == CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK)
+    if (res == FILE_SEND_PENDING)
     {
-        ioCh->filesWatcher->repeat = 2.; // 复用这个定时器2秒等应答
-        ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
+        IOChannel_KickPacer(me); // 由发送调度器逐包发送
     }
     return res;
 }
@@ -1487,14 +2411,52 @@ bool IOChannel_NotifyData(Channel *const me)
 {
     assert(me);
     IOChannel *ioCh = (IOChannel *)me;
+    if (ioCh->reactor == NULL)
+    {
+        return false;
+    }
+    if (me->shard != NULL)
+    {
+        // 同一个 loop 上的多个 channel 共用一次唤醒
+        ReactorShard_Post(me->shard, &ioCh->notifyTask);
+        return true;
+    }
     ev_async_send(ioCh->reactor, ioCh->asyncWatcher);
     return true;
 }
 
+static void IOChannel_OnNotifyTask(ReactorTask *const task)
+{
+    Channel *ch = (Channel *)task->data;
+    if (ch->transfer != NULL) // 收到确认，窗口可能有空位
+    {
+        IOChannel_KickPacer(ch);
+    }
+    Station_SendPacketsToChannel(ch->station, ch);
+    Station_SendFilePkgsToChannel(ch->station, ch);
+    IOChannel_PollOutbox(ch);
+}
+
 void IOChannel_OnFilesScanEvent(Reactor *reactor, ev_timer *w, int revents)
 {
     IOChannel *ioCh = (IOChannel *)w->data;
     Channel *ch = (Channel *)ioCh;
+    if (ch->status == CHANNEL_STATUS_SENDING_FILE)
+    {
+        if (ch->transfer == NULL || ch->transfer->window == 0) // 发送完成后重新设置
+        {
+            ev_timer_stop(ioCh->reactor, ioCh->filesWatcher);
+        }
+        else if (Channel_OnFileAckTimeout(ch)) // 窗口模式没有等到确认
+        {
+            IOChannel_KickPacer(ch);
+        }
+        else
+        {
+            IOChannel_OnFileTransferDone(ch);
+        }
+        return;
+    }
     if (ch->status == CHANNEL_STATUS_WAITTING_AYNC_FILESEND_ACK) // 主动发送没有等到应答
     {
         ch->status = CHANNEL_STATUS_RUNNING;
@@ -1505,6 +2467,7 @@ void IOChannel_OnFilesScanEvent(Reactor *reactor, ev_timer *w, int revents)
         }
         ioCh->filesWatcher->repeat = 10.; // slow down
         ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
+        ch->vptr->notifyData(ch); // 继续发送排队的文件
         return;
     }
     if (ch->status == CHANNEL_STATUS_WAITTING_SCAN_FILESEND_ACK) // 没有等到应答
@@ -1528,8 +2491,18 @@ void IOChannel_OnFilesScanEvent(Reactor *reactor, ev_timer *w, int revents)
     {
         return;
     }
-    IOChannel_OnFilesQuery(ch);
-    ioCh->filesWatcher->repeat = 10.; // slow down
+    Outbox *outbox = ch->station->outbox;
+    if (outbox != NULL && !Outbox_IsWatching(outbox) && Outbox_Size(outbox) == 0)
+    {
+        Outbox_Scan(outbox); // 不支持 inotify 时定时扫描
+    }
+    bool picked = IOChannel_SendNextFile(ch);
+    if (ch->status == CHANNEL_STATUS_SENDING_FILE)
+    {
+        return; // 发送完成后继续
+    }
+    // 还有文件时尽快发送下一个，否则等 outbox 通知
+    ioCh->filesWatcher->repeat = picked ? CHANNEL_FILES_NEXT_DELAY : CHANNEL_FILES_IDLE_INTERVAL;
     ev_timer_again(ioCh->reactor, ioCh->filesWatcher);
 }
 
@@ -1537,8 +2510,13 @@ void IOChannel_OnAsyncEvent(Reactor *reactor, ev_async *w, int revents)
 {
     IOChannel *ioCh = (IOChannel *)w->data;
     Channel *ch = (Channel *)ioCh;
+    if (ch->transfer != NULL) // 收到确认，窗口可能有空位
+    {
+        IOChannel_KickPacer(ch);
+    }
     Station_SendPacketsToChannel(ch->station, ch);
     Station_SendFilePkgsToChannel(ch->station, ch);
+    IOChannel_PollOutbox(ch);
 }
 
 void IOChannel_dtor(Channel *const me)
@@ -1567,7 +2545,16 @@ void IOChannel_dtor(Channel *const me)
             ev_async_stop(ioCh->reactor, ioCh->asyncWatcher);
             DelInstance(ioCh->asyncWatcher);
         }
-        ev_loop_destroy(ioCh->reactor);
+        if (ioCh->paceWatcher != NULL)
+        {
+            ev_timer_stop(ioCh->reactor, ioCh->paceWatcher);
+            DelInstance(ioCh->paceWatcher);
+        }
+        if (me->shard == NULL) // 共享的 loop 由 ReactorPool 释放
+        {
+            ev_loop_destroy(ioCh->reactor);
+        }
+        ioCh->reactor = NULL;
     }
     Channel_dtor(me);
 }
@@ -1584,6 +2571,7 @@ void IOChannel_ctor(IOChannel *me, uint8_t id, Station *const station, size_t bu
          &IOChannel_Keepalive,
          &IOChannel_OnRead,
          &IOChannel_Send,
+         &IOChannel_Sendv,
          &IOChannel_ExpandEncode,
          &IOChannel_OnFilesQuery,
          &IOChannel_NotifyData,
@@ -1596,7 +2584,15 @@ void IOChannel_ctor(IOChannel *me, uint8_t id, Station *const station, size_t bu
     Channel *super = (Channel *)me;
     Channel_ctor(super, id, station, buffSize, msgSendInterval);
     super->vptr = (const ChannelVtbl *)(&vtbl);
-    me->reactor = ev_loop_new(0);
+    me->reactor = NULL; // created on start, maybe shared
+    ReactorTask_ctor(&me->notifyTask, &IOChannel_OnNotifyTask, me);
+    me->connecting = false;
+    me->connectFailures = 0;
+    me->backoffSeed = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 8) ^ ((uint32_t)id * 2654435761u);
+    if (me->backoffSeed == 0)
+    {
+        me->backoffSeed = 1; // xorshift 不能为 0
+    }
 }
 // Abstract IOChannel END
 
@@ -1630,62 +2626,204 @@ bool setSocketBlockingEnabled(int fd, bool blocking)
 #endif
 }
 
+static void SocketChannel_CloseSocket(int fd)
+{
+#ifdef __linux
+    close(fd);
+#else
+    closesocket(fd);
+#endif
+}
+
+static int SocketChannel_LastError()
+{
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+/**
+ * 停止所有未完成的连接
+ */
+static void SocketChannel_AbortAttempts(SocketChannel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    for (uint8_t i = 0; i < me->attemptCount; i++)
+    {
+        ConnectAttempt *attempt = &me->attempts[i];
+        if (attempt->fd >= 0)
+        {
+            ev_io_stop(ioCh->reactor, &attempt->watcher);
+            SocketChannel_CloseSocket(attempt->fd);
+            attempt->fd = -1;
+        }
+    }
+    if (ioCh->reactor != NULL)
+    {
+        ev_timer_stop(ioCh->reactor, &me->attemptWatcher);
+    }
+    me->attemptCount = 0;
+    me->addrCount = 0;
+}
+
+static bool SocketChannel_HasPendingAttempt(SocketChannel *const me)
+{
+    for (uint8_t i = 0; i < me->attemptCount; i++)
+    {
+        if (me->attempts[i].fd >= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void SocketChannel_EmitConnectFailed(Channel *const me, struct sockaddr_in const *addr, int error)
+{
+    uint8_t const *ip = (uint8_t const *)&addr->sin_addr.s_addr;
+    EventLog_Emit(&me->station->log, STATION_EVENT_CONNECT_FAILED, me->id,
+                  ip[0], ip[1], ip[2], ip[3], (uint64_t)error);
+}
+
+/**
+ * 开始连接下一个地址，同步失败的地址直接跳过
+ * @return false: 所有地址都已开始
+ */
+static bool SocketChannel_StartAttempt(SocketChannel *const me)
+{
+    IOChannel *ioCh = (IOChannel *)me;
+    Channel *ch = (Channel *)me;
+    while (me->attemptCount < me->addrCount)
+    {
+        ConnectAttempt *attempt = &me->attempts[me->attemptCount++];
+        if (ch->id != CHANNEL_ID_FIXED)
+        {
+            uint8_t const *ip = (uint8_t const *)&attempt->addr.sin_addr.s_addr;
+            EventLog_Emit(&ch->station->log, STATION_EVENT_CONNECTING, ch->id,
+                          ip[0], ip[1], ip[2], ip[3], ntohs(attempt->addr.sin_port));
+        }
+        int sock;
+        if ((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+        {
+            SocketChannel_EmitConnectFailed(ch, &attempt->addr, SocketChannel_LastError());
+            continue;
+        }
+        int on = 1;
+#ifdef _WIN32
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (const char *)&on, sizeof(on));
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+#else
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (void *)&on, sizeof(on));
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+#endif
+        // 非阻塞，读写超时不再需要，连接超时由 connectWatcher 控制
+        setSocketBlockingEnabled(sock, false);
+        if (connect(sock, (struct sockaddr *)&attempt->addr, sizeof(struct sockaddr_in)) < 0)
+        {
+            int error = SocketChannel_LastError();
+#ifdef _WIN32
+            if (error != WSAEWOULDBLOCK)
+#else
+            if (error != EINPROGRESS)
+#endif
+            {
+                SocketChannel_EmitConnectFailed(ch, &attempt->addr, error);
+                SocketChannel_CloseSocket(sock);
+                continue;
+            }
+        }
+        // 可写时通过 SO_ERROR 判断结果
+        attempt->fd = sock;
+        ev_io_set(&attempt->watcher, sock, EV_WRITE);
+        ev_io_start(ioCh->reactor, &attempt->watcher);
+        return true;
+    }
+    return false;
+}
+
+static void SocketChannel_OnAttemptEvent(Reactor *reactor, ev_io *w, int revents)
+{
+    SocketChannel *self = (SocketChannel *)w->data;
+    IOChannel *ioCh = (IOChannel *)self;
+    Channel *ch = (Channel *)self;
+    ConnectAttempt *attempt = (ConnectAttempt *)w;
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(attempt->fd, SOL_SOCKET, SO_ERROR, (char *)&error, &len) != 0)
+    {
+        error = SocketChannel_LastError();
+    }
+    ev_io_stop(reactor, w);
+    if (error == 0)
+    {
+        // 先完成的地址胜出，记录下来下次优先
+        int fd = attempt->fd;
+        attempt->fd = -1;
+        ((SocketChannelVtbl *)ch->vptr)->ip(self)->addr = attempt->addr;
+        SocketChannel_AbortAttempts(self);
+        ioCh->fd = fd;
+        IOChannel_OnConnected(ch);
+        return;
+    }
+    SocketChannel_EmitConnectFailed(ch, &attempt->addr, error);
+    SocketChannel_CloseSocket(attempt->fd);
+    attempt->fd = -1;
+    if (!SocketChannel_HasPendingAttempt(self) && !SocketChannel_StartAttempt(self))
+    {
+        SocketChannel_AbortAttempts(self);
+        IOChannel_OnConnectFailed(ch);
+    }
+}
+
+/**
+ * happy eyeballs: 上一个地址 ATTEMPT_DELAY 内没有结果时，同时开始下一个
+ */
+static void SocketChannel_OnAttemptTimerEvent(Reactor *reactor, ev_timer *w, int revents)
+{
+    SocketChannel *self = (SocketChannel *)w->data;
+    if (!SocketChannel_StartAttempt(self))
+    {
+        ev_timer_stop(reactor, w); // 等待已开始的完成或者超时
+    }
+}
+
+/**
+ * 只开始连接，结果在 SocketChannel_OnAttemptEvent 中处理
+ */
 bool SocketChannel_Connect(Channel *const me)
 {
     assert(me);
+    SocketChannel *self = (SocketChannel *)me;
     IOChannel *ioCh = (IOChannel *)me;
-    Channel *ch = (Channel *)ioCh;
-    Ipv4 *ipv4 = ((SocketChannelVtbl *)ch->vptr)->ip((SocketChannel *)me);
-    if (me->id != CHANNEL_ID_FIXED)
+    SocketChannel_AbortAttempts(self);
+    struct sockaddr_in addrs[SOCKET_CHANNEL_MAX_ATTEMPTS];
+    uint8_t count = ((SocketChannelVtbl *)me->vptr)->addrs(self, addrs, SOCKET_CHANNEL_MAX_ATTEMPTS);
+    for (uint8_t i = 0; i < count; i++)
     {
-        printf("ch[%2d] connecting to %15s:%5d\r\n", ch->id, inet_ntoa(ipv4->addr.sin_addr), ntohs(ipv4->addr.sin_port));
+        self->attempts[i].addr = addrs[i];
     }
-    int sock;
-    if ((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+    self->addrCount = count;
+    if (!SocketChannel_StartAttempt(self))
     {
+        SocketChannel_AbortAttempts(self);
         return false;
     }
-    int on = 1;
-    int recvtimeout = 3;
-    int sendtimeout = 5;
-#ifdef _WIN32
-    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (const char *)&on, sizeof(on));
-    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
-
-    // 读写超时: 2s
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&recvtimeout, sizeof(recvtimeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char *)&sendtimeout, sizeof(sendtimeout));
-#else
-    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (void *)&on, sizeof(on));
-    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (void *)&recvtimeout, sizeof(recvtimeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (void *)&sendtimeout, sizeof(sendtimeout));
-#endif
-    setSocketBlockingEnabled(sock, false);
-    // if (connect(sock, (struct sockaddr *)ipv4, sizeof(struct sockaddr_in)) < 0)
-    // {
-    //     close(sock);
-    //     return false;
-    // }
-    connect(sock, (struct sockaddr *)ipv4, sizeof(struct sockaddr_in));
-    ioCh->fd = sock;
-    // printf("ch[%2d] connected\r\n", ch->id);
+    ev_timer_again(ioCh->reactor, &self->attemptWatcher);
     return true;
 }
 
 void SocketChannel_Close(Channel *const me)
 {
     assert(me);
+    SocketChannel_AbortAttempts((SocketChannel *)me);
     if (!me->isConnected)
     {
         return;
     }
     IOChannel *ioCh = (IOChannel *)me;
-#ifdef __linux
-    close(ioCh->fd);
-#else
-    closesocket(ioCh->fd);
-#endif
+    SocketChannel_CloseSocket(ioCh->fd);
     me->isConnected = false;
 }
 
@@ -1721,11 +2859,11 @@ ByteBuffer *SocketChannel_OnRead(Channel *const me)
         Ipv4 *ipv4 = ((SocketChannelVtbl *)ch->vptr)->ip((SocketChannel *)me);
         if (me->id != CHANNEL_ID_FIXED)
         {
-            printf("ch[%2d] breaking with %15s:%5d, error [%02d] %s\r\n", ch->id,
-                   inet_ntoa(ipv4->addr.sin_addr),
-                   ntohs(ipv4->addr.sin_port),
-                   err,
-                   errStr);
+            char peer[EVENT_DATA_LEN];
+            int len = snprintf(peer, sizeof(peer), "%s:%d %s", inet_ntoa(ipv4->addr.sin_addr),
+                               ntohs(ipv4->addr.sin_port), errStr != NULL ? errStr : "");
+            EventLog_EmitData(&ch->station->log, STATION_EVENT_BREAKING, ch->id,
+                              peer, len > 0 ? (size_t)len : 0, (uint64_t)err);
         }
 #ifdef _WIN32
         LocalFree(errStr);
@@ -1742,45 +2880,90 @@ bool SocketChannel_Send(Channel *const me, ByteBuffer *const buff)
 {
     assert(me);
     assert(buff);
-    if (me->isConnected)
-    {
-        IOChannel *ioCh = (IOChannel *)me;
-        Channel *ch = (Channel *)ioCh;
-        int sock = ioCh->fd;
-        int len = BB_Available(buff);
-        int8_t tryCounts = me->station->config.sendRetryCounts;
-        int sendLen = -1;
-        while (tryCounts >= 0)
-        {
-            sendLen = send(sock, (const char *)buff->buff, len, 0);
-            // LOG_D("ch[%2d] len %d sended %d", me->id, len, sendLen);
-            if (sendLen < 0)
-            {
-                if (errno == EINTR || errno == EWOULDBLOCK || errno == EAGAIN) // @Todo
-                {
-                    printf("ch[%2d] socket send error %d, but keep it\r\n", me->id, errno);
-                }
-                else
-                {
-                    printf("ch[%2d] socket send error %d, close it\r\n", me->id, errno);
-                    SocketChannel_Close(me);
-                    return false;
-                }
-            }
-            usleep(me->msgSendInterval * 1000);
-            if (sendLen == len)
-            {
-                return true;
-            }
-            printf("ch[%2d] send error: %d(require) != %d(send)\r\n", me->id, len, sendLen);
-            tryCounts--;
+    if (!me->isConnected)
+    {
+        return false;
+    }
+    return IOChannel_QueueFrame(me, buff);
+}
+
+/**
+ * 一次系统调用发送多段数据，部分发送时从断点继续
+ */
+static ssize_t SocketChannel_Writev(int sock, struct iovec const *iov, int iovcnt, size_t skip)
+{
+    struct iovec rest[CHANNEL_MAX_IOV];
+    int n = 0;
+    for (int i = 0; i < iovcnt && n < CHANNEL_MAX_IOV; i++)
+    {
+        if (skip >= iov[i].iov_len)
+        {
+            skip -= iov[i].iov_len;
+            continue;
         }
-        return sendLen == len;
+        rest[n].iov_base = (uint8_t *)iov[i].iov_base + skip;
+        rest[n].iov_len = iov[i].iov_len - skip;
+        skip = 0;
+        n++;
     }
-    else
+#ifdef _WIN32
+    ssize_t sent = 0;
+    for (int i = 0; i < n; i++)
     {
-        return false;
+        int len = send(sock, (const char *)rest[i].iov_base, rest[i].iov_len, 0);
+        if (len < 0)
+        {
+            return sent > 0 ? sent : len;
+        }
+        sent += len;
+        if ((size_t)len != rest[i].iov_len)
+        {
+            break;
+        }
+    }
+    return sent;
+#else
+    return writev(sock, rest, n);
+#endif
+}
+
+ssize_t SocketChannel_Sendv(Channel *const me, struct iovec *const iov, int iovcnt)
+{
+    assert(me);
+    assert(iov);
+    assert(iovcnt <= CHANNEL_MAX_IOV);
+    if (!me->isConnected)
+    {
+        return -1;
+    }
+    IOChannel *ioCh = (IOChannel *)me;
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        len += iov[i].iov_len;
+    }
+    size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t sendLen = SocketChannel_Writev(ioCh->fd, iov, iovcnt, sent);
+        if (sendLen >= 0)
+        {
+            sent += sendLen;
+            continue;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EWOULDBLOCK || errno == EAGAIN)
+        {
+            break; // 缓冲区已满，剩余部分等待可写
+        }
+        EventLog_Emit(&me->station->log, STATION_EVENT_SEND_ERROR, me->id, (uint64_t)errno);
+        SocketChannel_Close(me);
+        return -1;
     }
+    return sent;
 }
 
 bool SocketChannel_ExpandEncode(Channel *const me, ByteBuffer *const buff)
@@ -1830,9 +3013,16 @@ Ipv4 *SocketChannel_Ip(SocketChannel *me)
     return NULL;
 }
 
+uint8_t SocketChannel_Addrs(SocketChannel *me, struct sockaddr_in *addrs, uint8_t max)
+{
+    assert(0);
+    return 0;
+}
+
 void SocketChannel_dtor(Channel *const me)
 {
     assert(me);
+    SocketChannel_AbortAttempts((SocketChannel *)me);
     IOChannel_dtor(me);
 }
 
@@ -1851,6 +3041,7 @@ void SocketChannel_ctor(SocketChannel *me, uint8_t id, Station *const station)
           &SocketChannel_Keepalive,
           &SocketChannel_OnRead,
           &SocketChannel_Send,
+          &SocketChannel_Sendv,
           &SocketChannel_ExpandEncode,
           &SocketChannel_OnFilesQuery,
           &SocketChannel_NotifyData,
@@ -1860,7 +3051,8 @@ void SocketChannel_ctor(SocketChannel *me, uint8_t id, Station *const station)
          &SocketChannel_OnIOReadEvent,
          &SocketChannel_OnFilesScanEvent,
          &SocketChannel_OnAsyncEvent},
-        &SocketChannel_Ip};
+        &SocketChannel_Ip,
+        &SocketChannel_Addrs};
     IOChannel *super = (IOChannel *)me;
     IOChannel_ctor(super, id, station,
                    station->config.buffSize == NULL
@@ -1871,6 +3063,17 @@ void SocketChannel_ctor(SocketChannel *me, uint8_t id, Station *const station)
                        : *(station->config.msgSendInterval));
     Channel *ch = (Channel *)me;
     ch->vptr = (const ChannelVtbl *)(&vtbl);
+    for (uint8_t i = 0; i < SOCKET_CHANNEL_MAX_ATTEMPTS; i++)
+    {
+        ev_init(&me->attempts[i].watcher, &SocketChannel_OnAttemptEvent);
+        me->attempts[i].watcher.data = me;
+        me->attempts[i].fd = -1;
+    }
+    me->attemptCount = 0;
+    me->addrCount = 0;
+    ev_init(&me->attemptWatcher, &SocketChannel_OnAttemptTimerEvent);
+    me->attemptWatcher.repeat = SOCKET_CHANNEL_ATTEMPT_DELAY;
+    me->attemptWatcher.data = me;
 }
 // SocketChannel END
 
@@ -1881,6 +3084,13 @@ Ipv4 *Ipv4Channel_Ip(SocketChannel *me)
     return &((Ipv4Channel *)me)->ipv4;
 }
 
+uint8_t Ipv4Channel_Addrs(SocketChannel *me, struct sockaddr_in *addrs, uint8_t max)
+{
+    assert(me);
+    addrs[0] = ((Ipv4Channel *)me)->ipv4.addr;
+    return 1;
+}
+
 bool Ipv4Channel_ExpandEncode(Channel *const me, ByteBuffer *const buff)
 {
     BB_Expand(buff, ELEMENT_IDENTIFER_LEN + 6 + 3 + 1); // 2+6
@@ -1922,6 +3132,7 @@ void Ipv4Channel_ctor(Ipv4Channel *me, uint8_t id, Station *const station)
           &SocketChannel_Keepalive,
           &SocketChannel_OnRead,
           &SocketChannel_Send,
+          &SocketChannel_Sendv,
           &Ipv4Channel_ExpandEncode,
           &SocketChannel_OnFilesQuery,
           &SocketChannel_NotifyData,
@@ -1931,7 +3142,8 @@ void Ipv4Channel_ctor(Ipv4Channel *me, uint8_t id, Station *const station)
          &SocketChannel_OnIOReadEvent,
          &SocketChannel_OnFilesScanEvent,
          &SocketChannel_OnAsyncEvent},
-        &Ipv4Channel_Ip};
+        &Ipv4Channel_Ip,
+        &Ipv4Channel_Addrs};
     SocketChannel *super = (SocketChannel *)me;
     SocketChannel_ctor(super, id, station);
     Channel *ch = (Channel *)me;
@@ -1963,9 +3175,50 @@ bool DomainChannel_ExpandEncode(Channel *const me, ByteBuffer *const buff)
     return true;
 }
 
+/**
+ * 使用 resolver 缓存的地址，解析完成前返回 0，由连接定时器重试
+ * 上次连接成功的地址排在最前
+ */
+uint8_t DomainChannel_Addrs(SocketChannel *me, struct sockaddr_in *addrs, uint8_t max)
+{
+    assert(me);
+    DomainChannel *self = (DomainChannel *)me;
+    Resolver *resolver = &((Channel *)me)->station->resolver;
+    if (self->domain.resolved == NULL)
+    {
+        self->domain.resolved = Resolver_Add(resolver, self->domain.domainStr);
+    }
+    ResolverAddrs resolved;
+    if (Resolver_Get(resolver, self->domain.resolved, &resolved) == 0)
+    {
+        return 0;
+    }
+    uint8_t first = 0;
+    for (uint8_t i = 0; i < resolved.count; i++)
+    {
+        if (resolved.addrs[i].s_addr == self->domain.ipv4.addr.sin_addr.s_addr)
+        {
+            first = i;
+            break;
+        }
+    }
+    uint8_t count = resolved.count < max ? resolved.count : max;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        addrs[i] = self->domain.ipv4.addr; // family, port
+        addrs[i].sin_addr = resolved.addrs[(first + i) % resolved.count];
+    }
+    return count;
+}
+
 void DomainChannel_dtor(Channel *me)
 {
     assert(me);
+    DomainChannel *ch = (DomainChannel *)me;
+    if (ch->domain.domainStr != NULL)
+    {
+        DelInstance(ch->domain.domainStr);
+    }
     SocketChannel_dtor(me);
 }
 
@@ -1981,6 +3234,7 @@ void DomainChannel_ctor(DomainChannel *me, uint8_t id, Station *const station)
           &SocketChannel_Keepalive,
           &SocketChannel_OnRead,
           &SocketChannel_Send,
+          &SocketChannel_Sendv,
           &DomainChannel_ExpandEncode,
           &SocketChannel_OnFilesQuery,
           &SocketChannel_NotifyData,
@@ -1990,39 +3244,65 @@ void DomainChannel_ctor(DomainChannel *me, uint8_t id, Station *const station)
          &SocketChannel_OnIOReadEvent,
          &SocketChannel_OnFilesScanEvent,
          &SocketChannel_OnAsyncEvent},
-        &DomainChannel_Ip};
+        &DomainChannel_Ip,
+        &DomainChannel_Addrs};
     SocketChannel *super = (SocketChannel *)me;
     SocketChannel_ctor(super, id, station);
     Channel *ch = (Channel *)me;
     ch->vptr = (const ChannelVtbl *)&vtbl;
+    me->domain.domainStr = NULL;
+    me->domain.resolved = NULL;
 }
 // DomainChannel END
 
-Channel *Channel_Ipv4FromJson(cJSON *const channelInJson, Config *const config)
+/**
+ * channels 中的一项，从 JSON 或者缓存中读取
+ */
+typedef struct
+{
+    ChannelType type;
+    uint8_t id;
+    char const *host; // ipv4 或者 domain
+    uint16_t port;
+    uint8_t keepalive;
+} ChannelDesc;
+
+static void ChannelDesc_FromJson(ChannelDesc *const me, cJSON *const channelInJson)
 {
-    assert(channelInJson);
+    cJSON_GET_VALUE(type, ChannelType, channelInJson, valuedouble, CHANNEL_DISABLED);
     cJSON_GET_VALUE(id, uint8_t, channelInJson, valuedouble, 0);
+    cJSON_GET_VALUE(ipv4, char *, channelInJson, valuestring, NULL);
+    cJSON_GET_VALUE(domain, char *, channelInJson, valuestring, NULL);
+    cJSON_GET_VALUE(port, uint16_t, channelInJson, valuedouble, 60338);
+    cJSON_GET_VALUE(keepalive, uint8_t, channelInJson, valuedouble, CHANNLE_DEFAULT_KEEPALIVE_INTERVAL);
+    me->type = type;
+    me->id = id;
+    me->host = type == CHANNEL_DOMAIN ? domain : ipv4;
+    me->port = port;
+    me->keepalive = keepalive;
+}
+
+static Channel *Channel_Ipv4FromDesc(ChannelDesc const *const desc, Config *const config)
+{
+    uint8_t id = desc->id;
     if (!Config_IsChannelEnableById(config, id))
     {
         return NULL;
     }
-    cJSON_GET_VALUE(ipv4, char *, channelInJson, valuestring, NULL);
-    cJSON_GET_VALUE(port, uint16_t, channelInJson, valuedouble, 60338);
-    cJSON_GET_VALUE(keepalive, uint8_t, channelInJson, valuedouble, CHANNLE_DEFAULT_KEEPALIVE_INTERVAL);
-    if (ipv4 != NULL && port > 0 &&
+    if (desc->host != NULL && desc->port > 0 &&
         id >= CHANNEL_ID_MASTER_01 && id <= CHANNEL_ID_SLAVE_04)
     {
         Ipv4Channel *ch = NewInstance(Ipv4Channel);
         Ipv4Channel_ctor(ch, id, config->station); // 初始化 station 为 NULL
         Channel *super = (Channel *)ch;
         super->type = CHANNEL_IPV4;
-        super->keepaliveTimer = keepalive;
+        super->keepaliveTimer = desc->keepalive;
         ch->ipv4.addr.sin_family = AF_INET;
-        ch->ipv4.addr.sin_port = htons(port);
+        ch->ipv4.addr.sin_port = htons(desc->port);
 #ifdef _WIN32
-        if (inet_pton(AF_INET, ipv4, &ch->ipv4.addr.sin_addr) == 1)
+        if (inet_pton(AF_INET, desc->host, &ch->ipv4.addr.sin_addr) == 1)
 #else
-        if (inet_aton(ipv4, &ch->ipv4.addr.sin_addr) == 1)
+        if (inet_aton(desc->host, &ch->ipv4.addr.sin_addr) == 1)
 #endif
         {
             return (Channel *)ch;
@@ -2040,18 +3320,15 @@ Channel *Channel_Ipv4FromJson(cJSON *const channelInJson, Config *const config)
     }
 }
 
-Channel *Channel_DomainFromJson(cJSON *const channelInJson, Config *const config)
+static Channel *Channel_DomainFromDesc(ChannelDesc const *const desc, Config *const config)
 {
-    assert(channelInJson);
-    cJSON_GET_VALUE(id, uint8_t, channelInJson, valuedouble, 0);
+    uint8_t id = desc->id;
     if (!Config_IsChannelEnableById(config, id))
     {
         return NULL;
     }
-    cJSON_GET_VALUE(domain, char *, channelInJson, valuestring, NULL);
-    cJSON_GET_VALUE(port, uint16_t, channelInJson, valuedouble, 60338);
-    cJSON_GET_VALUE(keepalive, uint8_t, channelInJson, valuedouble, CHANNLE_DEFAULT_KEEPALIVE_INTERVAL);
-    if (domain != NULL && strlen(domain) > 0 && port > 0 &&
+    char const *domain = desc->host;
+    if (domain != NULL && strlen(domain) > 0 && desc->port > 0 &&
         id >= CHANNEL_ID_MASTER_01 && id <= CHANNEL_ID_SLAVE_04)
     {
 #ifdef _WIN32
@@ -2063,21 +3340,16 @@ Channel *Channel_DomainFromJson(cJSON *const channelInJson, Config *const config
 #else
 
 #endif
-        struct hostent *hosts = gethostbyname(domain);
-        if (hosts == NULL || hosts->h_addrtype != AF_INET)
-        {
-            return NULL;
-        }
         DomainChannel *ch = NewInstance(DomainChannel);
         DomainChannel_ctor(ch, id, config->station); // 初始化 station 为 NULL
         Channel *super = (Channel *)ch;
         super->type = CHANNEL_DOMAIN;
-        super->keepaliveTimer = keepalive;
-        ch->domain.domainStr = domain;
+        super->keepaliveTimer = desc->keepalive;
+        ch->domain.domainStr = strdup(domain); // 配置会被重新加载，不能引用
         ch->domain.ipv4.addr.sin_family = AF_INET;
-        ch->domain.ipv4.addr.sin_port = htons(port);
-        // GET THE FIRST IP
-        ch->domain.ipv4.addr.sin_addr = *(struct in_addr *)hosts->h_addr_list[0];
+        ch->domain.ipv4.addr.sin_port = htons(desc->port);
+        // 后台解析，不阻塞加载，连接时使用解析的结果
+        ch->domain.resolved = Resolver_Add(&config->station->resolver, domain);
         return (Channel *)ch;
     }
     else
@@ -2086,6 +3358,19 @@ Channel *Channel_DomainFromJson(cJSON *const channelInJson, Config *const config
     }
 }
 
+static Channel *Channel_FromDesc(ChannelDesc const *const desc, Config *const config)
+{
+    switch (desc->type)
+    {
+    case CHANNEL_IPV4: // 目前只处理IPV4, 其他认为无效
+        return Channel_Ipv4FromDesc(desc, config);
+    case CHANNEL_DOMAIN: // 自定义的域名方式
+        return Channel_DomainFromDesc(desc, config);
+    default:
+        return NULL;
+    }
+}
+
 Channel *Channel_ToiOTA(Config *const config)
 {
 #ifdef _WIN32
@@ -2098,28 +3383,21 @@ Channel *Channel_ToiOTA(Config *const config)
 
 #endif
     static char const *iOTA = "console.theiota.cn";
-    struct hostent *hosts = gethostbyname(iOTA);
-    if (hosts == NULL || hosts->h_addrtype != AF_INET)
-    {
-        return NULL;
-    }
     DomainChannel *ch = NewInstance(DomainChannel);
     DomainChannel_ctor(ch, CHANNEL_ID_FIXED, config->station); // 初始化 station 为 NULL
     Channel *super = (Channel *)ch;
     super->type = CHANNEL_DOMAIN;
     super->keepaliveTimer = 60;
-    ch->domain.domainStr = (char *)iOTA;
+    ch->domain.domainStr = strdup(iOTA);
     ch->domain.ipv4.addr.sin_family = AF_INET;
     ch->domain.ipv4.addr.sin_port = htons(60338);
-    // GET THE FIRST IP
-    ch->domain.ipv4.addr.sin_addr = *(struct in_addr *)hosts->h_addr_list[0];
+    ch->domain.resolved = Resolver_Add(&config->station->resolver, iOTA);
     return (Channel *)ch;
 }
 
-uint8_t Config_CenterAddr(Config *const me, uint8_t id)
+static uint8_t ConfigSnapshot_CenterAddr(ConfigSnapshot const *const me, uint8_t id)
 {
-    assert(me);
-    if (me->centerAddrs == NULL || id < 1 || id > 4)
+    if (me == NULL || me->centerAddrs == NULL || id < 1 || id > 4)
     {
         return 0;
     }
@@ -2127,6 +3405,15 @@ uint8_t Config_CenterAddr(Config *const me, uint8_t id)
     return *(p + id - 1);
 }
 
+uint8_t Config_CenterAddr(Config *const me, uint8_t id)
+{
+    assert(me);
+    Rcu_ReadLock(&me->snapshots);
+    uint8_t addr = ConfigSnapshot_CenterAddr(Config_Current(me), id);
+    Rcu_ReadUnlock(&me->snapshots);
+    return addr;
+}
+
 bool Config_IsCenterAddrEnable(Config *const me, uint8_t id)
 {
     return Config_CenterAddr(me, id) != 0;
@@ -2183,9 +3470,11 @@ int32_t Config_IndexOfChannel(Config *const me, uint8_t chId)
     return -1;
 }
 
-bool Config_InitFromJSON(Config *const me, cJSON *const json)
+/**
+ * 解析运行参数，centerAddrs / remoteStationAddr 必须存在
+ */
+ConfigSnapshot *ConfigSnapshot_FromJSON(cJSON *const json, uint64_t version)
 {
-    assert(me);
     assert(json);
     // 中心地址
     cJSON *centerAddrs = cJSON_GetObjectItem(json, "centerAddrs");
@@ -2193,11 +3482,10 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
     cJSON *remoteStationAddr = cJSON_GetObjectItem(json, "remoteStationAddr");
     if (centerAddrs == NULL || remoteStationAddr == NULL)
     {
-        return false;
+        return NULL;
     }
-    // init channel array
-    vec_init(&me->channels);
-    vec_reserve(&me->channels, 4); // channel 04~07
+    ConfigSnapshot *me = NewInstance(ConfigSnapshot);
+    me->version = version;
     // 中心地址
     me->centerAddrs = NewInstance(CenterAddrs); // we DO NOT care whether it is NULL
     cJSON_COPY_VALUE(me->centerAddrs->addr1, addr1, centerAddrs, valuedouble);
@@ -2221,17 +3509,231 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
     int shift = 0;
     while (*me->password > 0)
     {
-        pwdInBcd |= (*me->password % 10) << (shift++ << 2);
-        *me->password /= 10;
+        pwdInBcd |= (*me->password % 10) << (shift++ << 2);
+        *me->password /= 10;
+    }
+    *me->password = pwdInBcd;
+    // 工作模式
+    me->workMode = NewInstance(uint8_t);
+    *me->workMode = QUERY_ACK; //
+    cJSON_COPY_VALUE(*me->workMode, workMode, json, valuedouble);
+    // StationCategory
+    cJSON_GET_NUMBER(stationCategory, StationCategory, json, RIVER_STATION, 16);
+    me->stationCategory = stationCategory;
+    me->configInJSON = json;
+    return me;
+}
+
+void ConfigSnapshot_Free(void *ptr)
+{
+    ConfigSnapshot *me = (ConfigSnapshot *)ptr;
+    if (me == NULL)
+    {
+        return;
+    }
+    if (me->centerAddrs != NULL)
+    {
+        DelInstance(me->centerAddrs);
+    }
+    if (me->stationAddr != NULL)
+    {
+        DelInstance(me->stationAddr);
+    }
+    if (me->password != NULL)
+    {
+        DelInstance(me->password);
+    }
+    if (me->workMode != NULL)
+    {
+        DelInstance(me->workMode);
+    }
+    if (me->configInJSON != NULL)
+    {
+        cJSON_Delete(me->configInJSON);
+    }
+    DelInstance(me);
+}
+
+static void Config_AddChannel(Config *const me, ChannelDesc const *const desc)
+{
+    Channel *ch = Channel_FromDesc(desc, me);
+    if (ch == NULL)
+    {
+        return;
+    }
+    if (Config_FindChannel(me, ch->id) == NULL)
+    {
+        vec_push(&me->channels, ch);
+    }
+    else
+    {
+        ch->vptr->dtor(ch);
+        DelInstance(ch);
+    }
+}
+
+static void Config_AddFixedChannel(Config *const me)
+{
+    // add a fixed channel to make it reachable
+    Channel *ch = Channel_ToiOTA(me);
+    if (ch != NULL)
+    {
+        vec_push(&me->channels, ch);
+    }
+}
+
+bool Config_Update(Config *const me, cJSON *const patches)
+{
+    assert(me);
+    assert(patches);
+    pthread_mutex_lock(&me->updateMutex);
+    Rcu_ReadLock(&me->snapshots);
+    ConfigSnapshot const *current = Config_Current(me);
+    uint64_t version = current->version + 1;
+    cJSON *json = current->configInJSON != NULL ? cJSON_Duplicate(current->configInJSON, true) : NULL;
+    Rcu_ReadUnlock(&me->snapshots);
+    if (json == NULL) // 从缓存启动
+    {
+        json = cJSON_FromFile(me->configFile);
+    }
+    ConfigSnapshot *next = NULL;
+    if (json != NULL &&
+        cJSONUtils_ApplyPatchesCaseSensitive(json, patches) == 0 &&
+        (next = ConfigSnapshot_FromJSON(json, version)) != NULL)
+    {
+        cJSON_WriteFile(json, me->configFile);
+        Rcu_Publish(&me->snapshots, next);
+    }
+    else if (json != NULL)
+    {
+        cJSON_Delete(json);
+    }
+    pthread_mutex_unlock(&me->updateMutex);
+    return next != NULL;
+}
+
+bool Config_Reload(Config *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->updateMutex);
+    cJSON *json = cJSON_FromFile(me->configFile);
+    // 只有一个写者，不需要 ReadLock
+    ConfigSnapshot const *current = Config_Current(me);
+    if (json != NULL && current->configInJSON != NULL && cJSON_Compare(json, current->configInJSON, true))
+    {
+        // Config_Update 刚写入的文件，或者内容没有变化
+        cJSON_Delete(json);
+        pthread_mutex_unlock(&me->updateMutex);
+        return true;
+    }
+    ConfigSnapshot *next = NULL;
+    if (json != NULL)
+    {
+        next = ConfigSnapshot_FromJSON(json, current->version + 1);
+        if (next == NULL)
+        {
+            cJSON_Delete(json);
+        }
+    }
+    if (next != NULL)
+    {
+        Rcu_Publish(&me->snapshots, next);
+        printf("config reloaded, version[%llu].\r\n", (unsigned long long)next->version);
+    }
+    else
+    {
+        printf("config reload failed, keep version[%llu].\r\n", (unsigned long long)Config_Current(me)->version);
+    }
+    pthread_mutex_unlock(&me->updateMutex);
+    return next != NULL;
+}
+
+typedef struct
+{
+    Rcu *rcu;
+    RcuReader *reader;
+} ConfigLoopReader;
+
+static void Config_OnLoopRelease(Reactor *loop) EV_THROW
+{
+    ConfigLoopReader *r = (ConfigLoopReader *)ev_userdata(loop);
+    Rcu_Offline(r->reader); // 阻塞期间不持有任何配置
+}
+
+static void Config_OnLoopAcquire(Reactor *loop) EV_THROW
+{
+    ConfigLoopReader *r = (ConfigLoopReader *)ev_userdata(loop);
+    Rcu_Online(r->rcu, r->reader);
+}
+
+void Config_AttachLoop(Config *const me, Reactor *const loop)
+{
+    assert(me);
+    assert(loop);
+    RcuReader *reader = Rcu_Register(&me->snapshots);
+    if (reader == NULL)
+    {
+        printf("config readers are full.\r\n");
+        return;
+    }
+    ConfigLoopReader *r = NewInstance(ConfigLoopReader);
+    r->rcu = &me->snapshots;
+    r->reader = reader;
+    ev_set_userdata(loop, r);
+    ev_set_loop_release_cb(loop, &Config_OnLoopRelease, &Config_OnLoopAcquire);
+}
+
+void Config_DetachLoop(Config *const me, Reactor *const loop)
+{
+    assert(me);
+    assert(loop);
+    ConfigLoopReader *r = (ConfigLoopReader *)ev_userdata(loop);
+    if (r == NULL)
+    {
+        return;
+    }
+    ev_set_loop_release_cb(loop, NULL, NULL);
+    ev_set_userdata(loop, NULL);
+    Rcu_Unregister(&me->snapshots, r->reader);
+    DelInstance(r);
+}
+
+static void Config_OnFileChanged(void *data)
+{
+    Config_Reload((Config *)data);
+}
+
+void Config_Watch(Config *const me)
+{
+    assert(me);
+    if (me->configFile == NULL || me->watch != NULL)
+    {
+        return;
     }
-    *me->password = pwdInBcd;
-    // 工作模式
-    me->workMode = NewInstance(uint8_t);
-    *me->workMode = QUERY_ACK; //
-    cJSON_COPY_VALUE(*me->workMode, workMode, json, valuedouble);
-    // StationCategory
-    cJSON_GET_NUMBER(stationCategory, StationCategory, json, RIVER_STATION, 16);
-    me->stationCategory = stationCategory;
+    FileWatch *watch = NewInstance(FileWatch);
+    if (FileWatch_Open(watch, me->configFile, &Config_OnFileChanged, me))
+    {
+        me->watch = watch;
+    }
+    else
+    {
+        DelInstance(watch);
+    }
+}
+
+bool Config_InitFromJSON(Config *const me, cJSON *const json)
+{
+    assert(me);
+    assert(json);
+    ConfigSnapshot *snapshot = ConfigSnapshot_FromJSON(json, 1);
+    if (snapshot == NULL)
+    {
+        return false;
+    }
+    Rcu_Publish(&me->snapshots, snapshot); // 接管 json
+    // init channel array
+    vec_init(&me->channels);
+    vec_reserve(&me->channels, 4); // channel 04~07
     // filesDir
     cJSON_GET_VALUE(filesDir, char *, json, valuestring, NULL);
     if (filesDir == NULL)
@@ -2243,7 +3745,7 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
     }
     else
     {
-        size_t len = strlen(filesDir);
+        size_t len = strlen(filesDir) + 1;
         me->filesDir = (char *)malloc(len);
         memset(me->filesDir, '\0', len);
         memcpy(me->filesDir, filesDir, len);
@@ -2261,7 +3763,7 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
     }
     else
     {
-        size_t len = strlen(sentFilesDir);
+        size_t len = strlen(sentFilesDir) + 1;
         me->sentFilesDir = (char *)malloc(len);
         memset(me->sentFilesDir, '\0', len);
         memcpy(me->sentFilesDir, sentFilesDir, len);
@@ -2303,6 +3805,16 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
     cJSON *jFastFailed = cJSON_GetObjectItem(json, "fastFailed");
     me->fastFailed = jFastFailed == NULL || cJSON_IsNull(jFastFailed) || cJSON_IsTrue(jFastFailed);
 
+    // file sliding window: default 0, wait for one ack at the end (waitFileSendAck)
+    if (cJSON_HasObjectItem(json, "fileWindow"))
+    {
+        cJSON_COPY_VALUE(me->fileWindow, fileWindow, json, valuedouble);
+        if (me->fileWindow > CHANNEL_MAX_FILE_WINDOW)
+        {
+            me->fileWindow = CHANNEL_MAX_FILE_WINDOW;
+        }
+    }
+
     // send retry count
     if (cJSON_HasObjectItem(json, "sendRetryCounts"))
     {
@@ -2313,38 +3825,322 @@ bool Config_InitFromJSON(Config *const me, cJSON *const json)
         }
     }
 
+    // shared reactors: default 0, one thread per channel
+    if (cJSON_HasObjectItem(json, "reactors"))
+    {
+        cJSON_COPY_VALUE(me->reactors, reactors, json, valuedouble);
+        if (me->reactors > REACTOR_MAX_SHARDS)
+        {
+            me->reactors = REACTOR_MAX_SHARDS;
+        }
+    }
+    me->pinReactors = cJSON_IsTrue(cJSON_GetObjectItem(json, "pinReactors"));
+
+    // wal: default disabled
+    cJSON *wal = cJSON_GetObjectItem(json, "wal");
+    me->walEnabled = cJSON_IsTrue(wal) || cJSON_IsObject(wal);
+    if (cJSON_IsObject(wal))
+    {
+        cJSON_COPY_VALUE(me->walSegmentSize, segmentSize, wal, valuedouble);
+        cJSON_COPY_VALUE(me->walMaxSegments, maxSegments, wal, valuedouble);
+        cJSON_COPY_VALUE(me->walSyncInterval, syncInterval, wal, valuedouble);
+    }
+
+    // metrics: default disabled
+    cJSON *metrics = cJSON_GetObjectItem(json, "metrics");
+    me->metricsEnabled = cJSON_IsTrue(metrics) || cJSON_IsObject(metrics);
+    if (cJSON_IsObject(metrics))
+    {
+        cJSON_GET_VALUE(socket, char *, metrics, valuestring, NULL);
+        if (socket != NULL)
+        {
+            me->metricsSocket = strdup(socket);
+        }
+        cJSON_COPY_VALUE(me->metricsPort, port, metrics, valuedouble);
+    }
+    // log: level/rate/binary, default info to stdout
+    cJSON *log = cJSON_GetObjectItem(json, "log");
+    if (cJSON_IsObject(log))
+    {
+        cJSON_GET_VALUE(level, char *, log, valuestring, NULL);
+        me->logLevel = EventLevel_FromString(level, EVENT_LEVEL_INFO);
+        cJSON_COPY_VALUE(me->logRate, rate, log, valuedouble);
+        cJSON_GET_VALUE(binary, char *, log, valuestring, NULL);
+        if (binary != NULL)
+        {
+            me->logBinary = strdup(binary);
+        }
+    }
+    if (me->metricsEnabled && me->metricsSocket == NULL && me->metricsPort == 0)
+    {
+        size_t len = strlen(me->workDir) + 14;
+        me->metricsSocket = (char *)malloc(len); // /metrics.sock\0
+        snprintf(me->metricsSocket, len, "%s/metrics.sock", me->workDir);
+    }
+
     // channels
     cJSON *channels = cJSON_GetObjectItem(json, "channels");
     cJSON *channel;
     cJSON_ArrayForEach(channel, channels)
     {
-        cJSON_GET_VALUE(type, ChannelType, channel, valuedouble, CHANNEL_DISABLED);
-        Channel *ch = NULL;
-        switch (type)
-        {
-        case CHANNEL_IPV4: // 目前只处理IPV4, 其他认为无效
-            ch = Channel_Ipv4FromJson(channel, me);
-            break;
-        case CHANNEL_DOMAIN: // 自定义的域名方式
-            ch = Channel_DomainFromJson(channel, me);
-            break;
-        default:
-            break;
-        }
-        if (ch != NULL && Config_FindChannel(me, ch->id) == NULL)
+        ChannelDesc desc;
+        ChannelDesc_FromJson(&desc, channel);
+        Config_AddChannel(me, &desc);
+    }
+    Config_AddFixedChannel(me);
+    return true;
+}
+
+// ConfigCache
+#define CONFIG_CACHE_MAX_CHANNELS 16
+
+enum
+{
+    CONFIG_CACHE_WAIT_FILE_SEND_ACK = 1 << 0,
+    CONFIG_CACHE_SCAN_FILES = 1 << 1,
+    CONFIG_CACHE_FAST_FAILED = 1 << 2,
+    CONFIG_CACHE_PIN_REACTORS = 1 << 3,
+    CONFIG_CACHE_WAL = 1 << 4,
+    CONFIG_CACHE_METRICS = 1 << 5,
+    CONFIG_CACHE_BUFF_SIZE = 1 << 6,
+    CONFIG_CACHE_MSG_SEND_INTERVAL = 1 << 7,
+};
+
+/**
+ * 缓存中读出的配置，先完整读出再应用，出错时不影响 Config
+ * 字符串指向映射的内存
+ */
+typedef struct
+{
+    CenterAddrs centerAddrs;
+    RemoteStationAddr stationAddr;
+    uint16_t password; // BCD
+    uint8_t workMode;
+    StationCategory stationCategory;
+    char const *filesDir;
+    char const *sentFilesDir;
+    char const *socketDevice;
+    uint8_t flags;
+    uint32_t buffSize;
+    uint16_t msgSendInterval;
+    uint16_t fileWindow;
+    uint8_t sendRetryCounts;
+    uint16_t reactors;
+    uint64_t walSegmentSize;
+    uint32_t walMaxSegments;
+    uint32_t walSyncInterval;
+    char const *metricsSocket;
+    uint16_t metricsPort;
+    uint8_t logLevel;
+    uint32_t logRate;
+    char const *logBinary;
+    uint8_t channelCount;
+    ChannelDesc channels[CONFIG_CACHE_MAX_CHANNELS];
+} ConfigImage;
+
+static void Config_EncodeCache(Config *const me, ByteBuffer *const payload)
+{
+    ConfigSnapshot const *snapshot = Config_Current(me);
+    ConfigCache_PutUInt(payload, snapshot->centerAddrs->addr1, 1);
+    ConfigCache_PutUInt(payload, snapshot->centerAddrs->addr2, 1);
+    ConfigCache_PutUInt(payload, snapshot->centerAddrs->addr3, 1);
+    ConfigCache_PutUInt(payload, snapshot->centerAddrs->addr4, 1);
+    RemoteStationAddr const *addr = snapshot->stationAddr;
+    ConfigCache_PutUInt(payload, addr->A5, 1);
+    ConfigCache_PutUInt(payload, addr->A4, 1);
+    ConfigCache_PutUInt(payload, addr->A3, 1);
+    ConfigCache_PutUInt(payload, addr->A2, 1);
+    ConfigCache_PutUInt(payload, addr->A1, 1);
+    ConfigCache_PutUInt(payload, addr->A0, 1);
+    ConfigCache_PutUInt(payload, *snapshot->password, 2);
+    ConfigCache_PutUInt(payload, *snapshot->workMode, 1);
+    ConfigCache_PutUInt(payload, snapshot->stationCategory, 1);
+    ConfigCache_PutString(payload, me->filesDir);
+    ConfigCache_PutString(payload, me->sentFilesDir);
+    ConfigCache_PutString(payload, me->socketDevice);
+    uint8_t flags = (me->waitFileSendAck ? CONFIG_CACHE_WAIT_FILE_SEND_ACK : 0) |
+                    (me->scanFiles ? CONFIG_CACHE_SCAN_FILES : 0) |
+                    (me->fastFailed ? CONFIG_CACHE_FAST_FAILED : 0) |
+                    (me->pinReactors ? CONFIG_CACHE_PIN_REACTORS : 0) |
+                    (me->walEnabled ? CONFIG_CACHE_WAL : 0) |
+                    (me->metricsEnabled ? CONFIG_CACHE_METRICS : 0) |
+                    (me->buffSize != NULL ? CONFIG_CACHE_BUFF_SIZE : 0) |
+                    (me->msgSendInterval != NULL ? CONFIG_CACHE_MSG_SEND_INTERVAL : 0);
+    ConfigCache_PutUInt(payload, flags, 1);
+    ConfigCache_PutUInt(payload, me->buffSize != NULL ? *me->buffSize : 0, 4);
+    ConfigCache_PutUInt(payload, me->msgSendInterval != NULL ? *me->msgSendInterval : 0, 2);
+    ConfigCache_PutUInt(payload, me->fileWindow, 2);
+    ConfigCache_PutUInt(payload, me->sendRetryCounts, 1);
+    ConfigCache_PutUInt(payload, me->reactors, 2);
+    ConfigCache_PutUInt(payload, me->walSegmentSize, 8);
+    ConfigCache_PutUInt(payload, me->walMaxSegments, 4);
+    ConfigCache_PutUInt(payload, me->walSyncInterval, 4);
+    ConfigCache_PutString(payload, me->metricsSocket);
+    ConfigCache_PutUInt(payload, me->metricsPort, 2);
+    ConfigCache_PutUInt(payload, me->logLevel, 1);
+    ConfigCache_PutUInt(payload, me->logRate, 4);
+    ConfigCache_PutString(payload, me->logBinary);
+    // 保存配置项而不是创建的结果，启用状态/域名解析在加载时重新处理
+    ChannelDesc descs[CONFIG_CACHE_MAX_CHANNELS];
+    uint8_t count = 0;
+    cJSON *channel;
+    cJSON_ArrayForEach(channel, cJSON_GetObjectItem(snapshot->configInJSON, "channels"))
+    {
+        if (count < CONFIG_CACHE_MAX_CHANNELS)
         {
-            vec_push(&me->channels, ch);
+            ChannelDesc_FromJson(&descs[count++], channel);
         }
     }
-    // add a fixed channel to make it reachable
-    Channel *ch = Channel_ToiOTA(me);
-    if (ch != NULL)
+    ConfigCache_PutUInt(payload, count, 1);
+    for (uint8_t i = 0; i < count; i++)
     {
-        vec_push(&me->channels, ch);
+        ConfigCache_PutUInt(payload, descs[i].type, 1);
+        ConfigCache_PutUInt(payload, descs[i].id, 1);
+        ConfigCache_PutUInt(payload, descs[i].port, 2);
+        ConfigCache_PutUInt(payload, descs[i].keepalive, 1);
+        ConfigCache_PutString(payload, descs[i].host);
     }
-    return true;
 }
 
+static bool Config_DecodeCache(ConfigImage *const image, ConfigCache *const cache)
+{
+    image->centerAddrs.addr1 = ConfigCache_GetUInt(cache, 1);
+    image->centerAddrs.addr2 = ConfigCache_GetUInt(cache, 1);
+    image->centerAddrs.addr3 = ConfigCache_GetUInt(cache, 1);
+    image->centerAddrs.addr4 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A5 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A4 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A3 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A2 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A1 = ConfigCache_GetUInt(cache, 1);
+    image->stationAddr.A0 = ConfigCache_GetUInt(cache, 1);
+    image->password = ConfigCache_GetUInt(cache, 2);
+    image->workMode = ConfigCache_GetUInt(cache, 1);
+    image->stationCategory = (StationCategory)ConfigCache_GetUInt(cache, 1);
+    image->filesDir = ConfigCache_GetString(cache);
+    image->sentFilesDir = ConfigCache_GetString(cache);
+    image->socketDevice = ConfigCache_GetString(cache);
+    image->flags = ConfigCache_GetUInt(cache, 1);
+    image->buffSize = ConfigCache_GetUInt(cache, 4);
+    image->msgSendInterval = ConfigCache_GetUInt(cache, 2);
+    image->fileWindow = ConfigCache_GetUInt(cache, 2);
+    image->sendRetryCounts = ConfigCache_GetUInt(cache, 1);
+    image->reactors = ConfigCache_GetUInt(cache, 2);
+    image->walSegmentSize = ConfigCache_GetUInt(cache, 8);
+    image->walMaxSegments = ConfigCache_GetUInt(cache, 4);
+    image->walSyncInterval = ConfigCache_GetUInt(cache, 4);
+    image->metricsSocket = ConfigCache_GetString(cache);
+    image->metricsPort = ConfigCache_GetUInt(cache, 2);
+    image->logLevel = ConfigCache_GetUInt(cache, 1);
+    image->logRate = ConfigCache_GetUInt(cache, 4);
+    image->logBinary = ConfigCache_GetString(cache);
+    image->channelCount = ConfigCache_GetUInt(cache, 1);
+    if (image->channelCount > CONFIG_CACHE_MAX_CHANNELS)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < image->channelCount; i++)
+    {
+        ChannelDesc *desc = &image->channels[i];
+        desc->type = (ChannelType)ConfigCache_GetUInt(cache, 1);
+        desc->id = ConfigCache_GetUInt(cache, 1);
+        desc->port = ConfigCache_GetUInt(cache, 2);
+        desc->keepalive = ConfigCache_GetUInt(cache, 1);
+        desc->host = ConfigCache_GetString(cache);
+    }
+    return ConfigCache_IsComplete(cache) &&
+           image->filesDir != NULL && image->sentFilesDir != NULL && image->socketDevice != NULL;
+}
+
+static void Config_ApplyImage(Config *const me, ConfigImage const *const image)
+{
+    // 没有 JSON，需要时(RUNTIME_CONFIG/修改配置)再从 configFile 加载
+    ConfigSnapshot *snapshot = NewInstance(ConfigSnapshot);
+    snapshot->version = 1;
+    snapshot->centerAddrs = NewInstance(CenterAddrs);
+    *snapshot->centerAddrs = image->centerAddrs;
+    snapshot->stationAddr = NewInstance(RemoteStationAddr);
+    *snapshot->stationAddr = image->stationAddr;
+    snapshot->password = NewInstance(uint16_t);
+    *snapshot->password = image->password;
+    snapshot->workMode = NewInstance(uint8_t);
+    *snapshot->workMode = image->workMode;
+    snapshot->stationCategory = image->stationCategory;
+    snapshot->configInJSON = NULL;
+    Rcu_Publish(&me->snapshots, snapshot);
+    me->filesDir = strdup(image->filesDir);
+    me->sentFilesDir = strdup(image->sentFilesDir);
+    mode_t mode = S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH;
+    mkpath(me->filesDir, mode);
+    mkpath(me->sentFilesDir, mode);
+    me->socketDevice = strdup(image->socketDevice);
+    if (image->flags & CONFIG_CACHE_BUFF_SIZE)
+    {
+        me->buffSize = NewInstance(size_t);
+        *me->buffSize = image->buffSize;
+    }
+    if (image->flags & CONFIG_CACHE_MSG_SEND_INTERVAL)
+    {
+        me->msgSendInterval = NewInstance(uint16_t);
+        *me->msgSendInterval = image->msgSendInterval;
+    }
+    me->waitFileSendAck = image->flags & CONFIG_CACHE_WAIT_FILE_SEND_ACK;
+    me->scanFiles = image->flags & CONFIG_CACHE_SCAN_FILES;
+    me->fastFailed = image->flags & CONFIG_CACHE_FAST_FAILED;
+    me->pinReactors = image->flags & CONFIG_CACHE_PIN_REACTORS;
+    me->walEnabled = image->flags & CONFIG_CACHE_WAL;
+    me->metricsEnabled = image->flags & CONFIG_CACHE_METRICS;
+    me->fileWindow = image->fileWindow;
+    me->sendRetryCounts = image->sendRetryCounts;
+    me->reactors = image->reactors;
+    me->walSegmentSize = image->walSegmentSize;
+    me->walMaxSegments = image->walMaxSegments;
+    me->walSyncInterval = image->walSyncInterval;
+    me->metricsSocket = image->metricsSocket != NULL ? strdup(image->metricsSocket) : NULL;
+    me->metricsPort = image->metricsPort;
+    me->logLevel = image->logLevel;
+    me->logRate = image->logRate;
+    me->logBinary = image->logBinary != NULL ? strdup(image->logBinary) : NULL;
+    vec_init(&me->channels);
+    vec_reserve(&me->channels, 4); // channel 04~07
+    for (uint8_t i = 0; i < image->channelCount; i++)
+    {
+        Config_AddChannel(me, &image->channels[i]);
+    }
+    Config_AddFixedChannel(me);
+}
+
+/**
+ * configFile 未变化时从缓存加载，跳过 JSON 解析
+ */
+static bool Config_InitFromCache(Config *const me, char const *const cacheFile, ConfigCacheSource const *const source)
+{
+    ConfigCache cache;
+    if (!ConfigCache_Open(&cache, cacheFile, source))
+    {
+        return false;
+    }
+    ConfigImage image;
+    bool res = Config_DecodeCache(&image, &cache);
+    if (res)
+    {
+        Config_ApplyImage(me, &image);
+    }
+    ConfigCache_dtor(&cache);
+    return res;
+}
+
+static bool Config_SaveCache(Config *const me, char const *const cacheFile, ConfigCacheSource const *const source)
+{
+    ByteBuffer payload;
+    BB_ctor(&payload, 0);
+    Config_EncodeCache(me, &payload);
+    bool res = ConfigCache_Save(cacheFile, source, &payload);
+    BB_dtor(&payload);
+    return res;
+}
+// ConfigCache END
+
 bool Config_IsValid(Config *const config)
 {
     return config != NULL && config->channels.length > 0;
@@ -2352,6 +4148,11 @@ bool Config_IsValid(Config *const config)
 
 void Config_dtor(Config *const me)
 {
+    if (me->watch != NULL) // 先停止，回调会发布新的配置
+    {
+        FileWatch_dtor(me->watch);
+        DelInstance(me->watch);
+    }
     int i;
     Channel *ch = NULL;
     vec_foreach(&me->channels, ch, i)
@@ -2366,26 +4167,8 @@ void Config_dtor(Config *const me)
         }
     }
     vec_deinit(&me->channels);
-    if (me->centerAddrs != NULL)
-    {
-        DelInstance(me->centerAddrs);
-    }
-    if (me->stationAddr != NULL)
-    {
-        DelInstance(me->stationAddr);
-    }
-    if (me->password != NULL)
-    {
-        DelInstance(me->password);
-    }
-    if (me->workMode != NULL)
-    {
-        DelInstance(me->workMode);
-    }
-    if (me->configInJSON != NULL)
-    {
-        cJSON_Delete(me->configInJSON);
-    }
+    Rcu_dtor(&me->snapshots);
+    pthread_mutex_destroy(&me->updateMutex);
     if (me->configFile != NULL)
     {
         DelInstance(me->configFile);
@@ -2406,6 +4189,14 @@ void Config_dtor(Config *const me)
     {
         DelInstance(me->socketDevice);
     }
+    if (me->metricsSocket != NULL)
+    {
+        DelInstance(me->metricsSocket);
+    }
+    if (me->logBinary != NULL)
+    {
+        DelInstance(me->logBinary);
+    }
     if (me->buffSize != NULL)
     {
         DelInstance(me->buffSize);
@@ -2419,24 +4210,37 @@ void Config_dtor(Config *const me)
 void Config_ctor(Config *const me, Station *const station)
 {
     assert(me);
-    me->centerAddrs = NULL;
-    me->configInJSON = NULL;
+    Rcu_ctor(&me->snapshots, NULL, &ConfigSnapshot_Free);
+    pthread_mutex_init(&me->updateMutex, NULL);
+    me->watch = NULL;
     me->configFile = NULL;
     me->workDir = NULL;
-    me->password = NULL;
-    me->stationAddr = NULL;
-    me->workMode = NULL;
     me->station = station;
     me->sendRetryCounts = CHANNEL_DEFAULT_MSG_SEND_RETRY_COUNT;
+    me->fileWindow = 0;
     me->buffSize = NULL;
     me->msgSendInterval = NULL;
+    me->reactors = 0;
+    me->pinReactors = false;
+    me->walEnabled = false;
+    me->walSegmentSize = WAL_DEFAULT_SEGMENT_SIZE;
+    me->walMaxSegments = WAL_DEFAULT_MAX_SEGMENTS;
+    me->walSyncInterval = WAL_DEFAULT_SYNC_INTERVAL;
+    me->metricsEnabled = false;
+    me->metricsSocket = NULL;
+    me->metricsPort = 0;
+    me->logLevel = EVENT_LEVEL_INFO;
+    me->logRate = EVENT_LOG_DEFAULT_RATE;
+    me->logBinary = NULL;
 }
 
 // Packet
-void Packet_ctor(Packet *const me, Package *const pkg)
+void Packet_ctor(Packet *const me, ByteBuffer *const frame)
 {
     assert(me);
-    me->pkg = pkg;
+    me->frame = frame;
+    me->uplink = true;
+    me->seq = 0;
     me->channelSentMask = 0;
     me->result = true;
 }
@@ -2444,13 +4248,16 @@ void Packet_ctor(Packet *const me, Package *const pkg)
 void Packet_dtor(Packet *const me)
 {
     assert(me);
-    if (me->pkg != NULL)
+    if (me->frame != NULL)
     {
-        me->pkg->vptr->dtor(me->pkg);
-        DelInstance(me->pkg);
+        BB_dtor(me->frame);
+        DelInstance(me->frame);
     }
 }
 
+/**
+ * 只在投递前调用
+ */
 void Packet_Marking(Packet *const me, uint8_t chId)
 {
     assert(me);
@@ -2465,25 +4272,25 @@ void Packet_MarkingByChannel(Packet *const me, Channel *const ch)
     Packet_Marking(me, ch->id);
 }
 
-void Packet_Unmark(Packet *const me, uint8_t chId)
+void Packet_Release(Packet *const me, uint8_t chId)
 {
     assert(me);
     assert(chId > 0 && chId <= 16);
-    me->channelSentMask &= ~(1 << chId);
-}
-
-void Packet_UnmarkByChannel(Packet *const me, Channel *const ch)
-{
-    assert(me);
-    assert(ch);
-    Packet_Unmark(me, ch->id);
+    uint16_t bit = 1 << chId;
+    uint16_t remain = __atomic_and_fetch(&me->channelSentMask, (uint16_t)~bit, __ATOMIC_ACQ_REL);
+    if (remain == 0)
+    {
+        Packet *packet = me;
+        Packet_dtor(packet);
+        DelInstance(packet);
+    }
 }
 
 bool Packet_ShouldSend(Packet *const me, uint8_t chId)
 {
     assert(me);
     assert(chId > 0 && chId <= 16);
-    return me->channelSentMask & (1 << chId);
+    return __atomic_load_n(&me->channelSentMask, __ATOMIC_ACQUIRE) & (1 << chId);
 }
 
 bool Packet_ShouldSendByChannel(Packet *const me, Channel *const ch)
@@ -2533,43 +4340,358 @@ void FilePkg_Unmark(FilePkg *const me, uint8_t chId)
     me->channelSentMask &= ~(1 << chId);
 }
 
-void FilePkg_UnmarkByChannel(FilePkg *const me, Channel *const ch)
+void FilePkg_UnmarkByChannel(FilePkg *const me, Channel *const ch)
+{
+    assert(me);
+    assert(ch);
+    FilePkg_Unmark(me, ch->id);
+}
+
+bool FilePkg_ShouldSend(FilePkg *const me, uint8_t chId)
+{
+    assert(me);
+    assert(chId > 0 && chId <= 16);
+    return me->channelSentMask & (1 << chId);
+}
+
+bool FilePkg_ShouldSendByChannel(FilePkg *const me, Channel *const ch)
+{
+    assert(me);
+    assert(ch);
+    return FilePkg_ShouldSend(me, ch->id);
+}
+// FilePkg END
+
+ChannelHandleFunc Station_SetHandler(Station *const me, FunctionCode code, ChannelHandleFunc cb)
+{
+    assert(me);
+    ChannelHandleFunc old = me->handlers[(uint8_t)code];
+    me->handlers[(uint8_t)code] = cb;
+    return old;
+}
+
+bool Station_Use(Station *const me, ChannelMiddleware const *const middleware)
+{
+    assert(me);
+    assert(middleware);
+    assert(middleware->cb);
+    if (me->middlewareCount >= STATION_MAX_MIDDLEWARES)
+    {
+        return false;
+    }
+    me->middlewares[me->middlewareCount++] = middleware;
+    return true;
+}
+
+void Station_ctor(Station *const me)
+{
+    assert(me);
+    // 默认的处理，应用可以覆盖
+    static ChannelHandler const handlers[] = {
+        {TEST, &handleTEST},
+        {BASIC_CONFIG, &handleBASIC_CONFIG},
+        {MODIFY_BASIC_CONFIG, &handleMODIFY_BASIC_CONFIG},
+        {RUNTIME_CONFIG, &handleRUNTIME_CONFIG},
+        {MODIFY_RUNTIME_CONFIG, &handleMODIFY_RUNTIME_CONFIG},
+        {PICTURE, &handlePICTURE}};
+    memset(me->handlers, 0, sizeof(me->handlers));
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++)
+    {
+        me->handlers[(uint8_t)handlers[i].code] = handlers[i].cb;
+    }
+    me->middlewareCount = 0;
+    // me->reactor = NULL;
+    Config_ctor(&me->config, me);
+    // pthread_mutexattr_t mutexAttr;
+    // pthread_mutexattr_init(&mutexAttr);
+    // pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&me->cleanUpMutex, NULL);
+    // pthread_mutexattr_t sendMutexAttr;
+    // pthread_mutexattr_init(&sendMutexAttr);
+    // pthread_mutexattr_settype(&sendMutexAttr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&me->sendMutex, NULL);
+    ReactorPool_ctor(&me->reactors, 0, false);
+    me->wal = NULL;
+    me->outbox = NULL;
+    Resolver_ctor(&me->resolver);
+    StationMetrics_ctor(&me->metrics);
+    me->metricsServer = NULL;
+    EventLog_ctor(&me->log, STATION_EVENTS, STATION_EVENT_COUNT);
+}
+
+/**
+ * 打开 workDir/wal，恢复各 channel 的发送位置，连接后从断点继续发送
+ */
+static void Station_OpenWal(Station *const me)
+{
+    Config *config = &me->config;
+    if (!config->walEnabled)
+    {
+        return;
+    }
+    char dir[300] = {0};
+    snprintf(dir, 300, "%s/wal", config->workDir);
+    mode_t mode = S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH;
+    mkpath(dir, mode);
+    Wal *wal = NewInstance(Wal);
+    if (!Wal_Open(wal, dir, config->walSegmentSize, config->walMaxSegments, config->walSyncInterval))
+    {
+        printf("wal disabled, open %s failed.\r\n", dir);
+        DelInstance(wal);
+        return;
+    }
+    int i;
+    Channel *ch = NULL;
+    vec_foreach(&config->channels, ch, i)
+    {
+        if (ch->id < WAL_MAX_CURSORS &&
+            Config_IsChannelEnable(config, ch) &&
+            (ch->type == CHANNEL_IPV4 || ch->type == CHANNEL_DOMAIN))
+        {
+            Wal_Track(wal, ch->id);
+        }
+    }
+    me->wal = wal;
+}
+
+static void Station_OnOutboxChanged(void *data)
+{
+    Station *me = (Station *)data;
+    if (!me->config.scanFiles)
+    {
+        return;
+    }
+    int i;
+    Channel *ch = NULL;
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (ch != NULL && ch->isConnected && ch->station == me)
+        {
+            ch->vptr->notifyData(ch);
+        }
+    }
+}
+
+/**
+ * 所有 channel 共享一个 filesDir 的待发送队列，有新文件时唤醒 channel
+ * 没有启用 scanFiles 时也需要，用于响应中心站的文件查询
+ */
+static void Station_OpenOutbox(Station *const me)
+{
+    Outbox *outbox = NewInstance(Outbox);
+    if (!Outbox_Open(outbox, me->config.filesDir, &Station_OnOutboxChanged, me))
+    {
+        printf("scan files disabled, open %s failed.\r\n", me->config.filesDir);
+        Outbox_dtor(outbox);
+        DelInstance(outbox);
+        return;
+    }
+    me->outbox = outbox;
+}
+
+/**
+ * 启动运行日志的后台输出线程，失败时退回同步输出
+ */
+static void Station_OpenLog(Station *const me)
+{
+    Config *config = &me->config;
+    me->log.level = config->logLevel;
+    me->log.rate = config->logRate;
+    if (!EventLog_Start(&me->log, stdout, config->logBinary))
+    {
+        printf("async log disabled, open %s failed.\r\n", config->logBinary != NULL ? config->logBinary : "drainer");
+    }
+}
+
+// Metrics
+typedef struct
 {
-    assert(me);
-    assert(ch);
-    FilePkg_Unmark(me, ch->id);
+    char const *name;
+    char const *help;
+    size_t offset;
+} ChannelCounter;
+
+static ChannelCounter const CHANNEL_COUNTERS[] = {
+    {"sl651_frames_in_total", "Frames decoded from the center.", offsetof(ChannelMetrics, framesIn)},
+    {"sl651_bytes_in_total", "Bytes read from the center.", offsetof(ChannelMetrics, bytesIn)},
+    {"sl651_frames_out_total", "Frames written to the center.", offsetof(ChannelMetrics, framesOut)},
+    {"sl651_bytes_out_total", "Bytes written to the center.", offsetof(ChannelMetrics, bytesOut)},
+    {"sl651_send_blocked_total", "Times the socket send buffer was full.", offsetof(ChannelMetrics, sendBlocked)},
+    {"sl651_file_retransmits_total", "File packets sent again after NAK or ack timeout.", offsetof(ChannelMetrics, retransmits)},
+    {"sl651_connects_total", "Connections established.", offsetof(ChannelMetrics, connects)},
+    {"sl651_disconnects_total", "Connections lost.", offsetof(ChannelMetrics, disconnects)},
+    {"sl651_file_bytes_total", "File payload bytes sent.", offsetof(ChannelMetrics, fileBytes)},
+    {"sl651_files_sent_total", "File transfers completed.", offsetof(ChannelMetrics, filesSent)},
+    {"sl651_files_failed_total", "File transfers aborted.", offsetof(ChannelMetrics, filesFailed)},
+};
+
+static bool Station_IsMetricsChannel(Station *const me, Channel *const ch)
+{
+    return ch != NULL && ch->station == me &&
+           (ch->type == CHANNEL_IPV4 || ch->type == CHANNEL_DOMAIN);
 }
 
-bool FilePkg_ShouldSend(FilePkg *const me, uint8_t chId)
+/**
+ * 在抓取线程中调用，只读原子计数器和近似的队列长度
+ */
+static void Station_RenderMetrics(void *data, MetricsText *const text)
 {
-    assert(me);
-    assert(chId > 0 && chId <= 16);
-    return me->channelSentMask & (1 << chId);
+    Station *me = (Station *)data;
+    char labels[64];
+    int i;
+    Channel *ch = NULL;
+    for (size_t c = 0; c < sizeof(CHANNEL_COUNTERS) / sizeof(CHANNEL_COUNTERS[0]); c++)
+    {
+        MetricsText_Family(text, CHANNEL_COUNTERS[c].name, "counter", CHANNEL_COUNTERS[c].help);
+        vec_foreach(&me->config.channels, ch, i)
+        {
+            if (Station_IsMetricsChannel(me, ch))
+            {
+                snprintf(labels, sizeof(labels), "channel=\"%d\"", ch->id);
+                MetricsText_Sample(text, CHANNEL_COUNTERS[c].name, labels,
+                                   Metric_Get((MetricCounter *)((uint8_t *)&ch->metrics + CHANNEL_COUNTERS[c].offset)));
+            }
+        }
+    }
+    MetricsText_Family(text, "sl651_decode_errors_total", "counter", "Invalid frames by error code.");
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (Station_IsMetricsChannel(me, ch))
+        {
+            for (int code = 0; code < METRIC_MAX_ERROR_CODES; code++)
+            {
+                uint64_t count = Metric_Get(&ch->metrics.decodeErrors[code]);
+                if (count > 0)
+                {
+                    snprintf(labels, sizeof(labels), "channel=\"%d\",code=\"%d\"", ch->id, code);
+                    MetricsText_Sample(text, "sl651_decode_errors_total", labels, count);
+                }
+            }
+        }
+    }
+    MetricsText_Family(text, "sl651_connected", "gauge", "Whether the channel is connected.");
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (Station_IsMetricsChannel(me, ch))
+        {
+            snprintf(labels, sizeof(labels), "channel=\"%d\"", ch->id);
+            MetricsText_Sample(text, "sl651_connected", labels, ch->isConnected ? 1 : 0);
+        }
+    }
+    MetricsText_Family(text, "sl651_out_queue_bytes", "gauge", "Bytes waiting in the channel output queue.");
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (Station_IsMetricsChannel(me, ch))
+        {
+            snprintf(labels, sizeof(labels), "channel=\"%d\"", ch->id);
+            MetricsText_Sample(text, "sl651_out_queue_bytes", labels, __atomic_load_n(&ch->outBytes, __ATOMIC_RELAXED));
+        }
+    }
+    MetricsText_Family(text, "sl651_packets_queued", "gauge", "Packets waiting in the channel send ring.");
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (Station_IsMetricsChannel(me, ch))
+        {
+            snprintf(labels, sizeof(labels), "channel=\"%d\"", ch->id);
+            MetricsText_Sample(text, "sl651_packets_queued", labels, Ring_Size(&ch->sendRing));
+        }
+    }
+    pthread_mutex_lock(&me->sendMutex);
+    size_t files = me->files.length;
+    pthread_mutex_unlock(&me->sendMutex);
+    MetricsText_Family(text, "sl651_file_pkgs_queued", "gauge", "Files submitted by Station_AsyncSendFilePkg and not yet sent.");
+    MetricsText_Sample(text, "sl651_file_pkgs_queued", NULL, files);
+    if (me->outbox != NULL)
+    {
+        MetricsText_Family(text, "sl651_outbox_files", "gauge", "Files waiting in filesDir.");
+        MetricsText_Sample(text, "sl651_outbox_files", NULL, Outbox_Size(me->outbox));
+    }
+    MetricsText_Family(text, "sl651_handler_latency_seconds", "histogram", "Request handler latency by function code.");
+    for (int code = 0; code < METRIC_MAX_FUNC_CODES; code++)
+    {
+        MetricHistogram *h = __atomic_load_n(&me->metrics.handlerLatency[code], __ATOMIC_ACQUIRE);
+        if (h != NULL)
+        {
+            snprintf(labels, sizeof(labels), "func=\"%02X\"", code);
+            MetricsText_Histogram(text, "sl651_handler_latency_seconds", labels, h);
+        }
+    }
 }
 
-bool FilePkg_ShouldSendByChannel(FilePkg *const me, Channel *const ch)
+static void Station_OpenMetrics(Station *const me)
 {
-    assert(me);
-    assert(ch);
-    return FilePkg_ShouldSend(me, ch->id);
+    Config *config = &me->config;
+    if (!config->metricsEnabled)
+    {
+        return;
+    }
+    MetricsServer *server = NewInstance(MetricsServer);
+    if (!MetricsServer_Open(server, config->metricsSocket, config->metricsPort, &Station_RenderMetrics, me))
+    {
+        printf("metrics disabled, listen on %s:%d failed.\r\n",
+               config->metricsSocket != NULL ? config->metricsSocket : "127.0.0.1", config->metricsPort);
+        DelInstance(server);
+        return;
+    }
+    me->metricsServer = server;
 }
-// FilePkg END
+// Metrics END
 
-void Station_ctor(Station *const me)
+/**
+ * 所有 channel 分布到 N 个共享的 loop 上，每个 loop 一个线程
+ */
+static bool Station_StartShared(Station *const me)
 {
-    assert(me);
-    // me->reactor = NULL;
-    Config_ctor(&me->config, me);
-    // pthread_mutexattr_t mutexAttr;
-    // pthread_mutexattr_init(&mutexAttr);
-    // pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
-    pthread_mutex_init(&me->cleanUpMutex, NULL);
-    // pthread_mutexattr_t sendMutexAttr;
-    // pthread_mutexattr_init(&sendMutexAttr);
-    // pthread_mutexattr_settype(&sendMutexAttr, PTHREAD_MUTEX_RECURSIVE);
-    pthread_mutex_init(&me->sendMutex, NULL);
-    vec_init(&me->packets);
-    vec_reserve(&me->packets, 20);
+    ReactorPool_ctor(&me->reactors, me->config.reactors, me->config.pinReactors);
+    int i;
+    for (i = 0; i < me->reactors.count; i++)
+    {
+        if (me->reactors.shards[i].loop != NULL)
+        {
+            Config_AttachLoop(&me->config, me->reactors.shards[i].loop);
+        }
+    }
+    Channel *ch = NULL;
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (Config_IsChannelEnable(&me->config, ch) &&
+            (ch->type == CHANNEL_IPV4 || ch->type == CHANNEL_DOMAIN))
+        {
+            ReactorShard *shard = ReactorPool_LeastLoaded(&me->reactors);
+            if (shard == NULL)
+            {
+                printf("ch[%2d] start failed, no reactor.\r\n", ch->id);
+                continue;
+            }
+            ch->station = me;
+            ch->centerAddr = Config_CenterAddrOfChannel(&me->config, ch);
+            ch->shard = shard;
+            shard->load++;
+            ch->vptr->start(ch); // 只安装 watcher，不阻塞
+            printf("ch[%2d] run on reactor[%2d].\r\n", ch->id, shard->id);
+        }
+    }
+    if (!ReactorPool_Start(&me->reactors))
+    {
+        printf("some reactors start failed.\r\n");
+    }
+    ReactorPool_Join(&me->reactors);
+    for (i = 0; i < me->reactors.count; i++)
+    {
+        if (me->reactors.shards[i].loop != NULL)
+        {
+            Config_DetachLoop(&me->config, me->reactors.shards[i].loop);
+        }
+    }
+    // loop 都已退出，在当前线程里安全地关闭 channel
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (ch != NULL && ch->shard != NULL)
+        {
+            ch->vptr->stop(ch);
+        }
+    }
+    return true;
 }
 
 bool Station_StartBy(Station *const me, char const *workDir)
@@ -2578,24 +4700,54 @@ bool Station_StartBy(Station *const me, char const *workDir)
     assert(workDir);
     int len = strlen(workDir) + 1;
     assert(len > 0);
-    assert(me->config.centerAddrs == NULL); // assert all config is empty
+    assert(Config_Current(&me->config) == NULL); // assert all config is empty
     int fileLen = len + SL651_DEFAULT_CONFIG_FILE_NAME_LEN + 1;
     char *file = (char *)malloc(fileLen); // config.json
     memset(file, '\0', fileLen);
     snprintf(file, fileLen, "%s/config.json", workDir);
     me->config.workDir = strdup(workDir);
-    cJSON *json = cJSON_FromFile(file);
-    if (json != NULL &&
-        Config_InitFromJSON(&me->config, json) &&
-        Config_IsValid(&me->config))
+    char hostsFile[300] = {0};
+    snprintf(hostsFile, 300, "%s/" SL651_HOSTS_FILE, workDir);
+    if (access(hostsFile, R_OK) == 0)
+    {
+        Resolver_SetHostsFile(&me->resolver, hostsFile);
+    }
+    char cacheFile[300] = {0};
+    snprintf(cacheFile, 300, "%s/" SL651_CONFIG_CACHE_FILE, workDir);
+    // 在解析之前计算，保证缓存中的内容不比记录的 hash 新
+    ConfigCacheSource source;
+    bool hasSource = ConfigCacheSource_Stat(&source, file);
+    bool loaded = hasSource && Config_InitFromCache(&me->config, cacheFile, &source);
+    if (loaded)
+    {
+        printf("load config from %s.\r\n", cacheFile);
+    }
+    else
+    {
+        cJSON *json = cJSON_FromFile(file);
+        loaded = json != NULL && Config_InitFromJSON(&me->config, json);
+        if (loaded && hasSource && !Config_SaveCache(&me->config, cacheFile, &source))
+        {
+            printf("save config cache failed.\r\n");
+        }
+    }
+    if (loaded && Config_IsValid(&me->config))
     {
-        me->config.configInJSON = json;
         me->config.configFile = file;
+        Config_Watch(&me->config);
         // me->reactor = ev_loop_new(0);
         // if (me->reactor != NULL)
         // {
+        Station_OpenLog(me);
+        Station_OpenWal(me);
+        Station_OpenOutbox(me);
+        Station_OpenMetrics(me);
         int i;
         Channel *ch = NULL;
+        if (me->config.reactors > 0)
+        {
+            return Station_StartShared(me);
+        }
         vec_foreach(&me->config.channels, ch, i)
         {
             if (Config_IsChannelEnable(&me->config, ch) &&
@@ -2657,6 +4809,12 @@ bool Station_Start(Station *const me)
 bool Station_Stop(Station *const me)
 {
     assert(me);
+    if (ReactorPool_IsEnabled(&me->reactors))
+    {
+        // 共享的 loop 不能跨线程操作 watcher，让 loop 自己退出，channel 在 Station_StartBy 中关闭
+        ReactorPool_Stop(&me->reactors);
+        return true;
+    }
     int64_t i = 0;
     Channel *ch;
     vec_foreach(&me->config.channels, ch, i)
@@ -2711,6 +4869,10 @@ bool Station_IsFileSentByAllChannel(Station *const me, tinydir_file *const file,
     {
         remove(file->path);
     }
+    if (me->outbox != NULL)
+    {
+        Outbox_Remove(me->outbox, file->name);
+    }
     vec_foreach(&me->config.channels, ch, i)
     {
         if (ch != NULL &&
@@ -2724,135 +4886,247 @@ bool Station_IsFileSentByAllChannel(Station *const me, tinydir_file *const file,
     return true;
 }
 
-bool Station_AsyncSend(Station *const me, cJSON *const data)
+/**
+ * 编码一次，各 channel 发送前只修改中心站地址/流水号/发报时间
+ */
+static ByteBuffer *Station_EncodePackage(Station *const me, Package *const pkg)
 {
-    assert(me);
-    Package *pkg = NULL;
-    if (data == NULL || (pkg = createPackage(data)) == NULL)
+    Rcu_ReadLock(&me->config.snapshots); // 调用方不是 loop 线程
+    ConfigSnapshot const *config = Config_Current(&me->config);
+    pkg->head.centerAddr = 0; // patch by channel
+    pkg->head.stationAddr = *config->stationAddr;
+    pkg->head.password = *config->password;
+    if (pkg->head.direction == Up)
+    {
+        UplinkMessage *upMsg = (UplinkMessage *)pkg;
+        upMsg->messageHead.seq = 0; // patch by channel
+        upMsg->messageHead.stationAddrElement.stationAddr = *config->stationAddr;
+        upMsg->messageHead.stationCategory = config->stationCategory;
+    }
+    Rcu_ReadUnlock(&me->config.snapshots);
+    ByteBuffer *buff = pkg->vptr->encode(pkg);
+    if (buff != NULL)
+    {
+        BB_Flip(buff);
+    }
+    return buff;
+}
+
+/**
+ * 写入 wal 后通知已连接的 channel，未连接的 channel 连接后从 cursor 继续
+ */
+static bool Station_AppendToWal(Station *const me, ByteBuffer *frame)
+{
+    if (frame == NULL)
+    {
+        return false;
+    }
+    bool res = Wal_Append(me->wal, frame->buff, BB_Limit(frame));
+    BB_dtor(frame);
+    DelInstance(frame);
+    if (!res)
+    {
+        EventLog_Emit(&me->log, STATION_EVENT_WAL_FULL, EVENT_NO_CHANNEL, 0);
+        return false;
+    }
+    int64_t i = 0;
+    Channel *ch;
+    vec_foreach(&me->config.channels, ch, i)
+    {
+        if (ch != NULL &&
+            ch->id < WAL_MAX_CURSORS &&
+            Config_IsChannelEnable(&me->config, ch) &&
+            Channel_IsConnected(ch))
+        {
+            ch->vptr->notifyData(ch);
+        }
+    }
+    return true;
+}
+
+/**
+ * 投递已编码的报文，接管 frame
+ */
+static bool Station_Enqueue(Station *const me, ByteBuffer *frame, bool uplink, uint16_t seq)
+{
+    if (me->wal != NULL)
+    {
+        return Station_AppendToWal(me, frame);
+    }
+    if (frame == NULL)
     {
         return false;
     }
     Packet *packet = NewInstance(Packet);
-    Packet_ctor(packet, pkg);
-    pthread_mutex_lock(&me->sendMutex);
+    Packet_ctor(packet, frame);
+    packet->uplink = uplink;
+    packet->seq = seq;
+    // 先确定所有目标 channel 再投递，避免投递过程中被提前释放
+    Channel *targets[CHANNEL_ID_SLAVE_04 + 1] = {0};
+    int targetCount = 0;
     int64_t i = 0;
     Channel *ch;
     vec_foreach(&me->config.channels, ch, i)
     {
         if (ch != NULL &&
             ch->id != CHANNEL_ID_FIXED &&
+            targetCount < CHANNEL_ID_SLAVE_04 + 1 &&
             Config_IsChannelEnable(&me->config, ch) &&
-            Channel_IsConnected(ch) && // 尽可能不导致数据无法清理 isConnected是不安全的
-            ch->vptr->notifyData(ch))
+            Channel_IsConnected(ch)) // 尽可能不导致数据无法清理 isConnected是不安全的
         {
+            targets[targetCount++] = ch;
             Packet_MarkingByChannel(packet, ch);
         }
     }
-    if (packet->channelSentMask != 0)
-    {
-        vec_push(&me->packets, packet);
-    }
-    else
+    if (targetCount == 0)
     {
         Packet_dtor(packet);
         DelInstance(packet);
+        return true;
     }
-    pthread_mutex_unlock(&me->sendMutex);
-    return true;
+    int accepted = 0;
+    for (i = 0; i < targetCount; i++)
+    {
+        ch = targets[i];
+        if (Ring_Push(&ch->sendRing, packet))
+        {
+            accepted++;
+            ch->vptr->notifyData(ch);
+        }
+        else
+        {
+            EventLog_Emit(&me->log, STATION_EVENT_SEND_RING_FULL, ch->id, 0);
+            Packet_Release(packet, ch->id); // packet 可能在此之后被释放，不能再访问
+        }
+    }
+    return accepted > 0; // 所有 channel 都积压时通知调用方稍后重试
 }
 
-/**
- *  DON NOT CALL THIS DIRECTLY
- */
-static void Station_PacketSendResult(Station *const me, Packet *packet, size_t i)
+bool Station_AsyncSendPackage(Station *const me, Package *const pkg)
 {
     assert(me);
-    assert(packet);
-    vec_splice(&me->packets, i, 1);
-    Packet_dtor(packet);
-    DelInstance(packet);
+    assert(pkg);
+    ByteBuffer *frame = Station_EncodePackage(me, pkg);
+    bool uplink = pkg->head.direction == Up;
+    uint16_t seq = uplink ? 0 : ((DownlinkMessage *)pkg)->messageHead.seq;
+    return Station_Enqueue(me, frame, uplink, seq);
 }
 
-void Station_SendPacketsToChannel(Station *const me, Channel *const ch)
+bool Station_AsyncSend(Station *const me, cJSON *const data)
 {
     assert(me);
-    pthread_mutex_lock(&me->sendMutex);
-    int64_t i = 0;
-    Packet *packet;
-    vec_foreach(&me->packets, packet, i)
+    Package *pkg = NULL;
+    if (data == NULL || (pkg = createPackage(data)) == NULL)
     {
-        if (packet == NULL)
+        return false;
+    }
+    bool res = Station_AsyncSendPackage(me, pkg);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    return res;
+}
+
+bool Station_AsyncSendReport(Station *const me, ReportTemplate *const tpl)
+{
+    assert(me);
+    assert(tpl);
+    if (tpl->frame.buff == NULL)
+    {
+        return false;
+    }
+    Rcu_ReadLock(&me->config.snapshots); // 调用方不是 loop 线程
+    ConfigSnapshot const *config = Config_Current(&me->config);
+    ReportTemplate_SetStation(tpl, config->stationAddr, *config->password, config->stationCategory);
+    Rcu_ReadUnlock(&me->config.snapshots);
+    // 中心站地址/流水号/发报时间/CRC 由 channel 修改，复制一份投递
+    ByteBuffer *frame = NewInstance(ByteBuffer);
+    BB_ctor_copy(frame, tpl->frame.buff, BB_Limit(&tpl->frame));
+    BB_Flip(frame);
+    return Station_Enqueue(me, frame, true, 0);
+}
+
+bool Station_AsyncSendSpec(Station *const me, ReportSpec const *const spec)
+{
+    assert(me);
+    assert(spec);
+    Rcu_ReadLock(&me->config.snapshots); // 调用方不是 loop 线程
+    ConfigSnapshot const *config = Config_Current(&me->config);
+    RemoteStationAddr stationAddr = *config->stationAddr;
+    uint16_t password = *config->password;
+    uint8_t category = config->stationCategory;
+    Rcu_ReadUnlock(&me->config.snapshots);
+    return Station_Enqueue(me, ReportSpec_Encode(spec, &stationAddr, password, category), true, 0);
+}
+
+/**
+ * 从 cursor 开始发送 wal 中的报文，失败时保留 cursor 等待下次连接
+ */
+static void Station_SendWalToChannel(Station *const me, Channel *const ch)
+{
+    if (ch->id >= WAL_MAX_CURSORS)
+    {
+        return;
+    }
+    uint8_t const *data = NULL;
+    uint32_t len = 0;
+    while (ch->isConnected &&
+           !Channel_IsOutputBlocked(ch) && // 积压过多时保留 cursor，低水位后继续
+           (len = Wal_Peek(me->wal, ch->id, &data)) > 0)
+    {
+        ByteBuffer buff;
+        BB_ctor_copy(&buff, (uint8_t *)data, len);
+        BB_Flip(&buff);
+        bool uplink = (data[PACKAGE_HEAD_STX_DIRECTION_INDEX] >> PACKAGE_HEAD_STX_DIRECTION_INDEX_MASK_BIT) == Up;
+        uint16_t seq = 0;
+        if (!uplink)
         {
-            vec_splice(&me->packets, i, 1);
-            i--;
-            continue;
+            BB_BE_PeekUInt16At(&buff, PACKAGE_HEAD_STX_LEN, &seq);
         }
-        else
+        DateTime now;
+        DateTime_now(&now);
+        bool patched = Package_PatchEncoded(&buff, ch->centerAddr, uplink ? Channel_NextSeq(ch) : seq, &now);
+        bool res = patched && ch->vptr->send(ch, &buff);
+        BB_dtor(&buff);
+        if (!res && patched)
         {
-            if (packet->pkg != NULL && Packet_ShouldSendByChannel(packet, ch))
-            {
-                Package *pkg = packet->pkg;
-                if (pkg->head.direction == Up)
-                {
-                    UplinkMessage *msg = (UplinkMessage *)pkg;
-                    msg->messageHead.seq = Channel_NextSeq(ch);
-                }
-                Channel_FillPackageHead(ch, pkg); // 每个channel不同
-                ByteBuffer *buff = pkg->vptr->encode(pkg);
-                if (buff == NULL)
-                {
-                    packet->result = false;
-                    if (me->config.fastFailed)
-                    {
-                        Station_PacketSendResult(me, packet, i);
-                        i--;
-                        continue;
-                    }
-                    else
-                    {
-                        Packet_UnmarkByChannel(packet, ch);
-                        continue;
-                    }
-                }
-                BB_Flip(buff);
-                bool res = ch->vptr->send(ch, buff);
-                BB_dtor(buff);
-                DelInstance(buff);
-                packet->result = packet->result && res; // 记录结果
-                Packet_UnmarkByChannel(packet, ch);
-                if (!res && me->config.fastFailed)
-                {
-                    Station_PacketSendResult(me, packet, i);
-                    i--;
-                    continue;
-                }
-            }
-            if (Packet_IsSent(packet) || (me->config.fastFailed && !packet->result))
-            {
-                Station_PacketSendResult(me, packet, i);
-                i--;
-            }
+            break;
         }
+        Wal_Advance(me->wal, ch->id); // 无效的记录直接跳过
     }
-    // 压缩掉
-    // vec_compact(&me->packets);
-    pthread_mutex_unlock(&me->sendMutex);
 }
 
-void Station_ClearPackets(Station *const me)
+void Station_SendPacketsToChannel(Station *const me, Channel *const ch)
 {
     assert(me);
-    int64_t i = 0;
+    Channel_Config(ch); // 中心站地址可能已被修改
+    if (me->wal != NULL)
+    {
+        Station_SendWalToChannel(me, ch);
+        return;
+    }
     Packet *packet;
-    vec_foreach(&me->packets, packet, i)
+    // 积压过多时留在 sendRing 中，低水位后继续
+    while (!Channel_IsOutputBlocked(ch) && (packet = (Packet *)Ring_Pop(&ch->sendRing)) != NULL)
     {
-        if (packet != NULL)
+        // fastFailed: 已经有 channel 失败，其他 channel 不再发送
+        if (!me->config.fastFailed || __atomic_load_n(&packet->result, __ATOMIC_ACQUIRE))
         {
-            Packet_dtor(packet);
-            DelInstance(packet);
+            ByteBuffer buff;
+            BB_ctor_copy(&buff, packet->frame->buff, BB_Limit(packet->frame));
+            BB_Flip(&buff);
+            DateTime now;
+            DateTime_now(&now);
+            uint16_t seq = packet->uplink ? Channel_NextSeq(ch) : packet->seq;
+            bool res = Package_PatchEncoded(&buff, ch->centerAddr, seq, &now) &&
+                       ch->vptr->send(ch, &buff);
+            BB_dtor(&buff);
+            if (!res)
+            {
+                __atomic_store_n(&packet->result, false, __ATOMIC_RELEASE);
+            }
         }
+        Packet_Release(packet, ch->id);
     }
-    vec_deinit(&me->packets);
 }
 
 bool Station_AsyncSendFilePkg(Station *const me, const char *file)
@@ -2928,8 +5202,13 @@ void Station_SendFilePkgsToChannel(Station *const me, Channel *const ch)
         {
             if (f->file != NULL && FilePkg_ShouldSendByChannel(f, ch))
             {
-                printf("ch[%2d] sending file[%s]\r\n", ch->id, f->file);
+                char const *name = Station_BaseName(f->file);
+                EventLog_EmitData(&me->log, STATION_EVENT_FILE_PKG_SENDING, ch->id, name, strlen(name), 0);
                 FilePkgSendStatus res = ch->vptr->sendFilePkg(ch, f);
+                if (res == FILE_SEND_PENDING || res == FILE_SEND_BUSY) // 发送完成后由 Station_MarkFilePkgSent 处理
+                {
+                    break;
+                }
                 FilePkg_UnmarkByChannel(f, ch);
                 if (res == FILE_SEND_FAIL && me->config.fastFailed)
                 {
@@ -2989,11 +5268,29 @@ void Station_ClearFilePkgs(Station *const me)
 void Station_dtor(Station *const me)
 {
     assert(me);
+    if (me->metricsServer != NULL) // 抓取时会访问 channel
+    {
+        MetricsServer_dtor(me->metricsServer);
+        DelInstance(me->metricsServer);
+    }
+    if (me->outbox != NULL) // 先停止 watcher 线程，回调会访问 channel
+    {
+        Outbox_dtor(me->outbox);
+        DelInstance(me->outbox);
+    }
     Config_dtor(&me->config);
+    ReactorPool_dtor(&me->reactors);
+    Resolver_dtor(&me->resolver); // channel 已释放
+    if (me->wal != NULL)
+    {
+        Wal_dtor(me->wal);
+        DelInstance(me->wal);
+    }
     pthread_mutex_destroy(&me->cleanUpMutex);
     pthread_mutex_destroy(&me->sendMutex);
-    Station_ClearPackets(me);
     Station_ClearFilePkgs(me);
+    StationMetrics_dtor(&me->metrics);
+    EventLog_dtor(&me->log); // 最后停止，输出剩余的记录
     // if (me->reactor)
     // {
     //     ev_loop_destroy(me->reactor);
@@ -0,0 +1,54 @@
+#include <assert.h>
+
+#include "token_bucket.h"
+
+void TokenBucket_ctor(TokenBucket *const me, double rate, double burst)
+{
+    assert(me);
+    me->rate = rate;
+    me->burst = burst < 1 ? 1 : burst;
+    me->tokens = me->burst;
+    me->last = -1;
+}
+
+static void TokenBucket_Refill(TokenBucket *const me, double now)
+{
+    if (me->last < 0 || now < me->last) // 第一次或者时钟回拨
+    {
+        me->last = now;
+        return;
+    }
+    me->tokens += (now - me->last) * me->rate;
+    if (me->tokens > me->burst)
+    {
+        me->tokens = me->burst;
+    }
+    me->last = now;
+}
+
+bool TokenBucket_Take(TokenBucket *const me, double now)
+{
+    assert(me);
+    if (me->rate <= 0)
+    {
+        return true;
+    }
+    TokenBucket_Refill(me, now);
+    if (me->tokens < 1)
+    {
+        return false;
+    }
+    me->tokens -= 1;
+    return true;
+}
+
+double TokenBucket_Delay(TokenBucket *const me, double now)
+{
+    assert(me);
+    if (me->rate <= 0)
+    {
+        return 0;
+    }
+    TokenBucket_Refill(me, now);
+    return me->tokens >= 1 ? 0 : (1 - me->tokens) / me->rate;
+}
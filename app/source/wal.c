@@ -0,0 +1,625 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "common/class.h"
+#include "bytebuffer/bytebuffer.h"
+#include "tinydir/tinydir.h"
+#include "wal.h"
+
+#ifndef _WIN32
+#define WAL_SEGMENT_SUFFIX ".wal"
+#define WAL_SEGMENT_NAME_LEN 20 // 16 hex + .wal
+#define WAL_CURSORS_FILE "cursors"
+#define WAL_CURSORS_MAGIC 0x651AC0DE
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t mask;
+    uint64_t lsn[WAL_MAX_CURSORS];
+} WalCursorsFile;
+
+// WalSegment
+static void WalSegment_FileName(char const *dir, uint64_t base, char *file, size_t size)
+{
+    snprintf(file, size, "%s/%016llx" WAL_SEGMENT_SUFFIX, dir, (unsigned long long)base);
+}
+
+static WalSegment *WalSegment_Open(char const *dir, uint64_t base, size_t size, bool create)
+{
+    char file[300] = {0};
+    WalSegment_FileName(dir, base, file, 300);
+    int fd = open(file, O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (create)
+    {
+        if (ftruncate(fd, size) != 0) // 新文件全零，零长度即为结束标记
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+    else
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return NULL;
+        }
+        size = st.st_size;
+    }
+    if (size < WAL_RECORD_HEAD_LEN)
+    {
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+    WalSegment *seg = NewInstance(WalSegment);
+    seg->base = base;
+    seg->addr = (uint8_t *)addr;
+    seg->size = size;
+    seg->fd = fd;
+    return seg;
+}
+
+static void WalSegment_Close(WalSegment *seg, char const *dir, bool remove)
+{
+    munmap(seg->addr, seg->size);
+    close(seg->fd);
+    if (remove)
+    {
+        char file[300] = {0};
+        WalSegment_FileName(dir, seg->base, file, 300);
+        unlink(file);
+    }
+    DelInstance(seg);
+}
+
+/**
+ * 找到最后一条完整的记录，之后的内容清零
+ */
+static size_t WalSegment_Recover(WalSegment *seg)
+{
+    size_t off = 0;
+    while (off + WAL_RECORD_HEAD_LEN <= seg->size)
+    {
+        WalRecordHead head;
+        memcpy(&head, seg->addr + off, WAL_RECORD_HEAD_LEN);
+        if (head.len == 0 ||
+            head.magic != WAL_RECORD_MAGIC ||
+            off + WAL_RECORD_HEAD_LEN + head.len > seg->size ||
+            CRC16_Update(CRC16_INIT_VALUE, seg->addr + off + WAL_RECORD_HEAD_LEN, head.len) != head.crc)
+        {
+            break;
+        }
+        off += WAL_RECORD_HEAD_LEN + head.len;
+    }
+    memset(seg->addr + off, 0, seg->size - off);
+    return off;
+}
+// WalSegment END
+
+// Wal
+static void Wal_LoadCursors(Wal *const me)
+{
+    char file[300] = {0};
+    snprintf(file, 300, "%s/" WAL_CURSORS_FILE, me->dir);
+    me->cursorsFd = open(file, O_RDWR | O_CREAT, 0644);
+    WalCursorsFile saved;
+    if (me->cursorsFd < 0 ||
+        pread(me->cursorsFd, &saved, sizeof(saved), 0) != sizeof(saved) ||
+        saved.magic != WAL_CURSORS_MAGIC)
+    {
+        return;
+    }
+    me->persistedMask = saved.mask;
+    for (int i = 0; i < WAL_MAX_CURSORS; i++)
+    {
+        if (saved.mask & (1 << i))
+        {
+            uint64_t lsn = saved.lsn[i];
+            lsn = lsn < me->firstLsn ? me->firstLsn : lsn;
+            lsn = lsn > me->writeLsn ? me->writeLsn : lsn;
+            me->cursors[i].lsn = lsn;
+            me->savedCursors[i] = saved.lsn[i];
+        }
+    }
+}
+
+/**
+ * 丢弃的 segment 在没有 cursor 缓存、也没有正在进行的落盘之后解除映射
+ * cursor 只在持有锁时切换 segment，离开之后不会再访问
+ * call with mutex locked
+ */
+static void Wal_ReleaseRetired(Wal *const me)
+{
+    if (me->syncing > 0) // msync 可能还在访问这些映射
+    {
+        return;
+    }
+    for (int r = me->retired.length - 1; r >= 0; r--)
+    {
+        WalSegment *seg = me->retired.data[r];
+        bool cached = false;
+        for (int i = 0; i < WAL_MAX_CURSORS && !cached; i++)
+        {
+            cached = me->cursors[i].segAddr == seg->addr;
+        }
+        if (!cached)
+        {
+            vec_splice(&me->retired, r, 1);
+            WalSegment_Close(seg, me->dir, false);
+        }
+    }
+}
+
+/**
+ * 删除 segment 文件，映射留到 Wal_ReleaseRetired 再解除
+ * call with mutex locked
+ */
+static void Wal_Retire(Wal *const me, WalSegment *seg)
+{
+    char file[300] = {0};
+    WalSegment_FileName(me->dir, seg->base, file, 300);
+    unlink(file);
+    vec_push(&me->retired, seg);
+}
+
+/**
+ * 写满时丢弃最老的 segment，不等待落后的 cursor
+ * 一个 channel 长时间连接不上时只丢弃它自己积压的记录，不影响其他 channel 写入
+ * call with mutex locked, segments.length >= 2
+ */
+static void Wal_DropOldest(Wal *const me)
+{
+    WalSegment *seg = vec_first(&me->segments);
+    vec_splice(&me->segments, 0, 1);
+    me->firstLsn = vec_first(&me->segments)->base;
+    printf("wal full, drop segment [%016llx], lagging channels skip to lsn [%llu]\r\n",
+           (unsigned long long)seg->base, (unsigned long long)me->firstLsn);
+    Wal_Retire(me, seg);
+    Wal_ReleaseRetired(me);
+}
+
+/**
+ * 可以删除的 segment: 所有 cursor 都已经读完并且已经落盘
+ * call with mutex locked
+ */
+static void Wal_Reclaim(Wal *const me)
+{
+    uint64_t bound = me->syncedLsn;
+    for (int i = 0; i < WAL_MAX_CURSORS; i++)
+    {
+        if (me->cursors[i].tracked)
+        {
+            uint64_t lsn = __atomic_load_n(&me->cursors[i].lsn, __ATOMIC_ACQUIRE);
+            bound = lsn < bound ? lsn : bound;
+        }
+    }
+    while (me->segments.length > 1)
+    {
+        WalSegment *seg = vec_first(&me->segments);
+        if (seg->base + seg->size > bound)
+        {
+            break;
+        }
+        vec_splice(&me->segments, 0, 1);
+        Wal_Retire(me, seg);
+        me->firstLsn = vec_first(&me->segments)->base;
+    }
+    Wal_ReleaseRetired(me);
+}
+
+/**
+ * call with mutex locked, 落盘期间释放锁，不阻塞写入
+ * 释放锁期间 Wal_Append 可能丢弃或回收 segment，由 syncing 推迟解除映射
+ */
+static void Wal_SyncLocked(Wal *const me)
+{
+    uint64_t from = me->syncedLsn;
+    uint64_t target = me->writeLsn;
+    size_t count = 0;
+    typedef struct
+    {
+        uint8_t *addr;
+        size_t len;
+    } Range;
+    Range *ranges = NULL;
+    if (target > from)
+    {
+        ranges = (Range *)malloc(sizeof(Range) * me->segments.length);
+        long page = sysconf(_SC_PAGESIZE);
+        int i;
+        WalSegment *seg;
+        vec_foreach(&me->segments, seg, i)
+        {
+            uint64_t end = seg->base + seg->size;
+            if (end <= from || seg->base >= target)
+            {
+                continue;
+            }
+            size_t start = from > seg->base ? from - seg->base : 0;
+            size_t stop = (target < end ? target : end) - seg->base;
+            start &= ~(size_t)(page - 1); // msync 要求页对齐
+            ranges[count].addr = seg->addr + start;
+            ranges[count].len = stop - start;
+            count++;
+        }
+    }
+    WalCursorsFile file;
+    memset(&file, 0, sizeof(file));
+    file.magic = WAL_CURSORS_MAGIC;
+    file.mask = me->persistedMask;
+    for (int i = 0; i < WAL_MAX_CURSORS; i++)
+    {
+        file.lsn[i] = __atomic_load_n(&me->cursors[i].lsn, __ATOMIC_ACQUIRE);
+        file.mask |= me->cursors[i].tracked ? (1 << i) : 0;
+    }
+    bool cursorsChanged = memcmp(file.lsn, me->savedCursors, sizeof(file.lsn)) != 0;
+    me->syncing++;
+    pthread_mutex_unlock(&me->mutex);
+    for (size_t i = 0; i < count; i++)
+    {
+        msync(ranges[i].addr, ranges[i].len, MS_SYNC);
+    }
+    if (ranges != NULL)
+    {
+        DelInstance(ranges);
+    }
+    if (cursorsChanged && me->cursorsFd >= 0 &&
+        pwrite(me->cursorsFd, &file, sizeof(file), 0) == sizeof(file))
+    {
+        fdatasync(me->cursorsFd);
+    }
+    pthread_mutex_lock(&me->mutex);
+    me->syncing--;
+    if (target > me->syncedLsn)
+    {
+        me->syncedLsn = target;
+    }
+    if (cursorsChanged)
+    {
+        memcpy(me->savedCursors, file.lsn, sizeof(file.lsn));
+    }
+    Wal_Reclaim(me);
+}
+
+/**
+ * group commit: 有写入时等待 syncInterval 再一起落盘
+ * 空闲时每秒检查一次 cursor 的变化
+ */
+static void *Wal_Flush(void *arg)
+{
+    Wal *me = (Wal *)arg;
+    pthread_mutex_lock(&me->mutex);
+    while (!me->stopping)
+    {
+        if (me->syncedLsn == me->writeLsn)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&me->cond, &me->mutex, &ts);
+        }
+        if (!me->stopping && me->syncedLsn != me->writeLsn && me->syncInterval > 0)
+        {
+            pthread_mutex_unlock(&me->mutex);
+            usleep(me->syncInterval * 1000);
+            pthread_mutex_lock(&me->mutex);
+        }
+        Wal_SyncLocked(me);
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return NULL;
+}
+
+bool Wal_Open(Wal *const me, char const *const dir, size_t segmentSize, uint32_t maxSegments, uint32_t syncInterval)
+{
+    assert(me);
+    assert(dir);
+    memset(me, 0, sizeof(Wal));
+    me->cursorsFd = -1;
+    if (segmentSize < WAL_MIN_SEGMENT_SIZE || segmentSize > WAL_MAX_SEGMENT_SIZE)
+    {
+        segmentSize = WAL_DEFAULT_SEGMENT_SIZE;
+    }
+    me->segmentSize = segmentSize;
+    me->maxSegments = maxSegments < 2 ? WAL_DEFAULT_MAX_SEGMENTS : maxSegments;
+    me->syncInterval = syncInterval;
+    me->dir = strdup(dir);
+    mkdir(dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    vec_init(&me->segments);
+    vec_init(&me->retired);
+    // load segments, 文件名为定长 HEX，按名字排序即按 LSN 排序
+    tinydir_dir d;
+    if (tinydir_open_sorted(&d, dir) == 0)
+    {
+        for (size_t i = 0; i < d.n_files; i++)
+        {
+            tinydir_file file;
+            tinydir_readfile_n(&d, &file, i);
+            if (file.is_dir ||
+                strlen(file.name) != WAL_SEGMENT_NAME_LEN ||
+                strcmp(file.name + WAL_SEGMENT_NAME_LEN - strlen(WAL_SEGMENT_SUFFIX), WAL_SEGMENT_SUFFIX) != 0)
+            {
+                continue;
+            }
+            WalSegment *seg = WalSegment_Open(dir, strtoull(file.name, NULL, 16), 0, false);
+            if (seg != NULL)
+            {
+                vec_push(&me->segments, seg);
+            }
+        }
+        tinydir_close(&d);
+    }
+    if (me->segments.length == 0)
+    {
+        WalSegment *seg = WalSegment_Open(dir, 0, me->segmentSize, true);
+        if (seg == NULL)
+        {
+            printf("wal open %s failed, errno:[%d]\r\n", dir, errno);
+            vec_deinit(&me->segments);
+            vec_deinit(&me->retired);
+            DelInstance(me->dir);
+            return false;
+        }
+        vec_push(&me->segments, seg);
+    }
+    WalSegment *last = vec_last(&me->segments);
+    me->firstLsn = vec_first(&me->segments)->base;
+    me->writeLsn = last->base + WalSegment_Recover(last);
+    me->syncedLsn = me->writeLsn;
+    for (int i = 0; i < WAL_MAX_CURSORS; i++)
+    {
+        me->cursors[i].lsn = me->firstLsn;
+    }
+    Wal_LoadCursors(me);
+    pthread_mutex_init(&me->mutex, NULL);
+    pthread_cond_init(&me->cond, NULL);
+    pthread_t *thread = NewInstance(pthread_t);
+    if (pthread_create(thread, NULL, &Wal_Flush, me) == 0)
+    {
+        me->flusher = thread;
+    }
+    else
+    {
+        DelInstance(thread); // 没有后台线程时，依赖 Wal_Sync 和析构落盘
+    }
+    printf("wal open %s, segments:[%d] lsn:[%llu ~ %llu]\r\n", dir, me->segments.length,
+           (unsigned long long)me->firstLsn, (unsigned long long)me->writeLsn);
+    return true;
+}
+
+void Wal_dtor(Wal *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    me->stopping = true;
+    pthread_cond_signal(&me->cond);
+    pthread_mutex_unlock(&me->mutex);
+    if (me->flusher != NULL)
+    {
+        pthread_join(*me->flusher, NULL);
+        DelInstance(me->flusher);
+    }
+    pthread_mutex_lock(&me->mutex);
+    Wal_SyncLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+    int i;
+    WalSegment *seg;
+    vec_foreach(&me->segments, seg, i)
+    {
+        WalSegment_Close(seg, me->dir, false);
+    }
+    vec_deinit(&me->segments);
+    vec_foreach(&me->retired, seg, i)
+    {
+        WalSegment_Close(seg, me->dir, false);
+    }
+    vec_deinit(&me->retired);
+    if (me->cursorsFd >= 0)
+    {
+        close(me->cursorsFd);
+    }
+    pthread_mutex_destroy(&me->mutex);
+    pthread_cond_destroy(&me->cond);
+    if (me->dir != NULL)
+    {
+        DelInstance(me->dir);
+    }
+}
+
+bool Wal_Append(Wal *const me, uint8_t const *const data, uint32_t len)
+{
+    assert(me);
+    assert(data);
+    if (len == 0 || len + WAL_RECORD_HEAD_LEN > me->segmentSize)
+    {
+        return false;
+    }
+    WalRecordHead head = {len, CRC16_Update(CRC16_INIT_VALUE, data, len), WAL_RECORD_MAGIC};
+    pthread_mutex_lock(&me->mutex);
+    WalSegment *seg = vec_last(&me->segments);
+    size_t off = me->writeLsn - seg->base;
+    if (off + WAL_RECORD_HEAD_LEN + len > seg->size)
+    {
+        // 剩余空间保持为零，读取时据此跳到下一个 segment
+        Wal_Reclaim(me);
+        if ((uint32_t)me->segments.length >= me->maxSegments)
+        {
+            Wal_DropOldest(me);
+        }
+        WalSegment *next = WalSegment_Open(me->dir, seg->base + seg->size, me->segmentSize, true);
+        if (next == NULL)
+        {
+            pthread_mutex_unlock(&me->mutex);
+            return false;
+        }
+        vec_push(&me->segments, next);
+        seg = next;
+        off = 0;
+    }
+    memcpy(seg->addr + off, &head, WAL_RECORD_HEAD_LEN);
+    memcpy(seg->addr + off + WAL_RECORD_HEAD_LEN, data, len);
+    __atomic_store_n(&me->writeLsn, seg->base + off + WAL_RECORD_HEAD_LEN + len, __ATOMIC_RELEASE);
+    pthread_cond_signal(&me->cond);
+    pthread_mutex_unlock(&me->mutex);
+    return true;
+}
+
+void Wal_Track(Wal *const me, uint8_t id)
+{
+    assert(me);
+    assert(id < WAL_MAX_CURSORS);
+    pthread_mutex_lock(&me->mutex);
+    me->cursors[id].tracked = true;
+    if (!(me->persistedMask & (1 << id)))
+    {
+        me->cursors[id].lsn = me->firstLsn;
+    }
+    pthread_mutex_unlock(&me->mutex);
+}
+
+static bool Wal_LocateCursor(Wal *const me, WalCursor *const cur)
+{
+    bool found = false;
+    pthread_mutex_lock(&me->mutex);
+    if (cur->lsn < me->firstLsn)
+    {
+        __atomic_store_n(&cur->lsn, me->firstLsn, __ATOMIC_RELEASE);
+    }
+    int i;
+    WalSegment *seg;
+    vec_foreach(&me->segments, seg, i)
+    {
+        if (seg->base + seg->size > cur->lsn)
+        {
+            if (seg->base > cur->lsn) // 缺失的 segment
+            {
+                __atomic_store_n(&cur->lsn, seg->base, __ATOMIC_RELEASE);
+            }
+            cur->segBase = seg->base;
+            cur->segSize = seg->size;
+            cur->segAddr = seg->addr;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&me->mutex);
+    return found;
+}
+
+uint32_t Wal_Peek(Wal *const me, uint8_t id, uint8_t const **data)
+{
+    assert(me);
+    assert(id < WAL_MAX_CURSORS);
+    WalCursor *cur = &me->cursors[id];
+    cur->peekLen = 0;
+    if (!cur->tracked)
+    {
+        return 0;
+    }
+    for (;;)
+    {
+        uint64_t writeLsn = __atomic_load_n(&me->writeLsn, __ATOMIC_ACQUIRE);
+        if (cur->lsn >= writeLsn)
+        {
+            return 0;
+        }
+        if (cur->segAddr == NULL || cur->lsn < cur->segBase || cur->lsn >= cur->segBase + cur->segSize)
+        {
+            if (!Wal_LocateCursor(me, cur))
+            {
+                return 0;
+            }
+            continue;
+        }
+        size_t off = cur->lsn - cur->segBase;
+        WalRecordHead head = {0, 0, 0};
+        if (off + WAL_RECORD_HEAD_LEN <= cur->segSize)
+        {
+            memcpy(&head, cur->segAddr + off, WAL_RECORD_HEAD_LEN);
+        }
+        if (head.len == 0 || head.magic != WAL_RECORD_MAGIC || off + WAL_RECORD_HEAD_LEN + head.len > cur->segSize)
+        {
+            // segment 尾部剩余，写入已经切换到下一个 segment
+            __atomic_store_n(&cur->lsn, cur->segBase + cur->segSize, __ATOMIC_RELEASE);
+            continue;
+        }
+        cur->peekLen = head.len;
+        *data = cur->segAddr + off + WAL_RECORD_HEAD_LEN;
+        return head.len;
+    }
+}
+
+void Wal_Advance(Wal *const me, uint8_t id)
+{
+    assert(me);
+    assert(id < WAL_MAX_CURSORS);
+    WalCursor *cur = &me->cursors[id];
+    if (cur->peekLen == 0)
+    {
+        return;
+    }
+    __atomic_store_n(&cur->lsn, cur->lsn + WAL_RECORD_HEAD_LEN + cur->peekLen, __ATOMIC_RELEASE);
+    cur->peekLen = 0;
+}
+
+void Wal_Sync(Wal *const me)
+{
+    assert(me);
+    pthread_mutex_lock(&me->mutex);
+    Wal_SyncLocked(me);
+    pthread_mutex_unlock(&me->mutex);
+}
+// Wal END
+#else
+bool Wal_Open(Wal *const me, char const *const dir, size_t segmentSize, uint32_t maxSegments, uint32_t syncInterval)
+{
+    return false; // 没有 mmap，station 使用内存中的 sendRing
+}
+
+void Wal_dtor(Wal *const me)
+{
+}
+
+bool Wal_Append(Wal *const me, uint8_t const *const data, uint32_t len)
+{
+    return false;
+}
+
+void Wal_Track(Wal *const me, uint8_t id)
+{
+}
+
+uint32_t Wal_Peek(Wal *const me, uint8_t id, uint8_t const **data)
+{
+    return 0;
+}
+
+void Wal_Advance(Wal *const me, uint8_t id)
+{
+}
+
+void Wal_Sync(Wal *const me)
+{
+}
+#endif
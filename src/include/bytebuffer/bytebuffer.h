@@ -114,6 +114,11 @@ extern "C"
      * CRC16
      */
     uint8_t BB_CRC16(ByteBuffer *const me, uint16_t *crc16, uint32_t start, uint32_t size);
+    /**
+     * 增量计算 CRC16，首次传入 CRC16_INIT_VALUE，分段数据依次传入上一次的结果
+     */
+    uint16_t CRC16_Update(uint16_t crc16, const uint8_t *bin, uint32_t size);
+#define CRC16_INIT_VALUE 0xFFFF
 
     ByteBuffer *BB_GetByteBuffer(ByteBuffer *const me, uint32_t size);
     bool BB_CopyToByteBufferAt(ByteBuffer *const me, uint32_t start, uint32_t size, ByteBuffer *const dest);
@@ -165,4 +170,4 @@ extern "C"
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef H_RING
+#define H_RING
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RING_CACHE_LINE_SIZE 64
+
+    typedef struct
+    {
+        size_t seq;
+        void *data;
+    } RingCell;
+
+    /**
+     * 有界无锁队列，多生产者 / 单消费者
+     * 每个 cell 带序号，生产者 CAS 抢占 head，消费者独占 tail
+     * @see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+     */
+    typedef struct
+    {
+        RingCell *cells;
+        size_t mask;
+        uint8_t pad0[RING_CACHE_LINE_SIZE];
+        size_t head; // producers
+        uint8_t pad1[RING_CACHE_LINE_SIZE];
+        size_t tail; // consumer
+        uint8_t pad2[RING_CACHE_LINE_SIZE];
+    } Ring;
+
+    /**
+     * @param capacity 向上取整为 2 的幂
+     */
+    void Ring_ctor(Ring *const me, size_t capacity);
+    void Ring_dtor(Ring *const me);
+    // for any thread, false when full
+    bool Ring_Push(Ring *const me, void *const data);
+    // for the consumer thread only, NULL when empty
+    void *Ring_Pop(Ring *const me);
+    // 近似值，仅用于统计
+    size_t Ring_Size(Ring *const me);
+#define Ring_Capacity(ptr_) ((ptr_)->cells == NULL ? 0 : (ptr_)->mask + 1)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
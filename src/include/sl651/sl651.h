@@ -605,6 +605,17 @@ extern "C"
     bool Package_DecodeTail(Package *const me, ByteBuffer *const byteBuff);
     size_t Package_HeadSize(Package const *const me);
     size_t Package_TailSize(Package const *const me);
+    /**
+     * 在已编码(flip 后)的报文上原地修改中心站地址、流水号、发报时间，并重新计算 CRC
+     * 同一个报文发往多个中心站时只需编码一次
+     * @param sendTime NULL 时不修改
+     */
+    bool Package_PatchEncoded(ByteBuffer *const byteBuff, uint8_t centerAddr, uint16_t seq, DateTime const *const sendTime);
+    /**
+     * 修改已编码的 SYN 报文头(PACKAGE_HEAD_SYN_LEN 字节)中的正文长度、包总数和包序号
+     * 多包发送时所有包复用同一个报文头模板，CRC 由调用者计算
+     */
+    bool Package_PatchSynHead(uint8_t *const head, uint16_t len, uint16_t count, uint16_t seq);
     // an empty desctrutor implements
     static inline void Package_dtor(Package *const me)
     {
@@ -893,4 +904,4 @@ extern "C"
 #ifdef __cplusplus
 }
 #endif
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -249,22 +249,27 @@ void BB_Expand(ByteBuffer *const me, uint32_t size)
 }
 
 #define CRC_POLY_VALUE 0xA001
-static void CRC16(const uint8_t *bin, uint16_t *crc16, uint32_t size)
+uint16_t CRC16_Update(uint16_t crc16, const uint8_t *bin, uint32_t size)
 {
-    *crc16 = 0xFFFF;
     for (uint32_t i = 0; i < size; i++)
     {
-        *crc16 ^= bin[i];
+        crc16 ^= bin[i];
         for (uint8_t j = 0; j < 8; j++)
         {
-            uint8_t b = *crc16 & 0x01;
-            *crc16 >>= 1;
+            uint8_t b = crc16 & 0x01;
+            crc16 >>= 1;
             if (b == 1)
             {
-                *crc16 ^= CRC_POLY_VALUE;
+                crc16 ^= CRC_POLY_VALUE;
             }
         }
     }
+    return crc16;
+}
+
+static void CRC16(const uint8_t *bin, uint16_t *crc16, uint32_t size)
+{
+    *crc16 = CRC16_Update(CRC16_INIT_VALUE, bin, size);
 }
 
 uint8_t BB_CRC16(ByteBuffer *const me, uint16_t *crc16, uint32_t start, uint32_t size)
@@ -746,4 +751,4 @@ uint8_t BB_BCDPutUInt8(ByteBuffer *const me, uint8_t val)
     }
     me->buff[me->position++] = ((val / 10) << 4) + (val % 10);
     return 1;
-}
\ No newline at end of file
+}
\ No newline at end of file
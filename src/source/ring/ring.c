@@ -0,0 +1,102 @@
+#include <assert.h>
+#include "common/class.h"
+
+#include "ring/ring.h"
+
+void Ring_ctor(Ring *const me, size_t capacity)
+{
+    assert(me);
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    me->cells = (RingCell *)malloc(sizeof(RingCell) * size);
+    me->mask = size - 1;
+    me->head = 0;
+    me->tail = 0;
+    if (me->cells == NULL)
+    {
+        me->mask = 0;
+        return;
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        me->cells[i].seq = i;
+        me->cells[i].data = NULL;
+    }
+}
+
+void Ring_dtor(Ring *const me)
+{
+    assert(me);
+    if (me->cells != NULL)
+    {
+        DelInstance(me->cells);
+    }
+    me->mask = 0;
+}
+
+bool Ring_Push(Ring *const me, void *const data)
+{
+    assert(me);
+    if (me->cells == NULL)
+    {
+        return false;
+    }
+    RingCell *cell;
+    size_t pos = __atomic_load_n(&me->head, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        cell = &me->cells[pos & me->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&me->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (dif < 0) // full
+        {
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n(&me->head, __ATOMIC_RELAXED);
+        }
+    }
+    cell->data = data;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void *Ring_Pop(Ring *const me)
+{
+    assert(me);
+    if (me->cells == NULL)
+    {
+        return NULL;
+    }
+    size_t pos = me->tail;
+    RingCell *cell = &me->cells[pos & me->mask];
+    size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) // empty, or producer not finished yet
+    {
+        return NULL;
+    }
+    void *data = cell->data;
+    cell->data = NULL;
+    __atomic_store_n(&cell->seq, pos + me->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&me->tail, pos + 1, __ATOMIC_RELAXED);
+    return data;
+}
+
+size_t Ring_Size(Ring *const me)
+{
+    assert(me);
+    size_t head = __atomic_load_n(&me->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&me->tail, __ATOMIC_RELAXED);
+    return head > tail ? head - tail : 0;
+}
@@ -497,6 +497,84 @@ size_t Package_TailSize(Package const *const me)
     assert(me);
     return PACKAGE_TAIL_LEN;
 }
+
+bool Package_PatchEncoded(ByteBuffer *const byteBuff, uint8_t centerAddr, uint16_t seq, DateTime const *const sendTime)
+{
+    assert(byteBuff);
+    assert(byteBuff->buff);
+    uint32_t limit = BB_Limit(byteBuff);
+    uint8_t *frame = byteBuff->buff;
+    if (limit < PACKAGE_WRAPPER_LEN)
+    {
+        return set_error_indicate(SL651_ERROR_INSUFFICIENT_PACKAGE_LEN);
+    }
+    if (((frame[0] << 8) | frame[1]) != SOH_BINARY)
+    {
+        return set_error_indicate(SL651_ERROR_INVALID_SOH);
+    }
+    // 中心站地址，上行在遥测站地址前，下行在后
+    switch (frame[PACKAGE_HEAD_STX_DIRECTION_INDEX] >> PACKAGE_HEAD_STX_DIRECTION_INDEX_MASK_BIT)
+    {
+    case Up:
+        frame[2] = centerAddr;
+        break;
+    case Down:
+        frame[2 + REMOTE_STATION_ADDR_LEN] = centerAddr;
+        break;
+    default:
+        return set_error_indicate(SL651_ERROR_INVALID_DIRECTION);
+    }
+    uint32_t msgHead = PACKAGE_HEAD_STX_LEN;
+    bool hasMsgHead = true;
+    if (frame[PACKAGE_HEAD_STX_LEN - 1] == SYN)
+    {
+        msgHead = PACKAGE_HEAD_SYN_LEN;
+        uint32_t u32 = (frame[14] << 16) | (frame[15] << 8) | frame[16];
+        hasMsgHead = (u32 & PACKAGE_HEAD_SEQUENCE_SEQ_MASK) <= 1; // 第二包开始没有报文头
+    }
+    if (hasMsgHead)
+    {
+        if (limit < msgHead + 2 + DATETIME_LEN + PACKAGE_TAIL_LEN)
+        {
+            return set_error_indicate(SL651_ERROR_INSUFFICIENT_PACKAGE_LEN);
+        }
+        ByteBuffer patch;
+        BB_ctor_wrapped(&patch, frame + msgHead, 2 + DATETIME_LEN);
+        BB_Position(&patch) = 0; // wrapped 的 buffer 默认写满，回到开头覆盖
+        if (!(BB_BE_PutUInt16(&patch, seq) == 2 &&
+              (sendTime == NULL || DateTime_Encode(sendTime, &patch))))
+        {
+            return false;
+        }
+    }
+    uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, frame, limit - 2);
+    frame[limit - 2] = crc16 >> 8;
+    frame[limit - 1] = crc16 & 0xFF;
+    return true;
+}
+
+bool Package_PatchSynHead(uint8_t *const head, uint16_t len, uint16_t count, uint16_t seq)
+{
+    assert(head);
+    if (head[PACKAGE_HEAD_STX_LEN - 1] != SYN)
+    {
+        return set_error_indicate(SL651_ERROR_ENCODE_INVALID_HEAD);
+    }
+    if (len > PACKAGE_HEAD_STX_BODY_LEN_MASK ||
+        count > PACKAGE_HEAD_SEQUENCE_COUNT_MASK ||
+        seq > PACKAGE_HEAD_SEQUENCE_SEQ_MASK)
+    {
+        return set_error_indicate(SL651_ERROR_ENCODE_INVALID_HEAD);
+    }
+    // 保留方向位
+    head[PACKAGE_HEAD_STX_DIRECTION_INDEX] = (head[PACKAGE_HEAD_STX_DIRECTION_INDEX] & 0xF0) | (len >> 8);
+    head[PACKAGE_HEAD_STX_DIRECTION_INDEX + 1] = len & 0xFF;
+    uint32_t u32 = (((uint32_t)count) << PACKAGE_HEAD_SEQUENCE_COUNT_BIT_MASK_LEN) + seq;
+    head[PACKAGE_HEAD_STX_LEN] = u32 >> 16;
+    head[PACKAGE_HEAD_STX_LEN + 1] = (u32 >> 8) & 0xFF;
+    head[PACKAGE_HEAD_STX_LEN + 2] = u32 & 0xFF;
+    return true;
+}
 // "AbstractClass" Package END
 
 /* LinkMessage Construtor & Destrucor */
@@ -2523,4 +2601,4 @@ Package *decodePackage(ByteBuffer *const byteBuff)
     return pkg;
 }
 // Decode & Encode END
-// #pragma pack()
\ No newline at end of file
+// #pragma pack()
\ No newline at end of file
@@ -277,6 +277,35 @@ GTEST_TEST(ByteBuffer, BB_CRC16)
     DelInstance(buf);
 }
 
+GTEST_TEST(ByteBuffer, CRC16_Update)
+{
+    ByteBuffer *buf = NewInstance(ByteBuffer);
+    BB_ctor_fromHexStr(buf, "7E7E"
+                            "0012345678"
+                            "10"
+                            "1234"
+                            "34"
+                            "8008"
+                            "02"
+                            "0001"
+                            "140613143853"
+                            "04"
+                            "696E",
+                       50);
+    BB_Flip(buf);
+    uint32_t len = BB_Available(buf) - 2;
+    // 分段计算与整体计算一致
+    uint16_t crc = CRC16_INIT_VALUE;
+    crc = CRC16_Update(crc, buf->buff, 3);
+    crc = CRC16_Update(crc, buf->buff + 3, 10);
+    crc = CRC16_Update(crc, buf->buff + 13, len - 13);
+    ASSERT_EQ(crc, 0x696E);
+    ASSERT_EQ(CRC16_Update(CRC16_INIT_VALUE, buf->buff, 0), CRC16_INIT_VALUE);
+
+    BB_dtor(buf);
+    DelInstance(buf);
+}
+
 GTEST_TEST(ByteBuffer, BB_BE_BCDPutUInt)
 {
     ByteBuffer *buf = NewInstance(ByteBuffer);
@@ -327,4 +356,4 @@ int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}
\ No newline at end of file
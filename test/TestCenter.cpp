@@ -0,0 +1,456 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+
+#include "common/class.h"
+#include "center.h"
+
+// 测试报，遥测站地址 0012345678，流水号 3
+static char const *TEST_FRAME = "7E7E"
+                                "01"
+                                "0012345678"
+                                "1234"
+                                "30"
+                                "002B"
+                                "02"
+                                "0003"
+                                "591011154947"
+                                "F1F1"
+                                "0012345678"
+                                "48"
+                                "F0F0"
+                                "5910111549"
+                                "2019"
+                                "000005"
+                                "2619"
+                                "000005"
+                                "3923"
+                                "00000127"
+                                "3812"
+                                "1115"
+                                "03"
+                                "20FA";
+
+static ByteBuffer *testFrame()
+{
+    ByteBuffer *buff = NewInstance(ByteBuffer);
+    BB_ctor_fromHexStr(buff, TEST_FRAME, strlen(TEST_FRAME));
+    BB_Flip(buff);
+    return buff;
+}
+
+static void freeBuff(ByteBuffer *buff)
+{
+    BB_dtor(buff);
+    DelInstance(buff);
+}
+
+GTEST_TEST(Center, frameLength)
+{
+    ByteBuffer *frame = testFrame();
+    uint32_t len = BB_Limit(frame);
+    ASSERT_EQ(len, 60);
+    ASSERT_EQ(Center_FrameLength(frame->buff, len), 60);
+    ASSERT_EQ(Center_FrameLength(frame->buff, len - 1), 0);
+    ASSERT_EQ(Center_FrameLength(frame->buff, 5), 0);
+    // 前面有垃圾数据，跳到 SOH
+    uint8_t noise[64] = {0x11, 0x22, 0x7E, 0x33};
+    ASSERT_EQ(Center_FrameLength(noise, 4), -2);
+    ASSERT_EQ(Center_FrameLength(noise + 2, 2), -2);
+    ASSERT_EQ(Center_FrameLength(noise + 2, 1), 0);
+    // 结束符不对
+    memcpy(noise, frame->buff, len);
+    noise[len - 3] = 0x00;
+    ASSERT_EQ(Center_FrameLength(noise, len), -1);
+    freeBuff(frame);
+}
+
+GTEST_TEST(Center, encodeReply)
+{
+    ByteBuffer *frame = testFrame();
+    Package *request = decodePackage(frame);
+    ASSERT_TRUE(request != NULL);
+    ByteBuffer *reply = Center_EncodeReply(request, EOT);
+    ASSERT_TRUE(reply != NULL);
+    uint32_t len = BB_Limit(reply);
+    ASSERT_EQ(len, PACKAGE_WRAPPER_LEN + 2 + DATETIME_LEN);
+    // 下行: 遥测站地址在前
+    uint8_t const *out = reply->buff;
+    ASSERT_EQ(out[2], 0x00);
+    ASSERT_EQ(out[6], 0x78);
+    ASSERT_EQ(out[7], 0x01);
+    ASSERT_EQ(out[10], TEST);
+    ASSERT_EQ(out[11] >> 4, Down);
+    ASSERT_EQ(out[14], 0x00);
+    ASSERT_EQ(out[15], 0x03); // 流水号
+    ASSERT_EQ(out[len - 3], EOT);
+    Package *pkg = decodePackage(reply);
+    ASSERT_TRUE(pkg != NULL);
+    ASSERT_EQ(pkg->head.direction, Down);
+    ASSERT_EQ(((DownlinkMessage *)pkg)->messageHead.seq, 3);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    freeBuff(reply);
+    request->vptr->dtor(request);
+    DelInstance(request);
+    freeBuff(frame);
+}
+
+static int handled = 0;
+
+static bool onTest(CenterConn *const conn, Package *const request)
+{
+    __atomic_fetch_add(&handled, 1, __ATOMIC_RELAXED);
+    return conn->session != NULL && request->head.funcCode == TEST;
+}
+
+static bool readFrame(int fd, uint8_t *out, size_t size, size_t *len)
+{
+    *len = 0;
+    while (*len < size)
+    {
+        ssize_t n = recv(fd, out + *len, size - *len, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        *len += n;
+        int32_t frameLen = Center_FrameLength(out, *len);
+        if (frameLen > 0)
+        {
+            return (size_t)frameLen == *len;
+        }
+    }
+    return false;
+}
+
+GTEST_TEST(Center, serve)
+{
+    Center *center = (Center *)calloc(1, sizeof(Center));
+    Center_ctor(center, 2, false);
+    ASSERT_TRUE(Center_SetHandler(center, TEST, &onTest) == NULL);
+    ASSERT_TRUE(Center_Listen(center, "127.0.0.1", 0));
+    ASSERT_GT(center->port, 0);
+    ASSERT_TRUE(Center_Start(center));
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(center->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ASSERT_EQ(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+    ByteBuffer *frame = testFrame();
+    uint32_t len = BB_Limit(frame);
+    // 垃圾数据 + 分两次发送的报文
+    uint8_t noise[] = {0x00, 0x7E, 0x01};
+    ASSERT_EQ(send(fd, noise, sizeof(noise), 0), sizeof(noise));
+    ASSERT_EQ(send(fd, frame->buff, 20, 0), 20);
+    usleep(20 * 1000);
+    ASSERT_EQ(send(fd, frame->buff + 20, len - 20, 0), len - 20);
+    uint8_t reply[64];
+    size_t replyLen = 0;
+    ASSERT_TRUE(readFrame(fd, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(reply[10], TEST);
+    ASSERT_EQ(reply[replyLen - 3], EOT);
+    ASSERT_EQ(__atomic_load_n(&handled, __ATOMIC_RELAXED), 1);
+
+    // handler 返回 false 时应答 NAK
+    Center_SetReply(center, HOUR, CENTER_REPLY_CONFIRM);
+    Center_SetHandler(center, HOUR, &onTest);
+    frame->buff[10] = HOUR;
+    uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, frame->buff, len - 2);
+    frame->buff[len - 2] = crc16 >> 8;
+    frame->buff[len - 1] = crc16 & 0xFF;
+    ASSERT_EQ(send(fd, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(fd, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(reply[10], HOUR);
+    ASSERT_EQ(reply[replyLen - 3], NAK);
+
+    ASSERT_EQ(Center_SessionCount(center), 1);
+    RemoteStationAddr station = {0, 12, 34, 56, 78, 0};
+    CenterSession *session = Center_FindSession(center, &station);
+    ASSERT_TRUE(session != NULL);
+    ASSERT_EQ(__atomic_load_n(&session->framesIn, __ATOMIC_RELAXED), 2);
+    ASSERT_TRUE(__atomic_load_n(&session->conn, __ATOMIC_ACQUIRE) != NULL);
+    ASSERT_EQ(Metric_Get(&center->metrics.connects), 1);
+
+    // 名单固定后仍然可以找到，新连接绑定同一个 session
+    RemoteStationAddr other = {0, 12, 34, 56, 79, 0};
+    CenterSession *added = Center_AddSession(center, &other);
+    ASSERT_TRUE(added != NULL);
+    ASSERT_EQ(Center_AddSession(center, &other), added);
+    ASSERT_TRUE(Center_FreezeSessions(center));
+    ASSERT_EQ(Center_FindSession(center, &station), session);
+    ASSERT_EQ(Center_FindSession(center, &other), added);
+    ASSERT_EQ(Center_SessionCount(center), 2);
+    frame->buff[10] = TEST;
+    crc16 = CRC16_Update(CRC16_INIT_VALUE, frame->buff, len - 2);
+    frame->buff[len - 2] = crc16 >> 8;
+    frame->buff[len - 1] = crc16 & 0xFF;
+    ASSERT_EQ(send(fd, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(fd, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(reply[replyLen - 3], EOT);
+    ASSERT_EQ(__atomic_load_n(&session->framesIn, __ATOMIC_RELAXED), 3);
+
+    // 其他线程在读临界区中读到的 conn，断线后仍然有效
+    Rcu_ReadLock(&center->sessions.rcu);
+    CenterConn *conn = __atomic_load_n(&session->conn, __ATOMIC_ACQUIRE);
+    ASSERT_TRUE(conn != NULL);
+    close(fd);
+    for (int i = 0; i < 200 && __atomic_load_n(&session->conn, __ATOMIC_ACQUIRE) != NULL; i++)
+    {
+        usleep(10 * 1000);
+    }
+    ASSERT_TRUE(__atomic_load_n(&session->conn, __ATOMIC_ACQUIRE) == NULL);
+    ASSERT_EQ(conn->center, center);
+    ASSERT_EQ(conn->session, session);
+    Rcu_ReadUnlock(&center->sessions.rcu);
+
+    freeBuff(frame);
+    Center_dtor(center);
+    free(center);
+}
+
+GTEST_TEST(Center, reusePort)
+{
+    uint16_t const loops = 4;
+    int const clients = 32;
+    Center *center = (Center *)calloc(1, sizeof(Center));
+    Center_ctor(center, loops, false);
+    center->steer = true;
+    ASSERT_TRUE(Center_Listen(center, "127.0.0.1", 0));
+    ASSERT_TRUE(Center_Start(center));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(center->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fds[clients];
+    uint64_t expected[loops] = {0};
+    for (int i = 0; i < clients; i++)
+    {
+        fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(fds[i], (struct sockaddr *)&addr, sizeof(addr)), 0);
+        struct sockaddr_in local;
+        socklen_t len = sizeof(local);
+        ASSERT_EQ(getsockname(fds[i], (struct sockaddr *)&local, &len), 0);
+        expected[ntohs(local.sin_port) % loops]++;
+    }
+    uint64_t accepted = 0;
+    for (int wait = 0; wait < 200 && accepted < clients; wait++)
+    {
+        usleep(5 * 1000);
+        accepted = 0;
+        for (uint16_t i = 0; i < loops; i++)
+        {
+            accepted += Metric_Get(&center->loopMetrics[i].accepts);
+        }
+    }
+    ASSERT_EQ(accepted, clients);
+    ASSERT_EQ(Metric_Get(&center->metrics.connects), clients);
+    for (uint16_t i = 0; i < loops; i++)
+    {
+        CenterLoopMetrics *metrics = &center->loopMetrics[i];
+        ASSERT_EQ(Metric_Get(&metrics->acceptLatency.count), Metric_Get(&metrics->accepts));
+        ASSERT_EQ(__atomic_load_n(&center->pool.shards[i].load, __ATOMIC_RELAXED), Metric_Get(&metrics->accepts));
+        if (center->acceptorCount == loops && center->steer)
+        {
+            ASSERT_EQ(Metric_Get(&metrics->accepts), expected[i]);
+        }
+    }
+
+    MetricsText text;
+    MetricsText_ctor(&text);
+    Center_RenderMetrics(center, &text);
+    ASSERT_TRUE(strstr(text.buff, "sl651_center_connections{loop=\"3\"}") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "sl651_center_accepts_total{loop=\"0\"}") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "sl651_center_accept_latency_seconds_count{loop=\"0\"}") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "sl651_center_connects_total 32") != NULL);
+    MetricsText_dtor(&text);
+
+    for (int i = 0; i < clients; i++)
+    {
+        close(fds[i]);
+    }
+    Center_dtor(center);
+    free(center);
+}
+
+static void patchCrc(ByteBuffer *frame)
+{
+    uint32_t len = BB_Limit(frame);
+    uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, frame->buff, len - 2);
+    frame->buff[len - 2] = crc16 >> 8;
+    frame->buff[len - 1] = crc16 & 0xFF;
+}
+
+GTEST_TEST(Center, reportFingerprint)
+{
+    ByteBuffer *frame = testFrame();
+    uint32_t len = BB_Limit(frame);
+    uint64_t fingerprint = Center_ReportFingerprint(frame->buff, len);
+    // 重发: 中心站地址、密码、流水号、发报时间不同
+    frame->buff[2] = 0x02;
+    frame->buff[9] = 0x35;
+    frame->buff[15] = 0x04;
+    frame->buff[21] = 0x48;
+    patchCrc(frame);
+    ASSERT_EQ(Center_ReportFingerprint(frame->buff, len), fingerprint);
+    // 观测时间不同
+    frame->buff[36] = 0x50;
+    ASSERT_NE(Center_ReportFingerprint(frame->buff, len), fingerprint);
+    frame->buff[36] = 0x49;
+    // 遥测站、功能码不同
+    frame->buff[7] = 0x79;
+    ASSERT_NE(Center_ReportFingerprint(frame->buff, len), fingerprint);
+    frame->buff[7] = 0x78;
+    frame->buff[10] = HOUR;
+    ASSERT_NE(Center_ReportFingerprint(frame->buff, len), fingerprint);
+    freeBuff(frame);
+}
+
+static int reports = 0;
+
+static bool onReport(CenterConn *const conn, Package *const request)
+{
+    __atomic_fetch_add(&reports, 1, __ATOMIC_RELAXED);
+    return request->head.funcCode == TEST;
+}
+
+static int connectCenter(Center *center)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(center->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+GTEST_TEST(Center, dedup)
+{
+    Center *center = (Center *)calloc(1, sizeof(Center));
+    Center_ctor(center, 2, false);
+    ASSERT_TRUE(Center_EnableDedup(center, 60, 1024));
+    Center_SetHandler(center, TEST, &onReport);
+    Center_SetHandler(center, HOUR, &onReport);
+    ASSERT_TRUE(Center_Listen(center, "127.0.0.1", 0));
+    ASSERT_TRUE(Center_Start(center));
+    // 主备两个信道
+    int master = connectCenter(center);
+    int slave = connectCenter(center);
+    ASSERT_GE(master, 0);
+    ASSERT_GE(slave, 0);
+
+    ByteBuffer *frame = testFrame();
+    uint32_t len = BB_Limit(frame);
+    uint8_t reply[64];
+    size_t replyLen = 0;
+    ASSERT_EQ(send(master, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(master, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(reply[replyLen - 3], EOT);
+    // 备信道上同一份报告，流水号不同，仍然确认
+    frame->buff[15] = 0x09;
+    patchCrc(frame);
+    ASSERT_EQ(send(slave, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(slave, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(reply[replyLen - 3], EOT);
+    ASSERT_EQ(reply[15], 0x09);
+    ASSERT_EQ(__atomic_load_n(&reports, __ATOMIC_RELAXED), 1);
+    ASSERT_EQ(Metric_Get(&center->duplicates), 1);
+
+    // handler 失败后重发的报文再次分发
+    frame->buff[10] = HOUR;
+    patchCrc(frame);
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_EQ(send(master, frame->buff, len, 0), len);
+        ASSERT_TRUE(readFrame(master, reply, sizeof(reply), &replyLen));
+        ASSERT_EQ(reply[replyLen - 3], NAK);
+    }
+    ASSERT_EQ(__atomic_load_n(&reports, __ATOMIC_RELAXED), 3);
+    ASSERT_EQ(Metric_Get(&center->duplicates), 1);
+
+    // 不去重的功能码
+    Center_SetDedup(center, TEST, false);
+    frame->buff[10] = TEST;
+    patchCrc(frame);
+    ASSERT_EQ(send(slave, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(slave, reply, sizeof(reply), &replyLen));
+    ASSERT_EQ(__atomic_load_n(&reports, __ATOMIC_RELAXED), 4);
+
+    close(master);
+    close(slave);
+    freeBuff(frame);
+    Center_dtor(center);
+    free(center);
+}
+
+GTEST_TEST(Center, multiStation)
+{
+    Center *center = (Center *)calloc(1, sizeof(Center));
+    Center_ctor(center, 1, false);
+    Center_SetHandler(center, TEST, &onReport);
+    ASSERT_TRUE(Center_Listen(center, "127.0.0.1", 0));
+    ASSERT_TRUE(Center_Start(center));
+    int fd = connectCenter(center);
+    ASSERT_GE(fd, 0);
+
+    // 同一个连接上两个遥测站的报文
+    ByteBuffer *frame = testFrame();
+    uint32_t len = BB_Limit(frame);
+    uint8_t reply[64];
+    size_t replyLen = 0;
+    ASSERT_EQ(send(fd, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(fd, reply, sizeof(reply), &replyLen));
+    frame->buff[7] = 0x79; // 报文头和 F1F1 中的遥测站地址
+    frame->buff[28] = 0x79;
+    patchCrc(frame);
+    ASSERT_EQ(send(fd, frame->buff, len, 0), len);
+    ASSERT_TRUE(readFrame(fd, reply, sizeof(reply), &replyLen));
+    RemoteStationAddr first = {0, 12, 34, 56, 78, 0};
+    RemoteStationAddr second = {0, 12, 34, 56, 79, 0};
+    CenterSession *a = Center_FindSession(center, &first);
+    CenterSession *b = Center_FindSession(center, &second);
+    ASSERT_TRUE(a != NULL && b != NULL);
+    ASSERT_TRUE(__atomic_load_n(&a->conn, __ATOMIC_ACQUIRE) != NULL);
+    ASSERT_EQ(__atomic_load_n(&a->conn, __ATOMIC_ACQUIRE), __atomic_load_n(&b->conn, __ATOMIC_ACQUIRE));
+
+    // 断线后两个 session 都离线，不再指向释放的连接
+    close(fd);
+    for (int i = 0; i < 200 && (__atomic_load_n(&a->conn, __ATOMIC_ACQUIRE) != NULL ||
+                                __atomic_load_n(&b->conn, __ATOMIC_ACQUIRE) != NULL);
+         i++)
+    {
+        usleep(10 * 1000);
+    }
+    ASSERT_TRUE(__atomic_load_n(&a->conn, __ATOMIC_ACQUIRE) == NULL);
+    ASSERT_TRUE(__atomic_load_n(&b->conn, __ATOMIC_ACQUIRE) == NULL);
+
+    freeBuff(frame);
+    Center_dtor(center);
+    free(center);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
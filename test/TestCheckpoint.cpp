@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+
+#include "checkpoint.h"
+
+static char *checkpointFile(char *file)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_ckpt_XXXXXX");
+    if (mkdtemp(dir) == NULL)
+    {
+        return NULL;
+    }
+    sprintf(file, "%s/transfers.ckpt", dir);
+    return file;
+}
+
+static void removeCheckpointFile(char const *file)
+{
+    unlink(file);
+    char dir[128];
+    snprintf(dir, sizeof(dir), "%s", file);
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL)
+    {
+        *slash = '\0';
+        rmdir(dir);
+    }
+}
+
+static TransferCheckpoint checkpointOf(uint64_t hash, uint16_t acked)
+{
+    TransferCheckpoint cp = {0};
+    cp.fileHash = hash;
+    cp.fileSize = 100000;
+    cp.mtime = 1700000000;
+    cp.chunkSize = 1024;
+    cp.pkgCount = 98;
+    cp.acked = acked;
+    cp.seq = 7;
+    return cp;
+}
+
+GTEST_TEST(Checkpoint, reopen)
+{
+    char file[128];
+    ASSERT_TRUE(checkpointFile(file) != NULL);
+    CheckpointStore store;
+    CheckpointStore_ctor(&store);
+    ASSERT_TRUE(CheckpointStore_Open(&store, file));
+    TransferCheckpoint cp = checkpointOf(0x1234, 10);
+    ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    cp.acked = 20; // 覆盖
+    ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    cp = checkpointOf(0x5678, 3);
+    ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    ASSERT_TRUE(CheckpointStore_Remove(&store, 0x5678));
+    CheckpointStore_dtor(&store);
+
+    CheckpointStore_ctor(&store);
+    ASSERT_TRUE(CheckpointStore_Open(&store, file));
+    TransferCheckpoint const *found = CheckpointStore_Find(&store, 0x1234, 100000, 1700000000, 1024);
+    ASSERT_TRUE(found != NULL);
+    ASSERT_EQ(found->acked, 20);
+    ASSERT_EQ(found->seq, 7);
+    ASSERT_EQ(found->pkgCount, 98);
+    ASSERT_TRUE(CheckpointStore_Find(&store, 0x5678, 100000, 1700000000, 1024) == NULL);
+    // 文件或分包大小变化后不能续传
+    ASSERT_TRUE(CheckpointStore_Find(&store, 0x1234, 100000, 1700000000, 512) == NULL);
+    ASSERT_TRUE(CheckpointStore_Find(&store, 0x1234, 100000, 1700000000, 1024) == NULL);
+    CheckpointStore_dtor(&store);
+    removeCheckpointFile(file);
+}
+
+GTEST_TEST(Checkpoint, replaceOldest)
+{
+    CheckpointStore store;
+    CheckpointStore_ctor(&store); // memory only
+    for (uint64_t hash = 2; hash < 2 + CHECKPOINT_SLOTS; hash++)
+    {
+        TransferCheckpoint cp = checkpointOf(hash, 1);
+        ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    }
+    TransferCheckpoint cp = checkpointOf(2, 5); // 更新后不再是最旧的
+    ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    cp = checkpointOf(100, 1);
+    ASSERT_TRUE(CheckpointStore_Save(&store, &cp));
+    ASSERT_TRUE(CheckpointStore_Find(&store, 2, 100000, 1700000000, 1024) != NULL);
+    ASSERT_TRUE(CheckpointStore_Find(&store, 3, 100000, 1700000000, 1024) == NULL);
+    ASSERT_TRUE(CheckpointStore_Find(&store, 100, 100000, 1700000000, 1024) != NULL);
+    CheckpointStore_dtor(&store);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+
+#include "config_cache.h"
+
+static void writeFile(char const *file, char const *text)
+{
+    FILE *f = fopen(file, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+GTEST_TEST(ConfigCache, saveAndOpen)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_cache_XXXXXX");
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    char json[128], cache[128];
+    sprintf(json, "%s/config.json", dir);
+    sprintf(cache, "%s/config.cache", dir);
+    writeFile(json, "{\"password\": 1234}");
+    ConfigCacheSource source;
+    ASSERT_TRUE(ConfigCacheSource_Stat(&source, json));
+    ByteBuffer payload;
+    BB_ctor(&payload, 0);
+    ConfigCache_PutUInt(&payload, 0x1234, 2);
+    ConfigCache_PutString(&payload, "pics");
+    ConfigCache_PutString(&payload, NULL);
+    ConfigCache_PutUInt(&payload, 0x0102030405060708ULL, 8);
+    ASSERT_TRUE(ConfigCache_Save(cache, &source, &payload));
+    BB_dtor(&payload);
+
+    ConfigCache c;
+    ASSERT_TRUE(ConfigCache_Open(&c, cache, &source));
+    ASSERT_EQ(ConfigCache_GetUInt(&c, 2), 0x1234);
+    ASSERT_STREQ(ConfigCache_GetString(&c), "pics");
+    ASSERT_TRUE(ConfigCache_GetString(&c) == NULL);
+    ASSERT_EQ(ConfigCache_GetUInt(&c, 8), 0x0102030405060708ULL);
+    ASSERT_TRUE(ConfigCache_IsComplete(&c));
+    ConfigCache_GetUInt(&c, 1); // 越界
+    ASSERT_TRUE(c.error);
+    ConfigCache_dtor(&c);
+
+    // 内容变化(mtime 可能相同)，缓存失效
+    writeFile(json, "{\"password\": 4321}");
+    ConfigCacheSource changed;
+    ASSERT_TRUE(ConfigCacheSource_Stat(&changed, json));
+    ASSERT_NE(changed.hash, source.hash);
+    ASSERT_FALSE(ConfigCache_Open(&c, cache, &changed));
+
+    // 损坏的缓存
+    FILE *f = fopen(cache, "r+b");
+    fseek(f, CONFIG_CACHE_HEADER_LEN + 1, SEEK_SET);
+    fputc('x', f);
+    fclose(f);
+    ASSERT_FALSE(ConfigCache_Open(&c, cache, &source));
+    unlink(json);
+    unlink(cache);
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
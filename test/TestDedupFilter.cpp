@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+
+#include "dedup_filter.h"
+
+GTEST_TEST(DedupFilter, addRemove)
+{
+    DedupFilter filter;
+    DedupFilter_ctor(&filter, 60, 1000);
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1234, 100), DEDUP_NEW);
+    ASSERT_NE(DedupFilter_Add(&filter, 0x1234, 101), DEDUP_NEW);
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1235, 101), DEDUP_NEW);
+    // 0 / 1 为保留值，同样可以去重
+    ASSERT_EQ(DedupFilter_Add(&filter, 0, 101), DEDUP_NEW);
+    ASSERT_NE(DedupFilter_Add(&filter, 0, 101), DEDUP_NEW);
+    // 第一份处理完成前的重复报文不能确认
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1235, 101), DEDUP_PENDING);
+    DedupFilter_Commit(&filter, 0x1235);
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1235, 101), DEDUP_DUPLICATE);
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1234, 101), DEDUP_PENDING);
+    // 处理失败后允许重发的报文通过
+    DedupFilter_Remove(&filter, 0x1234);
+    ASSERT_EQ(DedupFilter_Add(&filter, 0x1234, 102), DEDUP_NEW);
+    ASSERT_NE(DedupFilter_Add(&filter, 0x1234, 102), DEDUP_NEW);
+    DedupFilter_dtor(&filter);
+}
+
+GTEST_TEST(DedupFilter, window)
+{
+    DedupFilter filter;
+    DedupFilter_ctor(&filter, 60, 1000);
+    ASSERT_EQ(DedupFilter_Add(&filter, 42, 1000), DEDUP_NEW);
+    // 其他写入推动换代，窗口内仍然记得
+    for (int64_t now = 1000; now < 1060; now++)
+    {
+        DedupFilter_Add(&filter, 1000000 + now, now);
+        ASSERT_NE(DedupFilter_Add(&filter, 42, now), DEDUP_NEW) << now;
+    }
+    // 超出 GENERATIONS 代之后被清空
+    ASSERT_EQ(DedupFilter_Add(&filter, 42, 1000 + 60 * 2), DEDUP_NEW);
+    // 长时间没有写入，老的一代已过期
+    ASSERT_EQ(DedupFilter_Add(&filter, 7, 2000), DEDUP_NEW);
+    ASSERT_EQ(DedupFilter_Add(&filter, 7, 3000), DEDUP_NEW);
+    DedupFilter_dtor(&filter);
+}
+
+GTEST_TEST(DedupFilter, boundedMemory)
+{
+    DedupFilter filter;
+    DedupFilter_ctor(&filter, 600, 1000);
+    size_t slotCount = filter.slotCount;
+    // 远超容量: 提前换代，最近的指纹仍然可以去重
+    uint64_t const n = 100000;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(DedupFilter_Add(&filter, i * 0x9E3779B97F4A7C15ULL, 10), DEDUP_NEW);
+    }
+    ASSERT_EQ(filter.slotCount, slotCount);
+    for (uint64_t i = n - 100; i < n; i++)
+    {
+        ASSERT_NE(DedupFilter_Add(&filter, i * 0x9E3779B97F4A7C15ULL, 10), DEDUP_NEW);
+    }
+    for (int s = 0; s < DEDUP_FILTER_STRIPES; s++)
+    {
+        for (int g = 0; g < DEDUP_FILTER_GENERATIONS; g++)
+        {
+            ASSERT_LE(filter.stripes[s].generations[g].count, filter.maxCount);
+        }
+    }
+    DedupFilter_dtor(&filter);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
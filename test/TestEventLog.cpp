@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gtest/gtest.h"
+
+#include "event_log.h"
+
+enum
+{
+    EV_FRAME,
+    EV_INVALID,
+    EV_FILE,
+    EV_COUNT
+};
+
+static EventDef const EVENTS[EV_COUNT] = {
+    {EVENT_LEVEL_DEBUG, EVENT_DATA_NONE, "request[%4llX] crc[%4llx]"},
+    {EVENT_LEVEL_WARN, EVENT_DATA_HEX, "invalid hex:[%s] errno:[%llu]"},
+    {EVENT_LEVEL_INFO, EVENT_DATA_STR, "file[%s] %llu/%llu"},
+};
+
+static char *readAll(FILE *f, char *buff, size_t size)
+{
+    fflush(f);
+    rewind(f);
+    size_t len = fread(buff, 1, size - 1, f);
+    buff[len] = '\0';
+    return buff;
+}
+
+GTEST_TEST(EventLog, format)
+{
+    FILE *out = tmpfile();
+    ASSERT_TRUE(out != NULL);
+    EventLog log;
+    EventLog_ctor(&log, EVENTS, EV_COUNT);
+    ASSERT_TRUE(EventLog_Start(&log, out, NULL));
+    EventLog_Emit(&log, EV_FRAME, 4, 0x2F, 0xABCD); // 低于 info，不记录
+    uint8_t frame[] = {0x7E, 0x7E, 0x01};
+    EventLog_EmitData(&log, EV_INVALID, 4, frame, sizeof(frame), 3);
+    EventLog_EmitData(&log, EV_FILE, EVENT_NO_CHANNEL, "a.jpg", 5, 7, 10);
+    EventLog_dtor(&log); // 输出剩余的记录
+    static char text[4096];
+    readAll(out, text, sizeof(text));
+    ASSERT_TRUE(strstr(text, "request") == NULL);
+    ASSERT_TRUE(strstr(text, " W ch[ 4] invalid hex:[7E7E01] errno:[3]\r\n") != NULL);
+    ASSERT_TRUE(strstr(text, " I file[a.jpg] 7/10\r\n") != NULL);
+    fclose(out);
+}
+
+GTEST_TEST(EventLog, rateLimit)
+{
+    FILE *out = tmpfile();
+    ASSERT_TRUE(out != NULL);
+    EventLog log;
+    EventLog_ctor(&log, EVENTS, EV_COUNT);
+    log.level = EVENT_LEVEL_DEBUG;
+    log.rate = 5;
+    ASSERT_TRUE(EventLog_Start(&log, out, NULL));
+    // 同一秒内，最多 5 条(跨秒时可能多几条)
+    for (int i = 0; i < 20; i++)
+    {
+        EventLog_Emit(&log, EV_FRAME, 4, (uint64_t)i, 0);
+    }
+    ASSERT_GE(EventLog_Lost(&log), 10);
+    EventLog_dtor(&log);
+    static char text[8192];
+    readAll(out, text, sizeof(text));
+    ASSERT_TRUE(strstr(text, "request[   0]") != NULL);
+    ASSERT_TRUE(strstr(text, "event log lost") != NULL);
+    fclose(out);
+}
+
+GTEST_TEST(EventLog, binary)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_log_XXXXXX");
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    char file[128];
+    sprintf(file, "%s/events.bin", dir);
+    EventLog log;
+    EventLog_ctor(&log, EVENTS, EV_COUNT);
+    log.rate = 0;
+    ASSERT_TRUE(EventLog_Start(&log, NULL, file));
+    for (int i = 0; i < 100; i++)
+    {
+        EventLog_EmitData(&log, EV_FILE, 10, "b.jpg", 5, (uint64_t)i, 100);
+    }
+    EventLog_dtor(&log);
+    FILE *f = fopen(file, "rb");
+    ASSERT_TRUE(f != NULL);
+    EventRecord r;
+    int count = 0;
+    while (fread(&r, sizeof(r), 1, f) == 1)
+    {
+        ASSERT_EQ(r.event, EV_FILE);
+        ASSERT_EQ(r.channel, 10);
+        ASSERT_EQ(r.argc, 2);
+        ASSERT_EQ(r.args[0], (uint64_t)count);
+        ASSERT_EQ(memcmp(r.data, "b.jpg", r.dataLen), 0);
+        count++;
+    }
+    fclose(f);
+    ASSERT_EQ(count, 100);
+    unlink(file);
+    rmdir(dir);
+}
+
+static size_t countRings(EventLog *const log)
+{
+    size_t count = 0;
+    for (EventRing *ring = log->rings; ring != NULL; ring = ring->next)
+    {
+        count++;
+    }
+    return count;
+}
+
+GTEST_TEST(EventLog, alternateLogs)
+{
+    FILE *out = tmpfile();
+    ASSERT_TRUE(out != NULL);
+    EventLog a;
+    EventLog b;
+    EventLog_ctor(&a, EVENTS, EV_COUNT);
+    EventLog_ctor(&b, EVENTS, EV_COUNT);
+    ASSERT_TRUE(EventLog_Start(&a, out, NULL));
+    ASSERT_TRUE(EventLog_Start(&b, out, NULL));
+    // 同一线程交替写两个 log，每个 log 只有本线程的一个 ring
+    for (int i = 0; i < 10; i++)
+    {
+        EventLog_EmitData(&a, EV_FILE, 1, "a.jpg", 5, (uint64_t)i, 10);
+        EventLog_EmitData(&b, EV_FILE, 2, "b.jpg", 5, (uint64_t)i, 10);
+    }
+    ASSERT_EQ(countRings(&a), 1);
+    ASSERT_EQ(countRings(&b), 1);
+    EventLog_dtor(&a);
+    EventLog_dtor(&b);
+    static char text[8192];
+    readAll(out, text, sizeof(text));
+    ASSERT_TRUE(strstr(text, " I ch[ 1] file[a.jpg] 9/10\r\n") != NULL);
+    ASSERT_TRUE(strstr(text, " I ch[ 2] file[b.jpg] 9/10\r\n") != NULL);
+    fclose(out);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
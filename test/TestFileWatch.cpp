@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+
+#include "file_watch.h"
+
+static int notified = 0;
+
+static void onChanged(void *data)
+{
+    __atomic_add_fetch((int *)data, 1, __ATOMIC_SEQ_CST);
+}
+
+static void writeFile(char const *file, char const *text)
+{
+    FILE *f = fopen(file, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+static bool waitNotified(int expect)
+{
+    // inotify 不可用时每秒轮询
+    for (int i = 0; i < 300; i++)
+    {
+        if (__atomic_load_n(&notified, __ATOMIC_SEQ_CST) >= expect)
+        {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+GTEST_TEST(FileWatch, writeAndRename)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_watch_XXXXXX");
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    char file[128], tmp[128], other[128];
+    sprintf(file, "%s/config.json", dir);
+    sprintf(tmp, "%s/config.json.tmp", dir);
+    sprintf(other, "%s/other.json", dir);
+    writeFile(file, "{}");
+    notified = 0;
+    FileWatch watch;
+    ASSERT_TRUE(FileWatch_Open(&watch, file, &onChanged, &notified));
+    writeFile(other, "{}"); // 其他文件不通知
+    usleep(300 * 1000);
+    ASSERT_EQ(__atomic_load_n(&notified, __ATOMIC_SEQ_CST), 0);
+    writeFile(file, "{\"a\": 1}");
+    ASSERT_TRUE(waitNotified(1));
+    int count = __atomic_load_n(&notified, __ATOMIC_SEQ_CST);
+    writeFile(tmp, "{\"a\": 22}");
+    rename(tmp, file); // 编辑器的保存方式
+    ASSERT_TRUE(waitNotified(count + 1));
+    FileWatch_dtor(&watch);
+    unlink(file);
+    unlink(other);
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
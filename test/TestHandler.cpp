@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gtest/gtest.h"
+
+#include "station.h"
+
+static int calls = 0;
+static char trace[32];
+
+static bool handleA(Channel *const ch, Package *const request)
+{
+    strcat(trace, "A");
+    return true;
+}
+
+static bool handleB(Channel *const ch, Package *const request)
+{
+    strcat(trace, "B");
+    return true;
+}
+
+static bool audit(ChannelMiddleware const *const me, ChannelDispatch *const next, Channel *const ch, Package *const request)
+{
+    strcat(trace, (char const *)me->data);
+    return ChannelDispatch_Next(next, ch, request);
+}
+
+static bool deny(ChannelMiddleware const *const me, ChannelDispatch *const next, Channel *const ch, Package *const request)
+{
+    calls++;
+    return request->head.funcCode == TEST ? ChannelDispatch_Next(next, ch, request) : false;
+}
+
+static bool dispatch(Channel *const ch, FunctionCode code)
+{
+    Package pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.head.funcCode = code;
+    return Channel_Dispatch(ch, &pkg);
+}
+
+GTEST_TEST(Handler, table)
+{
+    Station *station = (Station *)calloc(1, sizeof(Station));
+    Station_ctor(station);
+    Channel *ch = (Channel *)calloc(1, sizeof(Channel)); // 只用到 station / handlers
+    ch->station = station;
+    ASSERT_TRUE(Channel_FindHandler(ch, TEST) != NULL); // 默认的处理
+    ASSERT_TRUE(Channel_FindHandler(ch, HOUR) == NULL);
+    ASSERT_TRUE(ch->handlers == NULL);
+    ASSERT_TRUE(Station_SetHandler(station, HOUR, &handleA) == NULL);
+    ASSERT_TRUE(Channel_SetHandler(ch, HOUR, &handleB) == &handleA);
+    ASSERT_TRUE(Channel_FindHandler(ch, HOUR) == &handleB);
+    trace[0] = '\0';
+    ASSERT_TRUE(dispatch(ch, HOUR));
+    ASSERT_STREQ(trace, "B");
+    // 恢复使用 station 的处理
+    Channel_SetHandler(ch, HOUR, NULL);
+    trace[0] = '\0';
+    ASSERT_TRUE(dispatch(ch, HOUR));
+    ASSERT_STREQ(trace, "A");
+    ASSERT_FALSE(dispatch(ch, ADDED)); // 没有处理
+    // 只统计有 handler 的功能码
+    ASSERT_EQ(Metric_Get(&StationMetrics_Handler(&station->metrics, HOUR)->count), 2);
+    ASSERT_TRUE(station->metrics.handlerLatency[ADDED] == NULL);
+    free(ch->handlers);
+    free(ch);
+    Station_dtor(station);
+    free(station);
+}
+
+GTEST_TEST(Handler, middleware)
+{
+    Station *station = (Station *)calloc(1, sizeof(Station));
+    Station_ctor(station);
+    Channel *ch = (Channel *)calloc(1, sizeof(Channel)); // 只用到 station / handlers
+    ch->station = station;
+    static ChannelMiddleware const first = {&audit, (void *)"1"};
+    static ChannelMiddleware const second = {&audit, (void *)"2"};
+    static ChannelMiddleware const guard = {&deny, NULL};
+    ASSERT_TRUE(Station_Use(station, &first));
+    ASSERT_TRUE(Station_Use(station, &second));
+    ASSERT_TRUE(Station_Use(station, &guard));
+    Station_SetHandler(station, TEST, &handleA);
+    Station_SetHandler(station, HOUR, &handleB);
+    trace[0] = '\0';
+    calls = 0;
+    ASSERT_TRUE(dispatch(ch, TEST));
+    ASSERT_STREQ(trace, "12A");
+    trace[0] = '\0';
+    ASSERT_FALSE(dispatch(ch, HOUR)); // 被拦截
+    ASSERT_STREQ(trace, "12");
+    ASSERT_EQ(calls, 2);
+    free(ch->handlers);
+    free(ch);
+    Station_dtor(station);
+    free(station);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "gtest/gtest.h"
+
+#include "metrics.h"
+
+GTEST_TEST(Metrics, histogram)
+{
+    StationMetrics metrics;
+    StationMetrics_ctor(&metrics);
+    MetricHistogram *h = StationMetrics_Handler(&metrics, 0x2F);
+    ASSERT_TRUE(h != NULL);
+    ASSERT_EQ(h, StationMetrics_Handler(&metrics, 0x2F));
+    MetricHistogram_Observe(h, 5);
+    MetricHistogram_Observe(h, 10);       // 边界计入当前桶
+    MetricHistogram_Observe(h, 700);
+    MetricHistogram_Observe(h, 10000000); // +Inf
+    ASSERT_EQ(Metric_Get(&h->buckets[0]), 2);
+    ASSERT_EQ(Metric_Get(&h->buckets[4]), 1);
+    ASSERT_EQ(Metric_Get(&h->buckets[METRIC_HISTOGRAM_BUCKETS - 1]), 1);
+    ASSERT_EQ(Metric_Get(&h->count), 4);
+    ASSERT_EQ(Metric_Get(&h->sum), 10000715);
+
+    MetricsText text;
+    MetricsText_ctor(&text);
+    MetricsText_Family(&text, "latency_seconds", "histogram", "test.");
+    MetricsText_Histogram(&text, "latency_seconds", "func=\"2F\"", h);
+    ASSERT_TRUE(strstr(text.buff, "# TYPE latency_seconds histogram\n") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "latency_seconds_bucket{func=\"2F\",le=\"1e-05\"} 2\n") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "latency_seconds_bucket{func=\"2F\",le=\"0.001\"} 3\n") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "latency_seconds_bucket{func=\"2F\",le=\"+Inf\"} 4\n") != NULL);
+    ASSERT_TRUE(strstr(text.buff, "latency_seconds_count{func=\"2F\"} 4\n") != NULL);
+    MetricsText_dtor(&text);
+    StationMetrics_dtor(&metrics);
+}
+
+static void renderCounters(void *data, MetricsText *const text)
+{
+    ChannelMetrics *metrics = (ChannelMetrics *)data;
+    MetricsText_Family(text, "frames_in_total", "counter", "test.");
+    MetricsText_Sample(text, "frames_in_total", "channel=\"4\"", Metric_Get(&metrics->framesIn));
+    for (int i = 0; i < 500; i++) // 超过初始缓冲区
+    {
+        MetricsText_Sample(text, "filler", NULL, i);
+    }
+}
+
+static int request(char const *path, char const *req, char *resp, size_t size)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    send(fd, req, strlen(req), 0);
+    size_t len = 0;
+    ssize_t n;
+    while (len < size - 1 && (n = recv(fd, resp + len, size - 1 - len, 0)) > 0)
+    {
+        len += n;
+    }
+    resp[len] = '\0';
+    close(fd);
+    return len;
+}
+
+GTEST_TEST(Metrics, scrape)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_metrics_XXXXXX");
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    char path[128];
+    sprintf(path, "%s/metrics.sock", dir);
+    ChannelMetrics metrics = {0};
+    Metric_Add(&metrics.framesIn, 3);
+    ChannelMetrics_DecodeError(&metrics, 100); // 超出范围
+    ASSERT_EQ(Metric_Get(&metrics.decodeErrors[METRIC_MAX_ERROR_CODES - 1]), 1);
+
+    MetricsServer server;
+    ASSERT_TRUE(MetricsServer_Open(&server, path, 0, &renderCounters, &metrics));
+    static char resp[16 * 1024];
+    ASSERT_GT(request(path, "GET /metrics HTTP/1.0\r\n\r\n", resp, sizeof(resp)), 0);
+    ASSERT_EQ(strncmp(resp, "HTTP/1.0 200 OK\r\n", 17), 0);
+    ASSERT_TRUE(strstr(resp, "frames_in_total{channel=\"4\"} 3\n") != NULL);
+    ASSERT_TRUE(strstr(resp, "filler 499\n") != NULL);
+    // 非 HTTP 请求直接返回文本
+    ASSERT_GT(request(path, "\n", resp, sizeof(resp)), 0);
+    ASSERT_EQ(strncmp(resp, "# HELP frames_in_total", 22), 0);
+    MetricsServer_dtor(&server);
+    ASSERT_NE(access(path, F_OK), 0);
+    rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
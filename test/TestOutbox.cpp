@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "gtest/gtest.h"
+
+#include "outbox.h"
+
+static char *outboxTempDir()
+{
+    static char dir[64];
+    strcpy(dir, "/tmp/sl651_outbox_XXXXXX");
+    return mkdtemp(dir);
+}
+
+static void removeOutboxDir(char const *dir)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        return;
+    }
+    struct dirent *entry;
+    char path[128];
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static void touch(char const *dir, char const *name)
+{
+    char path[128];
+    sprintf(path, "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    fputs("sl651", f);
+    fclose(f);
+}
+
+static bool skipFirst(void *ctx, char const *path)
+{
+    return strstr(path, (char const *)ctx) != NULL;
+}
+
+static void onNotify(void *data)
+{
+    __atomic_add_fetch((int *)data, 1, __ATOMIC_RELEASE);
+}
+
+GTEST_TEST(Outbox, scanSorted)
+{
+    char *dir = outboxTempDir();
+    ASSERT_TRUE(dir != NULL);
+    touch(dir, "c.jpg");
+    touch(dir, "a.jpg");
+    touch(dir, "b.jpg");
+    Outbox outbox;
+    ASSERT_TRUE(Outbox_Open(&outbox, dir, NULL, NULL));
+    ASSERT_EQ(Outbox_Size(&outbox), 3);
+    char path[128];
+    char expected[128];
+    ASSERT_TRUE(Outbox_Next(&outbox, NULL, NULL, NULL, path, sizeof(path)));
+    sprintf(expected, "%s/a.jpg", dir);
+    ASSERT_STREQ(path, expected);
+    ASSERT_TRUE(Outbox_Next(&outbox, NULL, &skipFirst, (void *)"a.jpg", path, sizeof(path)));
+    sprintf(expected, "%s/b.jpg", dir);
+    ASSERT_STREQ(path, expected);
+    Outbox_Remove(&outbox, "a.jpg");
+    Outbox_Remove(&outbox, "a.jpg"); // not exists
+    ASSERT_TRUE(Outbox_Next(&outbox, NULL, NULL, NULL, path, sizeof(path)));
+    ASSERT_STREQ(path, expected);
+    ASSERT_EQ(Outbox_Size(&outbox), 2);
+    Outbox_dtor(&outbox);
+    removeOutboxDir(dir);
+}
+
+GTEST_TEST(Outbox, watch)
+{
+    char *dir = outboxTempDir();
+    ASSERT_TRUE(dir != NULL);
+    int notified = 0;
+    Outbox outbox;
+    ASSERT_TRUE(Outbox_Open(&outbox, dir, &onNotify, &notified));
+    ASSERT_TRUE(Outbox_IsWatching(&outbox));
+    ASSERT_EQ(Outbox_Size(&outbox), 0);
+    touch(dir, "b.jpg");
+    touch(dir, "a.jpg");
+    for (int i = 0; i < 200 && Outbox_Size(&outbox) < 2; i++)
+    {
+        usleep(10000);
+    }
+    ASSERT_EQ(Outbox_Size(&outbox), 2);
+    ASSERT_GT(__atomic_load_n(&notified, __ATOMIC_ACQUIRE), 0);
+    char path[128];
+    char expected[128];
+    ASSERT_TRUE(Outbox_Next(&outbox, NULL, NULL, NULL, path, sizeof(path)));
+    sprintf(expected, "%s/a.jpg", dir);
+    ASSERT_STREQ(path, expected);
+    remove(path);
+    for (int i = 0; i < 200 && Outbox_Size(&outbox) > 1; i++)
+    {
+        usleep(10000);
+    }
+    ASSERT_EQ(Outbox_Size(&outbox), 1);
+    Outbox_dtor(&outbox);
+    removeOutboxDir(dir);
+}
+
+static int skipChecks = 0;
+
+// a.jpg b.jpg 已发送
+static bool skipSent(void *ctx, char const *path)
+{
+    skipChecks++;
+    return strstr(path, "/a.jpg") != NULL || strstr(path, "/b.jpg") != NULL;
+}
+
+GTEST_TEST(Outbox, cursor)
+{
+    char *dir = outboxTempDir();
+    ASSERT_TRUE(dir != NULL);
+    touch(dir, "a.jpg");
+    touch(dir, "b.jpg");
+    touch(dir, "d.jpg");
+    Outbox outbox;
+    ASSERT_TRUE(Outbox_Open(&outbox, dir, NULL, NULL));
+    OutboxCursor cursor;
+    OutboxCursor_ctor(&cursor);
+    char path[128];
+    char expected[128];
+    sprintf(expected, "%s/d.jpg", dir);
+    ASSERT_TRUE(Outbox_Next(&outbox, &cursor, &skipSent, NULL, path, sizeof(path)));
+    ASSERT_STREQ(path, expected);
+    ASSERT_EQ(skipChecks, 3);
+    // 已发送的前缀不再检查
+    skipChecks = 0;
+    ASSERT_TRUE(Outbox_Next(&outbox, &cursor, &skipSent, NULL, path, sizeof(path)));
+    ASSERT_STREQ(path, expected);
+    ASSERT_EQ(skipChecks, 1);
+    // 加入 cursor 之前的文件，从头开始
+    touch(dir, "c.jpg");
+    Outbox_Add(&outbox, "c.jpg");
+    skipChecks = 0;
+    ASSERT_TRUE(Outbox_Next(&outbox, &cursor, &skipSent, NULL, path, sizeof(path)));
+    sprintf(expected, "%s/c.jpg", dir);
+    ASSERT_STREQ(path, expected);
+    ASSERT_EQ(skipChecks, 3);
+    // 移除后同名文件重新加入
+    Outbox_Remove(&outbox, "b.jpg");
+    Outbox_Remove(&outbox, "c.jpg");
+    Outbox_Remove(&outbox, "d.jpg");
+    ASSERT_FALSE(Outbox_Next(&outbox, &cursor, &skipSent, NULL, path, sizeof(path)));
+    Outbox_Add(&outbox, "d.jpg");
+    ASSERT_TRUE(Outbox_Next(&outbox, &cursor, &skipSent, NULL, path, sizeof(path)));
+    sprintf(expected, "%s/d.jpg", dir);
+    ASSERT_STREQ(path, expected);
+    OutboxCursor_dtor(&cursor);
+    Outbox_dtor(&outbox);
+    removeOutboxDir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
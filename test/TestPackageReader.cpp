@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+
+#include "common/class.h"
+#include "cJSON/cJSON_Helper.h"
+#include "package_reader.h"
+
+static char const *const FILES[] = {
+    "timing_report.json",
+    "even_time_report.json",
+    "rain_5_min.json",
+    "water_5_min.json",
+    "hour_report.json",
+};
+#define FILE_COUNT (sizeof(FILES) / sizeof(FILES[0]))
+
+/**
+ * 在 test 目录中运行时使用 ./jsontopkg，否则在源文件所在的目录中查找
+ */
+static char const *fixture(size_t i)
+{
+    static char paths[FILE_COUNT][512];
+    if (paths[i][0] == '\0')
+    {
+        snprintf(paths[i], sizeof(paths[i]), "./jsontopkg/%s", FILES[i]);
+        int dirLen = -1;
+        for (int n = 0; __FILE__[n] != '\0'; n++)
+        {
+            if (__FILE__[n] == '/' || __FILE__[n] == '\\')
+            {
+                dirLen = n;
+            }
+        }
+        if (access(paths[i], R_OK) != 0 && dirLen >= 0)
+        {
+            snprintf(paths[i], sizeof(paths[i]), "%.*s/jsontopkg/%s", dirLen, __FILE__, FILES[i]);
+        }
+    }
+    return paths[i];
+}
+
+static ByteBuffer *encode(Package *pkg)
+{
+    ByteBuffer *buff = pkg->vptr->encode(pkg);
+    BB_Flip(buff);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    return buff;
+}
+
+// 与 cJSON + createPackage 的结果一致
+static void assertSameAsCreator(char const *file, Package *pkg)
+{
+    ASSERT_TRUE(pkg != NULL);
+    cJSON *data = cJSON_FromFile(file);
+    ASSERT_TRUE(data != NULL) << "can not read " << file;
+    ByteBuffer *expected = encode(createPackage(data));
+    ByteBuffer *actual = encode(pkg);
+    ASSERT_EQ(BB_Limit(expected), BB_Limit(actual));
+    ASSERT_EQ(memcmp(expected->buff, actual->buff, BB_Limit(expected)), 0);
+    BB_dtor(expected);
+    DelInstance(expected);
+    BB_dtor(actual);
+    DelInstance(actual);
+    cJSON_Delete(data);
+}
+
+static size_t readFile(char const *file, char *buff, size_t size)
+{
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+    {
+        return 0;
+    }
+    size_t len = fread(buff, 1, size, f);
+    fclose(f);
+    return len;
+}
+
+GTEST_TEST(PackageReader, sameAsCreatePackage)
+{
+    static char text[8192];
+    for (size_t i = 0; i < FILE_COUNT; i++)
+    {
+        size_t len = readFile(fixture(i), text, sizeof(text));
+        ASSERT_GT(len, 0) << "can not read " << fixture(i);
+        PackageReader reader;
+        PackageReader_ctor_memory(&reader, text, len);
+        Package *pkg = NULL;
+        ASSERT_TRUE(PackageReader_Next(&reader, &pkg));
+        assertSameAsCreator(fixture(i), pkg);
+        ASSERT_FALSE(PackageReader_Next(&reader, &pkg));
+        ASSERT_EQ(reader.status, PACKAGE_READER_END);
+        PackageReader_dtor(&reader);
+    }
+}
+
+GTEST_TEST(PackageReader, streamArray)
+{
+    // 多个读缓冲大小的数组，中间有一个无效的报文
+    FILE *f = tmpfile();
+    ASSERT_TRUE(f != NULL);
+    static char text[8192];
+    int rounds = 20;
+    fputs("[", f);
+    for (int r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < FILE_COUNT; i++)
+        {
+            size_t len = readFile(fixture(i), text, sizeof(text));
+            ASSERT_GT(len, 0) << "can not read " << fixture(i);
+            fputs(r == 0 && i == 0 ? "" : ",\n", f);
+            fwrite(text, 1, len, f);
+        }
+    }
+    fputs(",{\"elements\":[{\"t\":\"unknown\",\"v\":{\"x\":[1,2]}}], \"fcode\":\"32\"}", f);
+    fputs(",{\"elements\":[{\"v\":4,\"vt\":\"11\",\"id\":\"26\",\"t\":\"number\"}],\"direction\":0,\"fcode\":\"33\"}]", f);
+    ASSERT_GT(ftell(f), PACKAGE_READER_BUFF_SIZE * 4);
+    rewind(f);
+    PackageReader reader;
+    PackageReader_ctor(&reader, f);
+    Package *pkg = NULL;
+    for (int r = 0; r < rounds; r++)
+    {
+        for (size_t i = 0; i < FILE_COUNT; i++)
+        {
+            ASSERT_TRUE(PackageReader_Next(&reader, &pkg));
+            assertSameAsCreator(fixture(i), pkg);
+        }
+    }
+    ASSERT_TRUE(PackageReader_Next(&reader, &pkg));
+    ASSERT_TRUE(pkg == NULL); // 无效的 element
+    ASSERT_TRUE(PackageReader_Next(&reader, &pkg));
+    ASSERT_TRUE(pkg != NULL); // key 的顺序不影响
+    ASSERT_EQ(pkg->head.funcCode, 0x33);
+    NumberElement *el = (NumberElement *)LinkMessage_ElementAt((LinkMessage *)pkg, 0);
+    ASSERT_EQ(el->super.identifierLeader, 0x26);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    ASSERT_FALSE(PackageReader_Next(&reader, &pkg));
+    ASSERT_EQ(reader.status, PACKAGE_READER_END);
+    PackageReader_dtor(&reader);
+    fclose(f);
+}
+
+GTEST_TEST(PackageReader, syntaxError)
+{
+    char const *text = "[{\"fcode\":\"32\",\"elements\":[{\"t\":\"number\",\"id\":\"26\",\"vt\":\"11\",\"v\":4}]},{\"fcode\" 32}]";
+    PackageReader reader;
+    PackageReader_ctor_memory(&reader, text, strlen(text));
+    Package *pkg = NULL;
+    ASSERT_TRUE(PackageReader_Next(&reader, &pkg));
+    ASSERT_TRUE(pkg != NULL);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    ASSERT_FALSE(PackageReader_Next(&reader, &pkg));
+    ASSERT_EQ(reader.status, PACKAGE_READER_SYNTAX_ERROR);
+    PackageReader_dtor(&reader);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -155,6 +155,169 @@ GTEST_TEST(Packet_creator, hourReport)
     cJSON_Delete(data);
 }
 
+static ByteBuffer *encodeSchema(cJSON *data)
+{
+    Package *pkg = createPackage(data);
+    if (pkg == NULL)
+    {
+        return NULL;
+    }
+    ByteBuffer *buff = pkg->vptr->encode(pkg);
+    BB_Flip(buff);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    return buff;
+}
+
+GTEST_TEST(Packet_creator, reportTemplate)
+{
+    cJSON *data = cJSON_FromFile("./jsontopkg/hour_report.json");
+    ReportTemplate tpl;
+    ASSERT_TRUE(ReportTemplate_Compile(&tpl, data));
+    ASSERT_EQ(ReportTemplate_ValueCount(&tpl), 12 + 12 + 3);
+    ASSERT_EQ(tpl.observeTimeAt, 0); // schema 中固定了观测时间
+    double values[12 + 12 + 3];
+    for (int round = 0; round < 2; round++)
+    {
+        // 第二轮修改 schema 中的值，两种方式的编码结果一致
+        int i = 0;
+        cJSON *el;
+        cJSON_ArrayForEach(el, cJSON_GetObjectItem(data, "elements"))
+        {
+            cJSON *v = cJSON_GetObjectItem(el, "v");
+            if (cJSON_IsArray(v))
+            {
+                cJSON *item;
+                cJSON_ArrayForEach(item, v)
+                {
+                    if (round > 0)
+                    {
+                        cJSON_SetNumberValue(item, item->valuedouble + 0.1 * (i % 3));
+                    }
+                    values[i++] = item->valuedouble;
+                }
+            }
+            else if (cJSON_IsNumber(v))
+            {
+                if (round > 0)
+                {
+                    cJSON_SetNumberValue(v, v->valuedouble * 2);
+                }
+                values[i++] = v->valuedouble;
+            }
+        }
+        ASSERT_EQ(i, ReportTemplate_ValueCount(&tpl));
+        ASSERT_TRUE(ReportTemplate_Fill(&tpl, values));
+        ByteBuffer *expected = encodeSchema(data);
+        ASSERT_TRUE(expected != NULL);
+        ASSERT_EQ(BB_Limit(expected), BB_Limit(&tpl.frame));
+        ASSERT_EQ(memcmp(expected->buff, tpl.frame.buff, BB_Limit(expected)), 0);
+        BB_dtor(expected);
+        DelInstance(expected);
+    }
+    ReportTemplate_dtor(&tpl);
+    cJSON_Delete(data);
+}
+
+GTEST_TEST(Packet_creator, reportTemplateStation)
+{
+    cJSON *data = cJSON_FromFile("./jsontopkg/timing_report.json");
+    cJSON_DeleteItemFromObject(data, "observetime");
+    ReportTemplate tpl;
+    ASSERT_TRUE(ReportTemplate_Compile(&tpl, data));
+    ASSERT_EQ(ReportTemplate_ValueCount(&tpl), 3);
+    ASSERT_GT(tpl.observeTimeAt, 0);
+    ASSERT_GT(tpl.stationAddrElementAt, 0);
+    ASSERT_GT(tpl.categoryAt, 0);
+    RemoteStationAddr addr = {0};
+    addr.A5 = 0x12;
+    addr.A1 = 0x34;
+    ReportTemplate_SetStation(&tpl, &addr, 0x1234, RIVER_STATION);
+    double values[] = {4, -13.2, 0.06};
+    // 负值不能写入模板，frame 不变
+    uint8_t before[256];
+    memcpy(before, tpl.frame.buff, BB_Limit(&tpl.frame));
+    ASSERT_FALSE(ReportTemplate_Fill(&tpl, values));
+    ASSERT_EQ(memcmp(before, tpl.frame.buff, BB_Limit(&tpl.frame)), 0);
+    values[1] = 13.2;
+    ASSERT_TRUE(ReportTemplate_Fill(&tpl, values));
+    // 解码验证
+    ByteBuffer frame;
+    BB_ctor_copy(&frame, tpl.frame.buff, BB_Limit(&tpl.frame));
+    BB_Flip(&frame);
+    Package *pkg = decodePackage(&frame);
+    ASSERT_TRUE(pkg != NULL);
+    ASSERT_EQ(pkg->head.password, 0x1234);
+    ASSERT_EQ(pkg->head.stationAddr.A5, 0x12);
+    UplinkMessage *msg = (UplinkMessage *)pkg;
+    ASSERT_EQ(msg->messageHead.stationCategory, RIVER_STATION);
+    ASSERT_EQ(msg->messageHead.stationAddrElement.stationAddr.A5, 0x12);
+    ObserveTime now;
+    ObserveTime_now(&now);
+    ASSERT_EQ(msg->messageHead.observeTimeElement.observeTime.year, now.year);
+    NumberElement *el = (NumberElement *)LinkMessage_ElementAt((LinkMessage *)pkg, 1);
+    float fv = 0;
+    NumberElement_GetFloat(el, &fv);
+    ASSERT_FLOAT_EQ(13.2f, fv);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    BB_dtor(&frame);
+    ReportTemplate_dtor(&tpl);
+    cJSON_Delete(data);
+}
+
+GTEST_TEST(Packet_creator, reportSpec)
+{
+    // 与 timing_report.json 相同
+    ReportField fields[] = {
+        {0x26, 0x11, 4},
+        {0x39, 0x12, 13.2},
+        {0x38, 0x12, 0.06}};
+    ObserveTime observeTime = {20, 6, 10, 17, 0};
+    ReportSpec spec = {0x32, &observeTime, fields, 3};
+    RemoteStationAddr addr = {0};
+    ByteBuffer *frame = ReportSpec_Encode(&spec, &addr, 0, 0);
+    ASSERT_TRUE(frame != NULL);
+    cJSON *data = cJSON_FromFile("./jsontopkg/timing_report.json");
+    ByteBuffer *expected = encodeSchema(data);
+    ASSERT_TRUE(expected != NULL);
+    ASSERT_EQ(BB_Limit(expected), BB_Limit(frame));
+    // 跳过发报时间，createPackage 使用当前时间
+    uint32_t sendTimeAt = PACKAGE_HEAD_STX_LEN + 2;
+    ASSERT_EQ(memcmp(expected->buff, frame->buff, sendTimeAt), 0);
+    uint32_t restAt = sendTimeAt + DATETIME_LEN;
+    ASSERT_EQ(memcmp(expected->buff + restAt, frame->buff + restAt, BB_Limit(frame) - restAt - 2), 0);
+    Package *pkg = decodePackage(frame);
+    ASSERT_TRUE(pkg != NULL);
+    NumberElement *el = (NumberElement *)LinkMessage_ElementAt((LinkMessage *)pkg, 2);
+    float fv = 0;
+    NumberElement_GetFloat(el, &fv);
+    ASSERT_FLOAT_EQ(0.06f, fv);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+    // 负值: 不支持符号位时失败，支持时为 0xFF + 绝对值
+    fields[1].value = -12.5;
+    ASSERT_TRUE(ReportSpec_Encode(&spec, &addr, 0, 0) == NULL);
+    fields[1].supportSignedFlag = true;
+    ByteBuffer *negative = ReportSpec_Encode(&spec, &addr, 0, 0);
+    ASSERT_TRUE(negative != NULL);
+    ASSERT_EQ(BB_Limit(negative), BB_Limit(frame) + 1);
+    uint8_t const field[] = {0x39, 0x12, 0xFF, 0x12, 0x50};
+    uint8_t const *found = (uint8_t const *)memmem(negative->buff, BB_Limit(negative), field, sizeof(field));
+    ASSERT_TRUE(found != NULL);
+    BB_dtor(negative);
+    DelInstance(negative);
+    // 无效的 dataDef
+    fields[1].value = 13.2;
+    fields[1].dataDef = 0x02;
+    ASSERT_TRUE(ReportSpec_Encode(&spec, &addr, 0, 0) == NULL);
+    BB_dtor(expected);
+    DelInstance(expected);
+    BB_dtor(frame);
+    DelInstance(frame);
+    cJSON_Delete(data);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include "gtest/gtest.h"
+
+#include "rcu.h"
+
+static int freed = 0;
+
+static void countFree(void *ptr)
+{
+    freed++;
+    free(ptr);
+}
+
+static int *newInt(int v)
+{
+    int *p = (int *)malloc(sizeof(int));
+    *p = v;
+    return p;
+}
+
+GTEST_TEST(Rcu, waitReaderQuiescent)
+{
+    freed = 0;
+    Rcu rcu;
+    Rcu_ctor(&rcu, newInt(1), &countFree);
+    RcuReader *reader = Rcu_Register(&rcu);
+    ASSERT_TRUE(reader != NULL);
+    int const *seen = (int const *)Rcu_Dereference(&rcu);
+    Rcu_Publish(&rcu, newInt(2));
+    // reader 还没有经过静止状态，旧的对象仍然有效
+    ASSERT_EQ(freed, 0);
+    ASSERT_EQ(*seen, 1);
+    ASSERT_EQ(*(int const *)Rcu_Dereference(&rcu), 2);
+    Rcu_Quiescent(&rcu, reader);
+    ASSERT_EQ(Rcu_Reclaim(&rcu), 0);
+    ASSERT_EQ(freed, 1);
+    // offline 的 reader 不阻塞回收
+    Rcu_Offline(reader);
+    Rcu_Publish(&rcu, newInt(3));
+    ASSERT_EQ(freed, 2);
+    Rcu_Online(&rcu, reader);
+    ASSERT_EQ(*(int const *)Rcu_Dereference(&rcu), 3);
+    Rcu_Unregister(&rcu, reader);
+    Rcu_dtor(&rcu);
+    ASSERT_EQ(freed, 3);
+}
+
+GTEST_TEST(Rcu, readLock)
+{
+    freed = 0;
+    Rcu rcu;
+    Rcu_ctor(&rcu, newInt(1), &countFree);
+    Rcu_ReadLock(&rcu);
+    Rcu_Publish(&rcu, newInt(2));
+    Rcu_Publish(&rcu, newInt(3));
+    ASSERT_EQ(freed, 0);
+    Rcu_ReadUnlock(&rcu);
+    ASSERT_EQ(Rcu_Reclaim(&rcu), 0);
+    ASSERT_EQ(freed, 2);
+    Rcu_dtor(&rcu);
+    ASSERT_EQ(freed, 3);
+}
+
+GTEST_TEST(Rcu, retire)
+{
+    freed = 0;
+    Rcu rcu;
+    Rcu_ctor(&rcu, newInt(1), &countFree);
+    RcuReader *reader = Rcu_Register(&rcu);
+    ASSERT_TRUE(reader != NULL);
+    Rcu_Retire(&rcu, newInt(2), &countFree);
+    ASSERT_EQ(freed, 0);
+    Rcu_ReadLock(&rcu);
+    Rcu_Quiescent(&rcu, reader);
+    ASSERT_EQ(Rcu_Reclaim(&rcu), 1); // 未注册线程在读
+    Rcu_ReadUnlock(&rcu);
+    ASSERT_EQ(Rcu_Reclaim(&rcu), 0);
+    ASSERT_EQ(freed, 1);
+    Rcu_Retire(&rcu, newInt(3), &countFree);
+    Rcu_Unregister(&rcu, reader);
+    ASSERT_EQ(freed, 2);
+    Rcu_dtor(&rcu);
+    ASSERT_EQ(freed, 3);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+
+#include "resolver.h"
+
+typedef struct
+{
+    uint32_t base; // 每次解析返回不同的地址
+    int calls;
+    bool fail;
+} StubDns;
+
+static uint8_t stubLookup(void *data, char const *host, struct in_addr *addrs, uint8_t max, uint32_t *ttl)
+{
+    StubDns *dns = (StubDns *)data;
+    __atomic_fetch_add(&dns->calls, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&dns->fail, __ATOMIC_SEQ_CST) || strcmp(host, "center.example") != 0)
+    {
+        return 0;
+    }
+    *ttl = 1;
+    uint32_t base = __atomic_load_n(&dns->base, __ATOMIC_SEQ_CST);
+    addrs[0].s_addr = htonl(base + 1);
+    addrs[1].s_addr = htonl(base + 2);
+    return 2;
+}
+
+// 等待后台解析
+static uint8_t waitResolved(Resolver *resolver, ResolverEntry *entry, ResolverAddrs *addrs, uint32_t version)
+{
+    for (int i = 0; i < 200; i++)
+    {
+        // 先读 version，之后读到的地址不会比它旧
+        uint32_t current = __atomic_load_n(&entry->version, __ATOMIC_SEQ_CST);
+        uint8_t count = Resolver_Get(resolver, entry, addrs);
+        if (count > 0 && current != version)
+        {
+            return count;
+        }
+        usleep(10 * 1000);
+    }
+    return 0;
+}
+
+GTEST_TEST(Resolver, stubAndTtl)
+{
+    StubDns dns = {0x0A000000, 0, false};
+    Resolver resolver;
+    Resolver_ctor(&resolver);
+    resolver.lookup = &stubLookup;
+    resolver.data = &dns;
+    ResolverEntry *entry = Resolver_Add(&resolver, "center.example");
+    ASSERT_TRUE(entry == Resolver_Add(&resolver, "CENTER.example")); // 同一个 host
+    ResolverAddrs addrs;
+    ASSERT_EQ(waitResolved(&resolver, entry, &addrs, 0), 2);
+    ASSERT_EQ(addrs.addrs[0].s_addr, htonl(0x0A000001));
+    ASSERT_EQ(addrs.addrs[1].s_addr, htonl(0x0A000002));
+    // 过期后刷新，刷新前返回旧的地址
+    __atomic_store_n(&dns.base, 0x0A000010, __ATOMIC_SEQ_CST);
+    ASSERT_EQ(Resolver_Get(&resolver, entry, &addrs), 2);
+    ASSERT_EQ(addrs.addrs[0].s_addr, htonl(0x0A000001));
+    usleep(1100 * 1000);
+    ASSERT_EQ(waitResolved(&resolver, entry, &addrs, 1), 2);
+    ASSERT_EQ(addrs.addrs[0].s_addr, htonl(0x0A000011));
+    // 失败时保留之前的地址
+    __atomic_store_n(&dns.fail, true, __ATOMIC_SEQ_CST);
+    usleep(1100 * 1000);
+    int calls = __atomic_load_n(&dns.calls, __ATOMIC_SEQ_CST);
+    Resolver_Get(&resolver, entry, &addrs);
+    for (int i = 0; i < 200 && __atomic_load_n(&dns.calls, __ATOMIC_SEQ_CST) == calls; i++)
+    {
+        usleep(10 * 1000);
+    }
+    ASSERT_GT(__atomic_load_n(&dns.calls, __ATOMIC_SEQ_CST), calls);
+    ASSERT_EQ(Resolver_Get(&resolver, entry, &addrs), 2);
+    ASSERT_EQ(addrs.addrs[0].s_addr, htonl(0x0A000011));
+    // 无法解析
+    ResolverEntry *unknown = Resolver_Add(&resolver, "unknown.example");
+    usleep(100 * 1000);
+    ASSERT_EQ(Resolver_Get(&resolver, unknown, &addrs), 0);
+    Resolver_dtor(&resolver);
+}
+
+GTEST_TEST(Resolver, hostsFile)
+{
+    char file[] = "/tmp/sl651_hosts_XXXXXX";
+    int fd = mkstemp(file);
+    ASSERT_GE(fd, 0);
+    FILE *f = fdopen(fd, "w");
+    fputs("# comment\n"
+          "127.0.0.1 localhost\n"
+          "::1 center.local\n"
+          "192.168.1.10\tcenter.local backup.local # first\n"
+          "192.168.1.11 center.local\n",
+          f);
+    fclose(f);
+    struct in_addr addrs[RESOLVER_MAX_ADDRS];
+    ASSERT_EQ(Resolver_LookupHostsFile(file, "center.local", addrs, RESOLVER_MAX_ADDRS), 2);
+    ASSERT_EQ(addrs[0].s_addr, inet_addr("192.168.1.10"));
+    ASSERT_EQ(addrs[1].s_addr, inet_addr("192.168.1.11"));
+    ASSERT_EQ(Resolver_LookupHostsFile(file, "first", addrs, RESOLVER_MAX_ADDRS), 0);
+    // 先查找 hosts 文件
+    Resolver resolver;
+    Resolver_ctor(&resolver);
+    Resolver_SetHostsFile(&resolver, file);
+    ResolverEntry *entry = Resolver_Add(&resolver, "backup.local");
+    ResolverAddrs resolved;
+    ASSERT_EQ(waitResolved(&resolver, entry, &resolved, 0), 1);
+    ASSERT_EQ(resolved.addrs[0].s_addr, inet_addr("192.168.1.10"));
+    Resolver_dtor(&resolver);
+    unlink(file);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
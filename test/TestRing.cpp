@@ -0,0 +1,84 @@
+#include <pthread.h>
+#include <sched.h>
+#include "gtest/gtest.h"
+
+#include "ring/ring.h"
+
+GTEST_TEST(Ring, pushPop)
+{
+    Ring ring;
+    Ring_ctor(&ring, 3);
+    ASSERT_EQ(Ring_Capacity(&ring), 4);
+    ASSERT_TRUE(Ring_Pop(&ring) == NULL);
+    int values[5] = {1, 2, 3, 4, 5};
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(Ring_Push(&ring, &values[i]));
+    }
+    ASSERT_FALSE(Ring_Push(&ring, &values[4])); // full
+    ASSERT_EQ(Ring_Size(&ring), 4);
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(Ring_Pop(&ring), &values[i]); // FIFO
+    }
+    ASSERT_TRUE(Ring_Pop(&ring) == NULL);
+    // wrap around
+    ASSERT_TRUE(Ring_Push(&ring, &values[4]));
+    ASSERT_EQ(Ring_Pop(&ring), &values[4]);
+    Ring_dtor(&ring);
+}
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+
+static void *produce(void *arg)
+{
+    Ring *ring = (Ring *)arg;
+    for (uintptr_t i = 1; i <= PER_PRODUCER; i++)
+    {
+        while (!Ring_Push(ring, (void *)i))
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+GTEST_TEST(Ring, multiProducer)
+{
+    Ring ring;
+    Ring_ctor(&ring, 64);
+    pthread_t threads[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        pthread_create(&threads[i], NULL, &produce, &ring);
+    }
+    uint64_t sum = 0;
+    size_t count = 0;
+    while (count < PRODUCERS * PER_PRODUCER)
+    {
+        void *data = Ring_Pop(&ring);
+        if (data != NULL)
+        {
+            sum += (uintptr_t)data;
+            count++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    ASSERT_TRUE(Ring_Pop(&ring) == NULL);
+    ASSERT_EQ(sum, (uint64_t)PRODUCERS * PER_PRODUCER * (PER_PRODUCER + 1) / 2);
+    Ring_dtor(&ring);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -3307,8 +3307,119 @@ GTEST_TEST(Package, putItTogether)
     DelInstance(byteOut);
 }
 
+static ByteBuffer *encodeIntervalMessage(uint8_t centerAddr, uint16_t seq, DateTime const *sendTime)
+{
+    UplinkMessage *msg = NewInstance(UplinkMessage);
+    UplinkMessage_ctor(msg, 1);
+    Package *pkg = (Package *)msg;
+    pkg->head.centerAddr = centerAddr;
+    pkg->head.funcCode = INTERVAL;
+    msg->messageHead.seq = seq;
+    msg->messageHead.sendTime = *sendTime;
+    NumberElement *nel = NewInstance(NumberElement);
+    NumberElement_ctor(nel, 0x20, 0x19, false);
+    NumberElement_SetFloat(nel, 11.1);
+    LinkMessage_PushElement((LinkMessage *)msg, (Element *)nel);
+    ByteBuffer *byteOut = pkg->vptr->encode(pkg);
+    BB_Flip(byteOut);
+    UplinkMessage_dtor(pkg);
+    DelInstance(msg);
+    return byteOut;
+}
+
+GTEST_TEST(Package, patchEncoded)
+{
+    DateTime t1 = {20, 1, 2, 3, 4, 5};
+    DateTime t2 = {21, 12, 31, 23, 59, 58};
+    ByteBuffer *patched = encodeIntervalMessage(0, 0, &t1);
+    ByteBuffer *expected = encodeIntervalMessage(4, 0x1234, &t2);
+    ASSERT_FALSE(BB_Equal(patched, expected));
+    ASSERT_TRUE(Package_PatchEncoded(patched, 4, 0x1234, &t2));
+    ASSERT_TRUE(BB_Equal(patched, expected));
+    // 不修改发报时间
+    ASSERT_TRUE(Package_PatchEncoded(patched, 5, 0x1235, NULL));
+    Package *pkg = decodePackage(patched);
+    ASSERT_TRUE(pkg != NULL);
+    ASSERT_EQ(pkg->head.centerAddr, 5);
+    ASSERT_EQ(((UplinkMessage *)pkg)->messageHead.seq, 0x1235);
+    ASSERT_EQ(((UplinkMessage *)pkg)->messageHead.sendTime.second, 58);
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+
+    // 长度不足
+    ByteBuffer shortBuff;
+    BB_ctor_fromHexStr(&shortBuff, "7E7E00", 6);
+    BB_Flip(&shortBuff);
+    ASSERT_FALSE(Package_PatchEncoded(&shortBuff, 4, 1, &t2));
+    BB_dtor(&shortBuff);
+
+    BB_dtor(patched);
+    DelInstance(patched);
+    BB_dtor(expected);
+    DelInstance(expected);
+}
+
+static ByteBuffer *encodePictureMessage(uint16_t count, uint16_t seq, uint8_t const *data, uint32_t len)
+{
+    UplinkMessage *msg = NewInstance(UplinkMessage);
+    UplinkMessage_ctor(msg, 1);
+    Package *pkg = (Package *)msg;
+    pkg->head.funcCode = PICTURE;
+    pkg->head.stxFlag = SYN;
+    pkg->head.sequence.count = count;
+    pkg->head.sequence.seq = seq;
+    pkg->tail.etxFlag = seq == count ? ETX : ETB;
+    msg->messageHead.seq = 0x22;
+    PictureElement *picEl = NewInstance(PictureElement);
+    PictureElement_ctor(picEl, seq);
+    picEl->buff = NewInstance(ByteBuffer);
+    BB_ctor_copy(picEl->buff, (uint8_t *)data, len);
+    BB_Flip(picEl->buff);
+    LinkMessage_PushElement((LinkMessage *)msg, (Element *)picEl);
+    ByteBuffer *byteOut = pkg->vptr->encode(pkg);
+    BB_Flip(byteOut);
+    UplinkMessage_dtor(pkg);
+    DelInstance(msg);
+    return byteOut;
+}
+
+GTEST_TEST(Package, patchSynHead)
+{
+    uint8_t data[] = {0xFF, 0xD8, 0x01, 0x02, 0x03};
+    ByteBuffer *tpl = encodePictureMessage(1, 1, data, 1);         // 不能编码空的图片数据
+    uint32_t tplLen = BB_Limit(tpl) - PACKAGE_TAIL_LEN - 1; // 第一包的报文头，包括要素标识符
+    for (uint16_t seq = 1; seq <= 3; seq++)
+    {
+        uint32_t headLen = seq == 1 ? tplLen : PACKAGE_HEAD_SYN_LEN;
+        uint8_t frame[128] = {0};
+        memcpy(frame, tpl->buff, headLen);
+        ASSERT_TRUE(Package_PatchSynHead(frame, headLen + sizeof(data) - PACKAGE_HEAD_STX_LEN, 3, seq));
+        memcpy(frame + headLen, data, sizeof(data));
+        uint32_t len = headLen + sizeof(data);
+        frame[len++] = seq == 3 ? ETX : ETB;
+        uint16_t crc16 = CRC16_Update(CRC16_INIT_VALUE, frame, headLen);
+        crc16 = CRC16_Update(crc16, data, sizeof(data));
+        crc16 = CRC16_Update(crc16, frame + len - 1, 1);
+        frame[len++] = crc16 >> 8;
+        frame[len++] = crc16 & 0xFF;
+        ByteBuffer *expected = encodePictureMessage(3, seq, data, sizeof(data));
+        ASSERT_EQ(BB_Limit(expected), len);
+        ASSERT_EQ(memcmp(expected->buff, frame, len), 0);
+        BB_dtor(expected);
+        DelInstance(expected);
+    }
+    // 非 SYN 报文
+    DateTime t = {20, 1, 2, 3, 4, 5};
+    ByteBuffer *stx = encodeIntervalMessage(0, 0, &t);
+    ASSERT_FALSE(Package_PatchSynHead(stx->buff, 10, 1, 1));
+    BB_dtor(stx);
+    DelInstance(stx);
+    BB_dtor(tpl);
+    DelInstance(tpl);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gtest/gtest.h"
+
+#include "sent_index.h"
+
+static char *sentIndexFile(char *file)
+{
+    char dir[64];
+    strcpy(dir, "/tmp/sl651_idx_XXXXXX");
+    if (mkdtemp(dir) == NULL)
+    {
+        return NULL;
+    }
+    sprintf(file, "%s/records.idx", dir);
+    return file;
+}
+
+// 删除索引文件、压缩时的临时文件和导入的 json，再删除目录
+static void removeSentIndexFile(char const *file)
+{
+    char path[160];
+    char const *suffixes[] = {"", ".tmp", ".json"};
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s%s", file, suffixes[i]);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s", file);
+    char *slash = strrchr(path, '/');
+    if (slash != NULL)
+    {
+        *slash = '\0';
+        rmdir(path);
+    }
+}
+
+static size_t fileSize(char const *file)
+{
+    struct stat st;
+    return stat(file, &st) == 0 ? st.st_size : 0;
+}
+
+GTEST_TEST(SentIndex, addRemove)
+{
+    SentIndex index;
+    SentIndex_ctor(&index);
+    char path[64];
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(path, "/data/outbox/%d.jpg", i);
+        ASSERT_TRUE(SentIndex_Add(&index, path));
+    }
+    ASSERT_EQ(SentIndex_Count(&index), 1000);
+    ASSERT_TRUE(SentIndex_Add(&index, "/data/outbox/1.jpg")); // duplicated
+    ASSERT_EQ(SentIndex_Count(&index), 1000);
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(path, "/data/outbox/%d.jpg", i);
+        ASSERT_TRUE(SentIndex_Remove(&index, path));
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(path, "/data/outbox/%d.jpg", i);
+        ASSERT_EQ(SentIndex_Contains(&index, path), i % 2 == 1);
+    }
+    ASSERT_FALSE(SentIndex_Contains(&index, "/data/outbox/1000.jpg"));
+    SentIndex_dtor(&index);
+}
+
+GTEST_TEST(SentIndex, reopen)
+{
+    char file[128];
+    ASSERT_TRUE(sentIndexFile(file) != NULL);
+    SentIndex index;
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_TRUE(SentIndex_Add(&index, "a.txt"));
+    ASSERT_TRUE(SentIndex_Add(&index, "b.txt"));
+    ASSERT_TRUE(SentIndex_Remove(&index, "a.txt"));
+    SentIndex_dtor(&index);
+    // 不完整的记录
+    FILE *f = fopen(file, "ab");
+    fputc(SENT_INDEX_OP_ADD, f);
+    fclose(f);
+
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_EQ(SentIndex_Count(&index), 1);
+    ASSERT_FALSE(SentIndex_Contains(&index, "a.txt"));
+    ASSERT_TRUE(SentIndex_Contains(&index, "b.txt"));
+    ASSERT_EQ(fileSize(file), 3 * SENT_INDEX_RECORD_LEN);
+    SentIndex_dtor(&index);
+    removeSentIndexFile(file);
+}
+
+GTEST_TEST(SentIndex, compact)
+{
+    char file[128];
+    ASSERT_TRUE(sentIndexFile(file) != NULL);
+    SentIndex index;
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_TRUE(SentIndex_Add(&index, "keep.txt"));
+    for (int i = 0; i < SENT_INDEX_COMPACT_THRESHOLD; i++)
+    {
+        ASSERT_TRUE(SentIndex_Add(&index, "tmp.txt"));
+        ASSERT_TRUE(SentIndex_Remove(&index, "tmp.txt"));
+    }
+    ASSERT_LT(fileSize(file), (SENT_INDEX_COMPACT_THRESHOLD + 2) * SENT_INDEX_RECORD_LEN);
+    SentIndex_dtor(&index);
+
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_EQ(SentIndex_Count(&index), 1);
+    ASSERT_TRUE(SentIndex_Contains(&index, "keep.txt"));
+    SentIndex_dtor(&index);
+    removeSentIndexFile(file);
+}
+
+GTEST_TEST(SentIndex, importJSON)
+{
+    char file[128];
+    ASSERT_TRUE(sentIndexFile(file) != NULL);
+    char json[140];
+    sprintf(json, "%s.json", file);
+    FILE *f = fopen(json, "w");
+    fputs("{\"records\":{\"/data/1.jpg\":{},\"/data/2.jpg\":{}}}", f);
+    fclose(f);
+    SentIndex index;
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_TRUE(SentIndex_ImportJSON(&index, json));
+    ASSERT_TRUE(SentIndex_Contains(&index, "/data/1.jpg"));
+    ASSERT_TRUE(SentIndex_Contains(&index, "/data/2.jpg"));
+    SentIndex_dtor(&index);
+
+    SentIndex_ctor(&index);
+    ASSERT_TRUE(SentIndex_Open(&index, file));
+    ASSERT_EQ(SentIndex_Count(&index), 2);
+    SentIndex_dtor(&index);
+    removeSentIndexFile(file);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "gtest/gtest.h"
+
+#include "session_table.h"
+
+// value 由 key 得到，读到的 value 必须和 key 对应
+#define VALUE_OF(key_) ((void *)(uintptr_t)((key_) * 2 + 1))
+
+static uint64_t keyOf(uint32_t i)
+{
+    RemoteStationAddr addr = {0, 0, 0, 0, 0, 0};
+    addr.A5 = (i / 100000000) % 100;
+    addr.A4 = (i / 1000000) % 100;
+    addr.A3 = (i / 10000) % 100;
+    addr.A2 = (i / 100) % 100;
+    addr.A1 = i % 100;
+    return SessionTable_Key(&addr);
+}
+
+static void countVisit(uint64_t key, void *value, void *data)
+{
+    ASSERT_EQ(value, VALUE_OF(key));
+    (*(size_t *)data)++;
+}
+
+GTEST_TEST(SessionTable, key)
+{
+    RemoteStationAddr addr = {0, 12, 34, 56, 78, 0};
+    ASSERT_EQ(SessionTable_Key(&addr), SESSION_TABLE_KEY_TAG | 0x000C22384EULL);
+    // A0 不参与
+    addr.A0 = 9;
+    ASSERT_EQ(SessionTable_Key(&addr), SESSION_TABLE_KEY_TAG | 0x000C22384EULL);
+    RemoteStationAddr zero = {0, 0, 0, 0, 0, 0};
+    ASSERT_NE(SessionTable_Key(&zero), (uint64_t)SESSION_TABLE_KEY_EMPTY);
+}
+
+GTEST_TEST(SessionTable, insertGrowFind)
+{
+    SessionTable table;
+    SessionTable_ctor(&table, 4);
+    uint32_t const n = 10000;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t key = keyOf(i);
+        ASSERT_EQ(SessionTable_Insert(&table, key, VALUE_OF(key)), VALUE_OF(key));
+    }
+    ASSERT_EQ(SessionTable_Count(&table), n);
+    // 已存在时不替换
+    ASSERT_EQ(SessionTable_Insert(&table, keyOf(7), (void *)0x10), VALUE_OF(keyOf(7)));
+    ASSERT_EQ(SessionTable_Count(&table), n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(SessionTable_Find(&table, keyOf(i)), VALUE_OF(keyOf(i)));
+    }
+    ASSERT_TRUE(SessionTable_Find(&table, keyOf(n)) == NULL);
+    size_t visited = 0;
+    SessionTable_ForEach(&table, &countVisit, &visited);
+    ASSERT_EQ(visited, n);
+    SessionTable_dtor(&table);
+}
+
+GTEST_TEST(SessionTable, freeze)
+{
+    SessionTable table;
+    SessionTable_ctor(&table, 0);
+    ASSERT_FALSE(SessionTable_Freeze(&table)); // 空表
+    uint32_t const n = 5000;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        SessionTable_Insert(&table, keyOf(i * 7), VALUE_OF(keyOf(i * 7)));
+    }
+    ASSERT_TRUE(SessionTable_Freeze(&table));
+    ASSERT_TRUE(SessionTable_IsFrozen(&table));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(SessionTable_Find(&table, keyOf(i * 7)), VALUE_OF(keyOf(i * 7)));
+        ASSERT_TRUE(SessionTable_Find(&table, keyOf(i * 7 + 1)) == NULL);
+    }
+    size_t visited = 0;
+    SessionTable_ForEach(&table, &countVisit, &visited);
+    ASSERT_EQ(visited, n);
+    // 名单外的遥测站: 退回开放寻址
+    uint64_t key = keyOf(1);
+    ASSERT_EQ(SessionTable_Insert(&table, key, VALUE_OF(key)), VALUE_OF(key));
+    ASSERT_FALSE(SessionTable_IsFrozen(&table));
+    ASSERT_EQ(SessionTable_Count(&table), n + 1);
+    ASSERT_EQ(SessionTable_Find(&table, key), VALUE_OF(key));
+    ASSERT_EQ(SessionTable_Find(&table, keyOf(7 * 100)), VALUE_OF(keyOf(7 * 100)));
+    SessionTable_dtor(&table);
+}
+
+typedef struct
+{
+    SessionTable *table;
+    uint32_t n;
+    int stop;
+    int errors;
+} ReaderArgs;
+
+static void *readLoop(void *arg)
+{
+    ReaderArgs *args = (ReaderArgs *)arg;
+    RcuReader *reader = Rcu_Register(&args->table->rcu);
+    while (!__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE))
+    {
+        for (uint32_t i = 0; i < args->n; i += 13)
+        {
+            uint64_t key = keyOf(i);
+            void *value = SessionTable_Find(args->table, key);
+            if (value != NULL && value != VALUE_OF(key))
+            {
+                __atomic_fetch_add(&args->errors, 1, __ATOMIC_RELAXED);
+            }
+        }
+        Rcu_Quiescent(&args->table->rcu, reader);
+    }
+    Rcu_Unregister(&args->table->rcu, reader);
+    return NULL;
+}
+
+GTEST_TEST(SessionTable, concurrentReaders)
+{
+    SessionTable table;
+    SessionTable_ctor(&table, 0);
+    ReaderArgs args = {&table, 20000, 0, 0};
+    pthread_t readers[4];
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_create(&readers[i], NULL, &readLoop, &args);
+    }
+    for (uint32_t i = 0; i < args.n; i++)
+    {
+        SessionTable_Insert(&table, keyOf(i), VALUE_OF(keyOf(i)));
+        if (i == args.n / 2)
+        {
+            SessionTable_Freeze(&table);
+        }
+    }
+    __atomic_store_n(&args.stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+    ASSERT_EQ(args.errors, 0);
+    ASSERT_EQ(SessionTable_Count(&table), args.n);
+    ASSERT_EQ(Rcu_Reclaim(&table.rcu), 0);
+    SessionTable_dtor(&table);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+
+#include "common/class.h"
+#include "cJSON/cJSON_Helper.h"
+#include "station.h"
+#include "center.h"
+
+#define TEST_CHANNEL_ID 4
+#define TEST_REPORT_FIELDS 380 // 每个报文约 3.8K，接近最大长度
+
+// 一个 station + 一个本地的中心站 socket，station 在单独的线程中运行
+typedef struct
+{
+    Station station;
+    pthread_t thread;
+    char dir[32];
+    int listenFd;
+    int fd;
+} StationFixture;
+
+static void *runStation(void *arg)
+{
+    StationFixture *f = (StationFixture *)arg;
+    Station_StartBy(&f->station, f->dir);
+    return NULL;
+}
+
+/**
+ * 中心站接收缓冲区设置得很小，不读取时 station 的发送很快积压
+ * @param extra 追加到 config.json 的配置项
+ */
+static bool StationFixture_Start(StationFixture *f, char const *extra)
+{
+    memset(f, 0, sizeof(*f));
+    f->fd = -1;
+    strcpy(f->dir, "/tmp/sl651_station_XXXXXX");
+    if (mkdtemp(f->dir) == NULL)
+    {
+        return false;
+    }
+    f->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int rcvBuf = 4096;
+    setsockopt(f->listenFd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (bind(f->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(f->listenFd, 1) != 0 ||
+        getsockname(f->listenFd, (struct sockaddr *)&addr, &addrLen) != 0)
+    {
+        return false;
+    }
+    char file[64];
+    sprintf(file, "%s/config.json", f->dir);
+    FILE *fp = fopen(file, "w");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fprintf(fp,
+            "{\"centerAddrs\": {\"addr1\": 1, \"addr2\": 0, \"addr3\": 0, \"addr4\": 0},"
+            "\"remoteStationAddr\": {\"A5\": 0, \"A4\": 12, \"A3\": 34, \"A2\": 56, \"A1\": 78, \"A0\": 0},"
+            "\"channels\": [{\"id\": %d, \"type\": 2, \"keepaliveTimer\": 40, \"ipv4\": \"127.0.0.1\", \"port\": %d}],"
+            "\"password\": 1234, \"workMode\": 3, \"filesDir\": \"%s/files\", \"reactors\": 1%s%s}",
+            TEST_CHANNEL_ID, ntohs(addr.sin_port), f->dir, extra != NULL ? ", " : "", extra != NULL ? extra : "");
+    fclose(fp);
+    Station_ctor(&f->station);
+    if (pthread_create(&f->thread, NULL, &runStation, f) != 0)
+    {
+        return false;
+    }
+    struct pollfd pfd = {f->listenFd, POLLIN, 0};
+    if (poll(&pfd, 1, 5000) != 1)
+    {
+        return false;
+    }
+    f->fd = accept(f->listenFd, NULL, NULL);
+    // 等 channel 标记为已连接，之后投递的报文才有目标
+    Channel *ch = Config_FindChannel(&f->station.config, TEST_CHANNEL_ID);
+    for (int i = 0; i < 500 && ch != NULL && !__atomic_load_n(&ch->isConnected, __ATOMIC_ACQUIRE); i++)
+    {
+        usleep(10 * 1000);
+    }
+    return f->fd >= 0 && ch != NULL && __atomic_load_n(&ch->isConnected, __ATOMIC_ACQUIRE);
+}
+
+static void StationFixture_Stop(StationFixture *f)
+{
+    Station_Stop(&f->station);
+    pthread_join(f->thread, NULL);
+    Station_dtor(&f->station);
+    if (f->fd >= 0)
+    {
+        close(f->fd);
+    }
+    close(f->listenFd);
+    char cmd[64];
+    sprintf(cmd, "rm -rf %s", f->dir);
+    system(cmd);
+}
+
+// 第一个要素为报文的编号，其余用于填充
+static bool postReport(Station *station, uint32_t no)
+{
+    ReportField fields[TEST_REPORT_FIELDS];
+    fields[0] = {0x26, 0x20, (double)no};
+    for (int i = 1; i < TEST_REPORT_FIELDS; i++)
+    {
+        fields[i] = {0x39, 0x40, 1};
+    }
+    ReportSpec spec = {0x32, NULL, fields, TEST_REPORT_FIELDS};
+    return Station_AsyncSendSpec(station, &spec);
+}
+
+// 中心站一侧按报文读出
+typedef struct
+{
+    uint8_t buff[64 * 1024];
+    size_t len;
+} FrameReader;
+
+/**
+ * 读出下一个报文
+ * @return NULL: timeout(ms) 内没有完整的报文或报文无效
+ */
+static Package *FrameReader_Next(FrameReader *r, int fd, int timeout)
+{
+    int32_t frameLen = 0;
+    while (r->len == 0 || (frameLen = Center_FrameLength(r->buff, r->len)) == 0)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) != 1)
+        {
+            return NULL;
+        }
+        ssize_t n = recv(fd, r->buff + r->len, sizeof(r->buff) - r->len, 0);
+        if (n <= 0)
+        {
+            return NULL;
+        }
+        r->len += n;
+    }
+    if (frameLen < 0) // 写出半个报文后又写了别的
+    {
+        return NULL;
+    }
+    ByteBuffer frame;
+    BB_ctor_copy(&frame, r->buff, frameLen);
+    BB_Flip(&frame);
+    Package *pkg = decodePackage(&frame);
+    BB_dtor(&frame);
+    r->len -= frameLen;
+    memmove(r->buff, r->buff + frameLen, r->len);
+    return pkg;
+}
+
+static bool FrameReader_IsIdle(FrameReader *r, int fd, int timeout)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return r->len == 0 && poll(&pfd, 1, timeout) == 0;
+}
+
+static void freePackage(Package *pkg)
+{
+    pkg->vptr->dtor(pkg);
+    DelInstance(pkg);
+}
+
+/**
+ * 按编号检查 0x32 报文的顺序，其他报文(测试报等)跳过
+ * @param next 下一个报文的编号，读到 until 为止
+ */
+static bool receiveReports(FrameReader *r, int fd, uint32_t *next, uint32_t until)
+{
+    while (*next < until)
+    {
+        Package *pkg = FrameReader_Next(r, fd, 5000);
+        if (pkg == NULL)
+        {
+            return false;
+        }
+        bool ordered = true;
+        if (pkg->head.funcCode == 0x32)
+        {
+            float no = -1;
+            NumberElement_GetFloat((NumberElement *)LinkMessage_ElementAt((LinkMessage *)pkg, 0), &no);
+            ordered = (uint32_t)no == *next;
+            (*next)++;
+        }
+        freePackage(pkg);
+        if (!ordered)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+GTEST_TEST(Station, outputBackpressure)
+{
+    StationFixture f;
+    ASSERT_TRUE(StationFixture_Start(&f, "\"msgSendInterval\": 1"));
+    Channel *ch = Config_FindChannel(&f.station.config, TEST_CHANNEL_ID);
+    // 中心站不读: socket 写满后剩余部分留在 writeQueue，超过高水位后不再消费 sendRing
+    uint32_t posted = 0;
+    int rejected = 0;
+    for (int i = 0; i < 20000 && rejected < 50; i++)
+    {
+        if (postReport(&f.station, posted))
+        {
+            posted++;
+            rejected = 0;
+        }
+        else
+        {
+            rejected++;
+            usleep(10 * 1000);
+        }
+    }
+    ASSERT_EQ(rejected, 50);
+    ASSERT_TRUE(Channel_IsOutputBlocked(ch));
+    ASSERT_GT(__atomic_load_n(&ch->outBytes, __ATOMIC_RELAXED), CHANNEL_OUT_LOW_WATERMARK);
+    ASSERT_EQ(Ring_Size(&ch->sendRing), CHANNEL_SEND_RING_SIZE);
+
+    // 中心站读出积压的报文，低于低水位后恢复，报文不丢失、不重复、按顺序
+    static FrameReader reader;
+    uint32_t next = 0;
+    ASSERT_TRUE(receiveReports(&reader, f.fd, &next, posted));
+    for (int i = 0; i < 100 && Channel_IsOutputBlocked(ch); i++) // 最后一包写出后才清除
+    {
+        usleep(10 * 1000);
+    }
+    ASSERT_FALSE(Channel_IsOutputBlocked(ch));
+    ASSERT_TRUE(postReport(&f.station, posted));
+    ASSERT_TRUE(receiveReports(&reader, f.fd, &next, posted + 1));
+    ASSERT_EQ(Ring_Size(&ch->sendRing), 0);
+
+    StationFixture_Stop(&f);
+}
+
+#define TEST_FILE_PKG_SIZE 200 // buffSize 的最小值
+#define TEST_FILE_PKG_COUNT 10
+#define TEST_FILE_WINDOW 4
+
+// 中心站收到的文件分包，记录每包的次数和最后一次的报文，用于应答
+typedef struct
+{
+    int counts[TEST_FILE_PKG_COUNT + 1];
+    Package *chunks[TEST_FILE_PKG_COUNT + 1];
+} FileChunks;
+
+static bool receiveChunks(FileChunks *chunks, FrameReader *r, int fd, int n)
+{
+    while (n > 0)
+    {
+        Package *pkg = FrameReader_Next(r, fd, 1000);
+        if (pkg == NULL)
+        {
+            return false;
+        }
+        if (pkg->head.funcCode != PICTURE)
+        {
+            freePackage(pkg);
+            continue;
+        }
+        uint16_t no = pkg->head.sequence.seq;
+        if (pkg->head.stxFlag != SYN || no == 0 || no > TEST_FILE_PKG_COUNT)
+        {
+            freePackage(pkg);
+            return false;
+        }
+        if (chunks->chunks[no] != NULL)
+        {
+            freePackage(chunks->chunks[no]);
+        }
+        chunks->chunks[no] = pkg;
+        chunks->counts[no]++;
+        n--;
+    }
+    return true;
+}
+
+static bool replyChunk(FileChunks *chunks, int fd, uint16_t no, uint8_t etx)
+{
+    ByteBuffer *reply = Center_EncodeReply(chunks->chunks[no], etx);
+    if (reply == NULL)
+    {
+        return false;
+    }
+    uint32_t len = BB_Limit(reply);
+    bool res = send(fd, reply->buff, len, 0) == (ssize_t)len;
+    BB_dtor(reply);
+    DelInstance(reply);
+    return res;
+}
+
+GTEST_TEST(Station, fileWindow)
+{
+    StationFixture f;
+    ASSERT_TRUE(StationFixture_Start(&f, "\"msgSendInterval\": 1, \"buffSize\": 200, \"fileWindow\": 4"));
+    Channel *ch = Config_FindChannel(&f.station.config, TEST_CHANNEL_ID);
+    char file[64];
+    sprintf(file, "%s/picture.jpg", f.dir);
+    FILE *fp = fopen(file, "wb");
+    ASSERT_TRUE(fp != NULL);
+    for (int i = 0; i < TEST_FILE_PKG_SIZE * TEST_FILE_PKG_COUNT; i++)
+    {
+        fputc(i & 0xFF, fp);
+    }
+    fclose(fp);
+    ASSERT_TRUE(Station_AsyncSendFilePkg(&f.station, file));
+
+    static FrameReader reader;
+    FileChunks chunks;
+    memset(&chunks, 0, sizeof(chunks));
+    // 窗口已满，等待确认
+    ASSERT_TRUE(receiveChunks(&chunks, &reader, f.fd, TEST_FILE_WINDOW));
+    for (int no = 1; no <= TEST_FILE_WINDOW; no++)
+    {
+        ASSERT_EQ(chunks.counts[no], 1);
+    }
+    ASSERT_TRUE(FrameReader_IsIdle(&reader, f.fd, 300));
+    // 乱序确认，第 1 包未确认，窗口不移动
+    ASSERT_TRUE(replyChunk(&chunks, f.fd, 3, ACK));
+    ASSERT_TRUE(replyChunk(&chunks, f.fd, 2, ACK));
+    ASSERT_TRUE(FrameReader_IsIdle(&reader, f.fd, 300));
+    // 只重发缺失的包
+    ASSERT_TRUE(replyChunk(&chunks, f.fd, 1, NAK));
+    ASSERT_TRUE(receiveChunks(&chunks, &reader, f.fd, 1));
+    ASSERT_EQ(chunks.counts[1], 2);
+    ASSERT_TRUE(FrameReader_IsIdle(&reader, f.fd, 300));
+    // 1~3 已确认，窗口移到 4~7
+    ASSERT_TRUE(replyChunk(&chunks, f.fd, 1, ACK));
+    ASSERT_TRUE(receiveChunks(&chunks, &reader, f.fd, 3));
+    ASSERT_TRUE(FrameReader_IsIdle(&reader, f.fd, 300));
+    for (int no = 4; no <= 7; no++)
+    {
+        ASSERT_TRUE(replyChunk(&chunks, f.fd, no, ACK));
+    }
+    ASSERT_TRUE(receiveChunks(&chunks, &reader, f.fd, TEST_FILE_PKG_COUNT - 7));
+    for (int no = 8; no <= TEST_FILE_PKG_COUNT; no++)
+    {
+        ASSERT_TRUE(replyChunk(&chunks, f.fd, no, ACK));
+    }
+    for (int i = 0; i < 100 && Metric_Get(&ch->metrics.filesSent) == 0; i++)
+    {
+        usleep(10 * 1000);
+    }
+    ASSERT_EQ(Metric_Get(&ch->metrics.filesSent), 1);
+    ASSERT_EQ(Metric_Get(&ch->metrics.retransmits), 1);
+    ASSERT_EQ(chunks.counts[1], 2);
+    for (int no = 2; no <= TEST_FILE_PKG_COUNT; no++)
+    {
+        ASSERT_EQ(chunks.counts[no], 1);
+    }
+    ASSERT_TRUE(FrameReader_IsIdle(&reader, f.fd, 100));
+
+    for (int no = 1; no <= TEST_FILE_PKG_COUNT; no++)
+    {
+        freePackage(chunks.chunks[no]);
+    }
+    StationFixture_Stop(&f);
+}
+
+static uint64_t configVersion(Config *config)
+{
+    Rcu_ReadLock(&config->snapshots);
+    uint64_t version = Config_Current(config)->version;
+    Rcu_ReadUnlock(&config->snapshots);
+    return version;
+}
+
+static uint64_t waitConfigVersion(Config *config, uint64_t version)
+{
+    for (int i = 0; i < 100 && configVersion(config) < version; i++)
+    {
+        usleep(10 * 1000);
+    }
+    return configVersion(config);
+}
+
+GTEST_TEST(Station, configUpdateOnce)
+{
+    StationFixture f;
+    ASSERT_TRUE(StationFixture_Start(&f, NULL));
+    Config *config = &f.station.config;
+    uint64_t version = configVersion(config);
+    // 写入 configFile 触发的 reload 不再发布相同内容的版本
+    cJSON *patches = cJSON_Parse("[{\"op\": \"replace\", \"path\": \"/password\", \"value\": 4321}]");
+    ASSERT_TRUE(patches != NULL);
+    ASSERT_TRUE(Config_Update(config, patches));
+    cJSON_Delete(patches);
+    ASSERT_EQ(configVersion(config), version + 1);
+    ASSERT_EQ(waitConfigVersion(config, version + 2), version + 1);
+    // 外部修改仍然重新加载
+    Rcu_ReadLock(&config->snapshots);
+    cJSON *json = cJSON_Duplicate(Config_Current(config)->configInJSON, true);
+    Rcu_ReadUnlock(&config->snapshots);
+    ASSERT_TRUE(json != NULL);
+    cJSON_ReplaceItemInObject(json, "password", cJSON_CreateNumber(5678));
+    cJSON_WriteFile(json, config->configFile);
+    cJSON_Delete(json);
+    ASSERT_EQ(waitConfigVersion(config, version + 2), version + 2);
+    StationFixture_Stop(&f);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,43 @@
+#include "gtest/gtest.h"
+
+#include "token_bucket.h"
+
+GTEST_TEST(TokenBucket, rate)
+{
+    TokenBucket tb;
+    TokenBucket_ctor(&tb, 100, 1); // 10ms
+    ASSERT_TRUE(TokenBucket_Take(&tb, 1.0));
+    ASSERT_FALSE(TokenBucket_Take(&tb, 1.0));
+    ASSERT_NEAR(TokenBucket_Delay(&tb, 1.0), 0.01, 1e-9);
+    ASSERT_NEAR(TokenBucket_Delay(&tb, 1.004), 0.006, 1e-9);
+    ASSERT_FALSE(TokenBucket_Take(&tb, 1.009));
+    ASSERT_TRUE(TokenBucket_Take(&tb, 1.0101));
+    ASSERT_FALSE(TokenBucket_Take(&tb, 1.0101));
+    // 空闲很久也不会超过桶容量
+    ASSERT_TRUE(TokenBucket_Take(&tb, 100.0));
+    ASSERT_FALSE(TokenBucket_Take(&tb, 100.0));
+}
+
+GTEST_TEST(TokenBucket, burst)
+{
+    TokenBucket tb;
+    TokenBucket_ctor(&tb, 10, 3);
+    ASSERT_TRUE(TokenBucket_Take(&tb, 0));
+    ASSERT_TRUE(TokenBucket_Take(&tb, 0));
+    ASSERT_TRUE(TokenBucket_Take(&tb, 0));
+    ASSERT_FALSE(TokenBucket_Take(&tb, 0));
+    ASSERT_DOUBLE_EQ(TokenBucket_Delay(&tb, 0), 0.1);
+    // 不限速
+    TokenBucket_ctor(&tb, 0, 1);
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(TokenBucket_Take(&tb, 0));
+    }
+    ASSERT_DOUBLE_EQ(TokenBucket_Delay(&tb, 0), 0);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
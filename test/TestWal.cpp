@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "gtest/gtest.h"
+
+#include "wal.h"
+
+static char *walTempDir()
+{
+    static char dir[64];
+    strcpy(dir, "/tmp/sl651_wal_XXXXXX");
+    return mkdtemp(dir);
+}
+
+static void removeWalDir(char const *dir)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        return;
+    }
+    struct dirent *entry;
+    char path[128];
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static void fillRecord(uint8_t *buff, uint32_t len, uint32_t no)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        buff[i] = (uint8_t)(no + i);
+    }
+}
+
+// 后台落盘线程可能同时在 msync，丢弃的 segment 由最后结束的一次落盘解除映射
+static void syncUntilReleased(Wal *wal)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        Wal_Sync(wal);
+        pthread_mutex_lock(&wal->mutex);
+        bool released = wal->retired.length == 0;
+        pthread_mutex_unlock(&wal->mutex);
+        if (released)
+        {
+            return;
+        }
+        usleep(1000 * 10);
+    }
+}
+
+GTEST_TEST(Wal, appendPeekAdvance)
+{
+    char *dir = walTempDir();
+    ASSERT_TRUE(dir != NULL);
+    Wal wal;
+    ASSERT_TRUE(Wal_Open(&wal, dir, WAL_MIN_SEGMENT_SIZE, 4, 0));
+    Wal_Track(&wal, 4);
+    uint8_t const *data = NULL;
+    ASSERT_EQ(Wal_Peek(&wal, 4, &data), 0);
+    uint8_t buff[100];
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    }
+    // 没有 track 的 cursor 读不到数据
+    ASSERT_EQ(Wal_Peek(&wal, 5, &data), 0);
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_EQ(Wal_Peek(&wal, 4, &data), sizeof(buff));
+        ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+        ASSERT_EQ(Wal_Peek(&wal, 4, &data), sizeof(buff)); // peek again
+        Wal_Advance(&wal, 4);
+    }
+    ASSERT_EQ(Wal_Peek(&wal, 4, &data), 0);
+    ASSERT_EQ(Wal_Pending(&wal, 4), 0);
+    Wal_dtor(&wal);
+    removeWalDir(dir);
+}
+
+GTEST_TEST(Wal, replayAfterReopen)
+{
+    char *dir = walTempDir();
+    ASSERT_TRUE(dir != NULL);
+    Wal wal;
+    uint8_t buff[1000];
+    uint8_t const *data = NULL;
+    ASSERT_TRUE(Wal_Open(&wal, dir, WAL_MIN_SEGMENT_SIZE, 8, 0));
+    Wal_Track(&wal, 4);
+    Wal_Track(&wal, 6);
+    // 跨 segment
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    }
+    ASSERT_GT(wal.segments.length, 1);
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        ASSERT_EQ(Wal_Peek(&wal, 4, &data), sizeof(buff));
+        Wal_Advance(&wal, 4);
+    }
+    Wal_dtor(&wal);
+
+    ASSERT_TRUE(Wal_Open(&wal, dir, WAL_MIN_SEGMENT_SIZE, 8, 0));
+    Wal_Track(&wal, 4);
+    Wal_Track(&wal, 6);
+    for (uint32_t i = 30; i < 100; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_EQ(Wal_Peek(&wal, 4, &data), sizeof(buff));
+        ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+        Wal_Advance(&wal, 4);
+    }
+    ASSERT_EQ(Wal_Peek(&wal, 4, &data), 0);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_EQ(Wal_Peek(&wal, 6, &data), sizeof(buff));
+        ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+        Wal_Advance(&wal, 6);
+    }
+    // 都读完后，落盘时回收旧的 segment
+    Wal_Sync(&wal);
+    ASSERT_EQ(wal.segments.length, 1);
+    Wal_dtor(&wal);
+    removeWalDir(dir);
+}
+
+GTEST_TEST(Wal, full)
+{
+    char *dir = walTempDir();
+    ASSERT_TRUE(dir != NULL);
+    Wal wal;
+    uint8_t buff[1000] = {0};
+    uint8_t const *data = NULL;
+    ASSERT_TRUE(Wal_Open(&wal, dir, WAL_MIN_SEGMENT_SIZE, 2, 0));
+    Wal_Track(&wal, 4); // 一直不读，例如连接不上的 channel
+    Wal_Track(&wal, 6);
+    ASSERT_FALSE(Wal_Append(&wal, buff, WAL_MIN_SEGMENT_SIZE)); // too large
+    uint32_t perSegment = WAL_MIN_SEGMENT_SIZE / (sizeof(buff) + WAL_RECORD_HEAD_LEN);
+    for (uint32_t i = 0; i < perSegment; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    }
+    // 6 正在读第一个 segment
+    ASSERT_EQ(Wal_Peek(&wal, 6, &data), sizeof(buff));
+    Wal_Advance(&wal, 6);
+    // 写满后丢弃最老的 segment，其他 channel 仍然可以写入
+    for (uint32_t i = perSegment; i < perSegment * 3; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    }
+    ASSERT_EQ(wal.segments.length, 2);
+    ASSERT_EQ(wal.retired.length, 1); // 6 仍缓存着第一个 segment
+    // 6 读完缓存的 segment 后跳到最早保留的记录
+    for (uint32_t i = 1; i < perSegment; i++)
+    {
+        fillRecord(buff, sizeof(buff), i);
+        ASSERT_EQ(Wal_Peek(&wal, 6, &data), sizeof(buff));
+        ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+        Wal_Advance(&wal, 6);
+    }
+    fillRecord(buff, sizeof(buff), perSegment);
+    ASSERT_EQ(Wal_Peek(&wal, 6, &data), sizeof(buff));
+    ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+    // 4 从最早保留的记录开始
+    ASSERT_EQ(Wal_Peek(&wal, 4, &data), sizeof(buff));
+    ASSERT_EQ(memcmp(data, buff, sizeof(buff)), 0);
+    syncUntilReleased(&wal);
+    ASSERT_EQ(wal.retired.length, 0);
+    Wal_dtor(&wal);
+    removeWalDir(dir);
+}
+
+GTEST_TEST(Wal, dropWhileSyncing)
+{
+    char *dir = walTempDir();
+    ASSERT_TRUE(dir != NULL);
+    Wal wal;
+    uint8_t buff[1000] = {0};
+    ASSERT_TRUE(Wal_Open(&wal, dir, WAL_MIN_SEGMENT_SIZE, 2, 0));
+    Wal_Track(&wal, 4); // 一直不读，segment 只能被丢弃
+    uint32_t perSegment = WAL_MIN_SEGMENT_SIZE / (sizeof(buff) + WAL_RECORD_HEAD_LEN);
+    for (uint32_t i = 0; i < perSegment * 2; i++)
+    {
+        ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    }
+    ASSERT_EQ(wal.segments.length, 2);
+    // 模拟落盘线程释放锁 msync 期间写满
+    pthread_mutex_lock(&wal.mutex);
+    wal.syncing++;
+    pthread_mutex_unlock(&wal.mutex);
+    uint64_t dropped = vec_first(&wal.segments)->base;
+    ASSERT_TRUE(Wal_Append(&wal, buff, sizeof(buff)));
+    ASSERT_EQ(wal.segments.length, 2);
+    ASSERT_EQ(wal.retired.length, 1); // 文件已删除，映射保留到落盘结束
+    ASSERT_EQ(vec_first(&wal.retired)->base, dropped);
+    char file[128];
+    snprintf(file, sizeof(file), "%s/%016llx.wal", dir, (unsigned long long)dropped);
+    ASSERT_NE(access(file, F_OK), 0);
+    pthread_mutex_lock(&wal.mutex);
+    wal.syncing--;
+    pthread_mutex_unlock(&wal.mutex);
+    syncUntilReleased(&wal);
+    ASSERT_EQ(wal.retired.length, 0);
+    Wal_dtor(&wal);
+    removeWalDir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
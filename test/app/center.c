@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "center.h"
+
+static bool onReport(CenterConn *const conn, Package *const request)
+{
+    RemoteStationAddr const *addr = &conn->session->addr;
+    printf("station[%02d%02d%02d%02d%02d] func[%02X] seq[%d]\r\n",
+           addr->A5, addr->A4, addr->A3, addr->A2, addr->A1,
+           request->head.funcCode, ((UplinkMessage *)request)->messageHead.seq);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = argc > 1 ? atoi(argv[1]) : 60338;
+    long loops = sysconf(_SC_NPROCESSORS_ONLN);
+    Center center;
+    Center_ctor(&center, loops > 0 ? loops : 1, true);
+    Center_EnableDedup(&center, CENTER_DEDUP_WINDOW, CENTER_DEDUP_CAPACITY);
+    for (uint8_t code = TEST; code <= PICTURE; code++)
+    {
+        Center_SetHandler(&center, (FunctionCode)code, &onReport);
+    }
+    if (!Center_Listen(&center, NULL, port) || !Center_Start(&center))
+    {
+        printf("center listen on %d failed.\r\n", port);
+        Center_dtor(&center);
+        return -1;
+    }
+    printf("center listen on %d.\r\n", center.port);
+    // loop exit
+    ReactorPool_Join(&center.pool);
+    Center_dtor(&center);
+    return 0;
+}